@@ -31,6 +31,10 @@
 #include <ngx_http.h>
 #include <nginx.h>
 
+#if (NGX_ZLIB)
+#include <zlib.h>
+#endif
+
 typedef struct {
     ngx_queue_t                     queue;
     ngx_regex_t                    *agent;
@@ -47,6 +51,7 @@ typedef enum {
     PUSH_STREAM_TEMPLATE_PART_TYPE_CHANNEL,
     PUSH_STREAM_TEMPLATE_PART_TYPE_TEXT,
     PUSH_STREAM_TEMPLATE_PART_TYPE_SIZE,
+    PUSH_STREAM_TEMPLATE_PART_TYPE_DELTA,
     PUSH_STREAM_TEMPLATE_PART_TYPE_LITERAL
 } ngx_http_push_stream_template_part_type;
 
@@ -63,6 +68,7 @@ typedef struct {
     ngx_uint_t                      index;
     ngx_flag_t                      eventsource;
     ngx_flag_t                      websocket;
+    ngx_flag_t                      deflate;
     ngx_queue_t                     parts;
     ngx_uint_t                      qtd_message_id;
     ngx_uint_t                      qtd_event_id;
@@ -72,6 +78,7 @@ typedef struct {
     ngx_uint_t                      qtd_size;
     ngx_uint_t                      qtd_tag;
     ngx_uint_t                      qtd_time;
+    ngx_uint_t                      qtd_delta;
     size_t                          literal_len;
 } ngx_http_push_stream_template_t;
 
@@ -80,6 +87,26 @@ typedef struct ngx_http_push_stream_shm_data_s ngx_http_push_stream_shm_data_t;
 typedef struct ngx_http_push_stream_global_shm_data_s ngx_http_push_stream_global_shm_data_t;
 typedef struct ngx_http_push_stream_channel_s ngx_http_push_stream_channel_t;
 
+// token buckets, in thousandths of a message or byte, holding up to one second of the rate
+typedef struct {
+    ngx_msec_t                      last;
+    ngx_int_t                       messages;
+    ngx_int_t                       bytes;
+} ngx_http_push_stream_publish_bucket_t;
+
+typedef struct {
+    ngx_queue_t                             queue;
+    ngx_str_t                               prefix;
+    ngx_http_push_stream_publish_bucket_t   bucket;
+} ngx_http_push_stream_publish_limit_group_shm_t;
+
+typedef struct {
+    ngx_str_t                               prefix;
+    ngx_uint_t                              rate;
+    size_t                                  bytes_rate;
+    ngx_http_push_stream_publish_bucket_t  *bucket;
+} ngx_http_push_stream_publish_limit_group_t;
+
 typedef struct {
     ngx_flag_t                      enabled;
     ngx_str_t                       channel_deleted_message_text;
@@ -93,9 +120,16 @@ typedef struct {
     ngx_uint_t                      max_subscribers_per_channel;
     ngx_uint_t                      max_messages_stored_per_channel;
     ngx_uint_t                      max_channel_id_length;
+    ngx_uint_t                      polling_response_cache_entries;
     ngx_queue_t                     msg_templates;
     ngx_flag_t                      timeout_with_body;
     ngx_str_t                       events_channel_id;
+    ngx_str_t                       ingest_socket;
+    ngx_socket_t                    ingest_fd;
+    ngx_flag_t                      ingest_store_messages;
+    ngx_uint_t                      channel_publish_rate;
+    size_t                          channel_publish_bytes_rate;
+    ngx_array_t                    *publish_limit_groups;
     ngx_http_push_stream_channel_t *events_channel;
     ngx_regex_t                    *backtrack_parser_regex;
     ngx_http_push_stream_msg_t     *ping_msg;
@@ -118,16 +152,33 @@ typedef struct {
     ngx_msec_t                      ping_message_interval;
     ngx_msec_t                      subscriber_connection_ttl;
     ngx_msec_t                      longpolling_connection_ttl;
+    ngx_msec_t                      longpolling_linger_time;
+    ngx_uint_t                      longpolling_linger_messages;
     ngx_flag_t                      websocket_allow_publish;
+    ngx_flag_t                      websocket_allow_subscribe;
+    ngx_uint_t                      websocket_max_subscriptions;
+    ngx_flag_t                      websocket_deflate;
     ngx_flag_t                      channel_info_on_publish;
+    ngx_flag_t                      publish_async;
+    ngx_flag_t                      message_key_compaction;
+    ngx_flag_t                      message_delta;
     ngx_flag_t                      allow_connections_to_events_channel;
     ngx_http_complex_value_t       *last_received_message_time;
     ngx_http_complex_value_t       *last_received_message_tag;
     ngx_http_complex_value_t       *last_event_id;
+    ngx_http_complex_value_t       *event_types;
+    ngx_http_complex_value_t       *accept_message_delta;
     ngx_http_complex_value_t       *user_agent;
     ngx_str_t                       padding_by_user_agent;
     ngx_queue_t                    *paddings;
     ngx_http_complex_value_t       *allowed_origins;
+    ngx_msec_t                      output_coalescing_delay;
+    size_t                          output_coalescing_size;
+    size_t                          max_pending_output_size;
+    ngx_uint_t                      max_pending_output_messages;
+    ngx_uint_t                      pending_output_policy;
+    ngx_http_complex_value_t       *max_message_rate;
+    ngx_str_t                       conflation_event_id_separator;
 } ngx_http_push_stream_loc_conf_t;
 
 // shared memory segment name
@@ -141,13 +192,20 @@ struct ngx_http_push_stream_msg_s {
     time_t                          time;
     ngx_flag_t                      deleted;
     ngx_int_t                       id;
+    ngx_int_t                       delta_base; // id of the message the delta applies to, 0 for full messages
     ngx_str_t                       raw;
+    ngx_uint_t                      opcode;
     ngx_int_t                       tag;
     ngx_str_t                      *event_id;
     ngx_str_t                      *event_type;
+    ngx_str_t                       key;
+    ngx_str_t                      *replaced_event_id; // event id of the older message with the same key removed by this one
+    ngx_int_t                       replaced_id;       // id of that message, 0 when none was removed
     ngx_str_t                      *event_id_message;
     ngx_str_t                      *event_type_message;
     ngx_str_t                      *formatted_messages;
+    ngx_str_t                      *deflated_messages;
+    ngx_http_push_stream_msg_t     *delta;
     ngx_int_t                       workers_ref_count;
     ngx_uint_t                      qtd_templates;
 };
@@ -169,6 +227,7 @@ struct ngx_http_push_stream_channel_s {
     ngx_uint_t                          last_message_id;
     time_t                              last_message_time;
     ngx_int_t                           last_message_tag;
+    ngx_atomic_t                        last_message_version; // odd while last message time and tag are being changed
     ngx_uint_t                          stored_messages;
     ngx_uint_t                          subscribers;
     ngx_queue_t                         workers_with_subscribers;
@@ -178,6 +237,8 @@ struct ngx_http_push_stream_channel_s {
     ngx_flag_t                          wildcard;
     char                                for_events;
     ngx_http_push_stream_msg_t         *channel_deleted_message;
+    ngx_http_push_stream_msg_t         *snapshot_message;
+    ngx_http_push_stream_publish_bucket_t publish_bucket;
     ngx_shmtx_t                        *mutex;
 };
 
@@ -196,6 +257,7 @@ typedef struct {
     ngx_http_push_stream_subscriber_t  *subscriber;
     ngx_http_push_stream_channel_t     *channel;
     ngx_http_push_stream_pid_queue_t   *channel_worker_sentinel;
+    ngx_int_t                           last_message_id; // last message sent in sequence, used to send deltas
 } ngx_http_push_stream_subscription_t;
 
 struct ngx_http_push_stream_subscriber_s {
@@ -213,6 +275,22 @@ typedef struct {
     ngx_http_push_stream_channel_t *channel;
 } ngx_http_push_stream_requested_channel_t;
 
+typedef struct {
+    ngx_str_t                       id;
+    ngx_str_t                       event_id;
+    ngx_str_t                       event_type;
+    ngx_str_t                       message_key;
+    ngx_str_t                       text;
+    ngx_http_push_stream_channel_t *channel;
+} ngx_http_push_stream_batch_record_t;
+
+typedef struct {
+    ngx_queue_t                       queue;
+    ngx_http_push_stream_main_conf_t *mcf;
+    ngx_http_push_stream_channel_t   *channel;
+    ngx_http_push_stream_msg_t       *msg;
+} ngx_http_push_stream_pending_broadcast_t;
+
 typedef struct {
     unsigned char fin:1;
     unsigned char rsv1:1;
@@ -222,18 +300,81 @@ typedef struct {
     unsigned char mask:1;
     unsigned char mask_key[4];
     uint64_t payload_len;
-    u_char  header[8];
     u_char *payload;
     ngx_uint_t step;
     ngx_buf_t  buf;
-    ngx_str_t consolidated;
+    ngx_buf_t  recv_buf;
+    ngx_chain_t  *fragments;
+    ngx_chain_t **fragments_last;
+    size_t        fragments_len;
     unsigned char fragmented:1;
     unsigned char last_fragment:1;
+    unsigned char deflate:1;
+    unsigned char compressed:1;
 } ngx_http_push_stream_frame_t;
 
 typedef struct {
-    ngx_event_t                        *disconnect_timer;
-    ngx_event_t                        *ping_timer;
+    ngx_queue_t                         queue;
+    ngx_http_push_stream_channel_t     *channel; // ->shared memory, only used to identify the channel
+    ngx_http_push_stream_msg_t         *msg; // ->shared memory
+    size_t                              len;
+} ngx_http_push_stream_deferred_msg_t;
+
+typedef struct ngx_http_push_stream_timer_s ngx_http_push_stream_timer_t;
+typedef void (*ngx_http_push_stream_timer_handler_pt)(ngx_http_push_stream_timer_t *timer);
+
+// subscriber timers are kept on a per worker timer wheel instead of the nginx timers tree
+struct ngx_http_push_stream_timer_s {
+    ngx_queue_t                             queue;
+    ngx_msec_t                              expires;
+    ngx_flag_t                              timer_set;
+    ngx_http_push_stream_timer_handler_pt   handler;
+    void                                   *data;
+};
+
+#define NGX_HTTP_PUSH_STREAM_TIMER_WHEEL_SLOTS       512  // must be a power of 2
+#define NGX_HTTP_PUSH_STREAM_TIMER_WHEEL_RESOLUTION  100  // 100 milliseconds per slot
+
+typedef struct {
+    ngx_queue_t                             slots[NGX_HTTP_PUSH_STREAM_TIMER_WHEEL_SLOTS];
+    ngx_msec_t                              next_tick;
+    ngx_uint_t                              timers;
+    ngx_event_t                             event;
+} ngx_http_push_stream_timer_wheel_t;
+
+// rendered polling responses are kept on each worker while the requested channels do not change
+typedef struct {
+    ngx_http_push_stream_channel_t     *channel;
+    ngx_uint_t                          last_message_id;
+    time_t                              last_message_time;
+    ngx_int_t                           last_message_tag;
+    ngx_uint_t                          stored_messages;
+    ngx_http_push_stream_msg_t         *snapshot_message; // NULL when the channel had no snapshot or it was expired
+} ngx_http_push_stream_polling_cache_channel_t;
+
+typedef struct {
+    ngx_queue_t                                     queue;
+    ngx_queue_t                                     lru;
+    uint32_t                                        hash;
+    ngx_str_t                                       key;
+    ngx_uint_t                                      qtd_channels;
+    ngx_http_push_stream_polling_cache_channel_t   *channels;
+    time_t                                          last_modified_time;
+    ngx_int_t                                       tag;
+    ngx_str_t                                       body;
+} ngx_http_push_stream_polling_cache_entry_t;
+
+#define NGX_HTTP_PUSH_STREAM_POLLING_CACHE_BUCKETS   1024  // must be a power of 2
+
+typedef struct {
+    ngx_queue_t                             buckets[NGX_HTTP_PUSH_STREAM_POLLING_CACHE_BUCKETS];
+    ngx_queue_t                             lru;
+    ngx_uint_t                              entries;
+} ngx_http_push_stream_polling_cache_t;
+
+typedef struct {
+    ngx_http_push_stream_timer_t       *disconnect_timer;
+    ngx_http_push_stream_timer_t       *ping_timer;
     ngx_http_push_stream_subscriber_t  *subscriber;
     ngx_flag_t                          longpolling;
     ngx_flag_t                          message_sent;
@@ -244,6 +385,27 @@ typedef struct {
     ngx_str_t                          *callback;
     ngx_http_push_stream_requested_channel_t *requested_channels;
     ngx_http_push_stream_frame_t       *frame;
+    ngx_chain_t                        *pending;
+    ngx_chain_t                        *pending_last;
+    size_t                              pending_size;
+    ngx_msec_t                          pending_flush_time;
+    ngx_queue_t                         pending_queue;
+    ngx_flag_t                          hold_output;
+    ngx_uint_t                          pending_messages;
+    ngx_queue_t                         deferred_messages;
+    ngx_queue_t                         deferred_free;
+    ngx_uint_t                          deferred_qtd;
+    size_t                              deferred_size;
+    size_t                              memory_size;
+    ngx_array_t                        *polling_response;
+    ngx_event_t                        *linger_timer;
+    ngx_queue_t                         free_subscriptions;
+    ngx_array_t                        *event_types;
+    ngx_flag_t                          accept_delta;
+    ngx_msec_t                          message_interval;
+    ngx_msec_t                          next_message_slot;
+    ngx_queue_t                         conflated_messages;
+    ngx_event_t                        *rate_timer;
 } ngx_http_push_stream_module_ctx_t;
 
 // messages to worker processes
@@ -260,6 +422,7 @@ typedef struct {
     ngx_queue_t                         messages_queue;
     ngx_queue_t                         subscribers_queue;
     ngx_uint_t                          subscribers; // # of subscribers in the worker
+    ngx_uint_t                          subscribers_memory; // bytes of the pool blocks used by the connections of the subscribers in the worker
     time_t                              startup;
     pid_t                               pid;
 } ngx_http_push_stream_worker_data_t;
@@ -272,6 +435,7 @@ struct ngx_http_push_stream_global_shm_data_s {
 
 struct ngx_http_push_stream_shm_data_s {
     ngx_rbtree_t                            tree;
+    ngx_atomic_t                            tree_version;       // odd while the channels tree is being changed
     ngx_uint_t                              channels;           // # of channels being used
     ngx_uint_t                              wildcard_channels;  // # of wildcard channels being used
     ngx_uint_t                              published_messages; // # of published messagens in all channels
@@ -291,6 +455,13 @@ struct ngx_http_push_stream_shm_data_s {
     ngx_shmtx_sh_t                          channels_to_delete_lock;
     ngx_uint_t                              channels_in_trash;  // # of channels in trash queue
     ngx_uint_t                              messages_in_trash;  // # of messages in trash queue
+    ngx_uint_t                              slow_subscribers_disconnected;     // # of subscribers disconnected by pending output limits
+    ngx_uint_t                              slow_subscribers_dropped_messages; // # of messages dropped or conflated by pending output limits
+    ngx_uint_t                              ingested_messages; // # of messages published through the ingest socket
+    ngx_uint_t                              ingest_errors;     // # of datagrams refused by the ingest socket
+    ngx_atomic_t                            publish_requests;  // # of requests answered by publisher locations
+    ngx_atomic_t                            publish_latency;   // sum of the microseconds publishers waited for the answers
+    ngx_queue_t                             publish_limit_groups; // buckets of the channel prefixes with publish rate limits, kept across reloads
     ngx_http_push_stream_worker_data_t      ipc[NGX_MAX_PROCESSES]; // interprocess stuff
     time_t                                  startup;
     time_t                                  last_message_time;
@@ -307,6 +478,8 @@ struct ngx_http_push_stream_shm_data_s {
     ngx_shmtx_sh_t                          cleanup_lock;
     ngx_shmtx_t                             events_channel_mutex;
     ngx_shmtx_sh_t                          events_channel_lock;
+    ngx_shmtx_t                             publish_limit_groups_mutex;
+    ngx_shmtx_sh_t                          publish_limit_groups_lock;
 };
 
 ngx_shm_zone_t     *ngx_http_push_stream_global_shm_zone = NULL;
@@ -319,18 +492,21 @@ static ngx_int_t        ngx_http_push_stream_send_response_all_channels_info_sum
 static ngx_int_t        ngx_http_push_stream_send_response_all_channels_info_detailed(ngx_http_request_t *r, ngx_str_t *prefix);
 static ngx_int_t        ngx_http_push_stream_send_response_channels_info_detailed(ngx_http_request_t *r, ngx_http_push_stream_requested_channel_t *requested_channels);
 
-static ngx_int_t        ngx_http_push_stream_find_or_add_template(ngx_conf_t *cf, ngx_str_t template, ngx_flag_t eventsource, ngx_flag_t websocket);
+static ngx_int_t        ngx_http_push_stream_find_or_add_template(ngx_conf_t *cf, ngx_str_t template, ngx_flag_t eventsource, ngx_flag_t websocket, ngx_flag_t deflate);
 
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_ALL_CHANNELS_INFO_ID = ngx_string("ALL");
 
 static const ngx_str_t NGX_HTTP_PUSH_STREAM_NO_CHANNEL_ID_MESSAGE  = ngx_string("No channel id provided.");
 static const ngx_str_t NGX_HTTP_PUSH_STREAM_CHANNEL_ID_NOT_AUTHORIZED_MESSAGE = ngx_string("Channel id not authorized for this method.");
 static const ngx_str_t NGX_HTTP_PUSH_STREAM_EMPTY_POST_REQUEST_MESSAGE = ngx_string("Empty post requests are not allowed.");
+static const ngx_str_t NGX_HTTP_PUSH_STREAM_INVALID_BATCH_RECORD_MESSAGE = ngx_string("Invalid batch record.");
 static const ngx_str_t NGX_HTTP_PUSH_STREAM_TOO_LARGE_CHANNEL_ID_MESSAGE = ngx_string("Channel id is too large.");
 static const ngx_str_t NGX_HTTP_PUSH_STREAM_TOO_MUCH_WILDCARD_CHANNELS = ngx_string("Subscribed too much wildcard channels.");
+static const ngx_str_t NGX_HTTP_PUSH_STREAM_TOO_MUCH_SUBSCRIBED_CHANNELS = ngx_string("Subscribed too much channels.");
 static const ngx_str_t NGX_HTTP_PUSH_STREAM_TOO_SUBSCRIBERS_PER_CHANNEL = ngx_string("Subscribers limit per channel has been exceeded.");
 static const ngx_str_t NGX_HTTP_PUSH_STREAM_CANNOT_CREATE_CHANNELS = ngx_string("Subscriber could not create channels.");
 static const ngx_str_t NGX_HTTP_PUSH_STREAM_NUMBER_OF_CHANNELS_EXCEEDED_MESSAGE = ngx_string("Number of channels were exceeded.");
+static const ngx_str_t NGX_HTTP_PUSH_STREAM_PUBLISH_RATE_EXCEEDED_MESSAGE = ngx_string("Publish rate limit exceeded.");
 static const ngx_str_t NGX_HTTP_PUSH_STREAM_INTERNAL_ONLY_EVENTS_CHANNEL_MESSAGE = ngx_string("Only internal routines can change events channel.");
 static const ngx_str_t NGX_HTTP_PUSH_STREAM_SUBSCRIPTION_EVENTS_CHANNEL_FORBIDDEN_MESSAGE = ngx_string("Subscription to events channel is not allowed.");
 static const ngx_str_t NGX_HTTP_PUSH_STREAM_NO_MANDATORY_HEADERS_MESSAGE = ngx_string("Don't have at least one of the mandatory headers: Connection, Upgrade, Sec-WebSocket-Key and Sec-WebSocket-Version");
@@ -341,6 +517,10 @@ static const ngx_str_t NGX_HTTP_PUSH_STREAM_CHANNEL_DELETED = ngx_string("Channe
 #define NGX_HTTP_PUSH_STREAM_TOO_LARGE_CHANNEL_ID           (void *) -2
 #define NGX_HTTP_PUSH_STREAM_NUMBER_OF_CHANNELS_EXCEEDED    (void *) -3
 
+#ifndef NGX_HTTP_TOO_MANY_REQUESTS
+#define NGX_HTTP_TOO_MANY_REQUESTS                          429
+#endif
+
 static ngx_str_t        NGX_HTTP_PUSH_STREAM_EMPTY = ngx_string("");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_BACKTRACK_PATTERN = ngx_string("((\\.b([0-9]+))?(/|$))");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_CALLBACK = ngx_string("callback");
@@ -350,7 +530,11 @@ static const ngx_str_t  NGX_HTTP_PUSH_STREAM_DATE_FORMAT_ISO_8601 = ngx_string("
 // headers
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_EVENT_ID = ngx_string("Event-Id");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_EVENT_TYPE = ngx_string("Event-Type");
+static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_MESSAGE_KEY = ngx_string("Message-Key");
+static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_SNAPSHOT = ngx_string("Snapshot");
+static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_ACCEPT_DELTA = ngx_string("Accept-Delta");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_LAST_EVENT_ID = ngx_string("Last-Event-Id");
+static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_EVENT_TYPES = ngx_string("Event-Types");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_ALLOW = ngx_string("Allow");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_EXPLAIN = ngx_string("X-Nginx-PushStream-Explain");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_MODE = ngx_string("X-Nginx-PushStream-Mode");
@@ -358,11 +542,13 @@ static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_TAG = ngx_string("X-Nginx-Pu
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_COMMIT = ngx_string("X-Nginx-PushStream-Commit");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_ETAG = ngx_string("Etag");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_IF_NONE_MATCH = ngx_string("If-None-Match");
+static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_IF_MODIFIED_SINCE = ngx_string("If-Modified-Since");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_UPGRADE = ngx_string("Upgrade");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_CONNECTION = ngx_string("Connection");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_SEC_WEBSOCKET_KEY = ngx_string("Sec-WebSocket-Key");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_SEC_WEBSOCKET_VERSION = ngx_string("Sec-WebSocket-Version");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_SEC_WEBSOCKET_ACCEPT = ngx_string("Sec-WebSocket-Accept");
+static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_SEC_WEBSOCKET_EXTENSIONS = ngx_string("Sec-WebSocket-Extensions");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_ACCESS_CONTROL_ALLOW_ORIGIN = ngx_string("Access-Control-Allow-Origin");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_ACCESS_CONTROL_ALLOW_METHODS = ngx_string("Access-Control-Allow-Methods");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_HEADER_ACCESS_CONTROL_ALLOW_HEADERS = ngx_string("Access-Control-Allow-Headers");
@@ -371,12 +557,16 @@ static const ngx_str_t  NGX_HTTP_PUSH_STREAM_WEBSOCKET_UPGRADE = ngx_string("Web
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_WEBSOCKET_CONNECTION = ngx_string("Upgrade");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_WEBSOCKET_SIGN_KEY = ngx_string("258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_WEBSOCKET_SUPPORTED_VERSIONS = ngx_string("8, 13");
+static const ngx_str_t  NGX_HTTP_PUSH_STREAM_WEBSOCKET_PERMESSAGE_DEFLATE = ngx_string("permessage-deflate");
+// compressed frames are shared by all subscribers, so the compression context cannot be kept between messages
+static const ngx_str_t  NGX_HTTP_PUSH_STREAM_WEBSOCKET_PERMESSAGE_DEFLATE_RESPONSE = ngx_string("permessage-deflate; server_no_context_takeover; client_no_context_takeover");
 
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_101_STATUS_LINE = ngx_string("101 Switching Protocols");
 
 
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_MODE_NORMAL   = ngx_string("normal");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_MODE_ADMIN    = ngx_string("admin");
+static const ngx_str_t  NGX_HTTP_PUSH_STREAM_MODE_BATCH    = ngx_string("batch");
 
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_MODE_STREAMING   = ngx_string("streaming");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_MODE_POLLING     = ngx_string("polling");
@@ -393,6 +583,11 @@ static const ngx_str_t  NGX_HTTP_PUSH_STREAM_MODE_WEBSOCKET   = ngx_string("webs
 #define NGX_HTTP_PUSH_STREAM_PUBLISHER_MODE_NORMAL       5
 #define NGX_HTTP_PUSH_STREAM_PUBLISHER_MODE_ADMIN        6
 #define NGX_HTTP_PUSH_STREAM_STATISTICS_MODE             7
+#define NGX_HTTP_PUSH_STREAM_PUBLISHER_MODE_BATCH        8
+
+#define NGX_HTTP_PUSH_STREAM_PENDING_OUTPUT_DISCONNECT   0
+#define NGX_HTTP_PUSH_STREAM_PENDING_OUTPUT_DROP_OLDEST  1
+#define NGX_HTTP_PUSH_STREAM_PENDING_OUTPUT_CONFLATE     2
 
 
 #define NGX_HTTP_PUSH_STREAM_WEBSOCKET_VERSION_8         8
@@ -400,30 +595,42 @@ static const ngx_str_t  NGX_HTTP_PUSH_STREAM_MODE_WEBSOCKET   = ngx_string("webs
 
 #define NGX_HTTP_PUSH_STREAM_WEBSOCKET_SHA1_SIGNED_HASH_LENGTH 20
 #define NGX_HTTP_PUSH_STREAM_WEBSOCKET_FRAME_HEADER_MAX_LENGTH 144
+#define NGX_HTTP_PUSH_STREAM_WEBSOCKET_DEFLATE_WINDOW_BITS     15
 
 #define NGX_HTTP_PUSH_STREAM_WEBSOCKET_LAST_FRAME   0x8
+#define NGX_HTTP_PUSH_STREAM_WEBSOCKET_RSV1         0x4
 
 #define NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE  0x1
+#define NGX_HTTP_PUSH_STREAM_WEBSOCKET_BINARY_OPCODE 0x2
 #define NGX_HTTP_PUSH_STREAM_WEBSOCKET_CLOSE_OPCODE 0x8
 #define NGX_HTTP_PUSH_STREAM_WEBSOCKET_PING_OPCODE  0x9
 #define NGX_HTTP_PUSH_STREAM_WEBSOCKET_PONG_OPCODE  0xA
 
 static const u_char NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_LAST_FRAME_BYTE    =  NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE  | (NGX_HTTP_PUSH_STREAM_WEBSOCKET_LAST_FRAME << 4);
+static const u_char NGX_HTTP_PUSH_STREAM_WEBSOCKET_BINARY_LAST_FRAME_BYTE  =  NGX_HTTP_PUSH_STREAM_WEBSOCKET_BINARY_OPCODE | (NGX_HTTP_PUSH_STREAM_WEBSOCKET_LAST_FRAME << 4);
+static const u_char NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_LAST_DEFLATED_FRAME_BYTE = NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE | ((NGX_HTTP_PUSH_STREAM_WEBSOCKET_LAST_FRAME | NGX_HTTP_PUSH_STREAM_WEBSOCKET_RSV1) << 4);
+static const u_char NGX_HTTP_PUSH_STREAM_WEBSOCKET_BINARY_LAST_DEFLATED_FRAME_BYTE = NGX_HTTP_PUSH_STREAM_WEBSOCKET_BINARY_OPCODE | ((NGX_HTTP_PUSH_STREAM_WEBSOCKET_LAST_FRAME | NGX_HTTP_PUSH_STREAM_WEBSOCKET_RSV1) << 4);
+static const u_char NGX_HTTP_PUSH_STREAM_WEBSOCKET_DEFLATE_TAIL[]          = {0x00, 0x00, 0xff, 0xff};
 static const u_char NGX_HTTP_PUSH_STREAM_WEBSOCKET_CLOSE_LAST_FRAME_BYTE[] = {NGX_HTTP_PUSH_STREAM_WEBSOCKET_CLOSE_OPCODE | (NGX_HTTP_PUSH_STREAM_WEBSOCKET_LAST_FRAME << 4), 0x00};
 static const u_char NGX_HTTP_PUSH_STREAM_WEBSOCKET_PING_LAST_FRAME_BYTE[]  = {NGX_HTTP_PUSH_STREAM_WEBSOCKET_PING_OPCODE  | (NGX_HTTP_PUSH_STREAM_WEBSOCKET_LAST_FRAME << 4), 0x00};
+static const ngx_str_t NGX_HTTP_PUSH_STREAM_WEBSOCKET_PING_FRAME = { sizeof(NGX_HTTP_PUSH_STREAM_WEBSOCKET_PING_LAST_FRAME_BYTE), (u_char *) NGX_HTTP_PUSH_STREAM_WEBSOCKET_PING_LAST_FRAME_BYTE };
 static const u_char NGX_HTTP_PUSH_STREAM_WEBSOCKET_PONG_LAST_FRAME_BYTE[]  = {NGX_HTTP_PUSH_STREAM_WEBSOCKET_PONG_OPCODE  | (NGX_HTTP_PUSH_STREAM_WEBSOCKET_LAST_FRAME << 4), 0x00};
 static const u_char NGX_HTTP_PUSH_STREAM_WEBSOCKET_PAYLOAD_LEN_16_BYTE   = 126;
 static const u_char NGX_HTTP_PUSH_STREAM_WEBSOCKET_PAYLOAD_LEN_64_BYTE   = 127;
 
 static const ngx_str_t NGX_HTTP_PUSH_STREAM_WEBSOCKET_CLOSE_REASON = ngx_string("\x03\xF0{\"http_status\": %d, \"explain\":\"%V\"}");
 
+static const ngx_str_t NGX_HTTP_PUSH_STREAM_WEBSOCKET_SUBSCRIBE_COMMAND = ngx_string("SUBSCRIBE ");
+static const ngx_str_t NGX_HTTP_PUSH_STREAM_WEBSOCKET_UNSUBSCRIBE_COMMAND = ngx_string("UNSUBSCRIBE ");
+
 
 // other stuff
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_ALLOW_GET_POST_PUT_DELETE_METHODS = ngx_string("GET, POST, PUT, DELETE");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_ALLOW_GET_POST_PUT_METHODS = ngx_string("GET, POST, PUT");
+static const ngx_str_t  NGX_HTTP_PUSH_STREAM_ALLOW_POST_PUT_METHODS = ngx_string("POST, PUT");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_ALLOW_GET = ngx_string("GET");
 
-static const ngx_str_t  NGX_HTTP_PUSH_STREAM_ALLOWED_HEADERS = ngx_string("If-Modified-Since,If-None-Match,Etag,Event-Id,Event-Type,Last-Event-Id");
+static const ngx_str_t  NGX_HTTP_PUSH_STREAM_ALLOWED_HEADERS = ngx_string("If-Modified-Since,If-None-Match,Etag,Event-Id,Event-Type,Last-Event-Id,Event-Types,Message-Key,Snapshot,Accept-Delta");
 
 #define NGX_HTTP_PUSH_STREAM_CHECK_AND_FINALIZE_REQUEST_ON_ERROR(val, fail, r, errormessage) \
     if (val == fail) {                                                       \
@@ -446,6 +653,17 @@ static const ngx_str_t  NGX_HTTP_PUSH_STREAM_ALLOWED_HEADERS = ngx_string("If-Mo
 #define NGX_HTTP_PUSH_STREAM_DECREMENT_COUNTER_BY(counter, qtd) \
     (counter = (counter > qtd) ? counter - qtd : 0)
 
+// writers are already serialized by a mutex, the version lets readers check a lockless snapshot
+#define NGX_HTTP_PUSH_STREAM_VERSION_WRITE_BEGIN(version) \
+    ngx_atomic_fetch_add(&(version), 1);                   \
+    ngx_memory_barrier()
+
+#define NGX_HTTP_PUSH_STREAM_VERSION_WRITE_END(version)   \
+    ngx_memory_barrier();                                  \
+    ngx_atomic_fetch_add(&(version), 1)
+
+#define NGX_HTTP_PUSH_STREAM_TREE_MAX_DEPTH   128 // deeper than any balanced tree, only reached by a lookup racing a change
+
 #define NGX_HTTP_PUSH_STREAM_TIME_FMT_LEN   30 //sizeof("Mon, 28 Sep 1970 06:00:00 GMT")
 
 
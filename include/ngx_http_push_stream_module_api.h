@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2010-2015 Wandenberg Peixoto <wandenberg@gmail.com>, Rogério Carvalho Schneider <stockrt@gmail.com>
+ *
+ * This file is part of Nginx Push Stream Module.
+ *
+ * Nginx Push Stream Module is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nginx Push Stream Module is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Nginx Push Stream Module.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ngx_http_push_stream_module_api.h
+ *
+ * Created: Oct 18, 2026
+ * Authors: Wandenberg Peixoto <wandenberg@gmail.com>, Rogério Carvalho Schneider <stockrt@gmail.com>
+ *
+ * Functions to be used by other nginx modules to publish messages on the same worker, without a request to a publisher location.
+ * This header only depends on nginx core and may be copied to the include path of those modules.
+ * All functions must be called from a worker process, after the configuration was loaded.
+ *
+ * Return values:
+ *   NGX_OK       - the operation was done
+ *   NGX_DECLINED - the channel does not exist, or its id is not accepted for publishing (wildcard, ALL, too large or the events channel)
+ *   NGX_BUSY     - the channel does not exist and the maximum number of channels was reached
+ *   NGX_AGAIN    - the message was not published because the publish rate of the channel, or of a prefix matching it, was reached
+ *   NGX_ERROR    - the module is not in use or the operation failed, the reason is logged
+ */
+
+#ifndef NGX_HTTP_PUSH_STREAM_MODULE_API_H_
+#define NGX_HTTP_PUSH_STREAM_MODULE_API_H_
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+typedef struct {
+    ngx_uint_t                          published_messages;
+    ngx_uint_t                          stored_messages;
+    ngx_uint_t                          subscribers;
+} ngx_http_push_stream_api_channel_stats_t;
+
+// publish a text message to the channel, creating it if it doesn't exist. event_id and event_type may be NULL
+ngx_int_t   ngx_http_push_stream_api_publish(ngx_str_t *channel_id, u_char *text, size_t len, ngx_str_t *event_id, ngx_str_t *event_type, ngx_flag_t store_messages, ngx_log_t *log);
+
+// delete the channel, its subscribers receive the text, or the push_stream_channel_deleted_message_text when text is NULL
+ngx_int_t   ngx_http_push_stream_api_delete_channel(ngx_str_t *channel_id, u_char *text, size_t len, ngx_log_t *log);
+
+// fill the stats with the current values of the channel
+ngx_int_t   ngx_http_push_stream_api_channel_stats(ngx_str_t *channel_id, ngx_http_push_stream_api_channel_stats_t *stats, ngx_log_t *log);
+
+#endif /* NGX_HTTP_PUSH_STREAM_MODULE_API_H_ */
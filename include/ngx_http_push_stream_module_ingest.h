@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2010-2015 Wandenberg Peixoto <wandenberg@gmail.com>, Rogério Carvalho Schneider <stockrt@gmail.com>
+ *
+ * This file is part of Nginx Push Stream Module.
+ *
+ * Nginx Push Stream Module is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nginx Push Stream Module is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Nginx Push Stream Module.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ngx_http_push_stream_module_ingest.h
+ *
+ * Created: Oct 18, 2026
+ * Authors: Wandenberg Peixoto <wandenberg@gmail.com>, Rogério Carvalho Schneider <stockrt@gmail.com>
+ */
+
+#ifndef NGX_HTTP_PUSH_STREAM_MODULE_INGEST_H_
+#define NGX_HTTP_PUSH_STREAM_MODULE_INGEST_H_
+
+#include <ngx_http_push_stream_module.h>
+
+#include <sys/un.h>
+
+#define NGX_HTTP_PUSH_STREAM_INGEST_BUFFER_SIZE         65536
+#define NGX_HTTP_PUSH_STREAM_INGEST_DATAGRAMS_PER_EVENT 1024
+
+static ngx_connection_t *ngx_http_push_stream_ingest_connection = NULL;
+static u_char          *ngx_http_push_stream_ingest_buffer = NULL;
+static ngx_pool_t      *ngx_http_push_stream_ingest_pool = NULL;
+
+static ngx_int_t        ngx_http_push_stream_ingest_init_module(ngx_cycle_t *cycle);
+static void             ngx_http_push_stream_ingest_cleanup(void *data);
+static void             ngx_http_push_stream_ingest_init_worker(ngx_cycle_t *cycle);
+static void             ngx_http_push_stream_ingest_exit_worker(ngx_cycle_t *cycle);
+static void             ngx_http_push_stream_ingest_handler(ngx_event_t *ev);
+static ngx_int_t        ngx_http_push_stream_ingest_message(ngx_http_push_stream_main_conf_t *mcf, ngx_str_t *id, u_char *text, size_t len, ngx_pool_t *temp_pool, ngx_log_t *log);
+
+#endif /* NGX_HTTP_PUSH_STREAM_MODULE_INGEST_H_ */
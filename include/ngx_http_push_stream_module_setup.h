@@ -33,6 +33,7 @@
 #include <ngx_http_push_stream_module_publisher.h>
 #include <ngx_http_push_stream_module_subscriber.h>
 #include <ngx_http_push_stream_module_websocket.h>
+#include <ngx_http_push_stream_module_ingest.h>
 
 #define NGX_HTTP_PUSH_STREAM_MESSAGE_BUFFER_CLEANUP_INTERVAL                5000     // 5 seconds
 static time_t NGX_HTTP_PUSH_STREAM_DEFAULT_SHM_MEMORY_CLEANUP_OBJECTS_TTL = 10;      // 10 seconds
@@ -52,6 +53,10 @@ static time_t NGX_HTTP_PUSH_STREAM_DEFAULT_CHANNEL_INACTIVITY_TIME        = 30;
 
 #define NGX_HTTP_PUSH_STREAM_DEFAULT_EVENTS_CHANNEL_ID ""
 
+#define NGX_HTTP_PUSH_STREAM_DEFAULT_CONFLATION_EVENT_ID_SEPARATOR ""
+
+#define NGX_HTTP_PUSH_STREAM_DEFAULT_WEBSOCKET_MAX_SUBSCRIPTIONS 100
+
 static char *       ngx_http_push_stream_channels_statistics(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
 
 // publisher
@@ -64,6 +69,7 @@ static char *       ngx_http_push_stream_subscriber(ngx_conf_t *cf, ngx_command_
 static char *       ngx_http_push_stream_setup_handler(ngx_conf_t *cf, void *conf, ngx_int_t (*handler) (ngx_http_request_t *));
 static ngx_int_t    ngx_http_push_stream_init_module(ngx_cycle_t *cycle);
 static ngx_int_t    ngx_http_push_stream_init_worker(ngx_cycle_t *cycle);
+static void         ngx_http_push_stream_init_worker_ping_messages(ngx_cycle_t *cycle);
 static void         ngx_http_push_stream_exit_worker(ngx_cycle_t *cycle);
 static void         ngx_http_push_stream_exit_master(ngx_cycle_t *cycle);
 static ngx_int_t    ngx_http_push_stream_preconfig(ngx_conf_t *cf);
@@ -77,6 +83,9 @@ static char *       ngx_http_push_stream_merge_loc_conf(ngx_conf_t *cf, void *pa
 char *              ngx_http_push_stream_set_shm_size_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
 ngx_int_t           ngx_http_push_stream_init_shm_zone(ngx_shm_zone_t *shm_zone, void *data);
 ngx_int_t           ngx_http_push_stream_init_global_shm_zone(ngx_shm_zone_t *shm_zone, void *data);
+static ngx_int_t    ngx_http_push_stream_init_publish_limit_groups(ngx_http_push_stream_main_conf_t *mcf, ngx_http_push_stream_shm_data_t *d);
+
+char *              ngx_http_push_stream_set_publish_limit_group_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
 
 char *              ngx_http_push_stream_set_header_template_from_file(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
 
@@ -27,6 +27,6 @@
 #define NGX_HTTP_PUSH_STREAM_MODULE_SUBSCRIBER_H_
 
 static ngx_int_t    ngx_http_push_stream_subscriber_handler(ngx_http_request_t *r);
-static ngx_int_t    ngx_http_push_stream_validate_channels(ngx_http_request_t *r, ngx_http_push_stream_requested_channel_t *channels_ids, ngx_int_t *status_code, ngx_str_t **explain_error_message);
+static ngx_int_t    ngx_http_push_stream_validate_channels(ngx_http_request_t *r, ngx_http_push_stream_requested_channel_t *channels_ids, ngx_http_push_stream_subscriber_t *subscriber, ngx_int_t *status_code, ngx_str_t **explain_error_message);
 
 #endif /* NGX_HTTP_PUSH_STREAM_MODULE_SUBSCRIBER_H_ */
@@ -56,7 +56,7 @@ static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNEL_INFO_GROUP_HEAD_PLAIN = ngx_strin
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNEL_INFO_GROUP_TAIL_PLAIN = ngx_string(CRLF);
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNEL_INFO_GROUP_ITEM_PLAIN = ngx_string(NGX_HTTP_PUSH_STREAM_CHANNEL_INFO_PLAIN_PATTERN "," CRLF);
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNEL_INFO_GROUP_LAST_ITEM_PLAIN = ngx_string(NGX_HTTP_PUSH_STREAM_CHANNEL_INFO_PLAIN_PATTERN);
-static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNELS_INFO_SUMMARIZED_PLAIN = ngx_string("hostname: %s" CRLF "time: %s" CRLF "channels: %ui" CRLF "wildcard_channels: %ui" CRLF "published_messages: %ui" CRLF "stored_messages: %ui" CRLF "messages_in_trash: %ui" CRLF "channels_in_trash: %ui" CRLF "subscribers: %ui" CRLF "uptime: %ui" CRLF "by_worker:"CRLF"%s" CRLF);
+static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNELS_INFO_SUMMARIZED_PLAIN = ngx_string("hostname: %s" CRLF "time: %s" CRLF "channels: %ui" CRLF "wildcard_channels: %ui" CRLF "published_messages: %ui" CRLF "stored_messages: %ui" CRLF "messages_in_trash: %ui" CRLF "channels_in_trash: %ui" CRLF "subscribers: %ui" CRLF "slow_subscribers_disconnected: %ui" CRLF "slow_subscribers_dropped_messages: %ui" CRLF "ingested_messages: %ui" CRLF "ingest_errors: %ui" CRLF "publish_latency_usec: %ui" CRLF "pool_bytes_per_subscriber: %ui" CRLF "uptime: %ui" CRLF "by_worker:"CRLF"%s" CRLF);
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNELS_INFO_SUMMARIZED_WORKER_ITEM_PLAIN = ngx_string(NGX_HTTP_PUSH_STREAM_WORKER_INFO_PLAIN_PATTERN "," CRLF);
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNELS_INFO_SUMMARIZED_WORKER_LAST_ITEM_PLAIN = ngx_string(NGX_HTTP_PUSH_STREAM_WORKER_INFO_PLAIN_PATTERN);
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CONTENT_TYPE_PLAIN = ngx_string("text/plain");
@@ -69,7 +69,7 @@ static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNEL_INFO_GROUP_HEAD_JSON = ngx_string
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNEL_INFO_GROUP_TAIL_JSON = ngx_string("]}" CRLF);
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNEL_INFO_GROUP_ITEM_JSON = ngx_string(NGX_HTTP_PUSH_STREAM_CHANNEL_INFO_JSON_PATTERN "," CRLF);
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNEL_INFO_GROUP_LAST_ITEM_JSON = ngx_string(NGX_HTTP_PUSH_STREAM_CHANNEL_INFO_JSON_PATTERN CRLF);
-static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNELS_INFO_SUMMARIZED_JSON = ngx_string("{\"hostname\": \"%s\", \"time\": \"%s\", \"channels\": %ui, \"wildcard_channels\": %ui, \"published_messages\": %ui, \"stored_messages\": %ui, \"messages_in_trash\": %ui, \"channels_in_trash\": %ui, \"subscribers\": %ui, \"uptime\": %ui, \"by_worker\": [" CRLF "%s" CRLF"]}" CRLF);
+static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNELS_INFO_SUMMARIZED_JSON = ngx_string("{\"hostname\": \"%s\", \"time\": \"%s\", \"channels\": %ui, \"wildcard_channels\": %ui, \"published_messages\": %ui, \"stored_messages\": %ui, \"messages_in_trash\": %ui, \"channels_in_trash\": %ui, \"subscribers\": %ui, \"slow_subscribers_disconnected\": %ui, \"slow_subscribers_dropped_messages\": %ui, \"ingested_messages\": %ui, \"ingest_errors\": %ui, \"publish_latency_usec\": %ui, \"pool_bytes_per_subscriber\": %ui, \"uptime\": %ui, \"by_worker\": [" CRLF "%s" CRLF"]}" CRLF);
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNELS_INFO_SUMMARIZED_WORKER_ITEM_JSON = ngx_string(NGX_HTTP_PUSH_STREAM_WORKER_INFO_JSON_PATTERN "," CRLF);
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNELS_INFO_SUMMARIZED_WORKER_LAST_ITEM_JSON = ngx_string(NGX_HTTP_PUSH_STREAM_WORKER_INFO_JSON_PATTERN);
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CONTENT_TYPE_JSON = ngx_string("application/json");
@@ -82,7 +82,7 @@ static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNEL_INFO_GROUP_HEAD_YAML = ngx_string
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNEL_INFO_GROUP_TAIL_YAML = ngx_string(CRLF);
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNEL_INFO_GROUP_ITEM_YAML = ngx_string(" -" CRLF NGX_HTTP_PUSH_STREAM_CHANNEL_INFO_YAML_PATTERN CRLF);
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNEL_INFO_GROUP_LAST_ITEM_YAML = ngx_string(" -" CRLF NGX_HTTP_PUSH_STREAM_CHANNEL_INFO_YAML_PATTERN);
-static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNELS_INFO_SUMMARIZED_YAML = ngx_string("  hostname: %s" CRLF"  time: %s" CRLF"  channels: %ui" CRLF"  wildcard_channels: %ui" CRLF"  published_messages: %ui" CRLF"  stored_messages: %ui" CRLF"  messages_in_trash: %ui" CRLF"  channels_in_trash: %ui" CRLF"  subscribers: %ui" CRLF"  uptime: %ui" CRLF"  by_worker:"CRLF"%s" CRLF);
+static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNELS_INFO_SUMMARIZED_YAML = ngx_string("  hostname: %s" CRLF"  time: %s" CRLF"  channels: %ui" CRLF"  wildcard_channels: %ui" CRLF"  published_messages: %ui" CRLF"  stored_messages: %ui" CRLF"  messages_in_trash: %ui" CRLF"  channels_in_trash: %ui" CRLF"  subscribers: %ui" CRLF"  slow_subscribers_disconnected: %ui" CRLF"  slow_subscribers_dropped_messages: %ui" CRLF"  ingested_messages: %ui" CRLF"  ingest_errors: %ui" CRLF"  publish_latency_usec: %ui" CRLF"  pool_bytes_per_subscriber: %ui" CRLF"  uptime: %ui" CRLF"  by_worker:"CRLF"%s" CRLF);
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNELS_INFO_SUMMARIZED_WORKER_ITEM_YAML = ngx_string("   -" CRLF NGX_HTTP_PUSH_STREAM_WORKER_INFO_YAML_PATTERN CRLF);
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNELS_INFO_SUMMARIZED_WORKER_LAST_ITEM_YAML = ngx_string("   -" CRLF NGX_HTTP_PUSH_STREAM_WORKER_INFO_YAML_PATTERN);
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CONTENT_TYPE_YAML = ngx_string("application/yaml");
@@ -119,12 +119,19 @@ static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNELS_INFO_SUMMARIZED_XML = ngx_string
         "  <messages_in_trash>%ui</messages_in_trash>" CRLF \
         "  <channels_in_trash>%ui</channels_in_trash>" CRLF \
         "  <subscribers>%ui</subscribers>" CRLF \
+        "  <slow_subscribers_disconnected>%ui</slow_subscribers_disconnected>" CRLF \
+        "  <slow_subscribers_dropped_messages>%ui</slow_subscribers_dropped_messages>" CRLF \
+        "  <ingested_messages>%ui</ingested_messages>" CRLF \
+        "  <ingest_errors>%ui</ingest_errors>" CRLF \
+        "  <publish_latency_usec>%ui</publish_latency_usec>" CRLF \
+        "  <pool_bytes_per_subscriber>%ui</pool_bytes_per_subscriber>" CRLF \
         "  <uptime>%ui</uptime>" CRLF \
         "  <by_worker>%s</by_worker>" CRLF \
         "</infos>" CRLF);
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNELS_INFO_SUMMARIZED_WORKER_ITEM_XML = ngx_string(NGX_HTTP_PUSH_STREAM_WORKER_INFO_XML_PATTERN);
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CHANNELS_INFO_SUMMARIZED_WORKER_LAST_ITEM_XML = ngx_string(NGX_HTTP_PUSH_STREAM_WORKER_INFO_XML_PATTERN);
 static ngx_str_t  NGX_HTTP_PUSH_STREAM_CONTENT_TYPE_XML = ngx_string("application/xml");
+static ngx_str_t  NGX_HTTP_PUSH_STREAM_CONTENT_TYPE_BINARY = ngx_string("application/octet-stream");
 
 static ngx_http_push_stream_content_subtype_t subtypes[] = {
     { "plain" , 5,
@@ -206,6 +213,7 @@ static const ngx_str_t  NGX_HTTP_PUSH_STREAM_TOKEN_MESSAGE_TEXT = ngx_string("~t
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_TOKEN_MESSAGE_SIZE = ngx_string("~size~");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_TOKEN_MESSAGE_TAG = ngx_string("~tag~");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_TOKEN_MESSAGE_TIME = ngx_string("~time~");
+static const ngx_str_t  NGX_HTTP_PUSH_STREAM_TOKEN_MESSAGE_DELTA = ngx_string("~delta~");
 
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_EVENTSOURCE_COMMENT_PREFIX = ngx_string(": ");
 static const ngx_str_t  NGX_HTTP_PUSH_STREAM_EVENTSOURCE_DEFAULT_HEADER_TEMPLATE = ngx_string(": \n");
@@ -232,25 +240,45 @@ static ngx_str_t  NGX_HTTP_PUSH_STREAM_EVENT_TYPE_CLIENT_UNSUBSCRIBED = ngx_stri
 
 ngx_event_t         ngx_http_push_stream_memory_cleanup_event;
 ngx_event_t         ngx_http_push_stream_buffer_cleanup_event;
+ngx_event_t         ngx_http_push_stream_output_coalescing_event;
+ngx_queue_t         ngx_http_push_stream_output_coalescing_queue;
+ngx_event_t         ngx_http_push_stream_pending_broadcasts_event;
+ngx_queue_t         ngx_http_push_stream_pending_broadcasts;
+ngx_http_push_stream_timer_wheel_t ngx_http_push_stream_timer_wheel;
+ngx_http_push_stream_polling_cache_t ngx_http_push_stream_polling_cache;
 
 // general request handling
-ngx_http_push_stream_msg_t *ngx_http_push_stream_convert_char_to_msg_on_shared(ngx_http_push_stream_main_conf_t *mcf, u_char *data, size_t len, ngx_http_push_stream_channel_t *channel, ngx_int_t id, ngx_str_t *event_id, ngx_str_t *event_type, ngx_pool_t *temp_pool);
+ngx_http_push_stream_msg_t *ngx_http_push_stream_convert_char_to_msg_on_shared(ngx_http_push_stream_main_conf_t *mcf, u_char *data, size_t len, ngx_http_push_stream_channel_t *channel, ngx_int_t id, ngx_int_t delta_base, ngx_str_t *event_id, ngx_str_t *event_type, ngx_uint_t opcode, ngx_pool_t *temp_pool);
 static ngx_int_t            ngx_http_push_stream_send_only_added_headers(ngx_http_request_t *r);
 static void                 ngx_http_push_stream_add_polling_headers(ngx_http_request_t *r, time_t last_modified_time, ngx_int_t tag, ngx_pool_t *temp_pool);
 static void                 ngx_http_push_stream_get_last_received_message_values(ngx_http_request_t *r, time_t *if_modified_since, ngx_int_t *tag, ngx_str_t **last_event_id);
+static ngx_int_t            ngx_http_push_stream_get_event_types_filter(ngx_http_request_t *r);
+static ngx_flag_t           ngx_http_push_stream_subscriber_accepts_message(ngx_http_request_t *r, ngx_http_push_stream_msg_t *msg);
+static void                 ngx_http_push_stream_get_accept_delta(ngx_http_request_t *r);
+static void                 ngx_http_push_stream_get_max_message_rate(ngx_http_request_t *r);
 static ngx_table_elt_t *    ngx_http_push_stream_add_response_header(ngx_http_request_t *r, const ngx_str_t *header_name, const ngx_str_t *header_value);
 static ngx_str_t *          ngx_http_push_stream_get_header(ngx_http_request_t *r, const ngx_str_t *header_name);
 static ngx_int_t            ngx_http_push_stream_send_only_header_response(ngx_http_request_t *r, ngx_int_t status, const ngx_str_t *explain_error_message);
 static ngx_int_t            ngx_http_push_stream_send_only_header_response_and_finalize(ngx_http_request_t *r, ngx_int_t status, const ngx_str_t *explain_error_message);
 static ngx_str_t *          ngx_http_push_stream_str_replace(const ngx_str_t *org, const ngx_str_t *find, const ngx_str_t *replace, off_t offset, ngx_pool_t *temp_pool);
 static ngx_str_t *          ngx_http_push_stream_get_formatted_websocket_frame(const u_char *opcode, off_t opcode_len, const u_char *text, off_t text_len, ngx_pool_t *temp_pool);
+#if (NGX_ZLIB)
+static ngx_int_t            ngx_http_push_stream_deflate_message(ngx_http_push_stream_msg_t *msg, ngx_uint_t index, ngx_str_t *text, ngx_slab_pool_t *shpool, ngx_pool_t *temp_pool);
+static void *               ngx_http_push_stream_zalloc(void *opaque, u_int items, u_int size);
+static void                 ngx_http_push_stream_zfree(void *opaque, void *address);
+#endif
 static ngx_str_t *          ngx_http_push_stream_get_formatted_message(ngx_http_request_t *r, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *msg);
 static ngx_str_t *          ngx_http_push_stream_format_message(ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *message, ngx_str_t *text, ngx_http_push_stream_template_t *template, ngx_pool_t *temp_pool);
 static ngx_str_t *          ngx_http_push_stream_apply_template_to_each_line(ngx_str_t *text, const ngx_str_t *message_template, ngx_pool_t *temp_pool);
 static ngx_int_t            ngx_http_push_stream_send_response_content_header(ngx_http_request_t *r, ngx_http_push_stream_loc_conf_t *pslcf);
 static ngx_int_t            ngx_http_push_stream_send_response(ngx_http_request_t *r, ngx_str_t *text, const ngx_str_t *content_type, ngx_int_t status_code);
 static ngx_int_t            ngx_http_push_stream_send_response_message(ngx_http_request_t *r, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *msg, ngx_flag_t send_callback, ngx_flag_t send_separator);
+static ngx_http_push_stream_subscription_t *ngx_http_push_stream_get_channel_subscription(ngx_http_push_stream_module_ctx_t *ctx, ngx_http_push_stream_channel_t *channel);
 static ngx_int_t            ngx_http_push_stream_send_response_text(ngx_http_request_t *r, const u_char *text, uint len, ngx_flag_t last_buffer);
+static ngx_int_t            ngx_http_push_stream_flush_coalesced_output(ngx_http_request_t *r);
+static ngx_int_t            ngx_http_push_stream_check_pending_output(ngx_http_request_t *r, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *msg);
+static ngx_int_t            ngx_http_push_stream_check_message_rate(ngx_http_request_t *r, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *msg);
+static void                 ngx_http_push_stream_linger_message(ngx_http_request_t *r, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *msg);
 static void                 ngx_http_push_stream_send_response_finalize(ngx_http_request_t *r);
 static void                 ngx_http_push_stream_send_response_finalize_for_longpolling_by_timeout(ngx_http_request_t *r);
 static ngx_int_t            ngx_http_push_stream_send_websocket_close_frame(ngx_http_request_t *r, ngx_uint_t http_status, const ngx_str_t *reason);
@@ -261,21 +289,47 @@ static void                 ngx_http_push_stream_unescape_uri(ngx_str_t *value);
 static void                 ngx_http_push_stream_complex_value(ngx_http_request_t *r, ngx_http_complex_value_t *val, ngx_str_t *value);
 
 
-ngx_int_t                   ngx_http_push_stream_add_msg_to_channel(ngx_http_push_stream_main_conf_t *mcf, ngx_log_t *log, ngx_http_push_stream_channel_t *channel, u_char *text, size_t len, ngx_str_t *event_id, ngx_str_t *event_type, ngx_flag_t store_messages, ngx_pool_t *temp_pool);
+ngx_int_t                   ngx_http_push_stream_add_msg_to_channel(ngx_http_push_stream_main_conf_t *mcf, ngx_log_t *log, ngx_http_push_stream_channel_t *channel, u_char *text, size_t len, ngx_str_t *event_id, ngx_str_t *event_type, ngx_str_t *message_key, ngx_uint_t opcode, ngx_flag_t store_messages, ngx_flag_t message_delta, ngx_pool_t *temp_pool);
+ngx_int_t                   ngx_http_push_stream_set_channel_snapshot(ngx_http_push_stream_main_conf_t *mcf, ngx_log_t *log, ngx_http_push_stream_channel_t *channel, u_char *text, size_t len, ngx_str_t *event_id, ngx_str_t *event_type, ngx_uint_t opcode, ngx_pool_t *temp_pool);
+ngx_int_t                   ngx_http_push_stream_add_msg_to_channel_async(ngx_http_push_stream_main_conf_t *mcf, ngx_log_t *log, ngx_http_push_stream_channel_t *channel, u_char *text, size_t len, ngx_str_t *event_id, ngx_str_t *event_type, ngx_str_t *message_key, ngx_uint_t opcode, ngx_flag_t store_messages, ngx_flag_t message_delta, ngx_pool_t *temp_pool);
+static ngx_http_push_stream_msg_t *ngx_http_push_stream_store_msg_on_channel(ngx_http_push_stream_main_conf_t *mcf, ngx_log_t *log, ngx_http_push_stream_channel_t *channel, u_char *text, size_t len, ngx_str_t *event_id, ngx_str_t *event_type, ngx_str_t *message_key, ngx_uint_t opcode, ngx_flag_t store_messages, ngx_flag_t message_delta, ngx_pool_t *temp_pool);
+static ngx_int_t            ngx_http_push_stream_defer_broadcast(ngx_http_push_stream_main_conf_t *mcf, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *msg, ngx_log_t *log);
+static void                 ngx_http_push_stream_pending_broadcasts_handler(ngx_event_t *ev);
+static void                 ngx_http_push_stream_flush_pending_broadcasts(void);
+static uint64_t             ngx_http_push_stream_monotonic_usec(void);
+static void                 ngx_http_push_stream_update_publish_latency(ngx_http_push_stream_main_conf_t *mcf, uint64_t start);
 ngx_int_t                   ngx_http_push_stream_send_event(ngx_http_push_stream_main_conf_t *mcf, ngx_log_t *log, ngx_http_push_stream_channel_t *channel, ngx_str_t *event_id, ngx_pool_t *temp_pool);
 
-static void                 ngx_http_push_stream_ping_timer_wake_handler(ngx_event_t *ev);
-static void                 ngx_http_push_stream_disconnect_timer_wake_handler(ngx_event_t *ev);
+static void                 ngx_http_push_stream_ping_timer_wake_handler(ngx_http_push_stream_timer_t *timer);
+static void                 ngx_http_push_stream_disconnect_timer_wake_handler(ngx_http_push_stream_timer_t *timer);
 static void                 ngx_http_push_stream_memory_cleanup_timer_wake_handler(ngx_event_t *ev);
 static void                 ngx_http_push_stream_buffer_timer_wake_handler(ngx_event_t *ev);
+static void                 ngx_http_push_stream_output_coalescing_timer_wake_handler(ngx_event_t *ev);
+static void                 ngx_http_push_stream_timer_wheel_wake_handler(ngx_event_t *ev);
 
 static void                 ngx_http_push_stream_timer_set(ngx_msec_t timer_interval, ngx_event_t *event, ngx_event_handler_pt event_handler, ngx_flag_t start_timer);
 static void                 ngx_http_push_stream_timer_reset(ngx_msec_t timer_interval, ngx_event_t *timer_event);
+static void                 ngx_http_push_stream_timer_wheel_init(ngx_cycle_t *cycle);
+static void                 ngx_http_push_stream_wheel_timer_reset(ngx_msec_t timer_interval, ngx_http_push_stream_timer_t *timer);
+static void                 ngx_http_push_stream_wheel_timer_del(ngx_http_push_stream_timer_t *timer);
+
+static void                 ngx_http_push_stream_polling_cache_init(void);
+static void                 ngx_http_push_stream_polling_cache_cleanup(void);
+static ngx_str_t *          ngx_http_push_stream_polling_cache_key(ngx_http_request_t *r, ngx_http_push_stream_requested_channel_t *requested_channels, time_t if_modified_since, ngx_int_t tag, ngx_str_t *last_event_id, ngx_pool_t *temp_pool);
+static ngx_http_push_stream_polling_cache_entry_t *ngx_http_push_stream_polling_cache_find(ngx_str_t *key, ngx_http_push_stream_requested_channel_t *requested_channels);
+static ngx_http_push_stream_polling_cache_channel_t *ngx_http_push_stream_polling_cache_snapshot(ngx_http_push_stream_requested_channel_t *requested_channels, ngx_uint_t *qtd_channels, ngx_pool_t *temp_pool);
+static void                 ngx_http_push_stream_polling_cache_remove(ngx_http_push_stream_polling_cache_entry_t *entry);
+static void                 ngx_http_push_stream_polling_cache_store(ngx_http_request_t *r, ngx_str_t *key, ngx_http_push_stream_polling_cache_channel_t *channels, ngx_uint_t qtd_channels, time_t last_modified_time, ngx_int_t tag, ngx_array_t *body);
 
 #define ngx_http_push_stream_memory_cleanup_timer_set(void) ngx_http_push_stream_timer_set(NGX_HTTP_PUSH_STREAM_DEFAULT_SHM_MEMORY_CLEANUP_INTERVAL, &ngx_http_push_stream_memory_cleanup_event, ngx_http_push_stream_memory_cleanup_timer_wake_handler, 1);
 #define ngx_http_push_stream_buffer_cleanup_timer_set(void) ngx_http_push_stream_timer_set(NGX_HTTP_PUSH_STREAM_MESSAGE_BUFFER_CLEANUP_INTERVAL, &ngx_http_push_stream_buffer_cleanup_event, ngx_http_push_stream_buffer_timer_wake_handler, 1);
+#define ngx_http_push_stream_channel_has_snapshot(channel) (((channel)->snapshot_message != NULL) && ((channel)->snapshot_message->expires >= ngx_time()))
+#define ngx_http_push_stream_channel_valid_snapshot(channel) (ngx_http_push_stream_channel_has_snapshot(channel) ? (channel)->snapshot_message : NULL)
 
 static void                 ngx_http_push_stream_worker_subscriber_cleanup(ngx_http_push_stream_subscriber_t *worker_subscriber);
+static void                 ngx_http_push_stream_remove_subscription(ngx_http_push_stream_subscription_t *subscription, ngx_pool_t *temp_pool);
+static void                 ngx_http_push_stream_update_subscriber_memory(ngx_http_request_t *r);
+static size_t               ngx_http_push_stream_pool_blocks_size(ngx_pool_t *pool);
 static ngx_str_t *          ngx_http_push_stream_create_str(ngx_pool_t *pool, uint len);
 
 static void                 ngx_http_push_stream_throw_the_message_away(ngx_http_push_stream_msg_t *msg, ngx_http_push_stream_shm_data_t *data);
@@ -285,6 +339,8 @@ static void                 ngx_http_push_stream_collect_expired_messages_and_em
 static void                 ngx_http_push_stream_free_message_memory(ngx_slab_pool_t *shpool, ngx_http_push_stream_msg_t *msg);
 static void                 ngx_http_push_stream_free_worker_message_memory(ngx_slab_pool_t *shpool, ngx_http_push_stream_worker_msg_t *worker_msg);
 static ngx_int_t            ngx_http_push_stream_free_memory_of_expired_messages_and_channels(ngx_flag_t force);
+static ngx_http_push_stream_msg_t *ngx_http_push_stream_create_message_delta(ngx_http_push_stream_main_conf_t *mcf, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *msg, ngx_str_t *event_id, ngx_str_t *event_type, ngx_pool_t *temp_pool);
+static ngx_uint_t           ngx_http_push_stream_remove_message_by_key_locked(ngx_http_push_stream_shm_data_t *data, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *replacement);
 ngx_uint_t                  ngx_http_push_stream_ensure_qtd_of_messages(ngx_http_push_stream_shm_data_t *data, ngx_http_push_stream_channel_t *channel, ngx_uint_t max_messages, ngx_flag_t expired);
 static ngx_inline void      ngx_http_push_stream_delete_worker_channel(void);
 
@@ -306,6 +362,7 @@ uint64_t                    ngx_http_push_stream_ntohll(uint64_t value);
 static ngx_int_t            ngx_http_push_stream_set_expires(ngx_http_request_t *r, ngx_http_push_stream_expires_t expires, time_t expires_time);
 
 ngx_http_push_stream_requested_channel_t *ngx_http_push_stream_parse_channels_ids_from_path(ngx_http_request_t *r, ngx_pool_t *pool);
+ngx_http_push_stream_requested_channel_t *ngx_http_push_stream_parse_channels_ids(ngx_http_request_t *r, ngx_str_t *channels_path, ngx_pool_t *pool);
 
 ngx_int_t                   ngx_http_push_stream_create_shmtx(ngx_shmtx_t *mtx, ngx_shmtx_sh_t *addr, u_char *name);
 
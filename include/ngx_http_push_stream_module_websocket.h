@@ -36,8 +36,8 @@
 static ngx_int_t    ngx_http_push_stream_websocket_handler(ngx_http_request_t *r);
 
 #define NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_START_STEP           0
-#define NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_GET_REAL_SIZE_STEP   1
-#define NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_GET_MASK_KEY_STEP    2
-#define NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_GET_PAYLOAD_STEP     3
+#define NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_GET_PAYLOAD_STEP     1
+
+#define NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_BUFFER_SIZE          4096
 
 #endif /* NGX_HTTP_PUSH_STREAM_MODULE_WEBSOCKET_H_ */
@@ -260,6 +260,31 @@ shared_examples_for "statistics location" do
     end
   end
 
+  it "should return the memory used by each subscriber in summarized channels statistics" do
+    channel = 'ch_test_pool_bytes_per_subscriber_in_summarized_channels_statistics'
+
+    nginx_run_server(config) do |conf|
+      EventMachine.run do
+        pub_1 = EventMachine::HttpRequest.new(nginx_address + '/channels-stats').get :head => headers
+        pub_1.callback do
+          expect(pub_1).to be_http_status(200)
+          expect(JSON.parse(pub_1.response)["pool_bytes_per_subscriber"]).to eql(0)
+
+          create_channel_by_subscribe(channel, headers) do
+            pub_2 = EventMachine::HttpRequest.new(nginx_address + '/channels-stats').get :head => headers
+            pub_2.callback do
+              expect(pub_2).to be_http_status(200)
+              response = JSON.parse(pub_2.response)
+              expect(response["subscribers"]).to eql(1)
+              expect(response["pool_bytes_per_subscriber"]).to be > 0
+              EventMachine.stop
+            end
+          end
+        end
+      end
+    end
+  end
+
   it "should check accepted methods" do
     nginx_run_server(config) do |conf|
       EventMachine.run do
@@ -21,6 +21,18 @@ describe "Setup Parameters" do
     expect(nginx_test_configuration({:max_channel_id_length => 0})).to include("push_stream_max_channel_id_length cannot be zero")
   end
 
+  it "should not accept '0' as polling response cache entries" do
+    expect(nginx_test_configuration({:polling_response_cache_entries => 0})).to include("push_stream_polling_response_cache_entries cannot be zero")
+  end
+
+  it "should not accept an ingest socket path larger than an unix socket address" do
+    expect(nginx_test_configuration({:ingest_socket => "/tmp/#{"x" * 120}.sock"})).to include("push_stream_ingest_socket path is too long")
+  end
+
+  it "should not accept an invalid messages rate for a channel prefix" do
+    expect(nginx_test_configuration({:channel_prefix_publish_rate => "ch_ abc 0"})).to include("push_stream_channel_prefix_publish_rate\" has an invalid messages rate")
+  end
+
   it "should not accept '0' as message ttl" do
     expect(nginx_test_configuration({:message_ttl => 0})).to include("push_stream_message_ttl cannot be zero")
   end
@@ -54,6 +66,42 @@ describe "Setup Parameters" do
     expect(nginx_test_configuration(config)).to include("max number of wildcard channels cannot be smaller than value in push_stream_wildcard_channel_max_qtd")
   end
 
+  it "should not accept '0' as long polling linger time" do
+    expect(nginx_test_configuration({:longpolling_linger_time => 0})).to include("push_stream_longpolling_linger_time cannot be zero")
+  end
+
+  it "should not accept '0' as long polling linger messages" do
+    expect(nginx_test_configuration({:longpolling_linger_time => "100ms", :longpolling_linger_messages => 0})).to include("push_stream_longpolling_linger_messages cannot be zero")
+  end
+
+  it "should not set long polling linger messages without set long polling linger time" do
+    expect(nginx_test_configuration({:longpolling_linger_messages => 5})).to include("cannot set long polling linger messages if push_stream_longpolling_linger_time is not set")
+  end
+
+  it "should not accept '0' as output coalescing delay" do
+    expect(nginx_test_configuration({:output_coalescing_delay => 0})).to include("push_stream_output_coalescing_delay cannot be zero")
+  end
+
+  it "should not accept '0' as output coalescing size" do
+    expect(nginx_test_configuration({:output_coalescing_delay => "5ms", :output_coalescing_size => 0})).to include("push_stream_output_coalescing_size cannot be zero")
+  end
+
+  it "should not set output coalescing size without set output coalescing delay" do
+    expect(nginx_test_configuration({:output_coalescing_size => "4k"})).to include("cannot set output coalescing size if push_stream_output_coalescing_delay is not set")
+  end
+
+  it "should not accept '0' as max pending output size" do
+    expect(nginx_test_configuration({:max_pending_output_size => 0})).to include("push_stream_max_pending_output_size cannot be zero")
+  end
+
+  it "should not accept '0' as max pending output messages" do
+    expect(nginx_test_configuration({:max_pending_output_messages => 0})).to include("push_stream_max_pending_output_messages cannot be zero")
+  end
+
+  it "should not accept an invalid pending output policy" do
+    expect(nginx_test_configuration({:pending_output_policy => "wait"})).to include("invalid value \"wait\" in \"push_stream_pending_output_policy\" directive")
+  end
+
   it "should accept a configuration without http block" do
     config = {
       :configuration_template => %q{
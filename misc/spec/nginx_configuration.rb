@@ -21,6 +21,8 @@ module NginxConfiguration
 
       :subscriber_connection_ttl => nil,
       :longpolling_connection_ttl => nil,
+      :longpolling_linger_time => nil,
+      :longpolling_linger_messages => nil,
       :timeout_with_body => 'off',
       :message_ttl => '50m',
 
@@ -29,6 +31,7 @@ module NginxConfiguration
       :max_messages_stored_per_channel => 20,
       :max_number_of_channels => nil,
       :max_number_of_wildcard_channels => nil,
+      :polling_response_cache_entries => nil,
 
       :wildcard_channel_max_qtd => 3,
       :wildcard_channel_prefix => 'broad_',
@@ -44,6 +47,8 @@ module NginxConfiguration
       :last_received_message_time => nil,
       :last_received_message_tag => nil,
       :last_event_id => nil,
+      :event_types => nil,
+      :accept_message_delta => nil,
       :user_agent => nil,
 
       :authorized_channels_only => 'off',
@@ -53,6 +58,9 @@ module NginxConfiguration
       :client_body_buffer_size => '32k',
 
       :channel_info_on_publish => "on",
+      :publish_async => nil,
+      :message_key_compaction => nil,
+      :message_delta => nil,
       :channel_inactivity_time => nil,
 
       :channel_id => '$arg_id',
@@ -62,6 +70,23 @@ module NginxConfiguration
       :events_channel_id => nil,
       :allow_connections_to_events_channel => nil,
 
+      :ingest_socket => nil,
+      :ingest_store_messages => nil,
+
+      :channel_publish_rate => nil,
+      :channel_publish_bytes_rate => nil,
+      :channel_prefix_publish_rate => nil,
+
+      :output_coalescing_delay => nil,
+      :output_coalescing_size => nil,
+
+      :max_pending_output_size => nil,
+      :max_pending_output_messages => nil,
+      :pending_output_policy => nil,
+
+      :max_message_rate => nil,
+      :conflation_event_id_separator => nil,
+
       :extra_location => '',
       :extra_configuration => ''
     }
@@ -121,6 +146,8 @@ http {
 
   <%= write_directive("push_stream_subscriber_connection_ttl", subscriber_connection_ttl, "timeout for subscriber connections") %>
   <%= write_directive("push_stream_longpolling_connection_ttl", longpolling_connection_ttl, "timeout for long polling connections") %>
+  <%= write_directive("push_stream_longpolling_linger_time", longpolling_linger_time) %>
+  <%= write_directive("push_stream_longpolling_linger_messages", longpolling_linger_messages) %>
   <%= write_directive("push_stream_timeout_with_body", timeout_with_body) %>
   <%= write_directive("push_stream_header_template", header_template, "header to be sent when receiving new subscriber connection") %>
   <%= write_directive("push_stream_header_template_file", header_template_file, "file with the header to be sent when receiving new subscriber connection") %>
@@ -132,6 +159,7 @@ http {
   <%= write_directive("push_stream_max_messages_stored_per_channel", max_messages_stored_per_channel, "max messages to store in memory") %>
   <%= write_directive("push_stream_max_number_of_channels", max_number_of_channels) %>
   <%= write_directive("push_stream_max_number_of_wildcard_channels", max_number_of_wildcard_channels) %>
+  <%= write_directive("push_stream_polling_response_cache_entries", polling_response_cache_entries) %>
 
   <%= write_directive("push_stream_wildcard_channel_max_qtd", wildcard_channel_max_qtd) %>
   <%= write_directive("push_stream_wildcard_channel_prefix", wildcard_channel_prefix) %>
@@ -149,6 +177,8 @@ http {
   <%= write_directive("push_stream_last_received_message_time", last_received_message_time) %>
   <%= write_directive("push_stream_last_received_message_tag", last_received_message_tag) %>
   <%= write_directive("push_stream_last_event_id", last_event_id) %>
+  <%= write_directive("push_stream_event_types", event_types) %>
+  <%= write_directive("push_stream_accept_message_delta", accept_message_delta) %>
 
   <%= write_directive("push_stream_channel_deleted_message_text", channel_deleted_message_text) %>
 
@@ -158,6 +188,23 @@ http {
   <%= write_directive("push_stream_events_channel_id", events_channel_id) %>
   <%= write_directive("push_stream_allow_connections_to_events_channel", allow_connections_to_events_channel) %>
 
+  <%= write_directive("push_stream_ingest_socket", ingest_socket) %>
+  <%= write_directive("push_stream_ingest_store_messages", ingest_store_messages) %>
+
+  <%= write_directive("push_stream_channel_publish_rate", channel_publish_rate) %>
+  <%= write_directive("push_stream_channel_publish_bytes_rate", channel_publish_bytes_rate) %>
+  <%= write_directive("push_stream_channel_prefix_publish_rate", channel_prefix_publish_rate) %>
+
+  <%= write_directive("push_stream_output_coalescing_delay", output_coalescing_delay) %>
+  <%= write_directive("push_stream_output_coalescing_size", output_coalescing_size) %>
+
+  <%= write_directive("push_stream_max_pending_output_size", max_pending_output_size) %>
+  <%= write_directive("push_stream_max_pending_output_messages", max_pending_output_messages) %>
+  <%= write_directive("push_stream_pending_output_policy", pending_output_policy) %>
+
+  <%= write_directive("push_stream_max_message_rate", max_message_rate) %>
+  <%= write_directive("push_stream_conflation_event_id_separator", conflation_event_id_separator) %>
+
   server {
     listen        <%= nginx_port %>;
     server_name   <%= nginx_host %>;
@@ -176,6 +223,9 @@ http {
       <%= write_directive("push_stream_channels_path", channels_path_for_pub) %>
       <%= write_directive("push_stream_store_messages", store_messages, "store messages") %>
       <%= write_directive("push_stream_channel_info_on_publish", channel_info_on_publish, "channel_info_on_publish") %>
+      <%= write_directive("push_stream_publish_async", publish_async) %>
+      <%= write_directive("push_stream_message_key_compaction", message_key_compaction) %>
+      <%= write_directive("push_stream_message_delta", message_delta) %>
 
       # client_max_body_size MUST be equal to client_body_buffer_size or
       # you will be sorry.
@@ -375,7 +375,7 @@ describe "Publisher Properties" do
             pub.callback do
               expect(pub.response_header['ACCESS_CONTROL_ALLOW_ORIGIN']).to eql("custom.domain.com")
               expect(pub.response_header['ACCESS_CONTROL_ALLOW_METHODS']).to eql(accepted_methods)
-              expect(pub.response_header['ACCESS_CONTROL_ALLOW_HEADERS']).to eql("If-Modified-Since,If-None-Match,Etag,Event-Id,Event-Type,Last-Event-Id")
+              expect(pub.response_header['ACCESS_CONTROL_ALLOW_HEADERS']).to eql("If-Modified-Since,If-None-Match,Etag,Event-Id,Event-Type,Last-Event-Id,Event-Types,Message-Key,Snapshot,Accept-Delta")
 
               EventMachine.stop
             end
@@ -392,7 +392,7 @@ describe "Publisher Properties" do
             pub.callback do
               expect(pub.response_header['ACCESS_CONTROL_ALLOW_ORIGIN']).to eql("test.com")
               expect(pub.response_header['ACCESS_CONTROL_ALLOW_METHODS']).to eql(accepted_methods)
-              expect(pub.response_header['ACCESS_CONTROL_ALLOW_HEADERS']).to eql("If-Modified-Since,If-None-Match,Etag,Event-Id,Event-Type,Last-Event-Id")
+              expect(pub.response_header['ACCESS_CONTROL_ALLOW_HEADERS']).to eql("If-Modified-Since,If-None-Match,Etag,Event-Id,Event-Type,Last-Event-Id,Event-Types,Message-Key,Snapshot,Accept-Delta")
 
               EventMachine.stop
             end
@@ -417,6 +417,224 @@ describe "Publisher Properties" do
       end
     end
 
+    it "should answer with accepted status before the subscribers receive the message when publishing asynchronously" do
+      body = 'published message'
+      channel = 'ch_test_publish_async'
+      number_of_subscribers = 100
+      received = 0
+      acknowledged = false
+
+      nginx_run_server(config.merge(:publish_async => "on", :header_template => nil, :footer_template => nil, :message_template => '~text~')) do |conf|
+        EventMachine.run do
+          number_of_subscribers.times do
+            sub = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s).get :head => headers
+            sub.stream do |chunk|
+              expect(chunk).to eql(body)
+              received += 1
+              if received == number_of_subscribers
+                # the last subscriber is reached after the publisher had the answer
+                expect(acknowledged).to be_truthy
+                EventMachine.stop
+              end
+            end
+          end
+
+          EM.add_timer(1) do
+            pub_1 = EventMachine::HttpRequest.new(nginx_address + '/pub?id=' + channel.to_s ).post :head => headers, :body => body
+            pub_1.callback do
+              expect(pub_1).to be_http_status(202).without_body
+              expect(received).to be < number_of_subscribers
+              acknowledged = true
+            end
+          end
+        end
+      end
+    end
+
+    it "should not send the channel information when publishing asynchronously" do
+      body = 'published message'
+      channel = 'ch_test_publish_async_channel_info'
+
+      nginx_run_server(config.merge(:publish_async => "on", :channel_info_on_publish => "on")) do |conf|
+        EventMachine.run do
+          pub_1 = EventMachine::HttpRequest.new(nginx_address + '/pub?id=' + channel.to_s ).post :head => headers, :body => body
+          pub_1.callback do
+            expect(pub_1).to be_http_status(202).without_body
+            EventMachine.stop
+          end
+        end
+      end
+    end
+
+    it "should refuse messages over the channel publish rate" do
+      body = 'published message'
+      channel = 'ch_test_channel_publish_rate'
+
+      nginx_run_server(config.merge(:channel_publish_rate => 2)) do |conf|
+        EventMachine.run do
+          pub_1 = EventMachine::HttpRequest.new(nginx_address + '/pub?id=' + channel.to_s ).post :head => headers, :body => body
+          pub_1.callback do
+            expect(pub_1).to be_http_status(200)
+            pub_2 = EventMachine::HttpRequest.new(nginx_address + '/pub?id=' + channel.to_s ).post :head => headers, :body => body
+            pub_2.callback do
+              expect(pub_2).to be_http_status(200)
+              pub_3 = EventMachine::HttpRequest.new(nginx_address + '/pub?id=' + channel.to_s ).post :head => headers, :body => body
+              pub_3.callback do
+                expect(pub_3).to be_http_status(429).without_body
+                expect(pub_3.response_header['X_NGINX_PUSHSTREAM_EXPLAIN']).to eql("Publish rate limit exceeded.")
+
+                pub_4 = EventMachine::HttpRequest.new(nginx_address + '/pub?id=other_' + channel.to_s ).post :head => headers, :body => body
+                pub_4.callback do
+                  expect(pub_4).to be_http_status(200)
+                  EventMachine.stop
+                end
+              end
+            end
+          end
+        end
+      end
+    end
+
+    it "should share the publish rate between the channels with the same prefix" do
+      body = 'published message'
+      channel = 'ch_test_prefix_publish_rate'
+
+      nginx_run_server(config.merge(:channel_prefix_publish_rate => "#{channel}_ 0 10")) do |conf|
+        EventMachine.run do
+          pub_1 = EventMachine::HttpRequest.new(nginx_address + '/pub?id=' + channel.to_s + '_1').post :head => headers, :body => body
+          pub_1.callback do
+            expect(pub_1).to be_http_status(200)
+            pub_2 = EventMachine::HttpRequest.new(nginx_address + '/pub?id=' + channel.to_s + '_2').post :head => headers, :body => body
+            pub_2.callback do
+              expect(pub_2).to be_http_status(429).without_body
+
+              pub_3 = EventMachine::HttpRequest.new(nginx_address + '/pub?id=' + channel.to_s).post :head => headers, :body => body
+              pub_3.callback do
+                expect(pub_3).to be_http_status(200)
+                EventMachine.stop
+              end
+            end
+          end
+        end
+      end
+    end
+
+    it "should give back the publish rate of the other channels when a message to many channels is refused" do
+      body = 'published message'
+      channel = 'ch_test_publish_rate_give_back'
+
+      nginx_run_server(config.merge(:channel_publish_rate => 1)) do |conf|
+        expect(post_to('/pub?id=' + channel.to_s + '_1', headers, body).code).to eql("200")
+        expect(post_to('/pub?id=' + channel.to_s + '_2/' + channel.to_s + '_1', headers, body).code).to eql("429")
+        expect(post_to('/pub?id=' + channel.to_s + '_2', headers, body).code).to eql("200")
+      end
+    end
+
+    it "should count the size of chunked bodies on the publish bytes rate" do
+      channel = 'ch_test_publish_bytes_rate_chunked'
+
+      nginx_run_server(config.merge(:channel_publish_bytes_rate => 10)) do |conf|
+        http = Net::HTTP.new(nginx_host, nginx_port)
+        req = Net::HTTP::Post.new('/pub?id=' + channel.to_s, headers.merge('Transfer-Encoding' => 'chunked'))
+        req.body_stream = StringIO.new('a message larger than the rate')
+        expect(http.request(req).code).to eql("200")
+
+        expect(post_to('/pub?id=' + channel.to_s, headers, 'x').code).to eql("429")
+      end
+    end
+
+    it "should keep only the last stored message of each key when compacting" do
+      channel = 'ch_test_message_key_compaction'
+
+      nginx_run_server(config.merge(:message_key_compaction => "on", :header_template => nil, :footer_template => nil, :message_template => '~text~|')) do |conf|
+        EventMachine.run do
+          pub_1 = EventMachine::HttpRequest.new(nginx_address + '/pub?id=' + channel.to_s ).post :head => headers.merge('Message-Key' => 'a'), :body => 'msg 1'
+          pub_1.callback do
+            pub_2 = EventMachine::HttpRequest.new(nginx_address + '/pub?id=' + channel.to_s ).post :head => headers.merge('Message-Key' => 'b'), :body => 'msg 2'
+            pub_2.callback do
+              pub_3 = EventMachine::HttpRequest.new(nginx_address + '/pub?id=' + channel.to_s ).post :head => headers.merge('Message-Key' => 'a'), :body => 'msg 3'
+              pub_3.callback do
+                expect(pub_3).to be_http_status(200).with_body
+                expect(JSON.parse(pub_3.response)["stored_messages"].to_i).to eql(2)
+
+                response = ''
+                sub_1 = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s + '.b3').get :head => headers
+                sub_1.stream do |chunk|
+                  response += chunk
+                  if response == 'msg 2|msg 3|'
+                    EventMachine.stop
+                  end
+                end
+              end
+            end
+          end
+        end
+      end
+    end
+
+    it "should resume from a last event id removed by the compaction" do
+      channel = 'ch_test_message_key_compaction_last_event_id'
+
+      nginx_run_server(config.merge(:message_key_compaction => "on", :header_template => nil, :footer_template => nil, :message_template => '~text~|')) do |conf|
+        publish_message(channel, headers.merge('Message-Key' => 'a', 'Event-Id' => 'event 1'), 'msg 1')
+        publish_message(channel, headers.merge('Message-Key' => 'b', 'Event-Id' => 'event 2'), 'msg 2')
+        publish_message(channel, headers.merge('Message-Key' => 'a', 'Event-Id' => 'event 3'), 'msg 3')
+
+        EventMachine.run do
+          response = ''
+          sub_1 = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s).get :head => headers.merge('Last-Event-Id' => 'event 1')
+          sub_1.stream do |chunk|
+            response += chunk
+            if response == 'msg 2|msg 3|'
+              EventMachine.stop
+            end
+          end
+        end
+
+        publish_message(channel, headers.merge('Message-Key' => 'a', 'Event-Id' => 'event 4'), 'msg 4')
+
+        EventMachine.run do
+          response = ''
+          sub_2 = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s).get :head => headers.merge('Last-Event-Id' => 'event 1')
+          sub_2.stream do |chunk|
+            response += chunk
+            if response == 'msg 2|msg 4|'
+              EventMachine.stop
+            end
+          end
+        end
+      end
+    end
+
+    it "should send the channel snapshot followed by the newer messages to subscribers asking for backtrack" do
+      channel = 'ch_test_channel_snapshot'
+
+      nginx_run_server(config.merge(:header_template => nil, :footer_template => nil, :message_template => '~text~|')) do |conf|
+        EventMachine.run do
+          pub_1 = EventMachine::HttpRequest.new(nginx_address + '/pub?id=' + channel.to_s ).post :head => headers, :body => 'delta 1'
+          pub_1.callback do
+            pub_2 = EventMachine::HttpRequest.new(nginx_address + '/pub?id=' + channel.to_s ).post :head => headers.merge('Snapshot' => 'true'), :body => 'state 1'
+            pub_2.callback do
+              expect(pub_2).to be_http_status(200).with_body
+              expect(JSON.parse(pub_2.response)["stored_messages"].to_i).to eql(1)
+
+              pub_3 = EventMachine::HttpRequest.new(nginx_address + '/pub?id=' + channel.to_s ).post :head => headers, :body => 'delta 2'
+              pub_3.callback do
+                response = ''
+                sub_1 = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s + '.b1').get :head => headers
+                sub_1.stream do |chunk|
+                  response += chunk
+                  if response == 'state 1|delta 2|'
+                    EventMachine.stop
+                  end
+                end
+              end
+            end
+          end
+        end
+      end
+    end
+
     it "should accept channel id inside an if block" do
       merged_config = config.merge({
         :header_template => nil,
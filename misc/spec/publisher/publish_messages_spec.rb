@@ -358,4 +358,186 @@ describe "Publisher Publishing Messages" do
       end
     end
   end
+
+  it "should publish many messages on a batch" do
+    channel_1 = 'ch_test_publish_batch_1'
+    channel_2 = 'ch_test_publish_batch_2'
+    response = ''
+
+    batch_config = config.merge(:message_template => '~channel~|~event-id~|~event-type~|~text~\r\n', :extra_location => %{
+      location /pub-batch {
+        push_stream_publisher batch;
+      }
+    })
+
+    nginx_run_server(batch_config) do |conf|
+      EventMachine.run do
+        sub = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel_1 + '/' + channel_2).get
+        sub.stream do |chunk|
+          response += chunk
+          if response.split("\r\n").size >= 3
+            expect(response).to eql("#{channel_1}|a:1|tick|msg 1\r\n#{channel_2}|||msg \"2\"\r\n#{channel_1}|a:2||msg 3\r\n")
+            EventMachine.stop
+          end
+        end
+
+        EM.add_timer(0.5) do
+          body = %{{"channel": "#{channel_1}", "event_id": "a:1", "event_type": "tick", "text": "msg 1"}\n} +
+                 %{\n} +
+                 %{{"channel": "#{channel_2}", "text": "msg \\"2\\""}\n} +
+                 %{{"channel": "#{channel_1}", "event_id": "a:2", "text": "msg 3"}\n}
+          pub = EventMachine::HttpRequest.new(nginx_address + '/pub-batch').post :body => body
+          pub.callback do
+            expect(pub).to be_http_status(200).without_body
+          end
+        end
+      end
+    end
+  end
+
+  it "should not publish any message when a batch record is invalid" do
+    channel = 'ch_test_publish_invalid_batch'
+
+    batch_config = config.merge(:extra_location => %{
+      location /pub-batch {
+        push_stream_publisher batch;
+      }
+    })
+
+    nginx_run_server(batch_config) do |conf|
+      EventMachine.run do
+        body = %{{"channel": "#{channel}", "text": "msg 1"}\n{"channel": "#{channel}"}\n}
+        pub = EventMachine::HttpRequest.new(nginx_address + '/pub-batch').post :body => body
+        pub.callback do
+          expect(pub).to be_http_status(400).without_body
+          expect(pub.response_header['X_NGINX_PUSHSTREAM_EXPLAIN']).to eql("Invalid batch record.")
+
+          stats = EventMachine::HttpRequest.new(nginx_address + '/channels-stats?id=' + channel).get
+          stats.callback do
+            expect(stats).to be_http_status(404)
+            EventMachine.stop
+          end
+        end
+      end
+    end
+  end
+
+  it "should not publish any message when a batch record is over the publish rate" do
+    channel_1 = 'ch_test_publish_batch_rate_1'
+    channel_2 = 'ch_test_publish_batch_rate_2'
+
+    batch_config = config.merge(:channel_publish_rate => 1, :extra_location => %{
+      location /pub-batch {
+        push_stream_publisher batch;
+      }
+    })
+
+    nginx_run_server(batch_config) do |conf|
+      body = %{{"channel": "#{channel_2}", "text": "msg 1"}\n{"channel": "#{channel_1}", "text": "msg 2"}\n{"channel": "#{channel_1}", "text": "msg 3"}\n}
+      response = post_to('/pub-batch', {}, body)
+      expect(response.code).to eql("429")
+      expect(response['X-Nginx-PushStream-Explain']).to eql("Publish rate limit exceeded.")
+
+      expect(post_to('/pub?id=' + channel_2, {}, 'msg 4').code).to eql("200")
+    end
+  end
+
+  it "should refuse batch records with raw control characters or unpaired surrogates" do
+    channel = 'ch_test_publish_invalid_json_batch'
+
+    batch_config = config.merge(:extra_location => %{
+      location /pub-batch {
+        push_stream_publisher batch;
+      }
+    })
+
+    nginx_run_server(batch_config) do |conf|
+      EventMachine.run do
+        body_1 = %{{"channel": "#{channel}", "text": "msg\t1"}\n}
+        body_2 = %{{"channel": "#{channel}", "text": "msg \\udc00"}\n}
+        pub_1 = EventMachine::HttpRequest.new(nginx_address + '/pub-batch').post :body => body_1
+        pub_1.callback do
+          expect(pub_1).to be_http_status(400).without_body
+
+          pub_2 = EventMachine::HttpRequest.new(nginx_address + '/pub-batch').post :body => body_2
+          pub_2.callback do
+            expect(pub_2).to be_http_status(400).without_body
+            expect(pub_2.response_header['X_NGINX_PUSHSTREAM_EXPLAIN']).to eql("Invalid batch record.")
+
+            stats = EventMachine::HttpRequest.new(nginx_address + '/channels-stats?id=' + channel).get
+            stats.callback do
+              expect(stats).to be_http_status(404)
+              EventMachine.stop
+            end
+          end
+        end
+      end
+    end
+  end
+
+  it "should publish the batch records sent on a websocket" do
+    channel_1 = 'ch_test_publish_batch_websocket_1'
+    channel_2 = 'ch_test_publish_batch_websocket_2'
+    request = "GET /pub-batch HTTP/1.0\r\nConnection: Upgrade\r\nSec-WebSocket-Key: /mQoZf6pRiv8+6o72GncLQ==\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\n"
+
+    batch_config = config.merge(:message_template => '~channel~|~text~\r\n', :extra_location => %{
+      location /pub-batch {
+        push_stream_publisher batch;
+      }
+    })
+
+    nginx_run_server(batch_config) do |conf|
+      subscriber = open_socket(nginx_host, nginx_port)
+      subscriber.print("GET /sub/#{channel_1}/#{channel_2} HTTP/1.0\r\n\r\n")
+      headers, body = read_response_on_socket(subscriber)
+
+      publisher = open_socket(nginx_host, nginx_port)
+      publisher.print("#{request}\r\n")
+      headers, body = read_response_on_socket(publisher)
+      expect(headers).to match_the_pattern(/HTTP\/1\.1 101 Switching Protocols/)
+
+      records = %{{"channel": "#{channel_1}", "text": "msg 1"}\n{"channel": "#{channel_2}", "text": "msg 2"}}
+      publisher.print("%c%c" % [0x81, records.size] + records)
+      records = %{{"channel": "#{channel_1}", "text": "msg 3"}}
+      publisher.print("%c%c" % [0x81, records.size] + records)
+
+      headers, body = read_response_on_socket(subscriber, "msg 3")
+      expect(body).to eql("#{channel_1}|msg 1\r\n#{channel_2}|msg 2\r\n#{channel_1}|msg 3\r\n")
+
+      records = %{{"channel": "#{channel_1}"}}
+      publisher.print("%c%c" % [0x81, records.size] + records)
+      body, dummy = read_response_on_socket(publisher, "record")
+      expect(body).to match_the_pattern(/"http_status": 400, "explain":"Invalid batch record."/)
+
+      subscriber.close
+      publisher.close
+    end
+  end
+
+  it "should publish the messages sent to the ingest socket" do
+    channel = 'ch_test_publish_ingest_socket'
+    ingest_socket = File.join(nginx_tests_tmp_dir, "ingest.sock")
+
+    nginx_run_server(config.merge(:ingest_socket => ingest_socket, :message_template => '~id~|~text~\r\n')) do |conf|
+      subscriber = open_socket(nginx_host, nginx_port)
+      subscriber.print("GET /sub/#{channel} HTTP/1.0\r\n\r\n")
+      headers, body = read_response_on_socket(subscriber)
+
+      ingest = Socket.new(:UNIX, :DGRAM)
+      ingest.send("#{channel}\nmsg 1", 0, Socket.sockaddr_un(ingest_socket))
+      ingest.send("datagram without channel id", 0, Socket.sockaddr_un(ingest_socket))
+      ingest.send("#{channel}\nmsg 2", 0, Socket.sockaddr_un(ingest_socket))
+      ingest.close
+
+      headers, body = read_response_on_socket(subscriber, "msg 2")
+      expect(body).to eql("1|msg 1\r\n2|msg 2\r\n")
+      subscriber.close
+
+      stats = open_socket(nginx_host, nginx_port)
+      stats.print("GET /channels-stats HTTP/1.0\r\n\r\n")
+      headers, body = read_response_on_socket(stats, "by_worker")
+      expect(body).to match_the_pattern(/"ingested_messages": 2, "ingest_errors": 1, /)
+      stats.close
+    end
+  end
 end
@@ -144,4 +144,77 @@ describe "Comunication Properties" do
       end
     end
   end
+
+  it "should deliver all messages in order when output coalescing is enabled" do
+    channel = 'ch_test_output_coalescing'
+
+    response = ""
+    nginx_run_server(config.merge(:message_template => "|~text~", :output_coalescing_delay => "50ms", :output_coalescing_size => "4k")) do |conf|
+      EventMachine.run do
+        sub = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s).get :head => headers
+        sub.stream do |chunk|
+          response += chunk
+
+          if response.split("|").length >= 6
+            expect(response).to eql("#{conf.header_template}|msg 1|msg 2|msg 3|msg 4|msg 5")
+            EventMachine.stop
+          end
+        end
+
+        EM.add_timer(0.5) do
+          (1..5).each { |i| publish_message(channel, headers, "msg #{i}") }
+        end
+      end
+    end
+  end
+
+  it "should send only the newest message of each event id prefix when the message rate is exceeded" do
+    channel = 'ch_test_max_message_rate'
+
+    response = ""
+    nginx_run_server(config.merge(:message_template => "|~text~", :max_message_rate => "2", :conflation_event_id_separator => ":")) do |conf|
+      EventMachine.run do
+        sub = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s).get :head => headers
+        sub.stream do |chunk|
+          response += chunk
+
+          if response.split("|").length >= 4
+            expect(response).to eql("#{conf.header_template}|msg 1|msg 4|msg 5")
+            EventMachine.stop
+          end
+        end
+
+        EM.add_timer(0.5) do
+          [["a:1", "msg 1"], ["a:2", "msg 2"], ["b:1", "msg 3"], ["a:3", "msg 4"], ["b:2", "msg 5"]].each do |event_id, body|
+            publish_message(channel, headers.merge('Event-Id' => event_id), body)
+          end
+        end
+      end
+    end
+  end
+
+  it "should disconnect a subscriber which does not read the messages when the pending output limit is reached" do
+    channel = 'ch_test_slow_subscriber_disconnected'
+    body = "a" * 100000
+
+    nginx_run_server(config.merge(:max_pending_output_size => "100k", :store_messages => "off", :shared_memory_size => "64m")) do |conf|
+      socket = open_socket(nginx_host, nginx_port)
+      socket.print("GET /sub/#{channel} HTTP/1.1\r\nHost: test\r\n\r\n")
+      sleep(0.5)
+
+      100.times { publish_message(channel, headers, body) }
+
+      EventMachine.run do
+        pub = EventMachine::HttpRequest.new(nginx_address + '/channels-stats').get :head => headers
+        pub.callback do
+          expect(pub).to be_http_status(200)
+          response = JSON.parse(pub.response)
+          expect(response["slow_subscribers_disconnected"]).to eql(1)
+          expect(response["subscribers"]).to eql(0)
+          EventMachine.stop
+        end
+      end
+      socket.close
+    end
+  end
 end
@@ -60,6 +60,30 @@ describe "Subscriber Properties" do
       end
     end
 
+    it "should keep waiting when the newer messages are filtered by event types" do
+      channel = 'ch_test_long_polling_keep_waiting_with_filtered_messages'
+      response = ""
+
+      nginx_run_server(config) do |conf|
+        EventMachine.run do
+          publish_message(channel, {'Event-Type' => 'type_b'}, 'msg 1')
+
+          sent_headers = headers.merge({'If-Modified-Since' => Time.at(0).utc.strftime("%a, %d %b %Y %T %Z"), 'Event-Types' => 'type_a'})
+          sub = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s).get :head => sent_headers
+          sub.stream do |chunk|
+            response += chunk
+          end
+          sub.callback do
+            expect(sub).to be_http_status(200)
+            expect(response).to eql("msg 2")
+            EventMachine.stop
+          end
+
+          publish_message_inline(channel, {'Event-Type' => 'type_a'}, 'msg 2', 1)
+        end
+      end
+    end
+
     it "should disconnect after timeout is reached" do
       channel = 'ch_test_disconnect_long_polling_subscriber_when_longpolling_timeout_is_set'
 
@@ -197,6 +221,48 @@ describe "Subscriber Properties" do
       end
     end
 
+    it "should receive the messages published on the linger window in one response" do
+      channel = 'ch_test_receive_messages_published_on_linger_window'
+
+      nginx_run_server(config.merge(:longpolling_linger_time => "1s", :message_template => '~text~|')) do |conf|
+        EventMachine.run do
+          sub_1 = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s).get :head => headers
+          sub_1.callback do
+            expect(sub_1).to be_http_status(200)
+            expect(sub_1.response).to eql("msg 1|msg 2|")
+            EventMachine.stop
+          end
+
+          EM.add_timer(0.5) do
+            publish_message(channel, headers, "msg 1")
+            publish_message(channel, headers, "msg 2")
+          end
+        end
+      end
+    end
+
+    it "should send the response when the number of linger messages is reached" do
+      channel = 'ch_test_send_response_when_linger_messages_is_reached'
+
+      nginx_run_server(config.merge(:longpolling_linger_time => "10s", :longpolling_linger_messages => 2, :message_template => '~text~|'), :timeout => 5) do |conf|
+        EventMachine.run do
+          start = Time.now
+          sub_1 = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s).get :head => headers
+          sub_1.callback do
+            expect(sub_1).to be_http_status(200)
+            expect(sub_1.response).to eql("msg 1|msg 2|")
+            expect(Time.now - start).to be < 5
+            EventMachine.stop
+          end
+
+          EM.add_timer(0.5) do
+            publish_message(channel, headers, "msg 1")
+            publish_message(channel, headers, "msg 2")
+          end
+        end
+      end
+    end
+
     it "should accept delete a channel with a long polling subscriber" do
       channel = 'ch_test_delete_channel_with_long_polling_subscriber'
       callback_function_name = "callback_function"
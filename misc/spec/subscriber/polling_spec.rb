@@ -63,6 +63,109 @@ describe "Subscriber Properties" do
         end
       end
 
+      it "should receive a 304 when the last received message is the last one on the channel" do
+        channel = 'ch_test_receive_a_304_when_last_received_message_is_the_last_one'
+        body = 'body'
+
+        nginx_run_server(config) do |conf|
+          EventMachine.run do
+            publish_message(channel, {}, body)
+
+            sub_1 = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s).get :head => headers.merge({'If-Modified-Since' => Time.at(0).utc.strftime("%a, %d %b %Y %T %Z")})
+            sub_1.callback do
+              expect(sub_1).to be_http_status(200)
+
+              sent_headers = headers.merge({'If-Modified-Since' => sub_1.response_header['LAST_MODIFIED'], 'If-None-Match' => sub_1.response_header['ETAG']})
+              sub_2 = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s).get :head => sent_headers
+              sub_2.callback do
+                expect(sub_2).to be_http_status(304).without_body
+                expect(sub_2.response_header['LAST_MODIFIED'].to_s).to eql(sent_headers['If-Modified-Since'])
+                expect(sub_2.response_header['ETAG'].to_s).to eql(sent_headers['If-None-Match'])
+                EventMachine.stop
+              end
+            end
+          end
+        end
+      end
+
+      it "should reuse the cached response until the channel receives a new message" do
+        channel = 'ch_test_reuse_cached_polling_response'
+        body = 'body'
+        sent_headers = headers.merge({'If-Modified-Since' => Time.at(0).utc.strftime("%a, %d %b %Y %T %Z")})
+
+        nginx_run_server(config.merge({:polling_response_cache_entries => 10})) do |conf|
+          EventMachine.run do
+            publish_message(channel, {}, body)
+
+            sub_1 = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s + '.b1').get :head => sent_headers
+            sub_1.callback do
+              expect(sub_1).to be_http_status(200)
+              expect(sub_1.response).to eql("#{body}")
+
+              sub_2 = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s + '.b1').get :head => sent_headers
+              sub_2.callback do
+                expect(sub_2).to be_http_status(200)
+                expect(sub_2.response_header['LAST_MODIFIED'].to_s).to eql(sub_1.response_header['LAST_MODIFIED'].to_s)
+                expect(sub_2.response_header['ETAG'].to_s).to eql("W/1")
+                expect(sub_2.response).to eql("#{body}")
+
+                publish_message(channel, {}, body + "1")
+
+                sub_3 = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s + '.b1').get :head => sent_headers
+                sub_3.callback do
+                  expect(sub_3).to be_http_status(200)
+                  expect(sub_3.response).to eql("#{body + "1"}")
+                  EventMachine.stop
+                end
+              end
+            end
+          end
+        end
+      end
+
+      it "should not reuse a cached response with an expired snapshot" do
+        channel = 'ch_test_cached_polling_response_expired_snapshot'
+        body = 'state'
+        sent_headers = headers.merge({'If-Modified-Since' => Time.at(0).utc.strftime("%a, %d %b %Y %T %Z")})
+
+        nginx_run_server(config.merge({:polling_response_cache_entries => 10, :message_ttl => '2s'})) do |conf|
+          EventMachine.run do
+            post_to('/pub?id=' + channel.to_s, {'Snapshot' => 'true'}, body)
+
+            sub_1 = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s + '.b1').get :head => sent_headers
+            sub_1.callback do
+              expect(sub_1).to be_http_status(200)
+              expect(sub_1.response).to eql("#{body}")
+
+              EM.add_timer(3) do
+                sub_2 = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s + '.b1').get :head => sent_headers
+                sub_2.callback do
+                  expect(sub_2).to be_http_status(304).without_body
+                  EventMachine.stop
+                end
+              end
+            end
+          end
+        end
+      end
+
+      it "should receive a 304 when the newer messages are filtered by event types" do
+        channel = 'ch_test_receive_a_304_when_messages_are_filtered'
+
+        nginx_run_server(config) do |conf|
+          EventMachine.run do
+            publish_message(channel, {'Event-Type' => 'type_b'}, 'msg 1')
+
+            sent_headers = headers.merge({'If-Modified-Since' => Time.at(0).utc.strftime("%a, %d %b %Y %T %Z"), 'Event-Types' => 'type_a'})
+            sub_1 = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s).get :head => sent_headers
+            sub_1.callback do
+              expect(sub_1).to be_http_status(304).without_body
+              EventMachine.stop
+            end
+          end
+        end
+      end
+
       it "should accept a callback parameter to works with JSONP" do
         channel = 'ch_test_return_message_using_function_name_specified_in_callback_parameter_when_polling'
         body = 'body'
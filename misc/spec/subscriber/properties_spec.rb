@@ -663,7 +663,7 @@ describe "Subscriber Properties" do
           sub_1.stream do |chunk|
             expect(sub_1.response_header['ACCESS_CONTROL_ALLOW_ORIGIN']).to eql("custom.domain.com")
             expect(sub_1.response_header['ACCESS_CONTROL_ALLOW_METHODS']).to eql("GET")
-            expect(sub_1.response_header['ACCESS_CONTROL_ALLOW_HEADERS']).to eql("If-Modified-Since,If-None-Match,Etag,Event-Id,Event-Type,Last-Event-Id")
+            expect(sub_1.response_header['ACCESS_CONTROL_ALLOW_HEADERS']).to eql("If-Modified-Since,If-None-Match,Etag,Event-Id,Event-Type,Last-Event-Id,Event-Types,Message-Key,Snapshot,Accept-Delta")
 
             EventMachine.stop
           end
@@ -680,7 +680,7 @@ describe "Subscriber Properties" do
           sub_1.stream do |chunk|
             expect(sub_1.response_header['ACCESS_CONTROL_ALLOW_ORIGIN']).to eql("test.com")
             expect(sub_1.response_header['ACCESS_CONTROL_ALLOW_METHODS']).to eql("GET")
-            expect(sub_1.response_header['ACCESS_CONTROL_ALLOW_HEADERS']).to eql("If-Modified-Since,If-None-Match,Etag,Event-Id,Event-Type,Last-Event-Id")
+            expect(sub_1.response_header['ACCESS_CONTROL_ALLOW_HEADERS']).to eql("If-Modified-Since,If-None-Match,Etag,Event-Id,Event-Type,Last-Event-Id,Event-Types,Message-Key,Snapshot,Accept-Delta")
 
             EventMachine.stop
           end
@@ -1038,4 +1038,75 @@ describe "Subscriber Properties" do
       end
     end
   end
+
+  it "should only receive messages of the event types the subscriber asked for" do
+    channel = 'ch_test_subscriber_event_types_filter'
+    actual_response = ''
+
+    nginx_run_server(config.merge(:header_template => nil, :message_template => '~text~|')) do |conf|
+      EventMachine.run do
+        sub = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s).get :head => headers.merge('Event-Types' => 'type_a,type_c')
+        sub.stream do |chunk|
+          actual_response += chunk
+          if actual_response.include?("msg 4|")
+            expect(actual_response).to eql("msg 1|msg 4|")
+            EventMachine.stop
+          end
+        end
+
+        EM.add_timer(0.5) do
+          publish_message(channel, {'Event-Type' => 'type_a'}, 'msg 1')
+          publish_message(channel, {'Event-Type' => 'type_b'}, 'msg 2')
+          publish_message(channel, {}, 'msg 3')
+          publish_message(channel, {'Event-Type' => 'type_c'}, 'msg 4')
+        end
+      end
+    end
+  end
+
+  it "should receive only the changes of the messages when accepting deltas" do
+    channel = 'ch_test_subscriber_accept_delta'
+    actual_response = ''
+
+    nginx_run_server(config.merge(:message_delta => 'on', :header_template => nil, :message_template => '~delta~:~text~|')) do |conf|
+      EventMachine.run do
+        sub = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s).get :head => headers.merge('Accept-Delta' => 'true')
+        sub.stream do |chunk|
+          actual_response += chunk
+          if actual_response.include?("13,16,7|")
+            expect(actual_response).to eql(':{"price": 10.5, "volume": 100}|1:13,16,7|')
+            EventMachine.stop
+          end
+        end
+
+        EM.add_timer(0.5) do
+          publish_message(channel, {}, '{"price": 10.5, "volume": 100}')
+          publish_message(channel, {}, '{"price": 10.7, "volume": 100}')
+        end
+      end
+    end
+  end
+
+  it "should keep whole utf-8 characters on the changes of the messages" do
+    channel = 'ch_test_subscriber_accept_delta_utf8'
+    actual_response = ''
+
+    nginx_run_server(config.merge(:message_delta => 'on', :header_template => nil, :message_template => '~delta~:~text~|')) do |conf|
+      EventMachine.run do
+        sub = EventMachine::HttpRequest.new(nginx_address + '/sub/' + channel.to_s).get :head => headers.merge('Accept-Delta' => 'true')
+        sub.stream do |chunk|
+          actual_response += chunk
+          if actual_response.include?("13,9,") && actual_response.end_with?("|")
+            expect(actual_response.force_encoding('UTF-8')).to eql(':{"name": "café crème"}|1:13,9,è|')
+            EventMachine.stop
+          end
+        end
+
+        EM.add_timer(0.5) do
+          publish_message(channel, {}, '{"name": "café crème"}')
+          publish_message(channel, {}, '{"name": "cafè crème"}')
+        end
+      end
+    end
+  end
 end
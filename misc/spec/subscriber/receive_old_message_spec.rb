@@ -298,6 +298,38 @@ describe "Receive old messages" do
         end
       end
     end
+
+    it "should receive only old messages of the event types in 'Event-Types' header" do
+      channel = 'ch_test_receive_old_messages_filtered_by_event_types_header'
+
+      nginx_run_server(config.merge(:message_template => '~text~\r\n')) do |conf|
+        publish_message(channel, {'Event-Type' => 'type_a'}, 'msg 1')
+        publish_message(channel, {'Event-Type' => 'type_b'}, 'msg 2')
+        publish_message(channel, {}, 'msg 3')
+        publish_message(channel, {'Event-Type' => 'type_c'}, 'msg 4')
+
+        sent_headers = headers.merge({'Event-Types' => 'type_a, type_c'})
+        expected_lines = (conf.subscriber_mode == "eventsource") ? 4 : 2
+        get_content(nginx_address + '/sub/' + channel.to_s + '.b4', expected_lines, sent_headers) do |response, response_headers|
+          expect(response.split(eol).reject{|line| line.start_with?("event: ")}.join(eol) + eol).to eql("msg 1\r\nmsg 4\r\n")
+        end
+      end
+    end
+
+    it "should receive only old messages of the event types set by 'push_stream_event_types'" do
+      channel = 'ch_test_receive_old_messages_filtered_by_event_types_directive'
+
+      nginx_run_server(config.merge(:event_types => "$arg_types", :message_template => '~text~\r\n')) do |conf|
+        publish_message(channel, {'Event-Type' => 'type_a'}, 'msg 1')
+        publish_message(channel, {'Event-Type' => 'type_b'}, 'msg 2')
+        publish_message(channel, {'Event-Type' => 'type_b'}, 'msg 3')
+
+        expected_lines = (conf.subscriber_mode == "eventsource") ? 4 : 2
+        get_content(nginx_address + '/sub/' + channel.to_s + '.b3?types=type_b', expected_lines, headers) do |response, response_headers|
+          expect(response.split(eol).reject{|line| line.start_with?("event: ")}.join(eol) + eol).to eql("msg 2\r\nmsg 3\r\n")
+        end
+      end
+    end
   end
 
   def get_content(url, number_expected_lines, request_headers, &block)
@@ -364,6 +364,28 @@ describe "Subscriber WebSocket" do
     end
   end
 
+  it "should drop messages published over the channel publish rate" do
+    frame = "%c%c%c%c%c%c%c%c%c%c%c" % [0x81, 0x85, 0xBD, 0xD0, 0xE5, 0x2A, 0xD5, 0xB5, 0x89, 0x46, 0xD2] #send 'hello' text
+    channel = 'ch_test_websocket_publish_rate'
+
+    request = "GET /ws/#{channel} HTTP/1.0\r\nConnection: Upgrade\r\nSec-WebSocket-Key: /mQoZf6pRiv8+6o72GncLQ==\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 8\r\n"
+
+    nginx_run_server(config.merge(:channel_publish_rate => 1)) do |conf|
+      socket = open_socket(nginx_host, nginx_port)
+      socket.print("#{request}\r\n")
+      headers, body = read_response_on_socket(socket)
+      socket.print(frame)
+      socket.print(frame)
+
+      sleep 1.5
+      publish_message(channel, {}, "after")
+
+      body, dummy = read_response_on_socket(socket, "after")
+      expect(body).to eql("\201\005hello\201\005after")
+      socket.close
+    end
+  end
+
   it "should publish large message" do
     channel = 'ch_test_publish_large_message'
 
@@ -693,7 +715,7 @@ describe "Subscriber WebSocket" do
 
   it "should reject unsupported frames" do
     channel = 'ch_test_reject_unsupported_frames'
-    frame = "%c%c%c%c%c%c%c%c%c%c%c" % [0x82, 0x85, 0xBD, 0xD0, 0xE5, 0x2A, 0xD5, 0xB5, 0x89, 0x46, 0xD2] #send binary frame
+    frame = "%c%c%c%c%c%c%c%c%c%c%c" % [0x83, 0x85, 0xBD, 0xD0, 0xE5, 0x2A, 0xD5, 0xB5, 0x89, 0x46, 0xD2] #send frame with a reserved opcode
 
     request = "GET /ws/#{channel}.b1 HTTP/1.0\r\nConnection: Upgrade\r\nSec-WebSocket-Key: /mQoZf6pRiv8+6o72GncLQ==\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 8\r\n"
 
@@ -721,6 +743,66 @@ describe "Subscriber WebSocket" do
     end
   end
 
+  it "should accept binary frames with any content" do
+    channel = 'ch_test_publish_binary_frames'
+    frame = "%c%c%c%c%c%c%c%c%c%c" % [0x82, 0x84, 0x37, 0xfa, 0x21, 0x3d, 0x37 ^ 0xff, 0xfa ^ 0x00, 0x21 ^ 0xa3, 0x3d ^ 0x80] #send binary frame with invalid utf8 bytes
+
+    request_1 = "GET /ws/#{channel}.b1 HTTP/1.0\r\nConnection: Upgrade\r\nSec-WebSocket-Key: /mQoZf6pRiv8+6o72GncLQ==\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 8\r\n"
+    request_2 = "GET /ws/#{channel} HTTP/1.0\r\nConnection: Upgrade\r\nSec-WebSocket-Key: /mQoZf6pRiv8+6o72GncLQ==\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 8\r\n"
+
+    nginx_run_server(config) do |conf|
+      socket_1 = open_socket(nginx_host, nginx_port)
+      socket_1.print("#{request_1}\r\n")
+      headers, body = read_response_on_socket(socket_1)
+      socket_1.print(frame)
+      body, dummy = read_response_on_socket(socket_1, "\x80")
+      expect(body).to eql("\x82\x04\xff\x00\xa3\x80")
+
+      socket_2 = open_socket(nginx_host, nginx_port)
+      socket_2.print("#{request_2}\r\n")
+      headers, body = read_response_on_socket(socket_2, "\x80")
+      expect(body).to eql("\x82\x04\xff\x00\xa3\x80")
+
+      socket_1.close
+      socket_2.close
+    end
+  end
+
+  it "should deliver messages published as application/octet-stream on binary frames" do
+    channel = 'ch_test_receive_binary_frames'
+    body = "\xff\x00\xa3\x80"
+
+    request = "GET /ws/#{channel} HTTP/1.0\r\nConnection: Upgrade\r\nSec-WebSocket-Key: /mQoZf6pRiv8+6o72GncLQ==\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 8\r\n"
+
+    nginx_run_server(config) do |conf|
+      publish_message(channel, {'Content-Type' => 'application/octet-stream'}, body)
+      publish_message(channel, {'Content-Type' => 'text/plain'}, 'text')
+
+      socket = open_socket(nginx_host, nginx_port)
+      socket.print("#{request}\r\n")
+      headers, body = read_response_on_socket(socket, "text")
+      expect(body).to eql("\x82\x04\xff\x00\xa3\x80\x81\x04text")
+      socket.close
+    end
+  end
+
+  it "should deliver binary messages base64 encoded to subscribers not using websocket" do
+    channel = 'ch_test_receive_binary_messages_on_stream'
+    body = "\xff\x00\xa3\x80"
+
+    request = "GET /sub/#{channel}.b1 HTTP/1.0\r\n"
+
+    nginx_run_server(config.merge(:message_template => '{\"text\":\"~text~\"}', :subscriber_connection_ttl => '1s')) do |conf|
+      publish_message(channel, {'Content-Type' => 'application/octet-stream'}, body)
+
+      socket = open_socket(nginx_host, nginx_port)
+      socket.print("#{request}\r\n")
+      headers, body = read_response_on_socket(socket, '}')
+      expect(body).to eql('{"text":"/wCjgA=="}')
+      socket.close
+    end
+  end
+
   it "should accept unmasked frames" do
     channel = 'ch_test_publish_unmasked_frames'
 
@@ -885,4 +967,294 @@ describe "Subscriber WebSocket" do
       socket.close
     end
   end
+
+  it "should accept many frames sent on the same packet" do
+    channel = 'ch_test_publish_frames_same_packet'
+    large_text = "a" * 5000
+
+    nginx_run_server(config.merge({ shared_memory_size: '15m' }), timeout: 60) do |conf|
+      frame_unmasked = "%c%c%c%c%c%c%c" % [0x81, 0x05, 0x48, 0x65, 0x6c, 0x6c, 0x6f] #send 'hello' frame
+      frame_masked = "%c%c%c%c%c%c%c%c%c%c%c" % [0x81, 0x85, 0x37, 0xfa, 0x21, 0x3d, 0x7f, 0x9f, 0x4d, 0x51, 0x58] #send 'hello' frame
+      frame_part1 = "%c%c%c%c%c" % [0x01, 0x03, 0x48, 0x65, 0x6c] #send 'Hel' frame
+      frame_part2 = "%c%c%c%c" % [0x80, 0x02, 0x6c, 0x6f] #send 'lo' frame
+      frame_large = "%c%c%c%c" % [0x81, 0x7e, 0x13, 0x88] + large_text #send a frame larger than the read buffer
+
+      request = "GET /ws/#{channel} HTTP/1.0\r\nConnection: Upgrade\r\nSec-WebSocket-Key: /mQoZf6pRiv8+6o72GncLQ==\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 8\r\n"
+
+      socket = open_socket(nginx_host, nginx_port)
+      socket.print("#{request}\r\n")
+      headers, body = read_response_on_socket(socket)
+
+      socket.print(frame_unmasked + frame_masked + frame_part1 + frame_part2 + frame_large + frame_unmasked)
+      body, dummy = read_response_on_socket(socket, "#{large_text}\x81\x05Hello")
+      expect(body).to eql("\x81\x05Hello" * 3 + "\x81\x7e\x13\x88#{large_text}" + "\x81\x05Hello")
+
+      socket.close
+
+      EventMachine.run do
+        pub = EventMachine::HttpRequest.new(nginx_address + '/channels-stats?id=' + channel.to_s).get :timeout => 30
+        pub.callback do
+          expect(pub).to be_http_status(200).with_body
+          response = JSON.parse(pub.response)
+          expect(response["published_messages"].to_i).to eql(5)
+          EventMachine.stop
+        end
+      end
+    end
+  end
+
+  context "when permessage-deflate is enabled" do
+    let(:deflate_config) do
+      config.merge({
+        :extra_location => %q{
+          location ~ /ws/(.*)? {
+              push_stream_subscriber websocket;
+              push_stream_channels_path               $1;
+              push_stream_websocket_allow_publish     on;
+              push_stream_websocket_deflate           on;
+          }
+        }
+      })
+    end
+
+    it "should not negotiate the extension when the client does not offer it" do
+      channel = 'ch_test_deflate_not_offered'
+      request = "GET /ws/#{channel} HTTP/1.0\r\nConnection: Upgrade\r\nSec-WebSocket-Key: /mQoZf6pRiv8+6o72GncLQ==\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\n"
+
+      nginx_run_server(deflate_config) do |conf|
+        socket = open_socket(nginx_host, nginx_port)
+        socket.print("#{request}\r\n")
+        headers, body = read_response_on_socket(socket)
+        expect(headers).to match_the_pattern(/HTTP\/1\.1 101 Switching Protocols/)
+        expect(headers).not_to match_the_pattern(/Sec-WebSocket-Extensions/)
+
+        publish_message(channel, {}, "Hello")
+
+        body, dummy = read_response_on_socket(socket, "Hello")
+        expect(body).to eql("\201\005Hello")
+        socket.close
+      end
+    end
+
+    it "should refuse an offer with a reduced server window" do
+      channel = 'ch_test_deflate_reduced_window'
+      request = "GET /ws/#{channel} HTTP/1.0\r\nConnection: Upgrade\r\nSec-WebSocket-Key: /mQoZf6pRiv8+6o72GncLQ==\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Extensions: permessage-deflate; server_max_window_bits=10\r\n"
+
+      nginx_run_server(deflate_config) do |conf|
+        socket = open_socket(nginx_host, nginx_port)
+        socket.print("#{request}\r\n")
+        headers, body = read_response_on_socket(socket)
+        expect(headers).to match_the_pattern(/HTTP\/1\.1 101 Switching Protocols/)
+        expect(headers).not_to match_the_pattern(/Sec-WebSocket-Extensions/)
+        socket.close
+      end
+    end
+
+    it "should receive compressed messages" do
+      channel = 'ch_test_deflate_receive_compressed_messages'
+      message = '{"items":[' + (1..20).map { |i| %[{"id":#{i},"status":"active"}] }.join(",") + ']}'
+      request = "GET /ws/#{channel} HTTP/1.0\r\nConnection: Upgrade\r\nSec-WebSocket-Key: /mQoZf6pRiv8+6o72GncLQ==\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Extensions: permessage-deflate; client_max_window_bits, x-webkit-deflate-frame\r\n"
+
+      nginx_run_server(deflate_config) do |conf|
+        socket = open_socket(nginx_host, nginx_port)
+        socket.print("#{request}\r\n")
+        headers, body = read_response_on_socket(socket)
+        expect(headers).to match_the_pattern(/Sec-WebSocket-Extensions: permessage-deflate; server_no_context_takeover; client_no_context_takeover/)
+
+        publish_message(channel, {}, message)
+
+        body, dummy = read_response_on_socket(socket, "\301")
+        expect(body[0]).to eql("\301")
+        length = body[1].ord
+        expect(length).to be < message.length
+        inflated = Zlib::Inflate.new(-Zlib::MAX_WBITS).inflate(body[2, length] + "\000\000\377\377")
+        expect(inflated).to eql(message)
+        socket.close
+      end
+    end
+
+    it "should accept compressed messages" do
+      channel = 'ch_test_deflate_accept_compressed_messages'
+      request = "GET /ws/#{channel} HTTP/1.0\r\nConnection: Upgrade\r\nSec-WebSocket-Key: /mQoZf6pRiv8+6o72GncLQ==\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Extensions: permessage-deflate\r\n"
+
+      payload = Zlib::Deflate.new(Zlib::DEFAULT_COMPRESSION, -Zlib::MAX_WBITS).deflate("Hello", Zlib::SYNC_FLUSH)[0..-5]
+      frame = "%c%c" % [0xC1, payload.length] + payload
+
+      nginx_run_server(deflate_config) do |conf|
+        socket = open_socket(nginx_host, nginx_port)
+        socket.print("#{request}\r\n")
+        headers, body = read_response_on_socket(socket)
+        socket.print(frame)
+        body, dummy = read_response_on_socket(socket, "llo")
+        expect(body).to eql("\201\005Hello")
+        socket.close
+      end
+    end
+  end
+
+  context "when subscriptions by websocket commands are allowed" do
+    let(:subscribe_config) do
+      config.merge({
+        :extra_location => %q{
+          location ~ /ws/(.*)? {
+              push_stream_subscriber websocket;
+              push_stream_channels_path               $1;
+              push_stream_websocket_allow_subscribe   on;
+          }
+        }
+      })
+    end
+
+    def text_frame(text)
+      "%c%c" % [0x81, text.size] + text
+    end
+
+    it "should add and remove channels without reconnecting" do
+      channel_1 = 'ch_test_websocket_subscribe_1'
+      channel_2 = 'ch_test_websocket_subscribe_2'
+      request = "GET /ws/#{channel_1} HTTP/1.0\r\nConnection: Upgrade\r\nSec-WebSocket-Key: /mQoZf6pRiv8+6o72GncLQ==\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\n"
+
+      nginx_run_server(subscribe_config) do |conf|
+        publish_message(channel_2, {}, "old")
+        publish_message(channel_2, {}, "stored")
+
+        socket = open_socket(nginx_host, nginx_port)
+        socket.print("#{request}\r\n")
+        headers, body = read_response_on_socket(socket)
+        expect(headers).to match_the_pattern(/HTTP\/1\.1 101 Switching Protocols/)
+
+        socket.print(text_frame("SUBSCRIBE #{channel_2}.b1"))
+        body, dummy = read_response_on_socket(socket, "stored")
+        expect(body).to eql("\201\006stored")
+
+        socket.print(text_frame("UNSUBSCRIBE #{channel_1}"))
+        sleep(0.5)
+
+        publish_message(channel_1, {}, "lost")
+        publish_message(channel_2, {}, "kept")
+
+        body, dummy = read_response_on_socket(socket, "kept")
+        expect(body).to eql("\201\004kept")
+        socket.close
+
+        EventMachine.run do
+          pub = EventMachine::HttpRequest.new(nginx_address + '/channels-stats?id=' + channel_1.to_s).get :timeout => 30
+          pub.callback do
+            expect(pub).to be_http_status(200).with_body
+            response = JSON.parse(pub.response)
+            expect(response["published_messages"].to_i).to eql(1)
+            expect(response["subscribers"].to_i).to eql(0)
+            EventMachine.stop
+          end
+        end
+      end
+    end
+
+    it "should not deliver messages waiting to be sent for an unsubscribed channel" do
+      channel_1 = 'ch_test_websocket_unsubscribe_deferred_1'
+      channel_2 = 'ch_test_websocket_unsubscribe_deferred_2'
+      request = "GET /ws/#{channel_1}/#{channel_2} HTTP/1.0\r\nConnection: Upgrade\r\nSec-WebSocket-Key: /mQoZf6pRiv8+6o72GncLQ==\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\n"
+
+      nginx_run_server(subscribe_config.merge(:max_message_rate => "1")) do |conf|
+        socket = open_socket(nginx_host, nginx_port)
+        socket.print("#{request}\r\n")
+        headers, body = read_response_on_socket(socket)
+
+        publish_message(channel_1, {}, "first")
+        publish_message(channel_1, {}, "deferred")
+        socket.print(text_frame("UNSUBSCRIBE #{channel_1}"))
+        sleep(1.5)
+
+        publish_message(channel_2, {}, "kept")
+        body, dummy = read_response_on_socket(socket, "kept")
+        expect(body).to eql("\201\005first\201\004kept")
+        socket.close
+      end
+    end
+
+    it "should count the channels already subscribed when validating new wildcard channels" do
+      channel = 'ch_test_websocket_subscribe_wildcard'
+      request = "GET /ws/#{channel} HTTP/1.0\r\nConnection: Upgrade\r\nSec-WebSocket-Key: /mQoZf6pRiv8+6o72GncLQ==\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\n"
+
+      nginx_run_server(subscribe_config) do |conf|
+        socket = open_socket(nginx_host, nginx_port)
+        socket.print("#{request}\r\n")
+        headers, body = read_response_on_socket(socket)
+
+        (1..4).each { |i| socket.print(text_frame("SUBSCRIBE broad_#{i}")) }
+        socket.print(text_frame("UNSUBSCRIBE #{channel}"))
+        sleep(0.5)
+
+        publish_message('broad_4', {}, "refused")
+        publish_message(channel, {}, "normal")
+        publish_message('broad_3', {}, "wildcard")
+
+        body, dummy = read_response_on_socket(socket, "wildcard")
+        expect(body).to eql("\201\006normal\201\010wildcard")
+        socket.close
+      end
+    end
+
+    it "should limit the number of channels subscribed by the connection" do
+      channel = 'ch_test_websocket_subscribe_limit'
+      request = "GET /ws/#{channel}_1 HTTP/1.0\r\nConnection: Upgrade\r\nSec-WebSocket-Key: /mQoZf6pRiv8+6o72GncLQ==\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\n"
+
+      nginx_run_server(subscribe_config.merge(:extra_location => subscribe_config[:extra_location].sub("allow_subscribe   on;", "allow_subscribe   on;\n push_stream_websocket_max_subscriptions 2;"))) do |conf|
+        socket = open_socket(nginx_host, nginx_port)
+        socket.print("#{request}\r\n")
+        headers, body = read_response_on_socket(socket)
+
+        socket.print(text_frame("SUBSCRIBE #{channel}_2"))
+        socket.print(text_frame("SUBSCRIBE #{channel}_3"))
+        sleep(0.5)
+
+        publish_message("#{channel}_3", {}, "refused")
+        publish_message("#{channel}_2", {}, "accepted")
+
+        body, dummy = read_response_on_socket(socket, "accepted")
+        expect(body).to eql("\201\010accepted")
+        socket.close
+      end
+    end
+
+    it "should resume the new subscription from the given message time and tag" do
+      channel_1 = 'ch_test_websocket_subscribe_resume_1'
+      channel_2 = 'ch_test_websocket_subscribe_resume_2'
+      request = "GET /ws/#{channel_1} HTTP/1.0\r\nConnection: Upgrade\r\nSec-WebSocket-Key: /mQoZf6pRiv8+6o72GncLQ==\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\n"
+
+      nginx_run_server(subscribe_config.merge(message_template: '~text~|~time~|~tag~')) do |conf|
+        socket = open_socket(nginx_host, nginx_port)
+        socket.print("#{request}\r\n")
+        headers, body = read_response_on_socket(socket)
+
+        publish_message(channel_1, {}, "first")
+        body, dummy = read_response_on_socket(socket, "|1")
+        text, time, tag = body[2..-1].split("|")
+
+        publish_message(channel_2, {}, "second")
+        publish_message(channel_2, {}, "third")
+
+        socket.print(text_frame("SUBSCRIBE #{channel_2}\r\nIf-Modified-Since: #{time}\r\nIf-None-Match: #{tag}"))
+        body, dummy = read_response_on_socket(socket, "third")
+        expect(body).to match_the_pattern(/second.*third/m)
+        socket.close
+      end
+    end
+
+    it "should publish messages which are not commands" do
+      channel = 'ch_test_websocket_subscribe_no_command'
+      request = "GET /ws/#{channel} HTTP/1.0\r\nConnection: Upgrade\r\nSec-WebSocket-Key: /mQoZf6pRiv8+6o72GncLQ==\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\n"
+
+      nginx_run_server(subscribe_config.merge(:extra_location => subscribe_config[:extra_location].sub("allow_subscribe   on;", "allow_subscribe   on;\n push_stream_websocket_allow_publish on;"))) do |conf|
+        socket = open_socket(nginx_host, nginx_port)
+        socket.print("#{request}\r\n")
+        headers, body = read_response_on_socket(socket)
+
+        socket.print(text_frame("SUBSCRIBER is not a command"))
+        body, dummy = read_response_on_socket(socket, "command")
+        expect(body).to eql("\201\033SUBSCRIBER is not a command")
+        socket.close
+      end
+    end
+  end
 end
@@ -0,0 +1,261 @@
+/*
+Copyright (C) 2011 Michael Costello, Wandenberg Peixoto <wandenberg@gmail.com>
+
+Measures the time spent by the server to deliver one message to all subscribers of a channel.
+Usage './fanout --help' to see option
+*/
+#include <argtable2.h>
+#include <time.h>
+#include "util.h"
+
+#define FANOUT_CHANNEL "fanout_bench"
+#define FANOUT_MESSAGE "**MSG**"
+
+int count_strinstr(const char *big, const char *little);
+int publish_message(struct sockaddr_in *server_address, char *buffer, int buffer_len);
+int wait_subscribers(int main_sd, int num_connections, int expected, struct epoll_event *events, char *buffer, int buffer_len, int timeout);
+
+double
+elapsed_ms(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+
+int
+main_program(int num_rounds, int num_connections, const char *server_hostname, int server_port, int timeout)
+{
+    struct sockaddr_in server_address;
+    int main_sd = -1, i, len;
+    Connection *connections = NULL;
+    Statistics stats = {0,0,0,0,0};
+    int exitcode = EXIT_SUCCESS;
+    struct epoll_event *events = NULL;
+    char buffer[BIG_BUFFER_SIZE];
+    struct timespec start;
+    double elapsed, total = 0, min = -1, max = 0;
+
+    info("Fanout starting up\n");
+    info("Fanout: %d rounds to %d subscribers on server: %s:%d\n", num_rounds, num_connections, server_hostname, server_port);
+
+    if ((fill_server_address(server_hostname, server_port, &server_address)) != 0) {
+        error2("ERROR host name not found\n");
+    }
+
+    if ((events = (struct epoll_event *) malloc(sizeof(struct epoll_event) * MAX_EVENTS)) == NULL) {
+        error2("Failed to allocate events\n");
+    }
+
+    if ((main_sd = epoll_create(200 /* this size is not used on Linux kernel 2.6.8+ */)) < 0) {
+        error3("Failed %d creating main epoll socket\n", errno);
+    }
+
+    if ((connections = init_connections(num_connections, &server_address, main_sd)) == NULL) {
+        error2("Failed to create to connections\n");
+    }
+
+    len = sprintf(buffer, "GET /sub/%s HTTP/1.1\r\nHost: loadtest\r\n\r\n", FANOUT_CHANNEL);
+    for (i = 0; i < num_connections; i++) {
+        connections[i].state = CONNECTED;
+        connections[i].message_count = 0;
+        connections[i].num_messages = 0;
+        if (write_connection(&connections[i], &stats, buffer, len) == EXIT_FAILURE) {
+            error2("Failed to subscribe connection %d\n", i);
+        }
+
+        if (change_connection(&connections[i], EPOLLIN | EPOLLHUP) < 0) {
+            error2("Failed changing events for connection = %d\n", i);
+        }
+    }
+
+    // wait all subscribers receive the response header
+    if (wait_subscribers(main_sd, num_connections, 0, events, buffer, BIG_BUFFER_SIZE, timeout) != EXIT_SUCCESS) {
+        error2("Subscribers were not connected\n");
+    }
+    summary("Subscribers=%d connected\n", num_connections);
+
+    for (i = 1; i <= num_rounds; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        if (publish_message(&server_address, buffer, BIG_BUFFER_SIZE) != EXIT_SUCCESS) {
+            error2("Failed to publish message %d\n", i);
+        }
+
+        if (wait_subscribers(main_sd, num_connections, i, events, buffer, BIG_BUFFER_SIZE, timeout) != EXIT_SUCCESS) {
+            error2("Message %d was not delivered to all subscribers\n", i);
+        }
+
+        elapsed = elapsed_ms(&start);
+        total += elapsed;
+        min = ((min < 0) || (elapsed < min)) ? elapsed : min;
+        max = (elapsed > max) ? elapsed : max;
+        info("Round %d delivered in %0.3f ms\n", i, elapsed);
+    }
+
+    summary("Subscribers=%d Rounds=%d FanoutTime(ms) Min=%0.3f Avg=%0.3f Max=%0.3f\n", num_connections, num_rounds, min, total / num_rounds, max);
+
+exit:
+    if (connections != NULL) {
+        for (i = 0; i < num_connections; i++) {
+            close_connection(&connections[i]);
+        }
+        free(connections);
+    }
+    if (events != NULL) free(events);
+
+    return exitcode;
+}
+
+
+int
+wait_subscribers(int main_sd, int num_connections, int expected, struct epoll_event *events, char *buffer, int buffer_len, int timeout)
+{
+    int num_events, i, bytes_read, done = 0;
+    Connection *connection;
+
+    while (done < num_connections) {
+        if ((num_events = epoll_wait(main_sd, events, MAX_EVENTS, timeout)) <= 0) {
+            return EXIT_FAILURE;
+        }
+
+        for (i = 0; i < num_events; i++) {
+            connection = (Connection *)(events[i].data.ptr);
+
+            if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                return EXIT_FAILURE;
+            }
+
+            if ((bytes_read = read(connection->sd, buffer, buffer_len - 1)) <= 0) {
+                return EXIT_FAILURE;
+            }
+            buffer[bytes_read] = '\0';
+            trace("Read Message: %s\n", buffer);
+
+            if (expected == 0) {
+                if (connection->num_messages == 0) {
+                    connection->num_messages = 1;
+                    done++;
+                }
+                continue;
+            }
+
+            connection->message_count += count_strinstr(buffer, FANOUT_MESSAGE);
+            if (connection->message_count == expected) {
+                done++;
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+int
+publish_message(struct sockaddr_in *server_address, char *buffer, int buffer_len)
+{
+    int sd, len, exitcode = EXIT_SUCCESS;
+
+    if ((sd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        error3("ERROR %d opening publisher socket\n", errno);
+    }
+
+    if (connect(sd, (struct sockaddr *) server_address, sizeof(struct sockaddr_in)) < 0)  {
+        close(sd);
+        error3("ERROR connecting publisher to server\n");
+    }
+
+    len = sprintf(buffer, "POST /pub?id=%s HTTP/1.1\r\nHost: loadtest\r\nConnection: close\r\nContent-Length: %d\r\n\r\n%s", FANOUT_CHANNEL, (int) strlen(FANOUT_MESSAGE), FANOUT_MESSAGE);
+    if (write(sd, buffer, len) != len) {
+        close(sd);
+        error3("ERROR writing message to server\n");
+    }
+
+    // response is not read before the fan out, it would be counted in the elapsed time
+    shutdown(sd, SHUT_WR);
+    close(sd);
+
+exit:
+    return exitcode;
+}
+
+
+int
+main(int argc, char **argv)
+{
+    struct arg_int *rounds  = arg_int0("m", "messages", "<n>", "define number of messages published, one at a time (default is 1)");
+    struct arg_int *subscribers  = arg_int0("s", "subscribers", "<n>", "define number of subscribers (default is 1)");
+
+    struct arg_str *server_name = arg_str0("S", "server", "<hostname>", "server hostname where messages will be published (default is \"127.0.0.1\")");
+    struct arg_int *server_port = arg_int0("P", "port", "<n>", "server port where messages will be published (default is 9080)");
+
+    struct arg_int *timeout = arg_int0(NULL, "timeout", "<n>", "timeout when waiting events on communication to the server (default is 1000)");
+    struct arg_int *verbose = arg_int0("v", "verbose", "<n>", "increase output messages detail (0 (default) - no messages, 1 - info messages, 2 - debug messages, 3 - trace messages");
+
+    struct arg_lit *help    = arg_lit0(NULL, "help", "print this help and exit");
+    struct arg_lit *version = arg_lit0(NULL, "version", "print version information and exit");
+    struct arg_end *end     = arg_end(20);
+
+    void* argtable[] = { rounds, subscribers, server_name, server_port, timeout, verbose, help, version, end };
+
+    const char* progname = "fanout";
+    int nerrors;
+    int exitcode = EXIT_SUCCESS;
+
+    /* verify the argtable[] entries were allocated sucessfully */
+    if (arg_nullcheck(argtable) != 0) {
+        /* NULL entries were detected, some allocations must have failed */
+        printf("%s: insufficient memory\n", progname);
+        exitcode = EXIT_FAILURE;
+        goto exit;
+    }
+
+    /* set any command line default values prior to parsing */
+    rounds->ival[0] = DEFAULT_NUM_MESSAGES;
+    subscribers->ival[0] = DEFAULT_CONCURRENT_CONN;
+    server_name->sval[0] = DEFAULT_SERVER_HOSTNAME;
+    server_port->ival[0] = DEFAULT_SERVER_PORT;
+    timeout->ival[0] = DEFAULT_TIMEOUT;
+    verbose->ival[0] = 0;
+
+    /* Parse the command line as defined by argtable[] */
+    nerrors = arg_parse(argc, argv, argtable);
+
+    /* special case: '--help' takes precedence over error reporting */
+    if (help->count > 0) {
+        printf(DESCRIPTION_FANOUT, progname, VERSION, COPYRIGHT);
+        printf("Usage: %s", progname);
+        arg_print_syntax(stdout, argtable, "\n");
+        arg_print_glossary(stdout, argtable, "  %-25s %s\n");
+        exitcode = EXIT_SUCCESS;
+        goto exit;
+    }
+
+    /* special case: '--version' takes precedence error reporting */
+    if (version->count > 0) {
+        printf(DESCRIPTION_FANOUT, progname, VERSION, COPYRIGHT);
+        exitcode = EXIT_SUCCESS;
+        goto exit;
+    }
+
+    /* If the parser returned any errors then display them and exit */
+    if (nerrors > 0) {
+        /* Display the error details contained in the arg_end struct.*/
+        arg_print_errors(stdout, end, progname);
+        printf("Try '%s --help' for more information.\n", progname);
+        exitcode = EXIT_FAILURE;
+        goto exit;
+    }
+
+    verbose_messages = verbose->ival[0];
+
+    /* normal case: take the command line options at face value */
+    exitcode = main_program(rounds->ival[0], subscribers->ival[0], server_name->sval[0], server_port->ival[0], timeout->ival[0]);
+
+exit:
+    /* deallocate each non-null entry in argtable[] */
+    arg_freetable(argtable, sizeof(argtable) / sizeof(argtable[0]));
+
+    return exitcode;
+}
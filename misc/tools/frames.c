@@ -0,0 +1,326 @@
+/*
+Copyright (C) 2011 Michael Costello, Wandenberg Peixoto <wandenberg@gmail.com>
+
+Measures the time spent to unmask and validate the payload of websocket frames sent by clients,
+comparing the byte by byte loops with the word at a time versions used by the module.
+Usage './frames --help' to see option
+*/
+#include <argtable2.h>
+#include <stdint.h>
+#include <time.h>
+#include "util.h"
+
+#define DEFAULT_PAYLOAD_SIZE 65536
+#define DEFAULT_ROUNDS       1000
+
+typedef void (*unmask_pt)(unsigned char *payload, uint64_t len, unsigned char *mask_key);
+typedef int (*is_utf8_pt)(unsigned char *p, size_t n);
+
+double elapsed_ms(struct timespec *start);
+
+
+/* copy of ngx_utf8_decode from nginx core */
+uint32_t
+utf8_decode(unsigned char **p, size_t n)
+{
+    size_t    len;
+    uint32_t  u, i, valid;
+
+    u = **p;
+
+    if (u >= 0xf0) {
+        u &= 0x07;
+        valid = 0xffff;
+        len = 3;
+    } else if (u >= 0xe0) {
+        u &= 0x0f;
+        valid = 0x7ff;
+        len = 2;
+    } else if (u >= 0xc2) {
+        u &= 0x1f;
+        valid = 0x7f;
+        len = 1;
+    } else {
+        (*p)++;
+        return 0xffffffff;
+    }
+
+    if (n - 1 < len) {
+        return 0xfffffffe;
+    }
+
+    (*p)++;
+
+    while (len) {
+        i = *(*p)++;
+
+        if (i < 0x80) {
+            return 0xffffffff;
+        }
+
+        u = (u << 6) | (i & 0x3f);
+
+        len--;
+    }
+
+    if (u > valid) {
+        return u;
+    }
+
+    return 0xffffffff;
+}
+
+
+void
+unmask_bytes(unsigned char *payload, uint64_t len, unsigned char *mask_key)
+{
+    uint64_t i;
+
+    for (i = 0; i < len; i++) {
+        payload[i] = payload[i] ^ mask_key[i % 4];
+    }
+}
+
+
+void
+unmask_words(unsigned char *payload, uint64_t len, unsigned char *mask_key)
+{
+    unsigned char *p = payload, *last = payload + len;
+    uint64_t       mask, word;
+    unsigned int   i;
+
+    for (i = 0; i < sizeof(uint64_t); i++) {
+        ((unsigned char *) &mask)[i] = mask_key[i % 4];
+    }
+
+    while ((size_t) (last - p) >= sizeof(uint64_t)) {
+        memcpy(&word, p, sizeof(uint64_t));
+        word ^= mask;
+        memcpy(p, &word, sizeof(uint64_t));
+        p += sizeof(uint64_t);
+    }
+
+    for (i = 0; p < last; i++, p++) {
+        *p ^= mask_key[i % 4];
+    }
+}
+
+
+int
+is_utf8_bytes(unsigned char *p, size_t n)
+{
+    unsigned char *last = p + n;
+
+    while (p < last) {
+        if (*p < 0x80) {
+            p++;
+            continue;
+        }
+
+        if (utf8_decode(&p, last - p) > 0x10ffff) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+int
+is_utf8_words(unsigned char *p, size_t n)
+{
+    unsigned char *last = p + n;
+    uint64_t       word;
+    size_t         ascii = 0;
+
+    while (p < last) {
+        if (*p < 0x80) {
+            p++;
+
+            // only long ascii runs are skipped a word at a time
+            if (++ascii < sizeof(uint64_t)) {
+                continue;
+            }
+
+            while ((size_t) (last - p) >= sizeof(uint64_t)) {
+                memcpy(&word, p, sizeof(uint64_t));
+                if (word & 0x8080808080808080ULL) {
+                    break;
+                }
+                p += sizeof(uint64_t);
+            }
+
+            ascii = 0;
+            continue;
+        }
+
+        ascii = 0;
+
+        if (utf8_decode(&p, last - p) > 0x10ffff) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+double
+elapsed_ms(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+
+double
+measure_unmask(unmask_pt unmask, unsigned char *payload, size_t size, int num_rounds)
+{
+    unsigned char mask_key[4] = {0x37, 0xfa, 0x21, 0x3d};
+    struct timespec start;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < num_rounds; i++) {
+        unmask(payload, size, mask_key);
+    }
+    return elapsed_ms(&start);
+}
+
+
+double
+measure_is_utf8(is_utf8_pt is_utf8, unsigned char *payload, size_t size, int num_rounds, int *valid)
+{
+    struct timespec start;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < num_rounds; i++) {
+        *valid &= is_utf8(payload, size);
+    }
+    return elapsed_ms(&start);
+}
+
+
+int
+main_program(int num_rounds, int payload_size, int non_ascii)
+{
+    unsigned char *payload = NULL, *copy = NULL;
+    const char *text = non_ascii ? "a\xc3\xa7\xc3\xa3o \xe2\x82\xac " : "{\"text\":\"a message\"} ";
+    size_t text_len = strlen(text), i;
+    double bytes_time, words_time;
+    int exitcode = EXIT_SUCCESS, valid_bytes = 1, valid_words = 1;
+
+    info("Frames: %d rounds over a payload of %d bytes\n", num_rounds, payload_size);
+
+    if (((payload = malloc(payload_size)) == NULL) || ((copy = malloc(payload_size)) == NULL)) {
+        error2("Failed to allocate payload\n");
+    }
+
+    // only whole characters are used, so the payload is always valid
+    for (i = 0; i + text_len <= (size_t) payload_size; i += text_len) {
+        memcpy(payload + i, text, text_len);
+    }
+    memset(payload + i, ' ', payload_size - i);
+    memcpy(copy, payload, payload_size);
+
+    bytes_time = measure_unmask(unmask_bytes, payload, payload_size, num_rounds);
+    words_time = measure_unmask(unmask_words, copy, payload_size, num_rounds);
+    if (memcmp(payload, copy, payload_size) != 0) {
+        error2("Unmasked payloads differ\n");
+    }
+    summary("Unmask Size=%d Rounds=%d Time(ms) Bytes=%0.3f Words=%0.3f Speedup=%0.2fx\n", payload_size, num_rounds, bytes_time, words_time, bytes_time / words_time);
+
+    // an even number of rounds restores the original payload
+    if (num_rounds % 2) {
+        unmask_words(payload, payload_size, (unsigned char *) "\x37\xfa\x21\x3d");
+    }
+
+    bytes_time = measure_is_utf8(is_utf8_bytes, payload, payload_size, num_rounds, &valid_bytes);
+    words_time = measure_is_utf8(is_utf8_words, payload, payload_size, num_rounds, &valid_words);
+    if (!valid_bytes || !valid_words) {
+        error2("Payload was not recognized as utf8\n");
+    }
+    summary("IsUtf8 Size=%d Rounds=%d NonAscii=%d Time(ms) Bytes=%0.3f Words=%0.3f Speedup=%0.2fx\n", payload_size, num_rounds, non_ascii, bytes_time, words_time, bytes_time / words_time);
+
+exit:
+    if (payload != NULL) free(payload);
+    if (copy != NULL) free(copy);
+
+    return exitcode;
+}
+
+
+int
+main(int argc, char **argv)
+{
+    struct arg_int *rounds  = arg_int0("r", "rounds", "<n>", "define number of times each loop runs over the payload (default is 1000)");
+    struct arg_int *size    = arg_int0("s", "size", "<n>", "define payload size in bytes (default is 65536)");
+    struct arg_lit *non_ascii = arg_lit0(NULL, "non-ascii", "fill the payload with multibyte characters");
+
+    struct arg_int *verbose = arg_int0("v", "verbose", "<n>", "increase output messages detail (0 (default) - no messages, 1 - info messages, 2 - debug messages, 3 - trace messages");
+
+    struct arg_lit *help    = arg_lit0(NULL, "help", "print this help and exit");
+    struct arg_lit *version = arg_lit0(NULL, "version", "print version information and exit");
+    struct arg_end *end     = arg_end(20);
+
+    void* argtable[] = { rounds, size, non_ascii, verbose, help, version, end };
+
+    const char* progname = "frames";
+    int nerrors;
+    int exitcode = EXIT_SUCCESS;
+
+    /* verify the argtable[] entries were allocated sucessfully */
+    if (arg_nullcheck(argtable) != 0) {
+        /* NULL entries were detected, some allocations must have failed */
+        printf("%s: insufficient memory\n", progname);
+        exitcode = EXIT_FAILURE;
+        goto exit;
+    }
+
+    /* set any command line default values prior to parsing */
+    rounds->ival[0] = DEFAULT_ROUNDS;
+    size->ival[0] = DEFAULT_PAYLOAD_SIZE;
+    verbose->ival[0] = 0;
+
+    /* Parse the command line as defined by argtable[] */
+    nerrors = arg_parse(argc, argv, argtable);
+
+    /* special case: '--help' takes precedence over error reporting */
+    if (help->count > 0) {
+        printf(DESCRIPTION_FRAMES, progname, VERSION, COPYRIGHT);
+        printf("Usage: %s", progname);
+        arg_print_syntax(stdout, argtable, "\n");
+        arg_print_glossary(stdout, argtable, "  %-25s %s\n");
+        exitcode = EXIT_SUCCESS;
+        goto exit;
+    }
+
+    /* special case: '--version' takes precedence error reporting */
+    if (version->count > 0) {
+        printf(DESCRIPTION_FRAMES, progname, VERSION, COPYRIGHT);
+        exitcode = EXIT_SUCCESS;
+        goto exit;
+    }
+
+    /* If the parser returned any errors then display them and exit */
+    if ((nerrors > 0) || (rounds->ival[0] <= 0) || (size->ival[0] <= 0)) {
+        /* Display the error details contained in the arg_end struct.*/
+        arg_print_errors(stdout, end, progname);
+        printf("Try '%s --help' for more information.\n", progname);
+        exitcode = EXIT_FAILURE;
+        goto exit;
+    }
+
+    verbose_messages = verbose->ival[0];
+
+    /* normal case: take the command line options at face value */
+    exitcode = main_program(rounds->ival[0], size->ival[0], non_ascii->count > 0);
+
+exit:
+    /* deallocate each non-null entry in argtable[] */
+    arg_freetable(argtable, sizeof(argtable) / sizeof(argtable[0]));
+
+    return exitcode;
+}
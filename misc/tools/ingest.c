@@ -0,0 +1,367 @@
+/*
+Copyright (C) 2011 Michael Costello, Wandenberg Peixoto <wandenberg@gmail.com>
+
+Measures the publish throughput of one backend, comparing one http request per message with
+one WebSocket kept open on a batch publisher location sending one record per frame and,
+when the path is given, with one datagram per message sent to the ingest socket.
+Usage './ingest --help' to see option
+*/
+#include <argtable2.h>
+#include <time.h>
+#include <sys/un.h>
+#include "util.h"
+
+#define INGEST_CHANNEL "ingest_bench"
+#define INGEST_MESSAGE "**MSG** msg=%06d 0123456789012345678901234567890123456789"
+
+int connect_server(struct sockaddr_in *server_address);
+int read_until(int sd, char *buffer, int buffer_len, const char *expected);
+int write_all(int sd, const char *buffer, int len);
+int published_messages(struct sockaddr_in *server_address, char *buffer, int buffer_len);
+
+double
+elapsed_ms(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+
+double
+publish_by_requests(struct sockaddr_in *server_address, int num_messages, char *buffer, int buffer_len)
+{
+    char message[BUFFER_SIZE];
+    struct timespec start;
+    int sd, len, msg_len, i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 1; i <= num_messages; i++) {
+        if ((sd = connect_server(server_address)) < 0) {
+            return -1;
+        }
+
+        msg_len = sprintf(message, INGEST_MESSAGE, i);
+        len = sprintf(buffer, "POST /pub?id=%s HTTP/1.1\r\nHost: loadtest\r\nConnection: close\r\nContent-Length: %d\r\n\r\n%s", INGEST_CHANNEL, msg_len, message);
+        if ((write_all(sd, buffer, len) != EXIT_SUCCESS) || (read_until(sd, buffer, buffer_len, NULL) != EXIT_SUCCESS) || (strncmp(buffer, "HTTP/1.1 200", 12) != 0)) {
+            error("Message %d was not published\n", i);
+            close(sd);
+            return -1;
+        }
+        close(sd);
+    }
+    return elapsed_ms(&start);
+}
+
+
+double
+publish_by_websocket(struct sockaddr_in *server_address, int num_messages, char *buffer, int buffer_len)
+{
+    unsigned char mask_key[4] = {0x37, 0xfa, 0x21, 0x3d};
+    char record[BUFFER_SIZE], message[BUFFER_SIZE];
+    struct timespec start;
+    int sd, len, rec_len, i, j;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if ((sd = connect_server(server_address)) < 0) {
+        return -1;
+    }
+
+    len = sprintf(buffer, "GET /pub_batch HTTP/1.1\r\nHost: loadtest\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n");
+    if ((write_all(sd, buffer, len) != EXIT_SUCCESS) || (read_until(sd, buffer, buffer_len, "\r\n\r\n") != EXIT_SUCCESS) || (strncmp(buffer, "HTTP/1.1 101", 12) != 0)) {
+        error("WebSocket was not accepted\n");
+        close(sd);
+        return -1;
+    }
+
+    for (i = 1; i <= num_messages; i++) {
+        sprintf(message, INGEST_MESSAGE, i);
+        rec_len = sprintf(record, "{\"channel\": \"%s\", \"text\": \"%s\"}", INGEST_CHANNEL, message);
+
+        // clients must mask the frames, records are always shorter than 126 bytes
+        len = 0;
+        buffer[len++] = (char) 0x81;
+        buffer[len++] = (char) (0x80 | rec_len);
+        memcpy(buffer + len, mask_key, 4);
+        len += 4;
+        for (j = 0; j < rec_len; j++) {
+            buffer[len++] = record[j] ^ mask_key[j % 4];
+        }
+
+        if (write_all(sd, buffer, len) != EXIT_SUCCESS) {
+            error("Message %d was not published\n", i);
+            close(sd);
+            return -1;
+        }
+    }
+
+    // frames are handled in order, the close answer comes after the last message was published
+    buffer[0] = (char) 0x88;
+    buffer[1] = (char) 0x80;
+    memcpy(buffer + 2, mask_key, 4);
+    if ((write_all(sd, buffer, 6) != EXIT_SUCCESS) || (read_until(sd, buffer, buffer_len, NULL) != EXIT_SUCCESS)) {
+        error("WebSocket was not closed\n");
+        close(sd);
+        return -1;
+    }
+    close(sd);
+
+    return elapsed_ms(&start);
+}
+
+
+double
+publish_by_datagrams(struct sockaddr_in *server_address, const char *socket_path, int num_messages, char *buffer, int buffer_len)
+{
+    struct sockaddr_un ingest_address;
+    struct timespec start;
+    int sd, len, published, initial, i;
+
+    memset(&ingest_address, 0, sizeof(struct sockaddr_un));
+    ingest_address.sun_family = AF_UNIX;
+    strncpy(ingest_address.sun_path, socket_path, sizeof(ingest_address.sun_path) - 1);
+
+    // the socket does not answer, the channel statistics tell when the messages were published
+    if ((initial = published_messages(server_address, buffer, buffer_len)) < 0) {
+        initial = 0;
+    }
+
+    if ((sd = socket(AF_UNIX, SOCK_DGRAM, 0)) < 0) {
+        error4("ERROR %d opening ingest socket\n", errno);
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 1; i <= num_messages; i++) {
+        len = sprintf(buffer, "%s\n" INGEST_MESSAGE, INGEST_CHANNEL, i);
+        // a blocking send waits while the worker did not read the previous datagrams, none of them is lost
+        if (sendto(sd, buffer, len, 0, (struct sockaddr *) &ingest_address, sizeof(struct sockaddr_un)) != len) {
+            error4("Message %d was not sent to %s\n", i, socket_path);
+            close(sd);
+            return -1;
+        }
+    }
+    close(sd);
+
+    while ((published = published_messages(server_address, buffer, buffer_len)) < initial + num_messages) {
+        if (published < 0) {
+            error("Failed to read the channel statistics\n");
+            return -1;
+        }
+
+        if (elapsed_ms(&start) > 60000) {
+            error("Only %d messages were published\n", published - initial);
+            return -1;
+        }
+        usleep(1000);
+    }
+
+    return elapsed_ms(&start);
+}
+
+
+int
+main_program(int num_messages, const char *server_hostname, int server_port, const char *socket_path)
+{
+    struct sockaddr_in server_address;
+    int exitcode = EXIT_SUCCESS;
+    char *buffer = NULL;
+    double requests_time, websocket_time, datagrams_time;
+
+    info("Ingest: %d messages on server: %s:%d\n", num_messages, server_hostname, server_port);
+
+    if ((fill_server_address(server_hostname, server_port, &server_address)) != 0) {
+        error2("ERROR host name not found\n");
+    }
+
+    if ((buffer = malloc(BIG_BUFFER_SIZE)) == NULL) {
+        error2("Failed to allocate buffer\n");
+    }
+
+    if ((requests_time = publish_by_requests(&server_address, num_messages, buffer, BIG_BUFFER_SIZE)) <= 0) {
+        error2("Failed to publish messages by requests\n");
+    }
+
+    if ((websocket_time = publish_by_websocket(&server_address, num_messages, buffer, BIG_BUFFER_SIZE)) <= 0) {
+        error2("Failed to publish messages by websocket\n");
+    }
+
+    summary("Messages=%d Time(ms) Requests=%0.3f WebSocket=%0.3f Msg/Sec Requests=%0.2f WebSocket=%0.2f Speedup=%0.2fx\n", num_messages, requests_time, websocket_time, num_messages * 1000.0 / requests_time, num_messages * 1000.0 / websocket_time, requests_time / websocket_time);
+
+    if (socket_path != NULL) {
+        if ((datagrams_time = publish_by_datagrams(&server_address, socket_path, num_messages, buffer, BIG_BUFFER_SIZE)) <= 0) {
+            error2("Failed to publish messages by datagrams\n");
+        }
+
+        summary("Messages=%d Time(ms) Datagrams=%0.3f Msg/Sec Datagrams=%0.2f Speedup=%0.2fx\n", num_messages, datagrams_time, num_messages * 1000.0 / datagrams_time, requests_time / datagrams_time);
+    }
+
+exit:
+    if (buffer != NULL) free(buffer);
+
+    return exitcode;
+}
+
+
+int
+connect_server(struct sockaddr_in *server_address)
+{
+    int sd;
+
+    if ((sd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        error4("ERROR %d opening socket\n", errno);
+        return -1;
+    }
+
+    if (connect(sd, (struct sockaddr *) server_address, sizeof(struct sockaddr_in)) < 0)  {
+        error4("ERROR connecting to server\n");
+        close(sd);
+        return -1;
+    }
+
+    return sd;
+}
+
+
+int
+write_all(int sd, const char *buffer, int len)
+{
+    int n;
+
+    while (len > 0) {
+        if ((n = write(sd, buffer, len)) <= 0) {
+            return EXIT_FAILURE;
+        }
+        buffer += n;
+        len -= n;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+int
+published_messages(struct sockaddr_in *server_address, char *buffer, int buffer_len)
+{
+    char *value;
+    int sd, len;
+
+    if ((sd = connect_server(server_address)) < 0) {
+        return -1;
+    }
+
+    len = sprintf(buffer, "GET /channels-stats?id=%s HTTP/1.1\r\nHost: loadtest\r\nConnection: close\r\n\r\n", INGEST_CHANNEL);
+    if ((write_all(sd, buffer, len) != EXIT_SUCCESS) || (read_until(sd, buffer, buffer_len, NULL) != EXIT_SUCCESS)) {
+        close(sd);
+        return -1;
+    }
+    close(sd);
+
+    // the channel does not exist before the first message
+    if ((value = strstr(buffer, "\"published_messages\": ")) == NULL) {
+        return 0;
+    }
+
+    return atoi(value + strlen("\"published_messages\": "));
+}
+
+
+int
+read_until(int sd, char *buffer, int buffer_len, const char *expected)
+{
+    int n, total = 0;
+
+    // without an expected text the whole response is read, until the server closes the connection
+    while (total < buffer_len - 1) {
+        if ((n = read(sd, buffer + total, buffer_len - 1 - total)) < 0) {
+            return EXIT_FAILURE;
+        }
+
+        buffer[total + n] = '\0';
+        total += n;
+        if ((n == 0) || ((expected != NULL) && (strstr(buffer, expected) != NULL))) {
+            break;
+        }
+    }
+    trace("Read Response: %s\n", buffer);
+
+    return (total > 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+int
+main(int argc, char **argv)
+{
+    struct arg_int *messages = arg_int0("m", "messages", "<n>", "define number of messages published by each method (default is 1)");
+
+    struct arg_str *socket_path = arg_str0(NULL, "socket", "<path>", "ingest socket path, to also publish the messages by datagrams (default is none)");
+
+    struct arg_str *server_name = arg_str0("S", "server", "<hostname>", "server hostname where messages will be published (default is \"127.0.0.1\")");
+    struct arg_int *server_port = arg_int0("P", "port", "<n>", "server port where messages will be published (default is 9080)");
+
+    struct arg_int *verbose = arg_int0("v", "verbose", "<n>", "increase output messages detail (0 (default) - no messages, 1 - info messages, 2 - debug messages, 3 - trace messages");
+
+    struct arg_lit *help    = arg_lit0(NULL, "help", "print this help and exit");
+    struct arg_lit *version = arg_lit0(NULL, "version", "print version information and exit");
+    struct arg_end *end     = arg_end(20);
+
+    void* argtable[] = { messages, socket_path, server_name, server_port, verbose, help, version, end };
+
+    const char* progname = "ingest";
+    int nerrors;
+    int exitcode = EXIT_SUCCESS;
+
+    /* verify the argtable[] entries were allocated sucessfully */
+    if (arg_nullcheck(argtable) != 0) {
+        /* NULL entries were detected, some allocations must have failed */
+        printf("%s: insufficient memory\n", progname);
+        exitcode = EXIT_FAILURE;
+        goto exit;
+    }
+
+    /* set any command line default values prior to parsing */
+    messages->ival[0] = DEFAULT_NUM_MESSAGES;
+    server_name->sval[0] = DEFAULT_SERVER_HOSTNAME;
+    server_port->ival[0] = DEFAULT_SERVER_PORT;
+    verbose->ival[0] = 0;
+
+    /* Parse the command line as defined by argtable[] */
+    nerrors = arg_parse(argc, argv, argtable);
+
+    /* special case: '--help' takes precedence over error reporting */
+    if (help->count > 0) {
+        printf(DESCRIPTION_INGEST, progname, VERSION, COPYRIGHT);
+        printf("Usage: %s", progname);
+        arg_print_syntax(stdout, argtable, "\n");
+        arg_print_glossary(stdout, argtable, "  %-25s %s\n");
+        exitcode = EXIT_SUCCESS;
+        goto exit;
+    }
+
+    /* special case: '--version' takes precedence error reporting */
+    if (version->count > 0) {
+        printf(DESCRIPTION_INGEST, progname, VERSION, COPYRIGHT);
+        exitcode = EXIT_SUCCESS;
+        goto exit;
+    }
+
+    /* If the parser returned any errors then display them and exit */
+    if ((nerrors > 0) || (messages->ival[0] <= 0)) {
+        /* Display the error details contained in the arg_end struct.*/
+        arg_print_errors(stdout, end, progname);
+        printf("Try '%s --help' for more information.\n", progname);
+        exitcode = EXIT_FAILURE;
+        goto exit;
+    }
+
+    verbose_messages = verbose->ival[0];
+
+    /* normal case: take the command line options at face value */
+    exitcode = main_program(messages->ival[0], server_name->sval[0], server_port->ival[0], (socket_path->count > 0) ? socket_path->sval[0] : NULL);
+
+exit:
+    /* deallocate each non-null entry in argtable[] */
+    arg_freetable(argtable, sizeof(argtable) / sizeof(argtable[0]));
+
+    return exitcode;
+}
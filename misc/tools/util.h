@@ -26,6 +26,9 @@
 #define COPYRIGHT "Copyright (C) 2011 Michael Costello, Wandenberg Peixoto <wandenberg@gmail.com>"
 #define DESCRIPTION_PUBLISHER "'%s' v%s - program to publish messages to test Push Stream Module.\n%s\n"
 #define DESCRIPTION_SUBSCRIBER "'%s' v%s - program to subscribe channels to test Push Stream Module.\n%s\n"
+#define DESCRIPTION_FANOUT "'%s' v%s - program to measure the time to deliver a message to all subscribers of Push Stream Module.\n%s\n"
+#define DESCRIPTION_FRAMES "'%s' v%s - program to measure the time to unmask and validate websocket frames of Push Stream Module.\n%s\n"
+#define DESCRIPTION_INGEST "'%s' v%s - program to measure the publish throughput of requests, websocket and ingest socket on Push Stream Module.\n%s\n"
 
 #define DEFAULT_NUM_MESSAGES    1
 #define DEFAULT_CONCURRENT_CONN 1
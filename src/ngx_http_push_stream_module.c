@@ -31,6 +31,8 @@
 #include <ngx_http_push_stream_module_publisher.c>
 #include <ngx_http_push_stream_module_subscriber.c>
 #include <ngx_http_push_stream_module_websocket.c>
+#include <ngx_http_push_stream_module_api.c>
+#include <ngx_http_push_stream_module_ingest.c>
 
 static ngx_str_t *
 ngx_http_push_stream_channel_info_formatted(ngx_pool_t *pool, const ngx_str_t *format, ngx_str_t *id, ngx_uint_t published_messages, ngx_uint_t stored_messages, ngx_uint_t subscribers)
@@ -66,6 +68,7 @@ ngx_http_push_stream_send_response_all_channels_info_summarized(ngx_http_request
     ngx_http_push_stream_shm_data_t             *data = mcf->shm_data;
     ngx_http_push_stream_worker_data_t          *worker_data;
     ngx_http_push_stream_content_subtype_t      *subtype;
+    ngx_uint_t                                   subscribers_memory = 0, workers_subscribers = 0;
 
     subtype = ngx_http_push_stream_match_channel_info_format_and_content_type(r, 1);
     currenttime = ngx_http_push_stream_get_formatted_current_time(r->pool);
@@ -75,6 +78,8 @@ ngx_http_push_stream_send_response_all_channels_info_summarized(ngx_http_request
     for(i = 0; i < NGX_MAX_PROCESSES; i++) {
         if (data->ipc[i].pid > 0) {
             used_slots++;
+            subscribers_memory += data->ipc[i].subscribers_memory;
+            workers_subscribers += data->ipc[i].subscribers;
         }
     }
 
@@ -95,14 +100,14 @@ ngx_http_push_stream_send_response_all_channels_info_summarized(ngx_http_request
     }
     *start = '\0';
 
-    len = 7*NGX_INT_T_LEN + subtype->format_summarized->len + hostname->len + currenttime->len + ngx_strlen(subscribers_by_workers) - 21;// minus 21 sprintf
+    len = 13*NGX_INT_T_LEN + subtype->format_summarized->len + hostname->len + currenttime->len + ngx_strlen(subscribers_by_workers) - 39;// minus 39 sprintf
 
     if ((text = ngx_http_push_stream_create_str(r->pool, len)) == NULL) {
         ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "Failed to allocate response buffer.");
         return NGX_HTTP_INTERNAL_SERVER_ERROR;
     }
 
-    ngx_sprintf(text->data, (char *) subtype->format_summarized->data, hostname->data, currenttime->data, data->channels, data->wildcard_channels, data->published_messages, data->stored_messages, data->messages_in_trash, data->channels_in_trash, data->subscribers, ngx_time() - data->startup, subscribers_by_workers);
+    ngx_sprintf(text->data, (char *) subtype->format_summarized->data, hostname->data, currenttime->data, data->channels, data->wildcard_channels, data->published_messages, data->stored_messages, data->messages_in_trash, data->channels_in_trash, data->subscribers, data->slow_subscribers_disconnected, data->slow_subscribers_dropped_messages, data->ingested_messages, data->ingest_errors, (data->publish_requests > 0) ? (ngx_uint_t) (data->publish_latency / data->publish_requests) : 0, (workers_subscribers > 0) ? subscribers_memory / workers_subscribers : 0, ngx_time() - data->startup, subscribers_by_workers);
     text->len = ngx_strlen(text->data);
 
     return ngx_http_push_stream_send_response(r, text, subtype->content_type, NGX_HTTP_OK);
@@ -310,7 +315,7 @@ ngx_http_push_stream_check_and_parse_template_pattern(ngx_conf_t *cf, ngx_http_p
 }
 
 static ngx_int_t
-ngx_http_push_stream_find_or_add_template(ngx_conf_t *cf, ngx_str_t template, ngx_flag_t eventsource, ngx_flag_t websocket)
+ngx_http_push_stream_find_or_add_template(ngx_conf_t *cf, ngx_str_t template, ngx_flag_t eventsource, ngx_flag_t websocket, ngx_flag_t deflate)
 {
     ngx_http_push_stream_main_conf_t      *mcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_push_stream_module);
     ngx_queue_t                           *q;
@@ -325,6 +330,8 @@ ngx_http_push_stream_find_or_add_template(ngx_conf_t *cf, ngx_str_t template, ng
         cur = ngx_queue_data(q, ngx_http_push_stream_template_t, queue);
         if ((ngx_memn2cmp(cur->template->data, template.data, cur->template->len, template.len) == 0) &&
             (cur->eventsource == eventsource) && (cur->websocket == websocket)) {
+            // the compressed version is produced if any location using the template needs it
+            cur->deflate = cur->deflate || deflate;
             return cur->index;
         }
     }
@@ -340,6 +347,7 @@ ngx_http_push_stream_find_or_add_template(ngx_conf_t *cf, ngx_str_t template, ng
     cur->template = aux;
     cur->eventsource = eventsource;
     cur->websocket = websocket;
+    cur->deflate = deflate;
     cur->index = mcf->qtd_templates;
     cur->qtd_message_id = 0;
     cur->qtd_event_id = 0;
@@ -349,6 +357,7 @@ ngx_http_push_stream_find_or_add_template(ngx_conf_t *cf, ngx_str_t template, ng
     cur->qtd_tag = 0;
     cur->qtd_time = 0;
     cur->qtd_size = 0;
+    cur->qtd_delta = 0;
     cur->literal_len = 0;
     ngx_queue_init(&cur->parts);
     ngx_memcpy(cur->template->data, template.data, template.len);
@@ -389,6 +398,10 @@ ngx_http_push_stream_find_or_add_template(ngx_conf_t *cf, ngx_str_t template, ng
             start += NGX_HTTP_PUSH_STREAM_TOKEN_MESSAGE_SIZE.len;
             last = start;
             cur->qtd_size++;
+        } else if ((rc == NGX_DECLINED) && ((rc = ngx_http_push_stream_check_and_parse_template_pattern(cf, cur, last, start, &NGX_HTTP_PUSH_STREAM_TOKEN_MESSAGE_DELTA, PUSH_STREAM_TEMPLATE_PART_TYPE_DELTA)) == NGX_OK)) {
+            start += NGX_HTTP_PUSH_STREAM_TOKEN_MESSAGE_DELTA.len;
+            last = start;
+            cur->qtd_delta++;
         } else {
             start += 1;
         }
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2010-2015 Wandenberg Peixoto <wandenberg@gmail.com>, Rogério Carvalho Schneider <stockrt@gmail.com>
+ *
+ * This file is part of Nginx Push Stream Module.
+ *
+ * Nginx Push Stream Module is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nginx Push Stream Module is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Nginx Push Stream Module.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ngx_http_push_stream_module_api.c
+ *
+ * Created: Oct 18, 2026
+ * Authors: Wandenberg Peixoto <wandenberg@gmail.com>, Rogério Carvalho Schneider <stockrt@gmail.com>
+ */
+
+#include <ngx_http_push_stream_module_api.h>
+
+static ngx_http_push_stream_main_conf_t *ngx_http_push_stream_api_get_main_conf(ngx_log_t *log);
+
+ngx_int_t
+ngx_http_push_stream_api_publish(ngx_str_t *channel_id, u_char *text, size_t len, ngx_str_t *event_id, ngx_str_t *event_type, ngx_flag_t store_messages, ngx_log_t *log)
+{
+    ngx_http_push_stream_main_conf_t   *mcf;
+    ngx_http_push_stream_channel_t     *channel;
+    const ngx_str_t                    *explain;
+    ngx_pool_t                         *temp_pool;
+    ngx_int_t                           rc;
+
+    if ((mcf = ngx_http_push_stream_api_get_main_conf(log)) == NULL) {
+        return NGX_ERROR;
+    }
+
+    if ((text == NULL) || (len == 0)) {
+        ngx_log_error(NGX_LOG_ERR, log, 0, "push stream module: tried to publish an empty message");
+        return NGX_ERROR;
+    }
+
+    if (ngx_http_push_stream_publisher_check_channel_id(mcf, log, channel_id, &explain) != NGX_OK) {
+        return NGX_DECLINED;
+    }
+
+    // create the channel if doesn't exist
+    if ((channel = ngx_http_push_stream_get_channel(channel_id, log, mcf)) == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (channel == NGX_HTTP_PUSH_STREAM_NUMBER_OF_CHANNELS_EXCEEDED) {
+        return NGX_BUSY;
+    }
+
+    if (channel->for_events) {
+        ngx_log_error(NGX_LOG_ERR, log, 0, "push stream module: only internal routines can change events channel");
+        return NGX_DECLINED;
+    }
+
+    if (!ngx_http_push_stream_take_channel_publish_tokens(mcf, channel, len)) {
+        ngx_log_error(NGX_LOG_INFO, log, 0, "push stream module: publish rate limit exceeded on channel %V", channel_id);
+        return NGX_AGAIN;
+    }
+
+    if ((temp_pool = ngx_create_pool(4096, log)) == NULL) {
+        ngx_log_error(NGX_LOG_ERR, log, 0, "push stream module: unable to allocate memory for temporary pool");
+        return NGX_ERROR;
+    }
+
+    rc = ngx_http_push_stream_add_msg_to_channel(mcf, log, channel, text, len, ((event_id != NULL) && (event_id->len > 0)) ? event_id : NULL, ((event_type != NULL) && (event_type->len > 0)) ? event_type : NULL, NULL, NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE, store_messages, 0, temp_pool);
+
+    ngx_destroy_pool(temp_pool);
+
+    return (rc == NGX_OK) ? NGX_OK : NGX_ERROR;
+}
+
+
+ngx_int_t
+ngx_http_push_stream_api_delete_channel(ngx_str_t *channel_id, u_char *text, size_t len, ngx_log_t *log)
+{
+    ngx_http_push_stream_main_conf_t   *mcf;
+    ngx_http_push_stream_channel_t     *channel;
+    ngx_pool_t                         *temp_pool;
+    ngx_flag_t                          deleted;
+
+    if ((mcf = ngx_http_push_stream_api_get_main_conf(log)) == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (((channel = ngx_http_push_stream_find_channel(channel_id, log, mcf)) == NULL) || channel->for_events) {
+        return NGX_DECLINED;
+    }
+
+    if (text == NULL) {
+        text = mcf->channel_deleted_message_text.data;
+        len = mcf->channel_deleted_message_text.len;
+    }
+
+    if ((temp_pool = ngx_create_pool(4096, log)) == NULL) {
+        ngx_log_error(NGX_LOG_ERR, log, 0, "push stream module: unable to allocate memory for temporary pool");
+        return NGX_ERROR;
+    }
+
+    deleted = ngx_http_push_stream_delete_channel(mcf, channel, text, len, temp_pool);
+
+    ngx_destroy_pool(temp_pool);
+
+    return deleted ? NGX_OK : NGX_DECLINED;
+}
+
+
+ngx_int_t
+ngx_http_push_stream_api_channel_stats(ngx_str_t *channel_id, ngx_http_push_stream_api_channel_stats_t *stats, ngx_log_t *log)
+{
+    ngx_http_push_stream_main_conf_t   *mcf;
+    ngx_http_push_stream_channel_t     *channel;
+
+    if ((mcf = ngx_http_push_stream_api_get_main_conf(log)) == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (((channel = ngx_http_push_stream_find_channel(channel_id, log, mcf)) == NULL) || channel->deleted) {
+        return NGX_DECLINED;
+    }
+
+    stats->published_messages = channel->last_message_id;
+    stats->stored_messages = channel->stored_messages;
+    stats->subscribers = channel->subscribers;
+
+    return NGX_OK;
+}
+
+
+static ngx_http_push_stream_main_conf_t *
+ngx_http_push_stream_api_get_main_conf(ngx_log_t *log)
+{
+    ngx_http_push_stream_main_conf_t   *mcf;
+
+    if ((ngx_process != NGX_PROCESS_WORKER) && (ngx_process != NGX_PROCESS_SINGLE)) {
+        ngx_log_error(NGX_LOG_ERR, log, 0, "push stream module: the api must be used by worker processes");
+        return NULL;
+    }
+
+    // the shared memory only exists on configurations with push stream locations
+    mcf = ngx_http_cycle_get_module_main_conf(ngx_cycle, ngx_http_push_stream_module);
+    if ((mcf == NULL) || !mcf->enabled || (mcf->shm_data == NULL)) {
+        ngx_log_error(NGX_LOG_ERR, log, 0, "push stream module: the api was used but the module is not in use on this configuration");
+        return NULL;
+    }
+
+    return mcf;
+}
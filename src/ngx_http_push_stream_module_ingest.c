@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2010-2015 Wandenberg Peixoto <wandenberg@gmail.com>, Rogério Carvalho Schneider <stockrt@gmail.com>
+ *
+ * This file is part of Nginx Push Stream Module.
+ *
+ * Nginx Push Stream Module is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nginx Push Stream Module is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Nginx Push Stream Module.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ngx_http_push_stream_module_ingest.c
+ *
+ * Created: Oct 18, 2026
+ * Authors: Wandenberg Peixoto <wandenberg@gmail.com>, Rogério Carvalho Schneider <stockrt@gmail.com>
+ */
+
+#include <ngx_http_push_stream_module_ingest.h>
+
+static ngx_int_t
+ngx_http_push_stream_ingest_init_module(ngx_cycle_t *cycle)
+{
+    ngx_http_push_stream_main_conf_t   *mcf = ngx_http_cycle_get_module_main_conf(cycle, ngx_http_push_stream_module);
+    ngx_core_conf_t                    *ccf = (ngx_core_conf_t *) ngx_get_conf(cycle->conf_ctx, ngx_core_module);
+    struct sockaddr_un                  addr;
+    ngx_socket_t                        s;
+    ngx_pool_cleanup_t                 *cln;
+
+    // testing the configuration must not replace the socket of the running server
+    if ((mcf == NULL) || (mcf->ingest_socket.len == 0) || ngx_test_config) {
+        return NGX_OK;
+    }
+
+    ngx_memzero(&addr, sizeof(struct sockaddr_un));
+    addr.sun_family = AF_UNIX;
+    ngx_memcpy(addr.sun_path, mcf->ingest_socket.data, mcf->ingest_socket.len);
+
+    if ((s = ngx_socket(AF_UNIX, SOCK_DGRAM, 0)) == (ngx_socket_t) -1) {
+        ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_socket_errno, "push stream module: could not create ingest socket %V", &mcf->ingest_socket);
+        return NGX_ERROR;
+    }
+
+    if (ngx_nonblocking(s) == -1) {
+        ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_socket_errno, "push stream module: could not set ingest socket %V as non blocking", &mcf->ingest_socket);
+        ngx_close_socket(s);
+        return NGX_ERROR;
+    }
+
+    // the socket of a previous configuration, like before a reload, is replaced
+    if ((ngx_delete_file(addr.sun_path) == NGX_FILE_ERROR) && (ngx_errno != NGX_ENOENT)) {
+        ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_errno, "push stream module: could not remove old ingest socket %V", &mcf->ingest_socket);
+        ngx_close_socket(s);
+        return NGX_ERROR;
+    }
+
+    if (bind(s, (struct sockaddr *) &addr, sizeof(struct sockaddr_un)) == -1) {
+        ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_socket_errno, "push stream module: could not bind ingest socket %V", &mcf->ingest_socket);
+        ngx_close_socket(s);
+        return NGX_ERROR;
+    }
+
+    // applications running with the worker user or group are allowed to send messages
+    if ((geteuid() == 0) && (chown((char *) addr.sun_path, ccf->user, ccf->group) == -1)) {
+        ngx_log_error(NGX_LOG_WARN, cycle->log, ngx_errno, "push stream module: could not change the owner of ingest socket %V", &mcf->ingest_socket);
+    }
+
+    if (chmod((char *) addr.sun_path, 0660) == -1) {
+        ngx_log_error(NGX_LOG_WARN, cycle->log, ngx_errno, "push stream module: could not change the mode of ingest socket %V", &mcf->ingest_socket);
+    }
+
+    // the master keeps the socket to hand it to a respawned first worker, it is closed with the cycle
+    if ((cln = ngx_pool_cleanup_add(cycle->pool, 0)) == NULL) {
+        ngx_close_socket(s);
+        return NGX_ERROR;
+    }
+
+    cln->handler = ngx_http_push_stream_ingest_cleanup;
+    cln->data = mcf;
+    mcf->ingest_fd = s;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_push_stream_ingest_cleanup(void *data)
+{
+    ngx_http_push_stream_main_conf_t   *mcf = data;
+
+    if (mcf->ingest_fd != (ngx_socket_t) -1) {
+        ngx_close_socket(mcf->ingest_fd);
+        mcf->ingest_fd = (ngx_socket_t) -1;
+    }
+}
+
+
+static void
+ngx_http_push_stream_ingest_init_worker(ngx_cycle_t *cycle)
+{
+    ngx_http_push_stream_main_conf_t   *mcf = ngx_http_cycle_get_module_main_conf(cycle, ngx_http_push_stream_module);
+    ngx_connection_t                   *c;
+    ngx_socket_t                        s;
+    ngx_int_t                           rc;
+
+    if ((mcf == NULL) || (mcf->ingest_fd == (ngx_socket_t) -1)) {
+        return;
+    }
+
+    // only one worker reads the socket, so the messages are published in the order they were sent
+    s = mcf->ingest_fd;
+    mcf->ingest_fd = (ngx_socket_t) -1;
+
+    if (ngx_worker != 0) {
+        ngx_close_socket(s);
+        return;
+    }
+
+    // one more byte to detect datagrams larger than the buffer
+    if ((ngx_http_push_stream_ingest_buffer = ngx_alloc(NGX_HTTP_PUSH_STREAM_INGEST_BUFFER_SIZE + 1, cycle->log)) == NULL) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, 0, "push stream module: unable to allocate memory for ingest buffer");
+        ngx_close_socket(s);
+        return;
+    }
+
+    if ((ngx_http_push_stream_ingest_pool = ngx_create_pool(4096, cycle->log)) == NULL) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, 0, "push stream module: unable to allocate memory for ingest pool");
+        ngx_close_socket(s);
+        return;
+    }
+
+    // registered like the channel used to talk with the master, but the connection is kept to be closed on exit
+    if ((c = ngx_get_connection(s, cycle->log)) == NULL) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, 0, "push stream module: unable to get a connection for ingest socket %V", &mcf->ingest_socket);
+        ngx_close_socket(s);
+        return;
+    }
+
+    c->pool = cycle->pool;
+    c->read->log = cycle->log;
+    c->write->log = cycle->log;
+    c->read->channel = 1;
+    c->write->channel = 1;
+    c->read->handler = ngx_http_push_stream_ingest_handler;
+
+    if ((ngx_add_conn != NULL) && ((ngx_event_flags & NGX_USE_EPOLL_EVENT) == 0)) {
+        rc = ngx_add_conn(c);
+    } else {
+        rc = ngx_add_event(c->read, NGX_READ_EVENT, 0);
+    }
+
+    if (rc == NGX_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno, "push stream module: failed to register ingest socket handler");
+        ngx_close_connection(c);
+        return;
+    }
+
+    ngx_http_push_stream_ingest_connection = c;
+}
+
+
+static void
+ngx_http_push_stream_ingest_exit_worker(ngx_cycle_t *cycle)
+{
+    // the socket file is kept, it may already belong to the configuration loaded by a reload
+    // the event is removed from the loop, and from the posted queue, before the socket is closed
+    if (ngx_http_push_stream_ingest_connection != NULL) {
+        ngx_close_connection(ngx_http_push_stream_ingest_connection);
+        ngx_http_push_stream_ingest_connection = NULL;
+    }
+
+    if (ngx_http_push_stream_ingest_pool != NULL) {
+        ngx_destroy_pool(ngx_http_push_stream_ingest_pool);
+        ngx_http_push_stream_ingest_pool = NULL;
+    }
+
+    if (ngx_http_push_stream_ingest_buffer != NULL) {
+        ngx_free(ngx_http_push_stream_ingest_buffer);
+        ngx_http_push_stream_ingest_buffer = NULL;
+    }
+}
+
+
+static void
+ngx_http_push_stream_ingest_handler(ngx_event_t *ev)
+{
+    ngx_http_push_stream_main_conf_t   *mcf = ngx_http_cycle_get_module_main_conf(ngx_cycle, ngx_http_push_stream_module);
+    ngx_http_push_stream_shm_data_t    *data = mcf->shm_data;
+    ngx_connection_t                   *c = ev->data;
+    u_char                             *buf = ngx_http_push_stream_ingest_buffer, *newline;
+    ngx_str_t                           id;
+    ngx_uint_t                          i;
+    ngx_err_t                           err;
+    ssize_t                             n;
+
+    if (ev->timedout) {
+        ev->timedout = 0;
+        return;
+    }
+
+    // the workers with subscribers are alerted once for each burst of datagrams
+    ngx_http_push_stream_defer_worker_alerts();
+
+    for (i = 0; i < NGX_HTTP_PUSH_STREAM_INGEST_DATAGRAMS_PER_EVENT; i++) {
+        n = recv(c->fd, buf, NGX_HTTP_PUSH_STREAM_INGEST_BUFFER_SIZE + 1, 0);
+
+        if (n == -1) {
+            err = ngx_socket_errno;
+            if (err == NGX_EINTR) {
+                continue;
+            }
+
+            if (err != NGX_EAGAIN) {
+                ngx_log_error(NGX_LOG_ERR, ev->log, err, "push stream module: failed to read from ingest socket");
+            }
+            break;
+        }
+
+        // each datagram has the channel id on the first line and the message text on the rest of it
+        newline = ngx_strlchr(buf, buf + n, '\n');
+        if ((n > NGX_HTTP_PUSH_STREAM_INGEST_BUFFER_SIZE) || (newline == NULL) || (newline == buf) || (newline + 1 == buf + n)) {
+            ngx_log_error(NGX_LOG_WARN, ev->log, 0, "push stream module: invalid ingest datagram with %z bytes", n);
+            data->ingest_errors++;
+            continue;
+        }
+
+        id.data = buf;
+        id.len = newline - buf;
+
+        if (ngx_http_push_stream_ingest_message(mcf, &id, newline + 1, buf + n - newline - 1, ngx_http_push_stream_ingest_pool, ev->log) == NGX_OK) {
+            data->ingested_messages++;
+        } else {
+            data->ingest_errors++;
+        }
+
+        ngx_reset_pool(ngx_http_push_stream_ingest_pool);
+    }
+
+    ngx_http_push_stream_send_deferred_worker_alerts(ev->log);
+
+    // other connections are served before the remaining datagrams are read
+    if (i == NGX_HTTP_PUSH_STREAM_INGEST_DATAGRAMS_PER_EVENT) {
+        ngx_post_event(ev, &ngx_posted_events);
+    }
+}
+
+
+static ngx_int_t
+ngx_http_push_stream_ingest_message(ngx_http_push_stream_main_conf_t *mcf, ngx_str_t *id, u_char *text, size_t len, ngx_pool_t *temp_pool, ngx_log_t *log)
+{
+    ngx_http_push_stream_channel_t     *channel;
+    const ngx_str_t                    *explain;
+
+    if (ngx_http_push_stream_publisher_check_channel_id(mcf, log, id, &explain) != NGX_OK) {
+        ngx_log_error(NGX_LOG_WARN, log, 0, "push stream module: ingest message refused: %V", explain);
+        return NGX_ERROR;
+    }
+
+    // create the channel if doesn't exist
+    channel = ngx_http_push_stream_get_channel(id, log, mcf);
+    if ((channel == NULL) || (channel == NGX_HTTP_PUSH_STREAM_NUMBER_OF_CHANNELS_EXCEEDED)) {
+        return NGX_ERROR;
+    }
+
+    if (channel->for_events) {
+        ngx_log_error(NGX_LOG_ERR, log, 0, "push stream module: only internal routines can change events channel");
+        return NGX_ERROR;
+    }
+
+    if (!ngx_http_push_stream_take_channel_publish_tokens(mcf, channel, len)) {
+        ngx_log_error(NGX_LOG_INFO, log, 0, "push stream module: ingest message refused: publish rate limit exceeded on channel %V", id);
+        return NGX_ERROR;
+    }
+
+    return ngx_http_push_stream_add_msg_to_channel(mcf, log, channel, text, len, NULL, NULL, NULL, NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE, mcf->ingest_store_messages, 0, temp_pool);
+}
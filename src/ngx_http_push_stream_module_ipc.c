@@ -228,6 +228,7 @@ ngx_http_push_stream_clean_worker_data(ngx_http_push_stream_shm_data_t *data)
 
     data->ipc[ngx_process_slot].pid = NGX_INVALID_FILE;
     data->ipc[ngx_process_slot].subscribers = 0;
+    data->ipc[ngx_process_slot].subscribers_memory = 0;
 }
 
 
@@ -324,6 +325,7 @@ ngx_http_push_stream_census_worker_subscribers_data(ngx_http_push_stream_shm_dat
 
 
     thisworker_data->subscribers = 0;
+    thisworker_data->subscribers_memory = 0;
 
     ngx_shmtx_lock(&data->channels_queue_mutex);
     for (q = ngx_queue_head(&data->channels_queue); q != ngx_queue_sentinel(&data->channels_queue); q = ngx_queue_next(q)) {
@@ -347,6 +349,7 @@ ngx_http_push_stream_census_worker_subscribers_data(ngx_http_push_stream_shm_dat
             subscription->channel_worker_sentinel->subscribers++;
         }
         thisworker_data->subscribers++;
+        thisworker_data->subscribers_memory += ((ngx_http_push_stream_module_ctx_t *) ngx_http_get_module_ctx(subscriber->request, ngx_http_push_stream_module))->memory_size;
     }
 
     ngx_shmtx_lock(&shpool->mutex);
@@ -480,8 +483,18 @@ ngx_http_push_stream_broadcast(ngx_http_push_stream_channel_t *channel, ngx_http
 
     for (q = ngx_queue_head(&channel->workers_with_subscribers); q != ngx_queue_sentinel(&channel->workers_with_subscribers); q = ngx_queue_next(q)) {
         worker = ngx_queue_data(q, ngx_http_push_stream_pid_queue_t, queue);
+        if (!queue_was_empty[worker->slot]) {
+            continue;
+        }
+
+        // alerted after the last message of the batch
+        if (ngx_http_push_stream_worker_alerts_deferred) {
+            ngx_http_push_stream_deferred_worker_alerts[worker->slot] = worker->pid;
+            continue;
+        }
+
         // interprocess communication breakdown
-        if (queue_was_empty[worker->slot] && (ngx_http_push_stream_alert_worker_check_messages(worker->pid, worker->slot, log) != NGX_OK)) {
+        if (ngx_http_push_stream_alert_worker_check_messages(worker->pid, worker->slot, log) != NGX_OK) {
             ngx_log_error(NGX_LOG_ERR, log, 0, "push stream module: error communicating with worker process, pid: %P, slot: %d", worker->pid, worker->slot);
         }
     }
@@ -491,6 +504,40 @@ ngx_http_push_stream_broadcast(ngx_http_push_stream_channel_t *channel, ngx_http
     }
 }
 
+static void
+ngx_http_push_stream_defer_worker_alerts(void)
+{
+    ngx_int_t                                i;
+
+    for (i = 0; i < NGX_MAX_PROCESSES; i++) {
+        ngx_http_push_stream_deferred_worker_alerts[i] = NGX_INVALID_PID;
+    }
+
+    ngx_http_push_stream_worker_alerts_deferred = 1;
+}
+
+
+static void
+ngx_http_push_stream_send_deferred_worker_alerts(ngx_log_t *log)
+{
+    ngx_int_t                                i;
+
+    ngx_http_push_stream_worker_alerts_deferred = 0;
+
+    // the messages are already on the queues, each worker is alerted once for all of them
+    for (i = 0; i < NGX_MAX_PROCESSES; i++) {
+        if (ngx_http_push_stream_deferred_worker_alerts[i] == NGX_INVALID_PID) {
+            continue;
+        }
+
+        if (ngx_http_push_stream_alert_worker_check_messages(ngx_http_push_stream_deferred_worker_alerts[i], i, log) != NGX_OK) {
+            ngx_log_error(NGX_LOG_ERR, log, 0, "push stream module: error communicating with worker process, pid: %P, slot: %d", ngx_http_push_stream_deferred_worker_alerts[i], i);
+        }
+        ngx_http_push_stream_deferred_worker_alerts[i] = NGX_INVALID_PID;
+    }
+}
+
+
 static ngx_int_t
 ngx_http_push_stream_respond_to_subscribers(ngx_http_push_stream_channel_t *channel, ngx_queue_t *subscriptions, ngx_http_push_stream_msg_t *msg)
 {
@@ -507,20 +554,43 @@ ngx_http_push_stream_respond_to_subscribers(ngx_http_push_stream_channel_t *chan
             ngx_http_push_stream_subscription_t *subscription = ngx_queue_data(q, ngx_http_push_stream_subscription_t, channel_worker_queue);
             q = ngx_queue_next(q);
             ngx_http_push_stream_subscriber_t *subscriber = subscription->subscriber;
+
+            // messages filtered by the subscriber are neither formatted nor sent
+            if (!ngx_http_push_stream_subscriber_accepts_message(subscriber->request, msg)) {
+                continue;
+            }
+
             if (subscriber->longpolling) {
+                ngx_http_push_stream_loc_conf_t       *pslcf = ngx_http_get_module_loc_conf(subscriber->request, ngx_http_push_stream_module);
+
+                // messages arriving on the linger window are sent on the same response
+                if (pslcf->longpolling_linger_time != NGX_CONF_UNSET_MSEC) {
+                    ngx_http_push_stream_linger_message(subscriber->request, channel, msg);
+                    continue;
+                }
+
                 ngx_http_push_stream_add_polling_headers(subscriber->request, msg->time, msg->tag, subscriber->request->pool);
                 ngx_http_send_header(subscriber->request);
 
-                ngx_http_push_stream_send_response_content_header(subscriber->request, ngx_http_get_module_loc_conf(subscriber->request, ngx_http_push_stream_module));
+                ngx_http_push_stream_send_response_content_header(subscriber->request, pslcf);
                 ngx_http_push_stream_send_response_message(subscriber->request, channel, msg, 1, 0);
                 ngx_http_push_stream_send_response_finalize(subscriber->request);
             } else {
-                if (ngx_http_push_stream_send_response_message(subscriber->request, channel, msg, 0, 0) != NGX_OK) {
+                // messages above the subscriber rate wait for the next slot
+                ngx_int_t rc = ngx_http_push_stream_check_message_rate(subscriber->request, channel, msg);
+                if (rc == NGX_OK) {
+                    rc = ngx_http_push_stream_check_pending_output(subscriber->request, channel, msg);
+                }
+                if (rc == NGX_OK) {
+                    rc = ngx_http_push_stream_send_response_message(subscriber->request, channel, msg, 0, 0);
+                }
+
+                if ((rc != NGX_OK) && (rc != NGX_DECLINED)) {
                     ngx_http_push_stream_send_response_finalize(subscriber->request);
                 } else {
                     ngx_http_push_stream_module_ctx_t     *ctx = ngx_http_get_module_ctx(subscriber->request, ngx_http_push_stream_module);
                     ngx_http_push_stream_loc_conf_t       *pslcf = ngx_http_get_module_loc_conf(subscriber->request, ngx_http_push_stream_module);
-                    ngx_http_push_stream_timer_reset(pslcf->ping_message_interval, ctx->ping_timer);
+                    ngx_http_push_stream_wheel_timer_reset(pslcf->ping_message_interval, ctx->ping_timer);
                 }
             }
         }
@@ -27,6 +27,18 @@
 #include <ngx_http_push_stream_module_version.h>
 
 static ngx_int_t    ngx_http_push_stream_publisher_handle_after_read_body(ngx_http_request_t *r, ngx_http_client_body_handler_pt post_handler);
+static ngx_int_t    ngx_http_push_stream_publisher_check_channel_id(ngx_http_push_stream_main_conf_t *mcf, ngx_log_t *log, ngx_str_t *id, const ngx_str_t **explain);
+static ngx_int_t    ngx_http_push_stream_publish_batch(ngx_http_request_t *r, u_char *p, u_char *last, ngx_pool_t *pool, ngx_pool_t *temp_pool, const ngx_str_t **explain);
+static ngx_int_t    ngx_http_push_stream_parse_batch_record(u_char *p, u_char *last, ngx_http_push_stream_batch_record_t *record);
+static ngx_int_t    ngx_http_push_stream_parse_json_string(u_char **pos, u_char *last, ngx_str_t *value);
+static u_char *     ngx_http_push_stream_skip_json_spaces(u_char *p, u_char *last);
+static ngx_int_t    ngx_http_push_stream_check_publish_rate(ngx_http_push_stream_main_conf_t *mcf, ngx_http_push_stream_requested_channel_t *requested_channels, size_t len);
+static ngx_flag_t   ngx_http_push_stream_take_channel_publish_tokens(ngx_http_push_stream_main_conf_t *mcf, ngx_http_push_stream_channel_t *channel, size_t len);
+static void         ngx_http_push_stream_give_back_channel_publish_tokens(ngx_http_push_stream_main_conf_t *mcf, ngx_http_push_stream_channel_t *channel, size_t len);
+static ngx_flag_t   ngx_http_push_stream_channel_has_prefix(ngx_http_push_stream_channel_t *channel, ngx_str_t *prefix);
+static ngx_flag_t   ngx_http_push_stream_take_publish_tokens(ngx_http_push_stream_publish_bucket_t *bucket, ngx_uint_t rate, size_t bytes_rate, size_t len);
+static void         ngx_http_push_stream_give_back_publish_tokens(ngx_http_push_stream_publish_bucket_t *bucket, ngx_uint_t rate, size_t bytes_rate, size_t len);
+static ngx_int_t    ngx_http_push_stream_refill_publish_tokens(ngx_int_t tokens, ngx_int_t rate, ngx_msec_int_t elapsed);
 
 static ngx_int_t
 ngx_http_push_stream_publisher_handler(ngx_http_request_t *r)
@@ -38,6 +50,8 @@ ngx_http_push_stream_publisher_handler(ngx_http_request_t *r)
     ngx_http_push_stream_requested_channel_t       *requested_channels, *requested_channel;
     ngx_str_t                                       vv_allowed_origins = ngx_null_string;
     ngx_queue_t                                     *q;
+    const ngx_str_t                                *explain;
+    ngx_int_t                                       rc;
 
     ngx_http_push_stream_set_expires(r, NGX_HTTP_PUSH_STREAM_EXPIRES_EPOCH, 0);
 
@@ -48,7 +62,7 @@ ngx_http_push_stream_publisher_handler(ngx_http_request_t *r)
 
     if (vv_allowed_origins.len > 0) {
         ngx_http_push_stream_add_response_header(r, &NGX_HTTP_PUSH_STREAM_HEADER_ACCESS_CONTROL_ALLOW_ORIGIN, &vv_allowed_origins);
-        const ngx_str_t *header_value = (cf->location_type == NGX_HTTP_PUSH_STREAM_PUBLISHER_MODE_ADMIN) ? &NGX_HTTP_PUSH_STREAM_ALLOW_GET_POST_PUT_DELETE_METHODS : &NGX_HTTP_PUSH_STREAM_ALLOW_GET_POST_PUT_METHODS;
+        const ngx_str_t *header_value = (cf->location_type == NGX_HTTP_PUSH_STREAM_PUBLISHER_MODE_ADMIN) ? &NGX_HTTP_PUSH_STREAM_ALLOW_GET_POST_PUT_DELETE_METHODS : ((cf->location_type == NGX_HTTP_PUSH_STREAM_PUBLISHER_MODE_BATCH) ? &NGX_HTTP_PUSH_STREAM_ALLOW_POST_PUT_METHODS : &NGX_HTTP_PUSH_STREAM_ALLOW_GET_POST_PUT_METHODS);
         ngx_http_push_stream_add_response_header(r, &NGX_HTTP_PUSH_STREAM_HEADER_ACCESS_CONTROL_ALLOW_METHODS, header_value);
         ngx_http_push_stream_add_response_header(r, &NGX_HTTP_PUSH_STREAM_HEADER_ACCESS_CONTROL_ALLOW_HEADERS, &NGX_HTTP_PUSH_STREAM_ALLOWED_HEADERS);
     }
@@ -63,6 +77,17 @@ ngx_http_push_stream_publisher_handler(ngx_http_request_t *r)
         return ngx_http_push_stream_send_only_header_response(r, NGX_HTTP_NOT_ALLOWED, NULL);
     }
 
+    // a websocket opened on a batch publisher keeps receiving records until it is closed
+    if ((cf->location_type == NGX_HTTP_PUSH_STREAM_PUBLISHER_MODE_BATCH) && (r->method & NGX_HTTP_GET) && (ngx_http_push_stream_get_header(r, &NGX_HTTP_PUSH_STREAM_HEADER_UPGRADE) != NULL)) {
+        return ngx_http_push_stream_websocket_handler(r);
+    }
+
+    // only accept POST/PUT methods, or GET to open a websocket, if batch publisher
+    if ((cf->location_type == NGX_HTTP_PUSH_STREAM_PUBLISHER_MODE_BATCH) && !(r->method & (NGX_HTTP_POST|NGX_HTTP_PUT))) {
+        ngx_http_push_stream_add_response_header(r, &NGX_HTTP_PUSH_STREAM_HEADER_ALLOW, &NGX_HTTP_PUSH_STREAM_ALLOW_POST_PUT_METHODS);
+        return ngx_http_push_stream_send_only_header_response(r, NGX_HTTP_NOT_ALLOWED, NULL);
+    }
+
     // only accept GET, POST and PUT methods if NOT enable publisher administration
     if ((cf->location_type != NGX_HTTP_PUSH_STREAM_PUBLISHER_MODE_ADMIN) && !(r->method & (NGX_HTTP_GET|NGX_HTTP_POST|NGX_HTTP_PUT))) {
         ngx_http_push_stream_add_response_header(r, &NGX_HTTP_PUSH_STREAM_HEADER_ALLOW, &NGX_HTTP_PUSH_STREAM_ALLOW_GET_POST_PUT_METHODS);
@@ -74,6 +99,11 @@ ngx_http_push_stream_publisher_handler(ngx_http_request_t *r)
         return ngx_http_push_stream_send_only_header_response(r, NGX_HTTP_INTERNAL_SERVER_ERROR, NULL);
     }
 
+    // the channels of each message come on the request body
+    if (cf->location_type == NGX_HTTP_PUSH_STREAM_PUBLISHER_MODE_BATCH) {
+        return ngx_http_push_stream_publisher_handle_after_read_body(r, ngx_http_push_stream_publisher_batch_handler);
+    }
+
     //get channels ids
     requested_channels = ngx_http_push_stream_parse_channels_ids_from_path(r, r->pool);
     if ((requested_channels == NULL) || ngx_queue_empty(&requested_channels->queue)) {
@@ -84,15 +114,8 @@ ngx_http_push_stream_publisher_handler(ngx_http_request_t *r)
     for (q = ngx_queue_head(&requested_channels->queue); q != ngx_queue_sentinel(&requested_channels->queue); q = ngx_queue_next(q)) {
         requested_channel = ngx_queue_data(q, ngx_http_push_stream_requested_channel_t, queue);
 
-        // check if channel id isn't equals to ALL or contain wildcard
-        if ((ngx_memn2cmp(requested_channel->id->data, NGX_HTTP_PUSH_STREAM_ALL_CHANNELS_INFO_ID.data, requested_channel->id->len, NGX_HTTP_PUSH_STREAM_ALL_CHANNELS_INFO_ID.len) == 0) || (ngx_strchr(requested_channel->id->data, '*') != NULL)) {
-            return ngx_http_push_stream_send_only_header_response(r, NGX_HTTP_FORBIDDEN, &NGX_HTTP_PUSH_STREAM_CHANNEL_ID_NOT_AUTHORIZED_MESSAGE);
-        }
-
-        // could not have a large size
-        if ((mcf->max_channel_id_length != NGX_CONF_UNSET_UINT) && (requested_channel->id->len > mcf->max_channel_id_length)) {
-            ngx_log_error(NGX_LOG_WARN, r->connection->log, 0, "push stream module: channel id is larger than allowed %d", requested_channel->id->len);
-            return ngx_http_push_stream_send_only_header_response(r, NGX_HTTP_BAD_REQUEST, &NGX_HTTP_PUSH_STREAM_TOO_LARGE_CHANNEL_ID_MESSAGE);
+        if ((rc = ngx_http_push_stream_publisher_check_channel_id(mcf, r->connection->log, requested_channel->id, &explain)) != NGX_OK) {
+            return ngx_http_push_stream_send_only_header_response(r, rc, explain);
         }
 
         if (r->method & (NGX_HTTP_POST|NGX_HTTP_PUT)) {
@@ -118,6 +141,12 @@ ngx_http_push_stream_publisher_handler(ngx_http_request_t *r)
 
     ctx->requested_channels = requested_channels;
 
+    // refused before the body is read using its announced size, chunked bodies are checked after they are read
+    if ((r->method & (NGX_HTTP_POST|NGX_HTTP_PUT)) && !r->headers_in.chunked && (ngx_http_push_stream_check_publish_rate(mcf, requested_channels, (r->headers_in.content_length_n > 0) ? (size_t) r->headers_in.content_length_n : 0) != NGX_OK)) {
+        ngx_log_error(NGX_LOG_INFO, r->connection->log, 0, "push stream module: publish rate limit exceeded");
+        return ngx_http_push_stream_send_only_header_response(r, NGX_HTTP_TOO_MANY_REQUESTS, &NGX_HTTP_PUSH_STREAM_PUBLISH_RATE_EXCEEDED_MESSAGE);
+    }
+
     if (r->method & (NGX_HTTP_POST|NGX_HTTP_PUT)) {
         return ngx_http_push_stream_publisher_handle_after_read_body(r, ngx_http_push_stream_publisher_body_handler);
     }
@@ -129,6 +158,193 @@ ngx_http_push_stream_publisher_handler(ngx_http_request_t *r)
     return ngx_http_push_stream_send_response_channels_info_detailed(r, requested_channels);
 }
 
+static ngx_int_t
+ngx_http_push_stream_publisher_check_channel_id(ngx_http_push_stream_main_conf_t *mcf, ngx_log_t *log, ngx_str_t *id, const ngx_str_t **explain)
+{
+    // check if channel id isn't equals to ALL or contain wildcard
+    if ((ngx_memn2cmp(id->data, NGX_HTTP_PUSH_STREAM_ALL_CHANNELS_INFO_ID.data, id->len, NGX_HTTP_PUSH_STREAM_ALL_CHANNELS_INFO_ID.len) == 0) || (ngx_strlchr(id->data, id->data + id->len, '*') != NULL)) {
+        *explain = &NGX_HTTP_PUSH_STREAM_CHANNEL_ID_NOT_AUTHORIZED_MESSAGE;
+        return NGX_HTTP_FORBIDDEN;
+    }
+
+    // could not have a large size
+    if ((mcf->max_channel_id_length != NGX_CONF_UNSET_UINT) && (id->len > mcf->max_channel_id_length)) {
+        ngx_log_error(NGX_LOG_WARN, log, 0, "push stream module: channel id is larger than allowed %d", id->len);
+        *explain = &NGX_HTTP_PUSH_STREAM_TOO_LARGE_CHANNEL_ID_MESSAGE;
+        return NGX_HTTP_BAD_REQUEST;
+    }
+
+    return NGX_OK;
+}
+
+static ngx_int_t
+ngx_http_push_stream_check_publish_rate(ngx_http_push_stream_main_conf_t *mcf, ngx_http_push_stream_requested_channel_t *requested_channels, size_t len)
+{
+    ngx_http_push_stream_requested_channel_t   *requested_channel;
+    ngx_queue_t                                *q, *q_taken;
+
+    // the message is published on all channels or on none of them, the tokens taken before a refusal are given back
+    for (q = ngx_queue_head(&requested_channels->queue); q != ngx_queue_sentinel(&requested_channels->queue); q = ngx_queue_next(q)) {
+        requested_channel = ngx_queue_data(q, ngx_http_push_stream_requested_channel_t, queue);
+        if (ngx_http_push_stream_take_channel_publish_tokens(mcf, requested_channel->channel, len)) {
+            continue;
+        }
+
+        for (q_taken = ngx_queue_head(&requested_channels->queue); q_taken != q; q_taken = ngx_queue_next(q_taken)) {
+            requested_channel = ngx_queue_data(q_taken, ngx_http_push_stream_requested_channel_t, queue);
+            ngx_http_push_stream_give_back_channel_publish_tokens(mcf, requested_channel->channel, len);
+        }
+
+        return NGX_DECLINED;
+    }
+
+    return NGX_OK;
+}
+
+static ngx_flag_t
+ngx_http_push_stream_take_channel_publish_tokens(ngx_http_push_stream_main_conf_t *mcf, ngx_http_push_stream_channel_t *channel, size_t len)
+{
+    ngx_http_push_stream_shm_data_t            *data = mcf->shm_data;
+    ngx_http_push_stream_publish_limit_group_t *groups;
+    ngx_flag_t                                  channel_limited = (mcf->channel_publish_rate > 0) || (mcf->channel_publish_bytes_rate > 0);
+    ngx_flag_t                                  allowed = 1;
+    ngx_uint_t                                  i, j;
+
+    if (channel_limited) {
+        ngx_shmtx_lock(channel->mutex);
+        allowed = ngx_http_push_stream_take_publish_tokens(&channel->publish_bucket, mcf->channel_publish_rate, mcf->channel_publish_bytes_rate, len);
+        ngx_shmtx_unlock(channel->mutex);
+
+        if (!allowed) {
+            return 0;
+        }
+    }
+
+    if (mcf->publish_limit_groups == NULL) {
+        return 1;
+    }
+
+    // every prefix matching the channel id has its own limits, all of them must accept the message
+    groups = mcf->publish_limit_groups->elts;
+    ngx_shmtx_lock(&data->publish_limit_groups_mutex);
+    for (i = 0; i < mcf->publish_limit_groups->nelts; i++) {
+        if (ngx_http_push_stream_channel_has_prefix(channel, &groups[i].prefix) && !ngx_http_push_stream_take_publish_tokens(groups[i].bucket, groups[i].rate, groups[i].bytes_rate, len)) {
+            allowed = 0;
+            break;
+        }
+    }
+
+    if (!allowed) {
+        for (j = 0; j < i; j++) {
+            if (ngx_http_push_stream_channel_has_prefix(channel, &groups[j].prefix)) {
+                ngx_http_push_stream_give_back_publish_tokens(groups[j].bucket, groups[j].rate, groups[j].bytes_rate, len);
+            }
+        }
+    }
+    ngx_shmtx_unlock(&data->publish_limit_groups_mutex);
+
+    if (!allowed && channel_limited) {
+        ngx_shmtx_lock(channel->mutex);
+        ngx_http_push_stream_give_back_publish_tokens(&channel->publish_bucket, mcf->channel_publish_rate, mcf->channel_publish_bytes_rate, len);
+        ngx_shmtx_unlock(channel->mutex);
+    }
+
+    return allowed;
+}
+
+static void
+ngx_http_push_stream_give_back_channel_publish_tokens(ngx_http_push_stream_main_conf_t *mcf, ngx_http_push_stream_channel_t *channel, size_t len)
+{
+    ngx_http_push_stream_shm_data_t            *data = mcf->shm_data;
+    ngx_http_push_stream_publish_limit_group_t *groups;
+    ngx_uint_t                                  i;
+
+    if ((mcf->channel_publish_rate > 0) || (mcf->channel_publish_bytes_rate > 0)) {
+        ngx_shmtx_lock(channel->mutex);
+        ngx_http_push_stream_give_back_publish_tokens(&channel->publish_bucket, mcf->channel_publish_rate, mcf->channel_publish_bytes_rate, len);
+        ngx_shmtx_unlock(channel->mutex);
+    }
+
+    if (mcf->publish_limit_groups == NULL) {
+        return;
+    }
+
+    groups = mcf->publish_limit_groups->elts;
+    ngx_shmtx_lock(&data->publish_limit_groups_mutex);
+    for (i = 0; i < mcf->publish_limit_groups->nelts; i++) {
+        if (ngx_http_push_stream_channel_has_prefix(channel, &groups[i].prefix)) {
+            ngx_http_push_stream_give_back_publish_tokens(groups[i].bucket, groups[i].rate, groups[i].bytes_rate, len);
+        }
+    }
+    ngx_shmtx_unlock(&data->publish_limit_groups_mutex);
+}
+
+static ngx_flag_t
+ngx_http_push_stream_channel_has_prefix(ngx_http_push_stream_channel_t *channel, ngx_str_t *prefix)
+{
+    return (channel->id.len >= prefix->len) && (ngx_strncmp(channel->id.data, prefix->data, prefix->len) == 0);
+}
+
+static ngx_flag_t
+ngx_http_push_stream_take_publish_tokens(ngx_http_push_stream_publish_bucket_t *bucket, ngx_uint_t rate, size_t bytes_rate, size_t len)
+{
+    ngx_msec_int_t                      elapsed = (ngx_msec_int_t) (ngx_current_msec - bucket->last);
+
+    // a new bucket starts full
+    if (bucket->last == 0) {
+        elapsed = 1000;
+        bucket->messages = 0;
+        bucket->bytes = 0;
+    }
+
+    if (elapsed > 0) {
+        bucket->last = ngx_current_msec;
+        bucket->messages = (rate > 0) ? ngx_http_push_stream_refill_publish_tokens(bucket->messages, rate, elapsed) : 0;
+        bucket->bytes = (bytes_rate > 0) ? ngx_http_push_stream_refill_publish_tokens(bucket->bytes, bytes_rate, elapsed) : 0;
+    }
+
+    // a message larger than the bytes available is accepted while the bucket is not empty, the next ones wait for the refill
+    if (((rate > 0) && (bucket->messages < 1000)) || ((bytes_rate > 0) && (bucket->bytes <= 0))) {
+        return 0;
+    }
+
+    if (rate > 0) {
+        bucket->messages -= 1000;
+    }
+
+    if (bytes_rate > 0) {
+        bucket->bytes -= (ngx_int_t) len * 1000;
+    }
+
+    return 1;
+}
+
+static void
+ngx_http_push_stream_give_back_publish_tokens(ngx_http_push_stream_publish_bucket_t *bucket, ngx_uint_t rate, size_t bytes_rate, size_t len)
+{
+    // the bucket never holds more than one second of the rate
+    if (rate > 0) {
+        bucket->messages = ngx_min(bucket->messages + 1000, (ngx_int_t) rate * 1000);
+    }
+
+    if (bytes_rate > 0) {
+        bucket->bytes = ngx_min(bucket->bytes + (ngx_int_t) len * 1000, (ngx_int_t) bytes_rate * 1000);
+    }
+}
+
+static ngx_int_t
+ngx_http_push_stream_refill_publish_tokens(ngx_int_t tokens, ngx_int_t rate, ngx_msec_int_t elapsed)
+{
+    ngx_int_t                           capacity = rate * 1000;
+
+    // rate per second is the same as thousandths per millisecond
+    if (elapsed > (capacity - tokens) / rate) {
+        return capacity;
+    }
+
+    return tokens + elapsed * rate;
+}
+
 static ngx_int_t
 ngx_http_push_stream_publisher_handle_after_read_body(ngx_http_request_t *r, ngx_http_client_body_handler_pt post_handler)
 {
@@ -238,15 +454,21 @@ ngx_http_push_stream_publisher_delete_handler(ngx_http_request_t *r)
 static void
 ngx_http_push_stream_publisher_body_handler(ngx_http_request_t *r)
 {
-    ngx_str_t                              *event_id, *event_type;
+    ngx_str_t                              *event_id, *event_type, *message_key = NULL, *snapshot;
     ngx_http_push_stream_module_ctx_t      *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
     ngx_http_push_stream_main_conf_t       *mcf = ngx_http_get_module_main_conf(r, ngx_http_push_stream_module);
     ngx_http_push_stream_loc_conf_t        *cf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
     ngx_buf_t                              *buf = NULL;
+    ngx_uint_t                              opcode = NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE;
+    ngx_str_t                              *content_type;
+    uint64_t                                start;
+    ngx_int_t                               rc;
 
     ngx_http_push_stream_requested_channel_t       *requested_channel;
     ngx_queue_t                                    *q;
 
+    start = ngx_http_push_stream_monotonic_usec();
+
     // check if body message wasn't empty
     if (r->headers_in.content_length_n <= 0) {
         ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: Post request was sent with no message");
@@ -262,24 +484,428 @@ ngx_http_push_stream_publisher_body_handler(ngx_http_request_t *r)
     buf = ngx_http_push_stream_read_request_body_to_buffer(r);
     NGX_HTTP_PUSH_STREAM_CHECK_AND_FINALIZE_REQUEST_ON_ERROR(buf, NULL, r, "push stream module: cannot allocate memory for read the message");
 
+    // the size of chunked bodies is only known now
+    if (r->headers_in.chunked && (ngx_http_push_stream_check_publish_rate(mcf, ctx->requested_channels, ngx_buf_size(buf)) != NGX_OK)) {
+        ngx_log_error(NGX_LOG_INFO, r->connection->log, 0, "push stream module: publish rate limit exceeded");
+        ngx_http_push_stream_send_only_header_response_and_finalize(r, NGX_HTTP_TOO_MANY_REQUESTS, &NGX_HTTP_PUSH_STREAM_PUBLISH_RATE_EXCEEDED_MESSAGE);
+        return;
+    }
+
     event_id = ngx_http_push_stream_get_header(r, &NGX_HTTP_PUSH_STREAM_HEADER_EVENT_ID);
     event_type = ngx_http_push_stream_get_header(r, &NGX_HTTP_PUSH_STREAM_HEADER_EVENT_TYPE);
 
+    if (cf->message_key_compaction) {
+        message_key = ngx_http_push_stream_get_header(r, &NGX_HTTP_PUSH_STREAM_HEADER_MESSAGE_KEY);
+    }
+
+    snapshot = ngx_http_push_stream_get_header(r, &NGX_HTTP_PUSH_STREAM_HEADER_SNAPSHOT);
+    if ((snapshot != NULL) && ((snapshot->len != 4) || (ngx_strncasecmp(snapshot->data, (u_char *) "true", 4) != 0))) {
+        snapshot = NULL;
+    }
+
+    // binary messages are delivered as binary frames to websocket subscribers
+    if (r->headers_in.content_type != NULL) {
+        content_type = &r->headers_in.content_type->value;
+        if ((content_type->len >= NGX_HTTP_PUSH_STREAM_CONTENT_TYPE_BINARY.len) && (ngx_strncasecmp(content_type->data, NGX_HTTP_PUSH_STREAM_CONTENT_TYPE_BINARY.data, NGX_HTTP_PUSH_STREAM_CONTENT_TYPE_BINARY.len) == 0) &&
+            ((content_type->len == NGX_HTTP_PUSH_STREAM_CONTENT_TYPE_BINARY.len) || (content_type->data[NGX_HTTP_PUSH_STREAM_CONTENT_TYPE_BINARY.len] == ';') || (content_type->data[NGX_HTTP_PUSH_STREAM_CONTENT_TYPE_BINARY.len] == ' '))) {
+            opcode = NGX_HTTP_PUSH_STREAM_WEBSOCKET_BINARY_OPCODE;
+        }
+    }
+
     for (q = ngx_queue_head(&ctx->requested_channels->queue); q != ngx_queue_sentinel(&ctx->requested_channels->queue); q = ngx_queue_next(q)) {
         requested_channel = ngx_queue_data(q, ngx_http_push_stream_requested_channel_t, queue);
 
-        if (ngx_http_push_stream_add_msg_to_channel(mcf, r->connection->log, requested_channel->channel, buf->pos, ngx_buf_size(buf), event_id, event_type, cf->store_messages, r->pool) != NGX_OK) {
+        if (snapshot != NULL) {
+            // the snapshot is only sent to new subscribers, it is not broadcast
+            rc = ngx_http_push_stream_set_channel_snapshot(mcf, r->connection->log, requested_channel->channel, buf->pos, ngx_buf_size(buf), event_id, event_type, opcode, r->pool);
+        } else if (cf->publish_async) {
+            rc = ngx_http_push_stream_add_msg_to_channel_async(mcf, r->connection->log, requested_channel->channel, buf->pos, ngx_buf_size(buf), event_id, event_type, message_key, opcode, cf->store_messages, cf->message_delta, r->pool);
+        } else {
+            rc = ngx_http_push_stream_add_msg_to_channel(mcf, r->connection->log, requested_channel->channel, buf->pos, ngx_buf_size(buf), event_id, event_type, message_key, opcode, cf->store_messages, cf->message_delta, r->pool);
+        }
+
+        if (rc != NGX_OK) {
             ngx_http_finalize_request(r, NGX_HTTP_INTERNAL_SERVER_ERROR);
             return;
         }
     }
 
-    if (cf->channel_info_on_publish) {
+    // the message is stored, subscribers receive it after the answer was sent
+    if (cf->publish_async) {
+        ngx_http_push_stream_send_only_header_response_and_finalize(r, NGX_HTTP_ACCEPTED, NULL);
+    } else if (cf->channel_info_on_publish) {
         ngx_http_push_stream_send_response_channels_info_detailed(r, ctx->requested_channels);
         ngx_http_finalize_request(r, NGX_OK);
     } else {
         ngx_http_push_stream_send_only_header_response_and_finalize(r, NGX_HTTP_OK, NULL);
     }
+
+    ngx_http_push_stream_update_publish_latency(mcf, start);
+}
+
+static void
+ngx_http_push_stream_publisher_batch_handler(ngx_http_request_t *r)
+{
+    ngx_http_push_stream_module_ctx_t      *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_main_conf_t       *mcf = ngx_http_get_module_main_conf(r, ngx_http_push_stream_module);
+    ngx_buf_t                              *buf = NULL;
+    const ngx_str_t                        *explain;
+    uint64_t                                start;
+    ngx_int_t                               rc;
+
+    start = ngx_http_push_stream_monotonic_usec();
+
+    // check if body message wasn't empty
+    if (r->headers_in.content_length_n <= 0) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: Post request was sent with no message");
+        ngx_http_push_stream_send_only_header_response_and_finalize(r, NGX_HTTP_BAD_REQUEST, &NGX_HTTP_PUSH_STREAM_EMPTY_POST_REQUEST_MESSAGE);
+        return;
+    }
+
+    // get and check if has access to request body
+    NGX_HTTP_PUSH_STREAM_CHECK_AND_FINALIZE_REQUEST_ON_ERROR(r->request_body->bufs, NULL, r, "push stream module: unexpected publisher message request body buffer location. please report this to the push stream module developers.");
+
+    // copy request body to a memory buffer
+    buf = ngx_http_push_stream_read_request_body_to_buffer(r);
+    NGX_HTTP_PUSH_STREAM_CHECK_AND_FINALIZE_REQUEST_ON_ERROR(buf, NULL, r, "push stream module: cannot allocate memory for read the message");
+
+    rc = ngx_http_push_stream_publish_batch(r, buf->pos, buf->last, r->pool, ctx->temp_pool, &explain);
+    ngx_http_push_stream_send_only_header_response_and_finalize(r, rc, explain);
+
+    ngx_http_push_stream_update_publish_latency(mcf, start);
+}
+
+static ngx_int_t
+ngx_http_push_stream_publish_batch(ngx_http_request_t *r, u_char *p, u_char *last, ngx_pool_t *pool, ngx_pool_t *temp_pool, const ngx_str_t **explain)
+{
+    ngx_http_push_stream_main_conf_t       *mcf = ngx_http_get_module_main_conf(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_loc_conf_t        *cf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_shm_data_t        *data = mcf->shm_data;
+    ngx_http_push_stream_batch_record_t    *records, *record, *previous;
+    ngx_array_t                            *batch;
+    u_char                                 *end;
+    ngx_uint_t                              i, j, line = 0, new_channels = 0, new_wildcard_channels = 0;
+    ngx_int_t                               rc;
+    ngx_flag_t                              is_wildcard_channel;
+
+    *explain = NULL;
+
+    if ((batch = ngx_array_create(pool, 64, sizeof(ngx_http_push_stream_batch_record_t))) == NULL) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: cannot allocate memory for the batch records");
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    // one json object per line, all of them are checked before the first channel is created or message is published
+    for (; p < last; p = end + 1) {
+        if ((end = ngx_strlchr(p, last, '\n')) == NULL) {
+            end = last;
+        }
+        line++;
+
+        if ((record = ngx_array_push(batch)) == NULL) {
+            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: cannot allocate memory for the batch records");
+            return NGX_HTTP_INTERNAL_SERVER_ERROR;
+        }
+
+        if ((rc = ngx_http_push_stream_parse_batch_record(p, end, record)) == NGX_DECLINED) {
+            batch->nelts--;
+            continue;
+        }
+
+        if (rc != NGX_OK) {
+            ngx_log_error(NGX_LOG_WARN, r->connection->log, 0, "push stream module: invalid batch record on line %ui", line);
+            *explain = &NGX_HTTP_PUSH_STREAM_INVALID_BATCH_RECORD_MESSAGE;
+            return NGX_HTTP_BAD_REQUEST;
+        }
+
+        if ((rc = ngx_http_push_stream_publisher_check_channel_id(mcf, r->connection->log, &record->id, explain)) != NGX_OK) {
+            return rc;
+        }
+
+        if ((mcf->events_channel_id.len > 0) && (ngx_memn2cmp(record->id.data, mcf->events_channel_id.data, record->id.len, mcf->events_channel_id.len) == 0)) {
+            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: only internal routines can change events channel");
+            *explain = &NGX_HTTP_PUSH_STREAM_INTERNAL_ONLY_EVENTS_CHANNEL_MESSAGE;
+            return NGX_HTTP_FORBIDDEN;
+        }
+
+        // consecutive records of the same channel share the lookup
+        previous = (batch->nelts > 1) ? record - 1 : NULL;
+        if ((previous != NULL) && (ngx_memn2cmp(previous->id.data, record->id.data, previous->id.len, record->id.len) == 0)) {
+            record->channel = previous->channel;
+            continue;
+        }
+
+        if ((record->channel = ngx_http_push_stream_find_channel(&record->id, r->connection->log, mcf)) != NULL) {
+            continue;
+        }
+
+        // count the channels to be created, each one once
+        records = batch->elts;
+        for (j = 0; j < batch->nelts - 1; j++) {
+            if ((records[j].channel == NULL) && (ngx_memn2cmp(records[j].id.data, record->id.data, records[j].id.len, record->id.len) == 0)) {
+                break;
+            }
+        }
+
+        if (j == batch->nelts - 1) {
+            is_wildcard_channel = (mcf->wildcard_channel_prefix.len > 0) && (ngx_strncmp(record->id.data, mcf->wildcard_channel_prefix.data, mcf->wildcard_channel_prefix.len) == 0);
+            is_wildcard_channel ? new_wildcard_channels++ : new_channels++;
+        }
+    }
+
+    // the counters are read without the lock, the limits are checked again when each channel is created
+    if (((new_channels > 0) && (mcf->max_number_of_channels != NGX_CONF_UNSET_UINT) && (data->channels + new_channels > mcf->max_number_of_channels)) ||
+        ((new_wildcard_channels > 0) && (mcf->max_number_of_wildcard_channels != NGX_CONF_UNSET_UINT) && (data->wildcard_channels + new_wildcard_channels > mcf->max_number_of_wildcard_channels))) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: number of channels were exceeded");
+        *explain = &NGX_HTTP_PUSH_STREAM_NUMBER_OF_CHANNELS_EXCEEDED_MESSAGE;
+        return NGX_HTTP_FORBIDDEN;
+    }
+
+    if (batch->nelts == 0) {
+        *explain = &NGX_HTTP_PUSH_STREAM_EMPTY_POST_REQUEST_MESSAGE;
+        return NGX_HTTP_BAD_REQUEST;
+    }
+
+    records = batch->elts;
+    for (i = 0; i < batch->nelts; i++) {
+        if (records[i].channel != NULL) {
+            continue;
+        }
+
+        // create the channel if doesn't exist
+        if ((i > 0) && (ngx_memn2cmp(records[i - 1].id.data, records[i].id.data, records[i - 1].id.len, records[i].id.len) == 0)) {
+            records[i].channel = records[i - 1].channel;
+            continue;
+        }
+
+        if ((records[i].channel = ngx_http_push_stream_get_channel(&records[i].id, r->connection->log, mcf)) == NULL) {
+            return NGX_HTTP_INTERNAL_SERVER_ERROR;
+        }
+
+        if (records[i].channel == NGX_HTTP_PUSH_STREAM_NUMBER_OF_CHANNELS_EXCEEDED) {
+            *explain = &NGX_HTTP_PUSH_STREAM_NUMBER_OF_CHANNELS_EXCEEDED_MESSAGE;
+            return NGX_HTTP_FORBIDDEN;
+        }
+    }
+
+    // the batch is refused when a record is over the publish rate, the tokens taken by the previous ones are given back
+    for (i = 0; i < batch->nelts; i++) {
+        if (!ngx_http_push_stream_take_channel_publish_tokens(mcf, records[i].channel, records[i].text.len)) {
+            for (j = 0; j < i; j++) {
+                ngx_http_push_stream_give_back_channel_publish_tokens(mcf, records[j].channel, records[j].text.len);
+            }
+
+            ngx_log_error(NGX_LOG_INFO, r->connection->log, 0, "push stream module: publish rate limit exceeded on channel %V", &records[i].id);
+            *explain = &NGX_HTTP_PUSH_STREAM_PUBLISH_RATE_EXCEEDED_MESSAGE;
+            return NGX_HTTP_TOO_MANY_REQUESTS;
+        }
+    }
+
+    // the workers are alerted once, when all messages are on their queues
+    ngx_http_push_stream_defer_worker_alerts();
+
+    rc = NGX_OK;
+    for (i = 0; i < batch->nelts; i++) {
+        rc = ngx_http_push_stream_add_msg_to_channel(mcf, r->connection->log, records[i].channel, records[i].text.data, records[i].text.len, (records[i].event_id.len > 0) ? &records[i].event_id : NULL, (records[i].event_type.len > 0) ? &records[i].event_type : NULL, cf->message_key_compaction ? &records[i].message_key : NULL, NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE, cf->store_messages, cf->message_delta, temp_pool);
+
+        // the records may live on the same pool used to format the messages
+        if (temp_pool != pool) {
+            ngx_reset_pool(temp_pool);
+        }
+
+        if (rc != NGX_OK) {
+            rc = NGX_HTTP_INTERNAL_SERVER_ERROR;
+            break;
+        }
+    }
+
+    ngx_http_push_stream_send_deferred_worker_alerts(r->connection->log);
+
+    return (rc == NGX_OK) ? NGX_HTTP_OK : rc;
+}
+
+static ngx_int_t
+ngx_http_push_stream_parse_batch_record(u_char *p, u_char *last, ngx_http_push_stream_batch_record_t *record)
+{
+    ngx_str_t                               key, value;
+
+    ngx_memzero(record, sizeof(ngx_http_push_stream_batch_record_t));
+
+    // blank lines are ignored
+    if ((p = ngx_http_push_stream_skip_json_spaces(p, last)) == last) {
+        return NGX_DECLINED;
+    }
+
+    if (*p++ != '{') {
+        return NGX_ERROR;
+    }
+
+    p = ngx_http_push_stream_skip_json_spaces(p, last);
+    if ((p < last) && (*p == '}')) {
+        return NGX_ERROR;
+    }
+
+    // a flat object with string values
+    for ( ;; ) {
+        if (ngx_http_push_stream_parse_json_string(&p, last, &key) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        p = ngx_http_push_stream_skip_json_spaces(p, last);
+        if ((p == last) || (*p++ != ':')) {
+            return NGX_ERROR;
+        }
+
+        p = ngx_http_push_stream_skip_json_spaces(p, last);
+        if (ngx_http_push_stream_parse_json_string(&p, last, &value) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        if ((key.len == 7) && (ngx_strncmp(key.data, "channel", 7) == 0)) {
+            record->id = value;
+        } else if ((key.len == 8) && (ngx_strncmp(key.data, "event_id", 8) == 0)) {
+            record->event_id = value;
+        } else if ((key.len == 10) && (ngx_strncmp(key.data, "event_type", 10) == 0)) {
+            record->event_type = value;
+        } else if ((key.len == 11) && (ngx_strncmp(key.data, "message_key", 11) == 0)) {
+            record->message_key = value;
+        } else if ((key.len == 4) && (ngx_strncmp(key.data, "text", 4) == 0)) {
+            record->text = value;
+        }
+
+        p = ngx_http_push_stream_skip_json_spaces(p, last);
+        if (p == last) {
+            return NGX_ERROR;
+        }
+
+        if (*p == ',') {
+            p = ngx_http_push_stream_skip_json_spaces(p + 1, last);
+            continue;
+        }
+
+        if (*p++ != '}') {
+            return NGX_ERROR;
+        }
+
+        break;
+    }
+
+    if ((ngx_http_push_stream_skip_json_spaces(p, last) != last) || (record->id.len == 0) || (record->text.len == 0)) {
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+static ngx_int_t
+ngx_http_push_stream_parse_json_string(u_char **pos, u_char *last, ngx_str_t *value)
+{
+    u_char                                 *p = *pos, *dst;
+    ngx_int_t                               low;
+    uint32_t                                ch;
+
+    if ((p == last) || (*p != '"')) {
+        return NGX_ERROR;
+    }
+
+    // the value is unescaped in place, it is never longer than the escaped text
+    value->data = dst = ++p;
+
+    while (p < last) {
+        if (*p == '"') {
+            value->len = dst - value->data;
+            *pos = p + 1;
+            return NGX_OK;
+        }
+
+        // control characters must be escaped
+        if (*p < 0x20) {
+            return NGX_ERROR;
+        }
+
+        if (*p != '\\') {
+            *dst++ = *p++;
+            continue;
+        }
+
+        if (++p == last) {
+            return NGX_ERROR;
+        }
+
+        switch (*p++) {
+        case '"':
+        case '\\':
+        case '/':
+            *dst++ = *(p - 1);
+            break;
+        case 'b':
+            *dst++ = '\b';
+            break;
+        case 'f':
+            *dst++ = '\f';
+            break;
+        case 'n':
+            *dst++ = '\n';
+            break;
+        case 'r':
+            *dst++ = '\r';
+            break;
+        case 't':
+            *dst++ = '\t';
+            break;
+        case 'u':
+            if ((last - p < 4) || ((low = ngx_hextoi(p, 4)) == NGX_ERROR)) {
+                return NGX_ERROR;
+            }
+            ch = low;
+            p += 4;
+
+            // a low surrogate is only valid after a high one
+            if ((ch >= 0xdc00) && (ch <= 0xdfff)) {
+                return NGX_ERROR;
+            }
+
+            // characters out of the basic plane come as a surrogate pair
+            if ((ch >= 0xd800) && (ch <= 0xdbff)) {
+                if ((last - p < 6) || (p[0] != '\\') || (p[1] != 'u') || ((low = ngx_hextoi(p + 2, 4)) == NGX_ERROR) || (low < 0xdc00) || (low > 0xdfff)) {
+                    return NGX_ERROR;
+                }
+                ch = 0x10000 + ((ch - 0xd800) << 10) + (low - 0xdc00);
+                p += 6;
+            }
+
+            if (ch < 0x80) {
+                *dst++ = (u_char) ch;
+            } else if (ch < 0x800) {
+                *dst++ = (u_char) (0xc0 | (ch >> 6));
+                *dst++ = (u_char) (0x80 | (ch & 0x3f));
+            } else if (ch < 0x10000) {
+                *dst++ = (u_char) (0xe0 | (ch >> 12));
+                *dst++ = (u_char) (0x80 | ((ch >> 6) & 0x3f));
+                *dst++ = (u_char) (0x80 | (ch & 0x3f));
+            } else {
+                *dst++ = (u_char) (0xf0 | (ch >> 18));
+                *dst++ = (u_char) (0x80 | ((ch >> 12) & 0x3f));
+                *dst++ = (u_char) (0x80 | ((ch >> 6) & 0x3f));
+                *dst++ = (u_char) (0x80 | (ch & 0x3f));
+            }
+            break;
+        default:
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_ERROR;
+}
+
+static u_char *
+ngx_http_push_stream_skip_json_spaces(u_char *p, u_char *last)
+{
+    while ((p < last) && ((*p == ' ') || (*p == '\t') || (*p == '\r'))) {
+        p++;
+    }
+
+    return p;
 }
 
 static ngx_int_t
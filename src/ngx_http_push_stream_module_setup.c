@@ -28,6 +28,13 @@
 ngx_uint_t ngx_http_push_stream_padding_max_len = 0;
 ngx_flag_t ngx_http_push_stream_enabled = 0;
 
+static ngx_conf_enum_t  ngx_http_push_stream_pending_output_policies[] = {
+    { ngx_string("disconnect"), NGX_HTTP_PUSH_STREAM_PENDING_OUTPUT_DISCONNECT },
+    { ngx_string("drop_oldest"), NGX_HTTP_PUSH_STREAM_PENDING_OUTPUT_DROP_OLDEST },
+    { ngx_string("conflate"), NGX_HTTP_PUSH_STREAM_PENDING_OUTPUT_CONFLATE },
+    { ngx_null_string, 0 }
+};
+
 static ngx_command_t    ngx_http_push_stream_commands[] = {
     { ngx_string("push_stream_channels_statistics"),
         NGX_HTTP_LOC_CONF|NGX_CONF_NOARGS,
@@ -103,6 +110,12 @@ static ngx_command_t    ngx_http_push_stream_commands[] = {
         NGX_HTTP_MAIN_CONF_OFFSET,
         offsetof(ngx_http_push_stream_main_conf_t, max_channel_id_length),
         NULL },
+    { ngx_string("push_stream_polling_response_cache_entries"),
+        NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE1,
+        ngx_conf_set_num_slot,
+        NGX_HTTP_MAIN_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_main_conf_t, polling_response_cache_entries),
+        NULL },
     { ngx_string("push_stream_max_number_of_channels"),
         NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE1,
         ngx_conf_set_num_slot,
@@ -127,6 +140,36 @@ static ngx_command_t    ngx_http_push_stream_commands[] = {
         NGX_HTTP_MAIN_CONF_OFFSET,
         offsetof(ngx_http_push_stream_main_conf_t, events_channel_id),
         NULL },
+    { ngx_string("push_stream_ingest_socket"),
+        NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE1,
+        ngx_conf_set_str_slot,
+        NGX_HTTP_MAIN_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_main_conf_t, ingest_socket),
+        NULL },
+    { ngx_string("push_stream_ingest_store_messages"),
+        NGX_HTTP_MAIN_CONF|NGX_CONF_FLAG,
+        ngx_conf_set_flag_slot,
+        NGX_HTTP_MAIN_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_main_conf_t, ingest_store_messages),
+        NULL },
+    { ngx_string("push_stream_channel_publish_rate"),
+        NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE1,
+        ngx_conf_set_num_slot,
+        NGX_HTTP_MAIN_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_main_conf_t, channel_publish_rate),
+        NULL },
+    { ngx_string("push_stream_channel_publish_bytes_rate"),
+        NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE1,
+        ngx_conf_set_size_slot,
+        NGX_HTTP_MAIN_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_main_conf_t, channel_publish_bytes_rate),
+        NULL },
+    { ngx_string("push_stream_channel_prefix_publish_rate"),
+        NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE3,
+        ngx_http_push_stream_set_publish_limit_group_slot,
+        NGX_HTTP_MAIN_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_main_conf_t, publish_limit_groups),
+        NULL },
 
     /* Location directives */
     { ngx_string("push_stream_channels_path"),
@@ -147,6 +190,24 @@ static ngx_command_t    ngx_http_push_stream_commands[] = {
         NGX_HTTP_LOC_CONF_OFFSET,
         offsetof(ngx_http_push_stream_loc_conf_t, channel_info_on_publish),
         NULL },
+    { ngx_string("push_stream_publish_async"),
+        NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+        ngx_conf_set_flag_slot,
+        NGX_HTTP_LOC_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_loc_conf_t, publish_async),
+        NULL },
+    { ngx_string("push_stream_message_key_compaction"),
+        NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+        ngx_conf_set_flag_slot,
+        NGX_HTTP_LOC_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_loc_conf_t, message_key_compaction),
+        NULL },
+    { ngx_string("push_stream_message_delta"),
+        NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+        ngx_conf_set_flag_slot,
+        NGX_HTTP_LOC_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_loc_conf_t, message_delta),
+        NULL },
     { ngx_string("push_stream_authorized_channels_only"),
         NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
         ngx_conf_set_flag_slot,
@@ -201,12 +262,42 @@ static ngx_command_t    ngx_http_push_stream_commands[] = {
         NGX_HTTP_LOC_CONF_OFFSET,
         offsetof(ngx_http_push_stream_loc_conf_t, longpolling_connection_ttl),
         NULL },
+    { ngx_string("push_stream_longpolling_linger_time"),
+        NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+        ngx_conf_set_msec_slot,
+        NGX_HTTP_LOC_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_loc_conf_t, longpolling_linger_time),
+        NULL },
+    { ngx_string("push_stream_longpolling_linger_messages"),
+        NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+        ngx_conf_set_num_slot,
+        NGX_HTTP_LOC_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_loc_conf_t, longpolling_linger_messages),
+        NULL },
     { ngx_string("push_stream_websocket_allow_publish"),
         NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
         ngx_conf_set_flag_slot,
         NGX_HTTP_LOC_CONF_OFFSET,
         offsetof(ngx_http_push_stream_loc_conf_t, websocket_allow_publish),
         NULL },
+    { ngx_string("push_stream_websocket_allow_subscribe"),
+        NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+        ngx_conf_set_flag_slot,
+        NGX_HTTP_LOC_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_loc_conf_t, websocket_allow_subscribe),
+        NULL },
+    { ngx_string("push_stream_websocket_max_subscriptions"),
+        NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+        ngx_conf_set_num_slot,
+        NGX_HTTP_LOC_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_loc_conf_t, websocket_max_subscriptions),
+        NULL },
+    { ngx_string("push_stream_websocket_deflate"),
+        NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+        ngx_conf_set_flag_slot,
+        NGX_HTTP_LOC_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_loc_conf_t, websocket_deflate),
+        NULL },
     { ngx_string("push_stream_last_received_message_time"),
         NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_HTTP_LIF_CONF|NGX_CONF_TAKE1,
         ngx_http_set_complex_value_slot,
@@ -225,6 +316,18 @@ static ngx_command_t    ngx_http_push_stream_commands[] = {
         NGX_HTTP_LOC_CONF_OFFSET,
         offsetof(ngx_http_push_stream_loc_conf_t, last_event_id),
         NULL },
+    { ngx_string("push_stream_event_types"),
+        NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_HTTP_LIF_CONF|NGX_CONF_TAKE1,
+        ngx_http_set_complex_value_slot,
+        NGX_HTTP_LOC_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_loc_conf_t, event_types),
+        NULL },
+    { ngx_string("push_stream_accept_message_delta"),
+        NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_HTTP_LIF_CONF|NGX_CONF_TAKE1,
+        ngx_http_set_complex_value_slot,
+        NGX_HTTP_LOC_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_loc_conf_t, accept_message_delta),
+        NULL },
     { ngx_string("push_stream_user_agent"),
         NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
         ngx_http_set_complex_value_slot,
@@ -249,6 +352,48 @@ static ngx_command_t    ngx_http_push_stream_commands[] = {
         NGX_HTTP_LOC_CONF_OFFSET,
         offsetof(ngx_http_push_stream_loc_conf_t, allow_connections_to_events_channel),
         NULL },
+    { ngx_string("push_stream_output_coalescing_delay"),
+        NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+        ngx_conf_set_msec_slot,
+        NGX_HTTP_LOC_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_loc_conf_t, output_coalescing_delay),
+        NULL },
+    { ngx_string("push_stream_output_coalescing_size"),
+        NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+        ngx_conf_set_size_slot,
+        NGX_HTTP_LOC_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_loc_conf_t, output_coalescing_size),
+        NULL },
+    { ngx_string("push_stream_max_pending_output_size"),
+        NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+        ngx_conf_set_size_slot,
+        NGX_HTTP_LOC_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_loc_conf_t, max_pending_output_size),
+        NULL },
+    { ngx_string("push_stream_max_pending_output_messages"),
+        NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+        ngx_conf_set_num_slot,
+        NGX_HTTP_LOC_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_loc_conf_t, max_pending_output_messages),
+        NULL },
+    { ngx_string("push_stream_pending_output_policy"),
+        NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+        ngx_conf_set_enum_slot,
+        NGX_HTTP_LOC_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_loc_conf_t, pending_output_policy),
+        &ngx_http_push_stream_pending_output_policies },
+    { ngx_string("push_stream_max_message_rate"),
+        NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_HTTP_LIF_CONF|NGX_CONF_TAKE1,
+        ngx_http_set_complex_value_slot,
+        NGX_HTTP_LOC_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_loc_conf_t, max_message_rate),
+        NULL },
+    { ngx_string("push_stream_conflation_event_id_separator"),
+        NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+        ngx_conf_set_str_slot,
+        NGX_HTTP_LOC_CONF_OFFSET,
+        offsetof(ngx_http_push_stream_loc_conf_t, conflation_event_id_separator),
+        NULL },
 
     ngx_null_command
 };
@@ -297,7 +442,13 @@ ngx_http_push_stream_init_module(ngx_cycle_t *cycle)
     if ((rc = ngx_http_push_stream_init_ipc(cycle, ccf->worker_processes)) == NGX_OK) {
         ngx_http_push_stream_alert_shutting_down_workers();
     }
-    return rc;
+
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    // bound while the master still has its privileges, the workers inherit it
+    return ngx_http_push_stream_ingest_init_module(cycle);
 }
 
 
@@ -319,10 +470,57 @@ ngx_http_push_stream_init_worker(ngx_cycle_t *cycle)
     // turn on timer to cleanup memory of old messages and channels
     ngx_http_push_stream_memory_cleanup_timer_set();
 
+    // prepare the queue of connections waiting to flush coalesced output
+    ngx_queue_init(&ngx_http_push_stream_output_coalescing_queue);
+
+    // messages published asynchronously waiting to alert the workers
+    ngx_queue_init(&ngx_http_push_stream_pending_broadcasts);
+
+    // subscribers ping and connection ttl timers share a single nginx timer
+    ngx_http_push_stream_timer_wheel_init(cycle);
+
+    // rendered polling responses reused by identical requests on this worker
+    ngx_http_push_stream_polling_cache_init();
+
+    ngx_http_push_stream_init_worker_ping_messages(cycle);
+
+    // messages sent by local applications to the ingest socket
+    ngx_http_push_stream_ingest_init_worker(cycle);
+
     return ngx_http_push_stream_register_worker_message_handler(cycle);
 }
 
 
+static void
+ngx_http_push_stream_init_worker_ping_messages(ngx_cycle_t *cycle)
+{
+    ngx_slab_pool_t                        *global_shpool = (ngx_slab_pool_t *) ngx_http_push_stream_global_shm_zone->shm.addr;
+    ngx_http_push_stream_global_shm_data_t *global_data = (ngx_http_push_stream_global_shm_data_t *) ngx_http_push_stream_global_shm_zone->data;
+    ngx_http_push_stream_main_conf_t       *mcf;
+    ngx_queue_t                            *q;
+    ngx_pool_t                             *temp_pool;
+
+    if ((temp_pool = ngx_create_pool(4096, cycle->log)) == NULL) {
+        ngx_log_error(NGX_LOG_ERR, cycle->log, 0, "push stream module: unable to allocate memory for temporary pool");
+        return;
+    }
+
+    // format the ping message to all templates once, subscribers only pick the text on each interval
+    ngx_shmtx_lock(&global_shpool->mutex);
+    for (q = ngx_queue_head(&global_data->shm_datas_queue); q != ngx_queue_sentinel(&global_data->shm_datas_queue); q = ngx_queue_next(q)) {
+        mcf = ngx_queue_data(q, ngx_http_push_stream_shm_data_t, shm_data_queue)->mcf;
+        if ((mcf != NULL) && (mcf->ping_msg == NULL)) {
+            if ((mcf->ping_msg = ngx_http_push_stream_convert_char_to_msg_on_shared(mcf, mcf->ping_message_text.data, mcf->ping_message_text.len, NULL, NGX_HTTP_PUSH_STREAM_PING_MESSAGE_ID, 0, NULL, NULL, NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE, temp_pool)) == NULL) {
+                ngx_log_error(NGX_LOG_ERR, cycle->log, 0, "push stream module: unable to allocate ping message in shared memory");
+            }
+        }
+    }
+    ngx_shmtx_unlock(&global_shpool->mutex);
+
+    ngx_destroy_pool(temp_pool);
+}
+
+
 static void
 ngx_http_push_stream_exit_master(ngx_cycle_t *cycle)
 {
@@ -347,8 +545,14 @@ ngx_http_push_stream_exit_worker(ngx_cycle_t *cycle)
         return;
     }
 
+    ngx_http_push_stream_flush_pending_broadcasts();
+
     ngx_http_push_stream_cleanup_shutting_down_worker();
 
+    ngx_http_push_stream_polling_cache_cleanup();
+
+    ngx_http_push_stream_ingest_exit_worker(cycle);
+
     ngx_http_push_stream_ipc_exit_worker(cycle);
 }
 
@@ -459,12 +663,19 @@ ngx_http_push_stream_create_main_conf(ngx_conf_t *cf)
     mcf->max_number_of_wildcard_channels = NGX_CONF_UNSET_UINT;
     mcf->message_ttl = NGX_CONF_UNSET;
     mcf->max_channel_id_length = NGX_CONF_UNSET_UINT;
+    mcf->polling_response_cache_entries = NGX_CONF_UNSET_UINT;
     mcf->max_subscribers_per_channel = NGX_CONF_UNSET;
     mcf->max_messages_stored_per_channel = NGX_CONF_UNSET_UINT;
     mcf->qtd_templates = 0;
     mcf->timeout_with_body = NGX_CONF_UNSET;
     ngx_str_null(&mcf->events_channel_id);
     mcf->events_channel = NULL;
+    ngx_str_null(&mcf->ingest_socket);
+    mcf->ingest_store_messages = NGX_CONF_UNSET;
+    mcf->ingest_fd = (ngx_socket_t) -1;
+    mcf->channel_publish_rate = NGX_CONF_UNSET_UINT;
+    mcf->channel_publish_bytes_rate = NGX_CONF_UNSET_SIZE;
+    mcf->publish_limit_groups = NULL;
     mcf->ping_msg = NULL;
     mcf->longpooling_timeout_msg = NULL;
     ngx_queue_init(&mcf->msg_templates);
@@ -489,6 +700,9 @@ ngx_http_push_stream_init_main_conf(ngx_conf_t *cf, void *parent)
     ngx_conf_merge_str_value(conf->wildcard_channel_prefix, conf->wildcard_channel_prefix, NGX_HTTP_PUSH_STREAM_DEFAULT_WILDCARD_CHANNEL_PREFIX);
     ngx_conf_merge_str_value(conf->events_channel_id, conf->events_channel_id, NGX_HTTP_PUSH_STREAM_DEFAULT_EVENTS_CHANNEL_ID);
     ngx_conf_init_value(conf->timeout_with_body, 0);
+    ngx_conf_init_value(conf->ingest_store_messages, 0);
+    ngx_conf_init_uint_value(conf->channel_publish_rate, 0);
+    ngx_conf_init_size_value(conf->channel_publish_bytes_rate, 0);
 
     // sanity checks
     // shm size should be set
@@ -533,6 +747,18 @@ ngx_http_push_stream_init_main_conf(ngx_conf_t *cf, void *parent)
         return NGX_CONF_ERROR;
     }
 
+    // polling response cache entries cannot be zero
+    if ((conf->polling_response_cache_entries != NGX_CONF_UNSET_UINT) && (conf->polling_response_cache_entries == 0)) {
+        ngx_conf_log_error(NGX_LOG_ERR, cf, 0, "push stream module: push_stream_polling_response_cache_entries cannot be zero.");
+        return NGX_CONF_ERROR;
+    }
+
+    // ingest socket path must fit on an unix socket address
+    if (conf->ingest_socket.len >= sizeof(((struct sockaddr_un *) 0)->sun_path)) {
+        ngx_conf_log_error(NGX_LOG_ERR, cf, 0, "push stream module: push_stream_ingest_socket path is too long.");
+        return NGX_CONF_ERROR;
+    }
+
     ngx_regex_compile_t *backtrack_parser = NULL;
     u_char               errstr[NGX_MAX_CONF_ERRSTR];
 
@@ -579,16 +805,33 @@ ngx_http_push_stream_create_loc_conf(ngx_conf_t *cf)
     lcf->ping_message_interval = NGX_CONF_UNSET_MSEC;
     lcf->subscriber_connection_ttl = NGX_CONF_UNSET_MSEC;
     lcf->longpolling_connection_ttl = NGX_CONF_UNSET_MSEC;
+    lcf->longpolling_linger_time = NGX_CONF_UNSET_MSEC;
+    lcf->longpolling_linger_messages = NGX_CONF_UNSET_UINT;
     lcf->websocket_allow_publish = NGX_CONF_UNSET_UINT;
+    lcf->websocket_allow_subscribe = NGX_CONF_UNSET_UINT;
+    lcf->websocket_max_subscriptions = NGX_CONF_UNSET_UINT;
+    lcf->websocket_deflate = NGX_CONF_UNSET_UINT;
     lcf->channel_info_on_publish = NGX_CONF_UNSET_UINT;
+    lcf->publish_async = NGX_CONF_UNSET_UINT;
+    lcf->message_key_compaction = NGX_CONF_UNSET_UINT;
+    lcf->message_delta = NGX_CONF_UNSET_UINT;
     lcf->allow_connections_to_events_channel = NGX_CONF_UNSET_UINT;
     lcf->last_received_message_time = NULL;
     lcf->last_received_message_tag = NULL;
     lcf->last_event_id = NULL;
+    lcf->event_types = NULL;
+    lcf->accept_message_delta = NULL;
     lcf->user_agent = NULL;
     ngx_str_null(&lcf->padding_by_user_agent);
     lcf->paddings = NULL;
     lcf->allowed_origins = NULL;
+    lcf->output_coalescing_delay = NGX_CONF_UNSET_MSEC;
+    lcf->output_coalescing_size = NGX_CONF_UNSET_SIZE;
+    lcf->max_pending_output_size = NGX_CONF_UNSET_SIZE;
+    lcf->max_pending_output_messages = NGX_CONF_UNSET_UINT;
+    lcf->pending_output_policy = NGX_CONF_UNSET_UINT;
+    lcf->max_message_rate = NULL;
+    ngx_str_null(&lcf->conflation_event_id_separator);
 
     return lcf;
 }
@@ -609,11 +852,25 @@ ngx_http_push_stream_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_msec_value(conf->ping_message_interval, prev->ping_message_interval, NGX_CONF_UNSET_MSEC);
     ngx_conf_merge_msec_value(conf->subscriber_connection_ttl, prev->subscriber_connection_ttl, NGX_CONF_UNSET_MSEC);
     ngx_conf_merge_msec_value(conf->longpolling_connection_ttl, prev->longpolling_connection_ttl, conf->subscriber_connection_ttl);
+    ngx_conf_merge_msec_value(conf->longpolling_linger_time, prev->longpolling_linger_time, NGX_CONF_UNSET_MSEC);
+    ngx_conf_merge_uint_value(conf->longpolling_linger_messages, prev->longpolling_linger_messages, NGX_CONF_UNSET_UINT);
     ngx_conf_merge_value(conf->websocket_allow_publish, prev->websocket_allow_publish, 0);
+    ngx_conf_merge_value(conf->websocket_allow_subscribe, prev->websocket_allow_subscribe, 0);
+    ngx_conf_merge_uint_value(conf->websocket_max_subscriptions, prev->websocket_max_subscriptions, NGX_HTTP_PUSH_STREAM_DEFAULT_WEBSOCKET_MAX_SUBSCRIPTIONS);
+    ngx_conf_merge_value(conf->websocket_deflate, prev->websocket_deflate, 0);
     ngx_conf_merge_value(conf->channel_info_on_publish, prev->channel_info_on_publish, 1);
+    ngx_conf_merge_value(conf->publish_async, prev->publish_async, 0);
+    ngx_conf_merge_value(conf->message_key_compaction, prev->message_key_compaction, 0);
+    ngx_conf_merge_value(conf->message_delta, prev->message_delta, 0);
     ngx_conf_merge_value(conf->allow_connections_to_events_channel, prev->allow_connections_to_events_channel, 0);
     ngx_conf_merge_str_value(conf->padding_by_user_agent, prev->padding_by_user_agent, NGX_HTTP_PUSH_STREAM_DEFAULT_PADDING_BY_USER_AGENT);
     ngx_conf_merge_uint_value(conf->location_type, prev->location_type, NGX_CONF_UNSET_UINT);
+    ngx_conf_merge_msec_value(conf->output_coalescing_delay, prev->output_coalescing_delay, NGX_CONF_UNSET_MSEC);
+    ngx_conf_merge_size_value(conf->output_coalescing_size, prev->output_coalescing_size, NGX_CONF_UNSET_SIZE);
+    ngx_conf_merge_size_value(conf->max_pending_output_size, prev->max_pending_output_size, NGX_CONF_UNSET_SIZE);
+    ngx_conf_merge_uint_value(conf->max_pending_output_messages, prev->max_pending_output_messages, NGX_CONF_UNSET_UINT);
+    ngx_conf_merge_uint_value(conf->pending_output_policy, prev->pending_output_policy, NGX_HTTP_PUSH_STREAM_PENDING_OUTPUT_DISCONNECT);
+    ngx_conf_merge_str_value(conf->conflation_event_id_separator, prev->conflation_event_id_separator, NGX_HTTP_PUSH_STREAM_DEFAULT_CONFLATION_EVENT_ID_SEPARATOR);
 
     if (conf->channels_path == NULL) {
         conf->channels_path = prev->channels_path;
@@ -631,6 +888,18 @@ ngx_http_push_stream_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
         conf->last_event_id = prev->last_event_id;
     }
 
+    if (conf->event_types == NULL) {
+        conf->event_types = prev->event_types;
+    }
+
+    if (conf->accept_message_delta == NULL) {
+        conf->accept_message_delta = prev->accept_message_delta;
+    }
+
+    if (conf->max_message_rate == NULL) {
+        conf->max_message_rate = prev->max_message_rate;
+    }
+
     if (conf->user_agent == NULL) {
         conf->user_agent = prev->user_agent;
     }
@@ -643,7 +912,8 @@ ngx_http_push_stream_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
         return NGX_CONF_OK;
     }
 
-    if (conf->channels_path == NULL) {
+    // batch publishers take the channels from the request body
+    if ((conf->channels_path == NULL) && (conf->location_type != NGX_HTTP_PUSH_STREAM_PUBLISHER_MODE_BATCH)) {
         ngx_conf_log_error(NGX_LOG_ERR, cf, 0, "push stream module: push_stream_channels_path must be set.");
         return NGX_CONF_ERROR;
     }
@@ -737,12 +1007,73 @@ ngx_http_push_stream_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
         return NGX_CONF_ERROR;
     }
 
+    // long polling linger time cannot be zero
+    if ((conf->longpolling_linger_time != NGX_CONF_UNSET_MSEC) && (conf->longpolling_linger_time == 0)) {
+        ngx_conf_log_error(NGX_LOG_ERR, cf, 0, "push stream module: push_stream_longpolling_linger_time cannot be zero.");
+        return NGX_CONF_ERROR;
+    }
+
+    // long polling linger messages cannot be zero
+    if ((conf->longpolling_linger_messages != NGX_CONF_UNSET_UINT) && (conf->longpolling_linger_messages == 0)) {
+        ngx_conf_log_error(NGX_LOG_ERR, cf, 0, "push stream module: push_stream_longpolling_linger_messages cannot be zero.");
+        return NGX_CONF_ERROR;
+    }
+
+    // long polling linger messages cannot be set without a time, the response would wait for messages that may never come
+    if ((conf->longpolling_linger_messages != NGX_CONF_UNSET_UINT) && (conf->longpolling_linger_time == NGX_CONF_UNSET_MSEC)) {
+        ngx_conf_log_error(NGX_LOG_ERR, cf, 0, "push stream module: cannot set long polling linger messages if push_stream_longpolling_linger_time is not set.");
+        return NGX_CONF_ERROR;
+    }
+
+#if !(NGX_ZLIB)
+    if (conf->websocket_deflate) {
+        ngx_conf_log_error(NGX_LOG_ERR, cf, 0, "push stream module: zlib support is needed to use push_stream_websocket_deflate.");
+        return NGX_CONF_ERROR;
+    }
+#endif
+
+    // output coalescing delay cannot be zero
+    if ((conf->output_coalescing_delay != NGX_CONF_UNSET_MSEC) && (conf->output_coalescing_delay == 0)) {
+        ngx_conf_log_error(NGX_LOG_ERR, cf, 0, "push stream module: push_stream_output_coalescing_delay cannot be zero.");
+        return NGX_CONF_ERROR;
+    }
+
+    // output coalescing size cannot be zero
+    if ((conf->output_coalescing_size != NGX_CONF_UNSET_SIZE) && (conf->output_coalescing_size == 0)) {
+        ngx_conf_log_error(NGX_LOG_ERR, cf, 0, "push stream module: push_stream_output_coalescing_size cannot be zero.");
+        return NGX_CONF_ERROR;
+    }
+
+    // output coalescing size cannot be set without a delay, pending data would never be sent on a quiet channel
+    if ((conf->output_coalescing_size != NGX_CONF_UNSET_SIZE) && (conf->output_coalescing_delay == NGX_CONF_UNSET_MSEC)) {
+        ngx_conf_log_error(NGX_LOG_ERR, cf, 0, "push stream module: cannot set output coalescing size if push_stream_output_coalescing_delay is not set.");
+        return NGX_CONF_ERROR;
+    }
+
+    // max pending output size cannot be zero
+    if ((conf->max_pending_output_size != NGX_CONF_UNSET_SIZE) && (conf->max_pending_output_size == 0)) {
+        ngx_conf_log_error(NGX_LOG_ERR, cf, 0, "push stream module: push_stream_max_pending_output_size cannot be zero.");
+        return NGX_CONF_ERROR;
+    }
+
+    // max pending output messages cannot be zero
+    if ((conf->max_pending_output_messages != NGX_CONF_UNSET_UINT) && (conf->max_pending_output_messages == 0)) {
+        ngx_conf_log_error(NGX_LOG_ERR, cf, 0, "push stream module: push_stream_max_pending_output_messages cannot be zero.");
+        return NGX_CONF_ERROR;
+    }
+
     // message template cannot be blank
     if (conf->message_template.len == 0) {
         ngx_conf_log_error(NGX_LOG_ERR, cf, 0, "push stream module: push_stream_message_template cannot be blank.");
         return NGX_CONF_ERROR;
     }
 
+    // websocket max subscriptions cannot be zero
+    if (conf->websocket_max_subscriptions == 0) {
+        ngx_conf_log_error(NGX_LOG_ERR, cf, 0, "push stream module: push_stream_websocket_max_subscriptions cannot be zero.");
+        return NGX_CONF_ERROR;
+    }
+
     // wildcard channel max qtd cannot be zero
     if ((conf->wildcard_channel_max_qtd != NGX_CONF_UNSET_UINT) && (conf->wildcard_channel_max_qtd == 0)) {
         ngx_conf_log_error(NGX_LOG_ERR, cf, 0, "push stream module: push_stream_wildcard_channel_max_qtd cannot be zero.");
@@ -766,7 +1097,7 @@ ngx_http_push_stream_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
         (conf->location_type == NGX_HTTP_PUSH_STREAM_SUBSCRIBER_MODE_STREAMING) ||
         (conf->location_type == NGX_HTTP_PUSH_STREAM_SUBSCRIBER_MODE_EVENTSOURCE) ||
         (conf->location_type == NGX_HTTP_PUSH_STREAM_SUBSCRIBER_MODE_WEBSOCKET)) {
-        if ((conf->message_template_index = ngx_http_push_stream_find_or_add_template(cf, conf->message_template, (conf->location_type == NGX_HTTP_PUSH_STREAM_SUBSCRIBER_MODE_EVENTSOURCE), (conf->location_type == NGX_HTTP_PUSH_STREAM_SUBSCRIBER_MODE_WEBSOCKET))) < 0) {
+        if ((conf->message_template_index = ngx_http_push_stream_find_or_add_template(cf, conf->message_template, (conf->location_type == NGX_HTTP_PUSH_STREAM_SUBSCRIBER_MODE_EVENTSOURCE), (conf->location_type == NGX_HTTP_PUSH_STREAM_SUBSCRIBER_MODE_WEBSOCKET), (conf->location_type == NGX_HTTP_PUSH_STREAM_SUBSCRIBER_MODE_WEBSOCKET) && conf->websocket_deflate)) < 0) {
             ngx_conf_log_error(NGX_LOG_ERR, cf, 0, "push stream module: push stream module: unable to parse message template: %V", &conf->message_template);
             return NGX_CONF_ERROR;
         }
@@ -835,8 +1166,10 @@ ngx_http_push_stream_publisher(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
             *field = NGX_HTTP_PUSH_STREAM_PUBLISHER_MODE_NORMAL;
         } else if ((value.len == NGX_HTTP_PUSH_STREAM_MODE_ADMIN.len) && (ngx_strncasecmp(value.data, NGX_HTTP_PUSH_STREAM_MODE_ADMIN.data, NGX_HTTP_PUSH_STREAM_MODE_ADMIN.len) == 0)) {
             *field = NGX_HTTP_PUSH_STREAM_PUBLISHER_MODE_ADMIN;
+        } else if ((value.len == NGX_HTTP_PUSH_STREAM_MODE_BATCH.len) && (ngx_strncasecmp(value.data, NGX_HTTP_PUSH_STREAM_MODE_BATCH.data, NGX_HTTP_PUSH_STREAM_MODE_BATCH.len) == 0)) {
+            *field = NGX_HTTP_PUSH_STREAM_PUBLISHER_MODE_BATCH;
         } else {
-            ngx_conf_log_error(NGX_LOG_ERR, cf, 0, "push stream module: invalid push_stream_publisher mode value: %V, accepted values (%s, %s)", &value, NGX_HTTP_PUSH_STREAM_MODE_NORMAL.data, NGX_HTTP_PUSH_STREAM_MODE_ADMIN.data);
+            ngx_conf_log_error(NGX_LOG_ERR, cf, 0, "push stream module: invalid push_stream_publisher mode value: %V, accepted values (%s, %s, %s)", &value, NGX_HTTP_PUSH_STREAM_MODE_NORMAL.data, NGX_HTTP_PUSH_STREAM_MODE_ADMIN.data, NGX_HTTP_PUSH_STREAM_MODE_BATCH.data);
             return NGX_CONF_ERROR;
         }
     }
@@ -942,6 +1275,85 @@ ngx_http_push_stream_set_shm_size_slot(ngx_conf_t *cf, ngx_command_t *cmd, void
 }
 
 
+char *
+ngx_http_push_stream_set_publish_limit_group_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_array_t                               **groups = (ngx_array_t **) ((char *) conf + cmd->offset);
+    ngx_http_push_stream_publish_limit_group_t *group;
+    ngx_str_t                                  *value = cf->args->elts;
+    ngx_int_t                                   rate;
+    ssize_t                                     bytes_rate;
+
+    if ((*groups == NULL) && ((*groups = ngx_array_create(cf->pool, 4, sizeof(ngx_http_push_stream_publish_limit_group_t))) == NULL)) {
+        return NGX_CONF_ERROR;
+    }
+
+    if (value[1].len == 0) {
+        return "requires a non empty channel id prefix";
+    }
+
+    if ((rate = ngx_atoi(value[2].data, value[2].len)) == NGX_ERROR) {
+        return "has an invalid messages rate";
+    }
+
+    if ((bytes_rate = ngx_parse_size(&value[3])) == NGX_ERROR) {
+        return "has an invalid bytes rate";
+    }
+
+    if ((group = ngx_array_push(*groups)) == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    group->prefix = value[1];
+    group->rate = rate;
+    group->bytes_rate = bytes_rate;
+    group->bucket = NULL;
+
+    return NGX_CONF_OK;
+}
+
+
+static ngx_int_t
+ngx_http_push_stream_init_publish_limit_groups(ngx_http_push_stream_main_conf_t *mcf, ngx_http_push_stream_shm_data_t *d)
+{
+    ngx_http_push_stream_publish_limit_group_shm_t *group_shm;
+    ngx_http_push_stream_publish_limit_group_t     *groups;
+    ngx_queue_t                                    *q;
+    ngx_uint_t                                      i;
+
+    if (mcf->publish_limit_groups == NULL) {
+        return NGX_OK;
+    }
+
+    // the buckets are found by prefix, workers of the previous configuration may still use them
+    groups = mcf->publish_limit_groups->elts;
+    for (i = 0; i < mcf->publish_limit_groups->nelts; i++) {
+        for (q = ngx_queue_head(&d->publish_limit_groups); q != ngx_queue_sentinel(&d->publish_limit_groups); q = ngx_queue_next(q)) {
+            group_shm = ngx_queue_data(q, ngx_http_push_stream_publish_limit_group_shm_t, queue);
+            if (ngx_memn2cmp(group_shm->prefix.data, groups[i].prefix.data, group_shm->prefix.len, groups[i].prefix.len) == 0) {
+                break;
+            }
+        }
+
+        if (q == ngx_queue_sentinel(&d->publish_limit_groups)) {
+            if ((group_shm = ngx_slab_alloc(mcf->shpool, sizeof(ngx_http_push_stream_publish_limit_group_shm_t) + groups[i].prefix.len)) == NULL) {
+                return NGX_ERROR;
+            }
+
+            group_shm->prefix.data = (u_char *) (group_shm + 1);
+            group_shm->prefix.len = groups[i].prefix.len;
+            ngx_memcpy(group_shm->prefix.data, groups[i].prefix.data, groups[i].prefix.len);
+            ngx_memzero(&group_shm->bucket, sizeof(ngx_http_push_stream_publish_bucket_t));
+            ngx_queue_insert_tail(&d->publish_limit_groups, &group_shm->queue);
+        }
+
+        groups[i].bucket = &group_shm->bucket;
+    }
+
+    return NGX_OK;
+}
+
+
 char *
 ngx_http_push_stream_set_header_template_from_file(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
@@ -1053,7 +1465,7 @@ ngx_http_push_stream_init_shm_zone(ngx_shm_zone_t *shm_zone, void *data)
         d->shpool = mcf->shpool;
         mcf->shm_data = data;
         ngx_queue_insert_tail(&global_shm_data->shm_datas_queue, &d->shm_data_queue);
-        return NGX_OK;
+        return ngx_http_push_stream_init_publish_limit_groups(mcf, d);
     }
 
     ngx_rbtree_node_t                   *sentinel;
@@ -1068,6 +1480,7 @@ ngx_http_push_stream_init_shm_zone(ngx_shm_zone_t *shm_zone, void *data)
         d->ipc[i].pid = -1;
         d->ipc[i].startup = 0;
         d->ipc[i].subscribers = 0;
+        d->ipc[i].subscribers_memory = 0;
         ngx_queue_init(&d->ipc[i].messages_queue);
         ngx_queue_init(&d->ipc[i].subscribers_queue);
     }
@@ -1079,6 +1492,12 @@ ngx_http_push_stream_init_shm_zone(ngx_shm_zone_t *shm_zone, void *data)
     d->subscribers = 0;
     d->channels_in_trash = 0;
     d->messages_in_trash = 0;
+    d->slow_subscribers_disconnected = 0;
+    d->slow_subscribers_dropped_messages = 0;
+    d->ingested_messages = 0;
+    d->ingest_errors = 0;
+    d->publish_requests = 0;
+    d->publish_latency = 0;
     d->startup = ngx_time();
     d->last_message_time = 0;
     d->last_message_tag = 0;
@@ -1091,11 +1510,17 @@ ngx_http_push_stream_init_shm_zone(ngx_shm_zone_t *shm_zone, void *data)
         return NGX_ERROR;
     }
     ngx_rbtree_init(&d->tree, sentinel, ngx_http_push_stream_rbtree_insert);
+    d->tree_version = 0;
 
     ngx_queue_init(&d->messages_trash);
     ngx_queue_init(&d->channels_queue);
     ngx_queue_init(&d->channels_to_delete);
     ngx_queue_init(&d->channels_trash);
+    ngx_queue_init(&d->publish_limit_groups);
+
+    if (ngx_http_push_stream_init_publish_limit_groups(mcf, d) != NGX_OK) {
+        return NGX_ERROR;
+    }
 
     ngx_queue_insert_tail(&global_shm_data->shm_datas_queue, &d->shm_data_queue);
 
@@ -1119,6 +1544,10 @@ ngx_http_push_stream_init_shm_zone(ngx_shm_zone_t *shm_zone, void *data)
         return NGX_ERROR;
     }
 
+    if (ngx_http_push_stream_create_shmtx(&d->publish_limit_groups_mutex, &d->publish_limit_groups_lock, (u_char *) "push_stream_publish_limit_groups") != NGX_OK) {
+        return NGX_ERROR;
+    }
+
     u_char lock_name[25];
     for (i = 0; i < 10; i++) {
         ngx_sprintf(lock_name, "push_stream_channels_%d", i);
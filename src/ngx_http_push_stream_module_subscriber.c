@@ -28,12 +28,15 @@
 static ngx_int_t                                 ngx_http_push_stream_subscriber_assign_channel(ngx_http_push_stream_main_conf_t *mcf, ngx_http_push_stream_loc_conf_t *cf, ngx_http_request_t *r, ngx_http_push_stream_requested_channel_t *requested_channel, time_t if_modified_since, ngx_int_t tag, ngx_str_t *last_event_id, ngx_http_push_stream_subscriber_t *subscriber, ngx_pool_t *temp_pool);
 static ngx_http_push_stream_subscriber_t        *ngx_http_push_stream_subscriber_prepare_request_to_keep_connected(ngx_http_request_t *r);
 static ngx_int_t                                 ngx_http_push_stream_registry_subscriber(ngx_http_request_t *r, ngx_http_push_stream_subscriber_t *worker_subscriber);
-static ngx_flag_t                                ngx_http_push_stream_has_old_messages_to_send(ngx_http_push_stream_channel_t *channel, ngx_uint_t backtrack, time_t if_modified_since, ngx_int_t tag, time_t greater_message_time, ngx_int_t greater_message_tag, ngx_str_t *last_event_id);
+static ngx_flag_t                                ngx_http_push_stream_get_channel_last_message(ngx_http_push_stream_channel_t *channel, time_t *last_message_time, ngx_int_t *last_message_tag);
+static ngx_flag_t                                ngx_http_push_stream_has_old_messages_to_send(ngx_http_request_t *r, ngx_http_push_stream_channel_t *channel, ngx_uint_t backtrack, time_t if_modified_since, ngx_int_t tag, time_t greater_message_time, ngx_int_t greater_message_tag, ngx_str_t *last_event_id);
+static ngx_flag_t                                ngx_http_push_stream_find_last_event_id_locked(ngx_http_push_stream_channel_t *channel, ngx_str_t *last_event_id, ngx_int_t *last_id);
 static void                                      ngx_http_push_stream_send_old_messages(ngx_http_request_t *r, ngx_http_push_stream_channel_t *channel, ngx_uint_t backtrack, time_t if_modified_since, ngx_int_t tag, time_t greater_message_time, ngx_int_t greater_message_tag, ngx_str_t *last_event_id);
 static ngx_http_push_stream_pid_queue_t         *ngx_http_push_stream_get_worker_subscriber_channel_sentinel_locked(ngx_slab_pool_t *shpool, ngx_http_push_stream_channel_t *channel, ngx_log_t *log);
 static ngx_http_push_stream_subscription_t      *ngx_http_push_stream_create_channel_subscription(ngx_http_request_t *r, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_subscriber_t *subscriber);
 static ngx_int_t                                 ngx_http_push_stream_assing_subscription_to_channel(ngx_slab_pool_t *shpool, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_subscription_t *subscription, ngx_queue_t *subscriptions, ngx_log_t *log);
 static ngx_int_t                                 ngx_http_push_stream_subscriber_polling_handler(ngx_http_request_t *r, ngx_http_push_stream_requested_channel_t *channels_ids, time_t if_modified_since, ngx_int_t tag, ngx_str_t *last_event_id, ngx_flag_t longpolling, ngx_pool_t *temp_pool);
+static ngx_int_t                                 ngx_http_push_stream_send_cached_polling_response(ngx_http_request_t *r, ngx_http_push_stream_polling_cache_entry_t *entry, ngx_pool_t *temp_pool);
 static ngx_http_push_stream_padding_t           *ngx_http_push_stream_get_padding_by_user_agent(ngx_http_request_t *r);
 void                                             ngx_http_push_stream_websocket_reading(ngx_http_request_t *r);
 
@@ -84,20 +87,28 @@ ngx_http_push_stream_subscriber_handler(ngx_http_request_t *r)
     }
 
     //get channels ids and backtracks from path
-    requested_channels = ngx_http_push_stream_parse_channels_ids_from_path(r, r->pool);
+    // requested channels are only needed until the subscriber is registered
+    requested_channels = ngx_http_push_stream_parse_channels_ids_from_path(r, ctx->temp_pool);
     if ((requested_channels == NULL) || ngx_queue_empty(&requested_channels->queue)) {
         ngx_log_error(NGX_LOG_WARN, r->connection->log, 0, "push stream module: the push_stream_channels_path is required but is not set");
         return ngx_http_push_stream_send_only_header_response(r, NGX_HTTP_BAD_REQUEST, &NGX_HTTP_PUSH_STREAM_NO_CHANNEL_ID_MESSAGE);
     }
 
     //validate channels: name, length and quantity. check if channel exists when authorized_channels_only is on. check if channel is full of subscribers
-    if (ngx_http_push_stream_validate_channels(r, requested_channels, &status_code, &explain_error_message) == NGX_ERROR) {
+    if (ngx_http_push_stream_validate_channels(r, requested_channels, NULL, &status_code, &explain_error_message) == NGX_ERROR) {
         return ngx_http_push_stream_send_only_header_response(r, status_code, explain_error_message);
     }
 
     // get control values
     ngx_http_push_stream_get_last_received_message_values(r, &if_modified_since, &tag, &last_event_id);
 
+    if (ngx_http_push_stream_get_event_types_filter(r) != NGX_OK) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    ngx_http_push_stream_get_accept_delta(r);
+    ngx_http_push_stream_get_max_message_rate(r);
+
     push_mode = ngx_http_push_stream_get_header(r, &NGX_HTTP_PUSH_STREAM_HEADER_MODE);
     polling = ((cf->location_type == NGX_HTTP_PUSH_STREAM_SUBSCRIBER_MODE_POLLING) || ((push_mode != NULL) && (push_mode->len == NGX_HTTP_PUSH_STREAM_MODE_POLLING.len) && (ngx_strncasecmp(push_mode->data, NGX_HTTP_PUSH_STREAM_MODE_POLLING.data, NGX_HTTP_PUSH_STREAM_MODE_POLLING.len) == 0)));
     longpolling = ((cf->location_type == NGX_HTTP_PUSH_STREAM_SUBSCRIBER_MODE_LONGPOLLING) || ((push_mode != NULL) && (push_mode->len == NGX_HTTP_PUSH_STREAM_MODE_LONGPOLLING.len) && (ngx_strncasecmp(push_mode->data, NGX_HTTP_PUSH_STREAM_MODE_LONGPOLLING.data, NGX_HTTP_PUSH_STREAM_MODE_LONGPOLLING.len) == 0)));
@@ -108,6 +119,7 @@ ngx_http_push_stream_subscriber_handler(ngx_http_request_t *r)
             ngx_destroy_pool(ctx->temp_pool);
             ctx->temp_pool = NULL;
         }
+        ngx_http_push_stream_update_subscriber_memory(r);
         return result;
     }
 
@@ -143,6 +155,7 @@ ngx_http_push_stream_subscriber_handler(ngx_http_request_t *r)
         ngx_destroy_pool(ctx->temp_pool);
         ctx->temp_pool = NULL;
     }
+    ngx_http_push_stream_update_subscriber_memory(r);
     return NGX_DONE;
 }
 
@@ -161,6 +174,10 @@ ngx_http_push_stream_subscriber_polling_handler(ngx_http_request_t *r, ngx_http_
     ngx_int_t                                       greater_message_tag;
     ngx_flag_t                                      has_message_to_send = 0;
     ngx_str_t                                       callback_function_name;
+    ngx_str_t                                      *cache_key = NULL;
+    ngx_http_push_stream_polling_cache_entry_t     *cache_entry;
+    ngx_http_push_stream_polling_cache_channel_t   *cached_channels = NULL;
+    ngx_uint_t                                      qtd_cached_channels = 0;
 
     if (ngx_http_arg(r, NGX_HTTP_PUSH_STREAM_CALLBACK.data, NGX_HTTP_PUSH_STREAM_CALLBACK.len, &callback_function_name) == NGX_OK) {
         ngx_http_push_stream_unescape_uri(&callback_function_name);
@@ -172,6 +189,14 @@ ngx_http_push_stream_subscriber_polling_handler(ngx_http_request_t *r, ngx_http_
         ctx->callback->len = callback_function_name.len;
     }
 
+    // identical requests reuse the response rendered on this worker while the channels do not change
+    if ((mcf->polling_response_cache_entries != NGX_CONF_UNSET_UINT) && (ctx->event_types == NULL) && ((cache_key = ngx_http_push_stream_polling_cache_key(r, requested_channels, if_modified_since, tag, last_event_id, temp_pool)) != NULL)) {
+        if ((cache_entry = ngx_http_push_stream_polling_cache_find(cache_key, requested_channels)) != NULL) {
+            return ngx_http_push_stream_send_cached_polling_response(r, cache_entry, temp_pool);
+        }
+        cached_channels = ngx_http_push_stream_polling_cache_snapshot(requested_channels, &qtd_cached_channels, temp_pool);
+    }
+
     greater_message_tag = tag;
     greater_message_time = (if_modified_since < 0) ? 0 : if_modified_since;
 
@@ -179,7 +204,7 @@ ngx_http_push_stream_subscriber_polling_handler(ngx_http_request_t *r, ngx_http_
     for (q = ngx_queue_head(&requested_channels->queue); q != ngx_queue_sentinel(&requested_channels->queue); q = ngx_queue_next(q)) {
         requested_channel = ngx_queue_data(q, ngx_http_push_stream_requested_channel_t, queue);
 
-        if (ngx_http_push_stream_has_old_messages_to_send(requested_channel->channel, requested_channel->backtrack_messages, if_modified_since, tag, greater_message_time, greater_message_tag, last_event_id)) {
+        if (ngx_http_push_stream_has_old_messages_to_send(r, requested_channel->channel, requested_channel->backtrack_messages, if_modified_since, tag, greater_message_time, greater_message_tag, last_event_id)) {
             has_message_to_send = 1;
             if (requested_channel->channel->last_message_time > greater_message_time) {
                 greater_message_time = requested_channel->channel->last_message_time;
@@ -233,9 +258,14 @@ ngx_http_push_stream_subscriber_polling_handler(ngx_http_request_t *r, ngx_http_
 
     ngx_http_send_header(r);
 
+    if (cached_channels != NULL) {
+        ctx->polling_response = ngx_array_create(temp_pool, ngx_pagesize, 1);
+    }
+
     // sending response content header
     if (ngx_http_push_stream_send_response_content_header(r, cf) == NGX_ERROR) {
         ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: could not send content header to subscriber");
+        ctx->polling_response = NULL;
         return NGX_HTTP_INTERNAL_SERVER_ERROR;
     }
 
@@ -257,6 +287,42 @@ ngx_http_push_stream_subscriber_polling_handler(ngx_http_request_t *r, ngx_http_
         ngx_http_push_stream_send_response_text(r, cf->footer_template.data, cf->footer_template.len, 0);
     }
 
+    // the copy lives on the temporary pool, it is not used after this point
+    if (ctx->polling_response != NULL) {
+        if (!r->connection->error) {
+            ngx_http_push_stream_polling_cache_store(r, cache_key, cached_channels, qtd_cached_channels, greater_message_time, greater_message_tag, ctx->polling_response);
+        }
+        ctx->polling_response = NULL;
+    }
+
+    ngx_http_send_special(r, NGX_HTTP_LAST | NGX_HTTP_FLUSH);
+
+    return NGX_OK;
+}
+
+static ngx_int_t
+ngx_http_push_stream_send_cached_polling_response(ngx_http_request_t *r, ngx_http_push_stream_polling_cache_entry_t *entry, ngx_pool_t *temp_pool)
+{
+    u_char                                         *body;
+
+    // the entry may be evicted before the response is written to the client
+    if ((body = ngx_pnalloc(r->pool, entry->body.len)) == NULL) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate memory for cached polling response");
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+    ngx_memcpy(body, entry->body.data, entry->body.len);
+
+    ngx_http_push_stream_add_polling_headers(r, entry->last_modified_time, entry->tag, temp_pool);
+
+    r->headers_out.status = NGX_HTTP_OK;
+    r->headers_out.content_length_n = -1;
+
+    ngx_http_send_header(r);
+
+    if (entry->body.len > 0) {
+        ngx_http_push_stream_send_response_text(r, body, entry->body.len, 0);
+    }
+
     ngx_http_send_special(r, NGX_HTTP_LAST | NGX_HTTP_FLUSH);
 
     return NGX_OK;
@@ -280,16 +346,28 @@ ngx_http_push_stream_subscriber_assign_channel(ngx_http_push_stream_main_conf_t
 
 
 static ngx_int_t
-ngx_http_push_stream_validate_channels(ngx_http_request_t *r, ngx_http_push_stream_requested_channel_t *requested_channels, ngx_int_t *status_code, ngx_str_t **explain_error_message)
+ngx_http_push_stream_validate_channels(ngx_http_request_t *r, ngx_http_push_stream_requested_channel_t *requested_channels, ngx_http_push_stream_subscriber_t *subscriber, ngx_int_t *status_code, ngx_str_t **explain_error_message)
 {
     ngx_http_push_stream_main_conf_t               *mcf = ngx_http_get_module_main_conf(r, ngx_http_push_stream_module);
     ngx_http_push_stream_loc_conf_t                *cf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
     ngx_http_push_stream_requested_channel_t       *requested_channel;
+    ngx_http_push_stream_subscription_t            *subscription;
     ngx_queue_t                                    *q;
     ngx_uint_t                                      subscribed_channels_qtd = 0;
     ngx_uint_t                                      subscribed_wildcard_channels_qtd = 0;
     ngx_flag_t                                      is_wildcard_channel;
 
+    // channels already subscribed by the connection count on the limits
+    if (subscriber != NULL) {
+        for (q = ngx_queue_head(&subscriber->subscriptions); q != ngx_queue_sentinel(&subscriber->subscriptions); q = ngx_queue_next(q)) {
+            subscription = ngx_queue_data(q, ngx_http_push_stream_subscription_t, queue);
+            subscribed_channels_qtd++;
+            if (subscription->channel->wildcard) {
+                subscribed_wildcard_channels_qtd++;
+            }
+        }
+    }
+
     for (q = ngx_queue_head(&requested_channels->queue); q != ngx_queue_sentinel(&requested_channels->queue); q = ngx_queue_next(q)) {
         requested_channel = ngx_queue_data(q, ngx_http_push_stream_requested_channel_t, queue);
         // could not be ALL channel or contain wildcard
@@ -348,6 +426,14 @@ ngx_http_push_stream_validate_channels(ngx_http_request_t *r, ngx_http_push_stre
         return NGX_ERROR;
     }
 
+    // check if number of channels subscribed by a websocket connection is acceptable
+    if ((subscriber != NULL) && (subscribed_channels_qtd > cf->websocket_max_subscriptions)) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: max subscribed channels exceeded");
+        *status_code = NGX_HTTP_FORBIDDEN;
+        *explain_error_message = (ngx_str_t *) &NGX_HTTP_PUSH_STREAM_TOO_MUCH_SUBSCRIBED_CHANNELS;
+        return NGX_ERROR;
+    }
+
     // create the channels in advance, if doesn't exist, to ensure max number of channels in the server
     for (q = ngx_queue_head(&requested_channels->queue); q != ngx_queue_sentinel(&requested_channels->queue); q = ngx_queue_next(q)) {
         requested_channel = ngx_queue_data(q, ngx_http_push_stream_requested_channel_t, queue);
@@ -434,13 +520,13 @@ ngx_http_push_stream_registry_subscriber(ngx_http_request_t *r, ngx_http_push_st
     if ((connection_ttl != NGX_CONF_UNSET_MSEC) || (cf->ping_message_interval != NGX_CONF_UNSET_MSEC)) {
 
         if (connection_ttl != NGX_CONF_UNSET_MSEC) {
-            if ((ctx->disconnect_timer = ngx_pcalloc(worker_subscriber->request->pool, sizeof(ngx_event_t))) == NULL) {
+            if ((ctx->disconnect_timer = ngx_pcalloc(worker_subscriber->request->pool, sizeof(ngx_http_push_stream_timer_t))) == NULL) {
                 return NGX_ERROR;
             }
         }
 
         if ((!ctx->longpolling) && (cf->ping_message_interval != NGX_CONF_UNSET_MSEC)) {
-            if ((ctx->ping_timer = ngx_pcalloc(worker_subscriber->request->pool, sizeof(ngx_event_t))) == NULL) {
+            if ((ctx->ping_timer = ngx_pcalloc(worker_subscriber->request->pool, sizeof(ngx_http_push_stream_timer_t))) == NULL) {
                 return NGX_ERROR;
             }
         }
@@ -448,15 +534,13 @@ ngx_http_push_stream_registry_subscriber(ngx_http_request_t *r, ngx_http_push_st
         if (ctx->disconnect_timer != NULL) {
             ctx->disconnect_timer->handler = ngx_http_push_stream_disconnect_timer_wake_handler;
             ctx->disconnect_timer->data = worker_subscriber->request;
-            ctx->disconnect_timer->log = worker_subscriber->request->connection->log;
-            ngx_http_push_stream_timer_reset(connection_ttl, ctx->disconnect_timer);
+            ngx_http_push_stream_wheel_timer_reset(connection_ttl, ctx->disconnect_timer);
         }
 
         if (ctx->ping_timer != NULL) {
             ctx->ping_timer->handler = ngx_http_push_stream_ping_timer_wake_handler;
             ctx->ping_timer->data = worker_subscriber->request;
-            ctx->ping_timer->log = worker_subscriber->request->connection->log;
-            ngx_http_push_stream_timer_reset(cf->ping_message_interval, ctx->ping_timer);
+            ngx_http_push_stream_wheel_timer_reset(cf->ping_message_interval, ctx->ping_timer);
         }
     }
 
@@ -470,38 +554,87 @@ ngx_http_push_stream_registry_subscriber(ngx_http_request_t *r, ngx_http_push_st
 }
 
 static ngx_flag_t
-ngx_http_push_stream_has_old_messages_to_send(ngx_http_push_stream_channel_t *channel, ngx_uint_t backtrack, time_t if_modified_since, ngx_int_t tag, time_t greater_message_time, ngx_int_t greater_message_tag, ngx_str_t *last_event_id)
+ngx_http_push_stream_has_old_messages_to_send(ngx_http_request_t *r, ngx_http_push_stream_channel_t *channel, ngx_uint_t backtrack, time_t if_modified_since, ngx_int_t tag, time_t greater_message_time, ngx_int_t greater_message_tag, ngx_str_t *last_event_id)
 {
-    ngx_flag_t old_messages = 0;
-    ngx_http_push_stream_msg_t *message;
+    ngx_http_push_stream_module_ctx_t *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+    ngx_flag_t old_messages = 0, filtered = (ctx != NULL) && (ctx->event_types != NULL);
+    ngx_http_push_stream_msg_t *message, *snapshot;
     ngx_queue_t                *q;
+    ngx_uint_t                  start;
+
+    // the snapshot replaces the backtrack, only the messages accepted by the event types filter count
+    if ((backtrack > 0) && ngx_http_push_stream_channel_has_snapshot(channel)) {
+        if (!filtered) {
+            return 1;
+        }
+
+        ngx_shmtx_lock(channel->mutex);
+        snapshot = channel->snapshot_message;
+        old_messages = (snapshot != NULL) && ngx_http_push_stream_subscriber_accepts_message(r, snapshot);
+        for (q = ngx_queue_head(&channel->message_queue); !old_messages && (snapshot != NULL) && (q != ngx_queue_sentinel(&channel->message_queue)); q = ngx_queue_next(q)) {
+            message = ngx_queue_data(q, ngx_http_push_stream_msg_t, queue);
+            if (message->deleted) {
+                break;
+            }
+
+            old_messages = (message->id > snapshot->id) && ngx_http_push_stream_subscriber_accepts_message(r, message);
+        }
+        ngx_shmtx_unlock(channel->mutex);
+
+        return old_messages;
+    }
 
     if (channel->stored_messages > 0) {
 
-        if (backtrack > 0) {
+        if ((backtrack > 0) && !filtered) {
             old_messages = 1;
-        } else if ((last_event_id != NULL) || (if_modified_since >= 0)) {
-            ngx_flag_t found = 0;
+        } else if (backtrack > 0) {
             ngx_shmtx_lock(channel->mutex);
-            for (q = ngx_queue_head(&channel->message_queue); q != ngx_queue_sentinel(&channel->message_queue); q = ngx_queue_next(q)) {
+            start = (backtrack > channel->stored_messages) ? 0 : channel->stored_messages - backtrack;
+            for (q = ngx_queue_head(&channel->message_queue); !old_messages && (q != ngx_queue_sentinel(&channel->message_queue)); q = ngx_queue_next(q)) {
                 message = ngx_queue_data(q, ngx_http_push_stream_msg_t, queue);
                 if (message->deleted) {
                     break;
                 }
 
-                if ((!found) && (last_event_id != NULL) && (message->event_id != NULL) && (ngx_memn2cmp(message->event_id->data, last_event_id->data, message->event_id->len, last_event_id->len) == 0)) {
-                    found = 1;
+                if (start > 0) {
+                    start--;
                     continue;
                 }
 
-                if ((!found) && (if_modified_since >= 0) && ((message->time > if_modified_since) || ((message->time == if_modified_since) && (tag >= 0) && (message->tag >= tag)))) {
+                old_messages = ngx_http_push_stream_subscriber_accepts_message(r, message);
+            }
+            ngx_shmtx_unlock(channel->mutex);
+        } else if ((last_event_id != NULL) || (if_modified_since >= 0)) {
+            ngx_flag_t found = 0, found_last_event_id;
+            time_t     last_message_time;
+            ngx_int_t  last_message_tag, last_id;
+
+            // nothing newer than the last received message, answered without locking the channel
+            if ((last_event_id == NULL) && ngx_http_push_stream_get_channel_last_message(channel, &last_message_time, &last_message_tag) &&
+                ((last_message_time < if_modified_since) || ((last_message_time == if_modified_since) && ((tag < 0) || (last_message_tag <= tag))))) {
+                return 0;
+            }
+
+            ngx_shmtx_lock(channel->mutex);
+            found_last_event_id = (last_event_id != NULL) && ngx_http_push_stream_find_last_event_id_locked(channel, last_event_id, &last_id);
+            for (q = ngx_queue_head(&channel->message_queue); q != ngx_queue_sentinel(&channel->message_queue); q = ngx_queue_next(q)) {
+                message = ngx_queue_data(q, ngx_http_push_stream_msg_t, queue);
+                if (message->deleted) {
+                    break;
+                }
+
+                if (found_last_event_id) {
+                    found = (message->id > last_id);
+                } else if ((!found) && (if_modified_since >= 0) && ((message->time > if_modified_since) || ((message->time == if_modified_since) && (tag >= 0) && (message->tag >= tag)))) {
                     found = 1;
                     if ((message->time == if_modified_since) && (message->tag == tag)) {
                         continue;
                     }
                 }
 
-                if (found) {
+                // the messages filtered by event types are not sent, the subscriber keeps waiting for the next ones
+                if (found && ngx_http_push_stream_subscriber_accepts_message(r, message)) {
                     old_messages = 1;
                     break;
                 }
@@ -512,15 +645,84 @@ ngx_http_push_stream_has_old_messages_to_send(ngx_http_push_stream_channel_t *ch
     return old_messages;
 }
 
+static ngx_flag_t
+ngx_http_push_stream_find_last_event_id_locked(ngx_http_push_stream_channel_t *channel, ngx_str_t *last_event_id, ngx_int_t *last_id)
+{
+    ngx_http_push_stream_msg_t *message;
+    ngx_queue_t                *q;
+    ngx_flag_t                  compacted = 0;
+
+    for (q = ngx_queue_head(&channel->message_queue); q != ngx_queue_sentinel(&channel->message_queue); q = ngx_queue_next(q)) {
+        message = ngx_queue_data(q, ngx_http_push_stream_msg_t, queue);
+        if (message->deleted) {
+            break;
+        }
+
+        if ((message->event_id != NULL) && (ngx_memn2cmp(message->event_id->data, last_event_id->data, message->event_id->len, last_event_id->len) == 0)) {
+            *last_id = message->id;
+            return 1;
+        }
+
+        // the message was compacted away, the ones published after it are still stored
+        if ((message->replaced_event_id != NULL) && (ngx_memn2cmp(message->replaced_event_id->data, last_event_id->data, message->replaced_event_id->len, last_event_id->len) == 0)) {
+            *last_id = message->replaced_id;
+            return 1;
+        }
+
+        compacted |= (message->replaced_id > 0);
+    }
+
+    // a message replaced more than once is no longer known, the stored messages are the latest of each key and are all sent
+    *last_id = 0;
+    return compacted;
+}
+
+static ngx_flag_t
+ngx_http_push_stream_get_channel_last_message(ngx_http_push_stream_channel_t *channel, time_t *last_message_time, ngx_int_t *last_message_tag)
+{
+    ngx_atomic_uint_t   version = channel->last_message_version;
+
+    // a publisher is changing the values, the caller must use the channel lock
+    if (version & 1) {
+        return 0;
+    }
+
+    ngx_memory_barrier();
+    *last_message_time = channel->last_message_time;
+    *last_message_tag = channel->last_message_tag;
+    ngx_memory_barrier();
+
+    return (channel->last_message_version == version);
+}
+
 static void
 ngx_http_push_stream_send_old_messages(ngx_http_request_t *r, ngx_http_push_stream_channel_t *channel, ngx_uint_t backtrack, time_t if_modified_since, ngx_int_t tag, time_t greater_message_time, ngx_int_t greater_message_tag, ngx_str_t *last_event_id)
 {
     ngx_http_push_stream_module_ctx_t     *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
-    ngx_http_push_stream_msg_t            *message;
+    ngx_http_push_stream_msg_t            *message, *snapshot;
     ngx_queue_t                           *q;
 
-    if (ngx_http_push_stream_has_old_messages_to_send(channel, backtrack, if_modified_since, tag, greater_message_time, greater_message_tag, last_event_id)) {
-        if (backtrack > 0) {
+    if (ngx_http_push_stream_has_old_messages_to_send(r, channel, backtrack, if_modified_since, tag, greater_message_time, greater_message_tag, last_event_id)) {
+        if ((backtrack > 0) && ngx_http_push_stream_channel_has_snapshot(channel)) {
+            ngx_shmtx_lock(channel->mutex);
+            // the snapshot is followed by all stored messages published after it, whatever the backtrack size
+            snapshot = channel->snapshot_message;
+            if (ngx_http_push_stream_subscriber_accepts_message(r, snapshot)) {
+                ngx_http_push_stream_send_response_message(r, channel, snapshot, 0, ctx->message_sent);
+            }
+
+            for (q = ngx_queue_head(&channel->message_queue); q != ngx_queue_sentinel(&channel->message_queue); q = ngx_queue_next(q)) {
+                message = ngx_queue_data(q, ngx_http_push_stream_msg_t, queue);
+                if (message->deleted) {
+                    break;
+                }
+
+                if ((message->id > snapshot->id) && ngx_http_push_stream_subscriber_accepts_message(r, message)) {
+                    ngx_http_push_stream_send_response_message(r, channel, message, 0, ctx->message_sent);
+                }
+            }
+            ngx_shmtx_unlock(channel->mutex);
+        } else if (backtrack > 0) {
             ngx_uint_t qtd = (backtrack > channel->stored_messages) ? channel->stored_messages : backtrack;
             ngx_uint_t start = channel->stored_messages - qtd;
             ngx_shmtx_lock(channel->mutex);
@@ -533,34 +735,35 @@ ngx_http_push_stream_send_old_messages(ngx_http_request_t *r, ngx_http_push_stre
 
                 if (start == 0) {
                     qtd--;
-                    ngx_http_push_stream_send_response_message(r, channel, message, 0, ctx->message_sent);
+                    if (ngx_http_push_stream_subscriber_accepts_message(r, message)) {
+                        ngx_http_push_stream_send_response_message(r, channel, message, 0, ctx->message_sent);
+                    }
                 } else {
                     start--;
                 }
             }
             ngx_shmtx_unlock(channel->mutex);
         } else if ((last_event_id != NULL) || (if_modified_since >= 0)) {
-            ngx_flag_t found = 0;
+            ngx_flag_t found = 0, found_last_event_id;
+            ngx_int_t  last_id;
             ngx_shmtx_lock(channel->mutex);
+            found_last_event_id = (last_event_id != NULL) && ngx_http_push_stream_find_last_event_id_locked(channel, last_event_id, &last_id);
             for (q = ngx_queue_head(&channel->message_queue); q != ngx_queue_sentinel(&channel->message_queue); q = ngx_queue_next(q)) {
                 message = ngx_queue_data(q, ngx_http_push_stream_msg_t, queue);
                 if (message->deleted) {
                     break;
                 }
 
-                if ((!found) && (last_event_id != NULL) && (message->event_id != NULL) && (ngx_memn2cmp(message->event_id->data, last_event_id->data, message->event_id->len, last_event_id->len) == 0)) {
-                    found = 1;
-                    continue;
-                }
-
-                if ((!found) && (if_modified_since >= 0) && ((message->time > if_modified_since) || ((message->time == if_modified_since) && (tag >= 0) && (message->tag >= tag)))) {
+                if (found_last_event_id) {
+                    found = (message->id > last_id);
+                } else if ((!found) && (if_modified_since >= 0) && ((message->time > if_modified_since) || ((message->time == if_modified_since) && (tag >= 0) && (message->tag >= tag)))) {
                     found = 1;
                     if ((message->time == if_modified_since) && (message->tag == tag)) {
                         continue;
                     }
                 }
 
-                if (found && (((greater_message_time == 0) && (greater_message_tag == -1)) || (greater_message_time > message->time) || ((greater_message_time == message->time) && (greater_message_tag >= message->tag)))) {
+                if (found && (((greater_message_time == 0) && (greater_message_tag == -1)) || (greater_message_time > message->time) || ((greater_message_time == message->time) && (greater_message_tag >= message->tag))) && ngx_http_push_stream_subscriber_accepts_message(r, message)) {
                     ngx_http_push_stream_send_response_message(r, channel, message, 0, ctx->message_sent);
                 }
             }
@@ -601,14 +804,22 @@ ngx_http_push_stream_get_worker_subscriber_channel_sentinel_locked(ngx_slab_pool
 static ngx_http_push_stream_subscription_t *
 ngx_http_push_stream_create_channel_subscription(ngx_http_request_t *r, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_subscriber_t *subscriber)
 {
+    ngx_http_push_stream_module_ctx_t          *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
     ngx_http_push_stream_subscription_t        *subscription;
-
-    if ((subscription = ngx_pcalloc(r->pool, sizeof(ngx_http_push_stream_subscription_t))) == NULL) {
+    ngx_queue_t                                *q;
+
+    // reuse the memory of channels unsubscribed by the same request
+    if ((ctx != NULL) && !ngx_queue_empty(&ctx->free_subscriptions)) {
+        q = ngx_queue_head(&ctx->free_subscriptions);
+        ngx_queue_remove(q);
+        subscription = ngx_queue_data(q, ngx_http_push_stream_subscription_t, queue);
+    } else if ((subscription = ngx_pcalloc(r->pool, sizeof(ngx_http_push_stream_subscription_t))) == NULL) {
         ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate subscribed channel reference");
         return NULL;
     }
 
     subscription->channel_worker_sentinel = NULL;
+    subscription->last_message_id = 0;
     subscription->channel = channel;
     subscription->subscriber = subscriber;
     ngx_queue_init(&subscription->queue);
@@ -34,6 +34,24 @@ void                   ngx_http_push_stream_collect_expired_messages_and_empty_c
 void                   ngx_http_push_stream_free_memory_of_expired_messages_and_channels_data(ngx_http_push_stream_shm_data_t *data, ngx_flag_t force);
 static ngx_inline void ngx_http_push_stream_cleanup_shutting_down_worker_data(ngx_http_push_stream_shm_data_t *data);
 static void            ngx_http_push_stream_flush_pending_output(ngx_http_request_t *r);
+static ngx_int_t       ngx_http_push_stream_coalesce_output(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx, ngx_chain_t *out, ngx_http_push_stream_loc_conf_t *pslcf);
+static void            ngx_http_push_stream_remove_coalesced_output(ngx_http_push_stream_module_ctx_t *ctx);
+static size_t          ngx_http_push_stream_pending_output_size(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx);
+static ngx_int_t       ngx_http_push_stream_defer_message(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *msg, ngx_http_push_stream_loc_conf_t *pslcf);
+static ngx_int_t       ngx_http_push_stream_send_deferred_messages(ngx_http_request_t *r);
+static ngx_http_push_stream_deferred_msg_t *ngx_http_push_stream_ref_message(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *msg);
+static void            ngx_http_push_stream_unref_message(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx, ngx_http_push_stream_deferred_msg_t *deferred);
+static ngx_http_push_stream_deferred_msg_t *ngx_http_push_stream_hold_message(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *msg);
+static void            ngx_http_push_stream_release_deferred_message(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx, ngx_http_push_stream_deferred_msg_t *deferred);
+static ngx_flag_t      ngx_http_push_stream_same_conflation_key(ngx_http_push_stream_loc_conf_t *pslcf, ngx_http_push_stream_msg_t *msg, ngx_http_push_stream_msg_t *other);
+static size_t          ngx_http_push_stream_event_id_prefix_len(ngx_http_push_stream_msg_t *msg, ngx_str_t *separator);
+static void            ngx_http_push_stream_rate_timer_wake_handler(ngx_event_t *ev);
+static void            ngx_http_push_stream_send_lingering_messages(ngx_http_request_t *r);
+static void            ngx_http_push_stream_linger_timer_wake_handler(ngx_event_t *ev);
+
+#define ngx_http_push_stream_is_coalescing_output(pslcf, ctx) (((pslcf)->output_coalescing_delay != NGX_CONF_UNSET_MSEC) && ((ctx)->subscriber != NULL) && !(ctx)->longpolling)
+#define ngx_http_push_stream_is_limiting_pending_output(pslcf) (((pslcf)->max_pending_output_size != NGX_CONF_UNSET_SIZE) || ((pslcf)->max_pending_output_messages != NGX_CONF_UNSET_UINT))
+#define ngx_http_push_stream_is_lingering(ctx) (((ctx) != NULL) && (ctx)->longpolling && !ngx_queue_empty(&(ctx)->deferred_messages))
 
 
 ngx_uint_t
@@ -67,6 +85,101 @@ ngx_http_push_stream_ensure_qtd_of_messages(ngx_http_push_stream_shm_data_t *dat
 }
 
 
+// the delta text is "kept prefix length,kept suffix length,replacement" of the previous message text
+static ngx_http_push_stream_msg_t *
+ngx_http_push_stream_create_message_delta(ngx_http_push_stream_main_conf_t *mcf, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *msg, ngx_str_t *event_id, ngx_str_t *event_type, ngx_pool_t *temp_pool)
+{
+    ngx_http_push_stream_msg_t             *previous = NULL, *delta;
+    ngx_int_t                               base = 0;
+    size_t                                  prefix = 0, suffix = 0, max, replacement_len;
+    u_char                                 *text, *last;
+
+    // only the last published message is used as base, and it must be stored
+    ngx_shmtx_lock(channel->mutex);
+    if (!ngx_queue_empty(&channel->message_queue)) {
+        previous = ngx_queue_data(ngx_queue_last(&channel->message_queue), ngx_http_push_stream_msg_t, queue);
+        if ((previous->id == (ngx_int_t) channel->last_message_id) && (previous->opcode == NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE)) {
+            base = previous->id;
+        }
+    }
+    ngx_shmtx_unlock(channel->mutex);
+
+    if (base <= 0) {
+        return NULL;
+    }
+
+    // compared without the lock, a removed message stays on the trash and a stale base is discarded when the message is stored
+    max = ngx_min(previous->raw.len, msg->raw.len);
+    while ((prefix < max) && (previous->raw.data[prefix] == msg->raw.data[prefix])) {
+        prefix++;
+    }
+
+    // the replacement starts and ends on utf-8 character boundaries, the delta is sent as text
+    while ((prefix > 0) && (((prefix < msg->raw.len) && ((msg->raw.data[prefix] & 0xC0) == 0x80)) || ((prefix < previous->raw.len) && ((previous->raw.data[prefix] & 0xC0) == 0x80)))) {
+        prefix--;
+    }
+
+    while ((suffix < max - prefix) && (previous->raw.data[previous->raw.len - suffix - 1] == msg->raw.data[msg->raw.len - suffix - 1])) {
+        suffix++;
+    }
+
+    while ((suffix > 0) && ((msg->raw.data[msg->raw.len - suffix] & 0xC0) == 0x80)) {
+        suffix--;
+    }
+
+    replacement_len = msg->raw.len - prefix - suffix;
+    if ((text = ngx_pnalloc(temp_pool, 2 * NGX_SIZE_T_LEN + 2 + replacement_len)) == NULL) {
+        return NULL;
+    }
+    last = ngx_sprintf(text, "%uz,%uz,", prefix, suffix);
+    last = ngx_cpymem(last, msg->raw.data + prefix, replacement_len);
+
+    // not worth when the messages are too different
+    if ((size_t) (last - text) > (msg->raw.len / 2)) {
+        return NULL;
+    }
+
+    if ((delta = ngx_http_push_stream_convert_char_to_msg_on_shared(mcf, text, last - text, channel, msg->id, base, event_id, event_type, NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE, temp_pool)) == NULL) {
+        ngx_log_error(NGX_LOG_WARN, temp_pool->log, 0, "push stream module: unable to allocate message delta in shared memory, sending only the full message");
+        return NULL;
+    }
+    delta->time = msg->time;
+    delta->tag = msg->tag;
+
+    return delta;
+}
+
+
+// the channel mutex must be held, there is at most one stored message for each key
+static ngx_uint_t
+ngx_http_push_stream_remove_message_by_key_locked(ngx_http_push_stream_shm_data_t *data, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *replacement)
+{
+    ngx_http_push_stream_msg_t             *msg;
+    ngx_queue_t                            *q;
+
+    for (q = ngx_queue_head(&channel->message_queue); q != ngx_queue_sentinel(&channel->message_queue); q = ngx_queue_next(q)) {
+        msg = ngx_queue_data(q, ngx_http_push_stream_msg_t, queue);
+
+        if ((msg->key.len == replacement->key.len) && (ngx_memcmp(msg->key.data, replacement->key.data, replacement->key.len) == 0)) {
+            // subscribers resuming from the removed message find its position on the replacement
+            replacement->replaced_id = msg->id;
+            if ((msg->event_id != NULL) && ((replacement->replaced_event_id = ngx_slab_alloc(data->shpool, sizeof(ngx_str_t) + msg->event_id->len)) != NULL)) {
+                replacement->replaced_event_id->data = (u_char *) (replacement->replaced_event_id + 1);
+                replacement->replaced_event_id->len = msg->event_id->len;
+                ngx_memcpy(replacement->replaced_event_id->data, msg->event_id->data, msg->event_id->len);
+            }
+
+            NGX_HTTP_PUSH_STREAM_DECREMENT_COUNTER(channel->stored_messages);
+            ngx_queue_remove(&msg->queue);
+            ngx_http_push_stream_throw_the_message_away(msg, data);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
 static void
 ngx_http_push_stream_delete_channels(void)
 {
@@ -232,6 +345,14 @@ ngx_http_push_stream_cleanup_shutting_down_worker_data(ngx_http_push_stream_shm_
         ngx_del_timer(&ngx_http_push_stream_buffer_cleanup_event);
     }
 
+    if (ngx_http_push_stream_output_coalescing_event.timer_set) {
+        ngx_del_timer(&ngx_http_push_stream_output_coalescing_event);
+    }
+
+    if (ngx_http_push_stream_timer_wheel.event.timer_set) {
+        ngx_del_timer(&ngx_http_push_stream_timer_wheel.event);
+    }
+
     ngx_http_push_stream_clean_worker_data(data);
 }
 
@@ -266,12 +387,13 @@ ngx_http_push_stream_apply_text_template(ngx_str_t **dst_value, ngx_str_t **dst_
 }
 
 ngx_http_push_stream_msg_t *
-ngx_http_push_stream_convert_char_to_msg_on_shared(ngx_http_push_stream_main_conf_t *mcf, u_char *data, size_t len, ngx_http_push_stream_channel_t *channel, ngx_int_t id, ngx_str_t *event_id, ngx_str_t *event_type, ngx_pool_t *temp_pool)
+ngx_http_push_stream_convert_char_to_msg_on_shared(ngx_http_push_stream_main_conf_t *mcf, u_char *data, size_t len, ngx_http_push_stream_channel_t *channel, ngx_int_t id, ngx_int_t delta_base, ngx_str_t *event_id, ngx_str_t *event_type, ngx_uint_t opcode, ngx_pool_t *temp_pool)
 {
     ngx_slab_pool_t                           *shpool = mcf->shpool;
     ngx_http_push_stream_shm_data_t           *shm_data = mcf->shm_data;
     ngx_queue_t                               *q;
     ngx_http_push_stream_msg_t                *msg;
+    ngx_str_t                                 *text_payload;
     int                                        i = 0;
 
     if ((msg = ngx_slab_alloc(shpool, sizeof(ngx_http_push_stream_msg_t))) == NULL) {
@@ -280,12 +402,19 @@ ngx_http_push_stream_convert_char_to_msg_on_shared(ngx_http_push_stream_main_con
 
     msg->event_id = NULL;
     msg->event_type = NULL;
+    ngx_str_null(&msg->key);
+    msg->replaced_event_id = NULL;
+    msg->replaced_id = 0;
     msg->event_id_message = NULL;
     msg->event_type_message = NULL;
     msg->formatted_messages = NULL;
+    msg->deflated_messages = NULL;
+    msg->delta = NULL;
     msg->deleted = 0;
     msg->expires = 0;
     msg->id = id;
+    msg->delta_base = delta_base;
+    msg->opcode = opcode;
     msg->workers_ref_count = 0;
     msg->time = (id < 0) ? 0 : ngx_time();
     msg->tag = (id < 0) ? 0 : ((msg->time == shm_data->last_message_time) ? (shm_data->last_message_tag + 1) : 1);
@@ -302,6 +431,15 @@ ngx_http_push_stream_convert_char_to_msg_on_shared(ngx_http_push_stream_main_con
     ngx_memcpy(msg->raw.data, data, len);
     msg->raw.data[msg->raw.len] = '\0';
 
+    // binary messages are base64 encoded for subscribers not using websocket frames
+    text_payload = &msg->raw;
+    if (opcode == NGX_HTTP_PUSH_STREAM_WEBSOCKET_BINARY_OPCODE) {
+        if ((text_payload = ngx_http_push_stream_create_str(temp_pool, ngx_base64_encoded_length(msg->raw.len))) == NULL) {
+            ngx_http_push_stream_free_message_memory(shpool, msg);
+            return NULL;
+        }
+        ngx_encode_base64(text_payload, &msg->raw);
+    }
 
     if (ngx_http_push_stream_apply_text_template(&msg->event_id, &msg->event_id_message, event_id, &NGX_HTTP_PUSH_STREAM_EVENTSOURCE_ID_TEMPLATE, &NGX_HTTP_PUSH_STREAM_TOKEN_MESSAGE_EVENT_ID, shpool, temp_pool) != NGX_OK) {
         ngx_http_push_stream_free_message_memory(shpool, msg);
@@ -326,7 +464,7 @@ ngx_http_push_stream_convert_char_to_msg_on_shared(ngx_http_push_stream_main_con
             ngx_http_push_stream_line_t     *cur_line;
             ngx_queue_t                     *lines, *q_line;
 
-            if ((lines = ngx_http_push_stream_split_by_crlf(&msg->raw, temp_pool)) == NULL) {
+            if ((lines = ngx_http_push_stream_split_by_crlf(text_payload, temp_pool)) == NULL) {
                 ngx_http_push_stream_free_message_memory(shpool, msg);
                 return NULL;
             }
@@ -343,7 +481,7 @@ ngx_http_push_stream_convert_char_to_msg_on_shared(ngx_http_push_stream_main_con
                 ngx_sprintf(aux->data, "%V\n", tmp);
             }
         } else {
-            aux = ngx_http_push_stream_format_message(channel, msg, &msg->raw, cur, temp_pool);
+            aux = ngx_http_push_stream_format_message(channel, msg, cur->websocket ? &msg->raw : text_payload, cur, temp_pool);
         }
 
         if (aux == NULL) {
@@ -353,7 +491,8 @@ ngx_http_push_stream_convert_char_to_msg_on_shared(ngx_http_push_stream_main_con
 
         ngx_str_t *text = aux;
         if (cur->websocket) {
-            text = ngx_http_push_stream_get_formatted_websocket_frame(&NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_LAST_FRAME_BYTE, sizeof(NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_LAST_FRAME_BYTE), aux->data, aux->len, temp_pool);
+            const u_char *frame_byte = (opcode == NGX_HTTP_PUSH_STREAM_WEBSOCKET_BINARY_OPCODE) ? &NGX_HTTP_PUSH_STREAM_WEBSOCKET_BINARY_LAST_FRAME_BYTE : &NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_LAST_FRAME_BYTE;
+            text = ngx_http_push_stream_get_formatted_websocket_frame(frame_byte, 1, aux->data, aux->len, temp_pool);
         }
 
         ngx_str_t *formmated = (msg->formatted_messages + i);
@@ -365,6 +504,13 @@ ngx_http_push_stream_convert_char_to_msg_on_shared(ngx_http_push_stream_main_con
         formmated->len = text->len;
         ngx_memcpy(formmated->data, text->data, formmated->len);
 
+#if (NGX_ZLIB)
+        if (cur->deflate && (ngx_http_push_stream_deflate_message(msg, i, aux, shpool, temp_pool) != NGX_OK)) {
+            ngx_http_push_stream_free_message_memory(shpool, msg);
+            return NULL;
+        }
+#endif
+
         i++;
     }
 
@@ -373,38 +519,243 @@ ngx_http_push_stream_convert_char_to_msg_on_shared(ngx_http_push_stream_main_con
 
 
 ngx_int_t
-ngx_http_push_stream_add_msg_to_channel(ngx_http_push_stream_main_conf_t *mcf, ngx_log_t *log, ngx_http_push_stream_channel_t *channel, u_char *text, size_t len, ngx_str_t *event_id, ngx_str_t *event_type, ngx_flag_t store_messages, ngx_pool_t *temp_pool)
+ngx_http_push_stream_add_msg_to_channel(ngx_http_push_stream_main_conf_t *mcf, ngx_log_t *log, ngx_http_push_stream_channel_t *channel, u_char *text, size_t len, ngx_str_t *event_id, ngx_str_t *event_type, ngx_str_t *message_key, ngx_uint_t opcode, ngx_flag_t store_messages, ngx_flag_t message_delta, ngx_pool_t *temp_pool)
 {
-    ngx_http_push_stream_shm_data_t        *data = mcf->shm_data;
     ngx_http_push_stream_msg_t             *msg;
-    ngx_uint_t                              qtd_removed;
+
+    if ((msg = ngx_http_push_stream_store_msg_on_channel(mcf, log, channel, text, len, event_id, event_type, message_key, opcode, store_messages, message_delta, temp_pool)) == NULL) {
+        return NGX_ERROR;
+    }
+
+    // messages published asynchronously by this worker and not broadcast yet go first
+    if (!ngx_http_push_stream_pending_broadcasts_event.posted || (ngx_http_push_stream_defer_broadcast(mcf, channel, msg, log) != NGX_OK)) {
+        // send an alert to workers
+        ngx_http_push_stream_broadcast(channel, msg, log, mcf);
+    }
+
+    // turn on timer to cleanup buffer of old messages
+    ngx_http_push_stream_buffer_cleanup_timer_set();
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_http_push_stream_add_msg_to_channel_async(ngx_http_push_stream_main_conf_t *mcf, ngx_log_t *log, ngx_http_push_stream_channel_t *channel, u_char *text, size_t len, ngx_str_t *event_id, ngx_str_t *event_type, ngx_str_t *message_key, ngx_uint_t opcode, ngx_flag_t store_messages, ngx_flag_t message_delta, ngx_pool_t *temp_pool)
+{
+    ngx_http_push_stream_msg_t             *msg;
+
+    if ((msg = ngx_http_push_stream_store_msg_on_channel(mcf, log, channel, text, len, event_id, event_type, message_key, opcode, store_messages, message_delta, temp_pool)) == NULL) {
+        return NGX_ERROR;
+    }
+
+    // the message is already on the channel, workers are alerted after the publisher got its response
+    if (ngx_http_push_stream_defer_broadcast(mcf, channel, msg, log) != NGX_OK) {
+        ngx_http_push_stream_broadcast(channel, msg, log, mcf);
+    }
+
+    // turn on timer to cleanup buffer of old messages
+    ngx_http_push_stream_buffer_cleanup_timer_set();
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_http_push_stream_set_channel_snapshot(ngx_http_push_stream_main_conf_t *mcf, ngx_log_t *log, ngx_http_push_stream_channel_t *channel, u_char *text, size_t len, ngx_str_t *event_id, ngx_str_t *event_type, ngx_uint_t opcode, ngx_pool_t *temp_pool)
+{
+    ngx_http_push_stream_msg_t             *msg, *old_snapshot;
+    ngx_uint_t                              last_message_id;
+
+    ngx_shmtx_lock(channel->mutex);
+    last_message_id = channel->last_message_id;
+    ngx_shmtx_unlock(channel->mutex);
+
+    // the snapshot covers the messages published until now, a message published concurrently is also sent after it
+    msg = ngx_http_push_stream_convert_char_to_msg_on_shared(mcf, text, len, channel, last_message_id, 0, event_id, event_type, opcode, temp_pool);
+    if (msg == NULL) {
+        ngx_log_error(NGX_LOG_ERR, log, 0, "push stream module: unable to allocate snapshot message in shared memory");
+        return NGX_ERROR;
+    }
+
+    msg->expires = msg->time + mcf->message_ttl;
+
+    ngx_shmtx_lock(channel->mutex);
+    old_snapshot = channel->snapshot_message;
+    channel->snapshot_message = msg;
+    channel->expires = ngx_time() + mcf->channel_inactivity_time;
+    ngx_shmtx_unlock(channel->mutex);
+
+    if (old_snapshot != NULL) {
+        ngx_http_push_stream_throw_the_message_away(old_snapshot, mcf->shm_data);
+    }
+
+    // turn on timer to cleanup buffer of old messages
+    ngx_http_push_stream_buffer_cleanup_timer_set();
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_push_stream_defer_broadcast(ngx_http_push_stream_main_conf_t *mcf, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *msg, ngx_log_t *log)
+{
+    ngx_event_t                                *ev = &ngx_http_push_stream_pending_broadcasts_event;
+    ngx_http_push_stream_pending_broadcast_t   *pending;
+
+    if ((pending = ngx_alloc(sizeof(ngx_http_push_stream_pending_broadcast_t), log)) == NULL) {
+        return NGX_ERROR;
+    }
+
+    pending->mcf = mcf;
+    pending->channel = channel;
+    pending->msg = msg;
+    ngx_queue_insert_tail(&ngx_http_push_stream_pending_broadcasts, &pending->queue);
+
+    if (ev->handler == NULL) {
+        ev->handler = ngx_http_push_stream_pending_broadcasts_handler;
+        ev->data = ev; //set event as data to avoid error when running on debug mode (on log event)
+        ev->log = ngx_cycle->log;
+    }
+
+    if (!ev->posted) {
+        ngx_post_event(ev, &ngx_posted_events);
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_push_stream_pending_broadcasts_handler(ngx_event_t *ev)
+{
+    ngx_http_push_stream_pending_broadcast_t   *pending;
+    ngx_queue_t                                *q;
+
+    // each worker is alerted once for all messages published since the last run
+    ngx_http_push_stream_defer_worker_alerts();
+
+    while (!ngx_queue_empty(&ngx_http_push_stream_pending_broadcasts)) {
+        q = ngx_queue_head(&ngx_http_push_stream_pending_broadcasts);
+        pending = ngx_queue_data(q, ngx_http_push_stream_pending_broadcast_t, queue);
+        ngx_queue_remove(q);
+
+        ngx_http_push_stream_broadcast(pending->channel, pending->msg, ev->log, pending->mcf);
+        ngx_free(pending);
+    }
+
+    ngx_http_push_stream_send_deferred_worker_alerts(ev->log);
+}
+
+
+static void
+ngx_http_push_stream_flush_pending_broadcasts(void)
+{
+    ngx_event_t                                *ev = &ngx_http_push_stream_pending_broadcasts_event;
+
+    if (ev->posted) {
+        ngx_delete_posted_event(ev);
+        ngx_http_push_stream_pending_broadcasts_handler(ev);
+    }
+}
+
+
+static uint64_t
+ngx_http_push_stream_monotonic_usec(void)
+{
+#if (NGX_HAVE_CLOCK_MONOTONIC)
+    struct timespec                         ts;
+
+    // the wall clock may step backwards, the monotonic one does not
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    struct timeval                          tv;
+
+    ngx_gettimeofday(&tv);
+
+    return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+
+static void
+ngx_http_push_stream_update_publish_latency(ngx_http_push_stream_main_conf_t *mcf, uint64_t start)
+{
+    uint64_t                                now = ngx_http_push_stream_monotonic_usec();
+
+    ngx_atomic_fetch_add(&mcf->shm_data->publish_requests, 1);
+    ngx_atomic_fetch_add(&mcf->shm_data->publish_latency, (now > start) ? (ngx_atomic_int_t) (now - start) : 0);
+}
+
+
+static ngx_http_push_stream_msg_t *
+ngx_http_push_stream_store_msg_on_channel(ngx_http_push_stream_main_conf_t *mcf, ngx_log_t *log, ngx_http_push_stream_channel_t *channel, u_char *text, size_t len, ngx_str_t *event_id, ngx_str_t *event_type, ngx_str_t *message_key, ngx_uint_t opcode, ngx_flag_t store_messages, ngx_flag_t message_delta, ngx_pool_t *temp_pool)
+{
+    ngx_http_push_stream_shm_data_t        *data = mcf->shm_data;
+    ngx_http_push_stream_msg_t             *msg, *stale_delta = NULL;
+    ngx_uint_t                              qtd_removed, qtd_compacted = 0;
 
     // create a buffer copy in shared mem
-    msg = ngx_http_push_stream_convert_char_to_msg_on_shared(mcf, text, len, channel, channel->last_message_id + 1, event_id, event_type, temp_pool);
+    msg = ngx_http_push_stream_convert_char_to_msg_on_shared(mcf, text, len, channel, channel->last_message_id + 1, 0, event_id, event_type, opcode, temp_pool);
     if (msg == NULL) {
         ngx_log_error(NGX_LOG_ERR, log, 0, "push stream module: unable to allocate message in shared memory");
-        return NGX_ERROR;
+        return NULL;
+    }
+
+    // only stored messages are compacted
+    if (store_messages && (message_key != NULL) && (message_key->len > 0)) {
+        if ((msg->key.data = ngx_slab_alloc(mcf->shpool, message_key->len)) == NULL) {
+            ngx_log_error(NGX_LOG_ERR, log, 0, "push stream module: unable to allocate message key in shared memory");
+            ngx_http_push_stream_free_message_memory(mcf->shpool, msg);
+            return NULL;
+        }
+        msg->key.len = message_key->len;
+        ngx_memcpy(msg->key.data, message_key->data, message_key->len);
+    }
+
+    // subscribers in sequence may receive only the changes from the previous message
+    if (store_messages && message_delta && (opcode == NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE)) {
+        msg->delta = ngx_http_push_stream_create_message_delta(mcf, channel, msg, event_id, event_type, temp_pool);
     }
 
     ngx_shmtx_lock(channel->mutex);
+    // the delta is useless if other message was published meanwhile
+    if ((msg->delta != NULL) && ((channel->last_message_id != (ngx_uint_t) msg->delta->delta_base) || (msg->id != msg->delta->delta_base + 1))) {
+        stale_delta = msg->delta;
+        msg->delta = NULL;
+    }
+
     channel->last_message_id++;
 
-    // tag message with time stamp and a sequence tag
-    channel->last_message_time = msg->time;
-    channel->last_message_tag = msg->tag;
+    // tag message with time stamp and a sequence tag, keeping the greatest one when workers publish concurrently
+    if ((msg->time > channel->last_message_time) || ((msg->time == channel->last_message_time) && (msg->tag > channel->last_message_tag))) {
+        NGX_HTTP_PUSH_STREAM_VERSION_WRITE_BEGIN(channel->last_message_version);
+        channel->last_message_time = msg->time;
+        channel->last_message_tag = msg->tag;
+        NGX_HTTP_PUSH_STREAM_VERSION_WRITE_END(channel->last_message_version);
+    }
     // set message expiration time
     msg->expires = msg->time + mcf->message_ttl;
     channel->expires = ngx_time() + mcf->channel_inactivity_time;
 
     // put messages on the queue
     if (store_messages) {
+        // the older message with the same key is replaced, backtrack and resume replay only the latest of each key
+        if (msg->key.len > 0) {
+            qtd_compacted = ngx_http_push_stream_remove_message_by_key_locked(data, channel, msg);
+        }
+
         ngx_queue_insert_tail(&channel->message_queue, &msg->queue);
         channel->stored_messages++;
     }
     ngx_shmtx_unlock(channel->mutex);
 
+    ngx_http_push_stream_free_message_memory(mcf->shpool, stale_delta);
+
     // now see if the queue is too big
-    qtd_removed = ngx_http_push_stream_ensure_qtd_of_messages(data, channel, mcf->max_messages_stored_per_channel, 0);
+    qtd_removed = qtd_compacted + ngx_http_push_stream_ensure_qtd_of_messages(data, channel, mcf->max_messages_stored_per_channel, 0);
 
     if (!channel->for_events) {
         ngx_shmtx_lock(&data->channels_queue_mutex);
@@ -423,13 +774,7 @@ ngx_http_push_stream_add_msg_to_channel(ngx_http_push_stream_main_conf_t *mcf, n
         ngx_shmtx_unlock(&data->channels_queue_mutex);
     }
 
-    // send an alert to workers
-    ngx_http_push_stream_broadcast(channel, msg, log, mcf);
-
-    // turn on timer to cleanup buffer of old messages
-    ngx_http_push_stream_buffer_cleanup_timer_set();
-
-    return NGX_OK;
+    return msg;
 }
 
 
@@ -447,7 +792,7 @@ ngx_http_push_stream_send_event(ngx_http_push_stream_main_conf_t *mcf, ngx_log_t
         ngx_str_t *event = ngx_http_push_stream_create_str(temp_pool, len);
         if (event != NULL) {
             ngx_sprintf(event->data, NGX_HTTP_PUSH_STREAM_EVENT_TEMPLATE, event_type, &channel->id);
-            ngx_http_push_stream_add_msg_to_channel(mcf, log, mcf->events_channel, event->data, ngx_strlen(event->data), NULL, event_type, 1, temp_pool);
+            ngx_http_push_stream_add_msg_to_channel(mcf, log, mcf->events_channel, event->data, ngx_strlen(event->data), NULL, event_type, NULL, NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE, 1, 0, temp_pool);
         }
     }
 
@@ -564,8 +909,28 @@ ngx_http_push_stream_send_response_message(ngx_http_request_t *r, ngx_http_push_
     ngx_http_push_stream_loc_conf_t       *pslcf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
     ngx_http_push_stream_module_ctx_t     *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
     ngx_flag_t                             use_jsonp = (ctx != NULL) && (ctx->callback != NULL);
+    ngx_flag_t                             hold_output = (ctx != NULL) && !ctx->hold_output;
+    ngx_http_push_stream_subscription_t   *subscription = NULL;
+    ngx_int_t                              message_id = msg->id;
     ngx_int_t rc = NGX_OK;
 
+    // subscribers accepting deltas which received the previous message of the channel get only the changes
+    if ((ctx != NULL) && ctx->accept_delta && (channel != NULL) && (msg->id > 0) && ((subscription = ngx_http_push_stream_get_channel_subscription(ctx, channel)) != NULL)) {
+        if ((msg->delta != NULL) && (subscription->last_message_id == msg->delta->delta_base)) {
+            msg = msg->delta;
+        }
+
+        // the snapshot is not a message of the sequence
+        if (msg == channel->snapshot_message) {
+            message_id = 0;
+        }
+    }
+
+    // all pieces of the message are sent to the socket at once
+    if (hold_output) {
+        ctx->hold_output = 1;
+    }
+
     if (pslcf->location_type == NGX_HTTP_PUSH_STREAM_SUBSCRIBER_MODE_EVENTSOURCE) {
         if (msg->event_id_message != NULL) {
             rc = ngx_http_push_stream_send_response_text(r, msg->event_id_message->data, msg->event_id_message->len, 0);
@@ -607,10 +972,42 @@ ngx_http_push_stream_send_response_message(ngx_http_request_t *r, ngx_http_push_
         }
     }
 
+    if (hold_output) {
+        ctx->hold_output = 0;
+        if ((rc == NGX_OK) && !ngx_http_push_stream_is_coalescing_output(pslcf, ctx)) {
+            rc = ngx_http_push_stream_flush_coalesced_output(r);
+        }
+    }
+
+    if (subscription != NULL) {
+        subscription->last_message_id = (rc == NGX_OK) ? message_id : 0;
+    }
+
     return rc;
 }
 
 
+static ngx_http_push_stream_subscription_t *
+ngx_http_push_stream_get_channel_subscription(ngx_http_push_stream_module_ctx_t *ctx, ngx_http_push_stream_channel_t *channel)
+{
+    ngx_http_push_stream_subscription_t   *subscription;
+    ngx_queue_t                           *q;
+
+    if (ctx->subscriber == NULL) {
+        return NULL;
+    }
+
+    for (q = ngx_queue_head(&ctx->subscriber->subscriptions); q != ngx_queue_sentinel(&ctx->subscriber->subscriptions); q = ngx_queue_next(q)) {
+        subscription = ngx_queue_data(q, ngx_http_push_stream_subscription_t, queue);
+        if (subscription->channel == channel) {
+            return subscription;
+        }
+    }
+
+    return NULL;
+}
+
+
 ngx_chain_t *
 ngx_http_push_stream_get_buf(ngx_http_request_t *r)
 {
@@ -756,6 +1153,11 @@ ngx_http_push_stream_flush_pending_output(ngx_http_request_t *r)
     ngx_log_debug2(NGX_LOG_DEBUG_HTTP, wev->log, 0, "push stream module http writer done: \"%V?%V\"", &r->uri, &r->args);
 
     r->write_event_handler = ngx_http_request_empty_handler;
+
+    // the client caught up, messages held by the pending output limits can be sent now
+    if (ngx_http_push_stream_send_deferred_messages(r) != NGX_OK) {
+        ngx_http_push_stream_send_response_finalize(r);
+    }
 }
 
 
@@ -786,13 +1188,25 @@ ngx_http_push_stream_send_response(ngx_http_request_t *r, ngx_str_t *text, const
 static ngx_int_t
 ngx_http_push_stream_send_response_text(ngx_http_request_t *r, const u_char *text, uint len, ngx_flag_t last_buffer)
 {
-    ngx_buf_t     *b;
-    ngx_chain_t   *out;
+    ngx_http_push_stream_loc_conf_t       *pslcf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_module_ctx_t     *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+    ngx_buf_t                             *b;
+    ngx_chain_t                           *out;
+    u_char                                *p;
 
     if ((text == NULL) || (r->connection->error)) {
         return NGX_ERROR;
     }
 
+    // keep a copy of the polling response being rendered to reuse it on identical requests
+    if ((ctx != NULL) && (ctx->polling_response != NULL) && (len > 0)) {
+        if ((p = ngx_array_push_n(ctx->polling_response, len)) == NULL) {
+            ctx->polling_response = NULL;
+        } else {
+            ngx_memcpy(p, text, len);
+        }
+    }
+
     out = ngx_http_push_stream_get_buf(r);
     if (out == NULL) {
         return NGX_ERROR;
@@ -812,60 +1226,584 @@ ngx_http_push_stream_send_response_text(ngx_http_request_t *r, const u_char *tex
 
     out->next = NULL;
 
-    return ngx_http_push_stream_output_filter(r, out);
-}
-
+    if (ctx == NULL) {
+        return ngx_http_push_stream_output_filter(r, out);
+    }
 
-static ngx_int_t
-ngx_http_push_stream_send_response_padding(ngx_http_request_t *r, size_t len, ngx_flag_t sending_header)
-{
-    ngx_http_push_stream_module_ctx_t *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
-    ngx_http_push_stream_loc_conf_t   *pslcf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
-    ngx_flag_t eventsource = (pslcf->location_type == NGX_HTTP_PUSH_STREAM_SUBSCRIBER_MODE_EVENTSOURCE);
+    // only registered streaming subscribers hold their output between messages
+    if (!last_buffer && (ctx->hold_output || ngx_http_push_stream_is_coalescing_output(pslcf, ctx))) {
+        return ngx_http_push_stream_coalesce_output(r, ctx, out, pslcf);
+    }
 
-    if (ctx->padding != NULL) {
-        ngx_int_t diff = ((sending_header) ? ctx->padding->header_min_len : ctx->padding->message_min_len) - len;
-        if (diff > 0) {
-            ngx_int_t padding_index = diff / 100;
-            ngx_str_t *padding = eventsource ? ngx_http_push_stream_module_paddings_chunks_for_eventsource[padding_index] : ngx_http_push_stream_module_paddings_chunks[padding_index];
-            ngx_http_push_stream_send_response_text(r, padding->data, padding->len, 0);
-        }
+    // pending buffers must be sent before this one to keep the order
+    if (ctx->pending != NULL) {
+        ctx->pending_last->next = out;
+        out = ctx->pending;
+        ngx_http_push_stream_remove_coalesced_output(ctx);
     }
 
-    return NGX_OK;
+    return ngx_http_push_stream_output_filter(r, out);
 }
 
 
-
 static void
-ngx_http_push_stream_run_cleanup_pool_handler(ngx_pool_t *p, ngx_pool_cleanup_pt handler)
+ngx_http_push_stream_remove_coalesced_output(ngx_http_push_stream_module_ctx_t *ctx)
 {
-    ngx_pool_cleanup_t       *c;
-
-    if (p == NULL) {
-        return;
+    if (ctx->pending != NULL) {
+        ngx_queue_remove(&ctx->pending_queue);
+        ngx_queue_init(&ctx->pending_queue);
     }
 
-    for (c = p->cleanup; c; c = c->next) {
-        if ((c->handler == handler) && (c->data != NULL)) {
-            c->handler(c->data);
-            return;
-        }
-    }
+    ctx->pending = NULL;
+    ctx->pending_last = NULL;
+    ctx->pending_size = 0;
 }
 
-/**
- * Should never be called inside a locked block
- * */
-static void
-ngx_http_push_stream_send_response_finalize(ngx_http_request_t *r)
+
+static ngx_int_t
+ngx_http_push_stream_coalesce_output(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx, ngx_chain_t *out, ngx_http_push_stream_loc_conf_t *pslcf)
 {
-    ngx_http_push_stream_loc_conf_t *pslcf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
-    ngx_int_t                        rc = NGX_OK;
+    ngx_event_t                           *ev = &ngx_http_push_stream_output_coalescing_event;
+    ngx_http_push_stream_module_ctx_t     *cur;
+    ngx_queue_t                           *q;
+
+    out->buf->flush = 0;
+
+    if ((ctx->pending == NULL) && ngx_http_push_stream_is_coalescing_output(pslcf, ctx)) {
+        ctx->pending = out;
+        ctx->pending_flush_time = ngx_current_msec + pslcf->output_coalescing_delay;
+
+        // keep the queue ordered by flush time, locations may have different delays
+        for (q = ngx_queue_last(&ngx_http_push_stream_output_coalescing_queue); q != ngx_queue_sentinel(&ngx_http_push_stream_output_coalescing_queue); q = ngx_queue_prev(q)) {
+            cur = ngx_queue_data(q, ngx_http_push_stream_module_ctx_t, pending_queue);
+            if ((ngx_msec_int_t) (cur->pending_flush_time - ctx->pending_flush_time) <= 0) {
+                break;
+            }
+        }
+        ngx_queue_insert_after(q, &ctx->pending_queue);
+
+        if (ev->handler == NULL) {
+            ev->handler = ngx_http_push_stream_output_coalescing_timer_wake_handler;
+            ev->data = ev; //set event as data to avoid error when running on debug mode (on log event)
+            ev->log = ngx_cycle->log;
+        }
+
+        if (ev->timer_set && ((ngx_msec_int_t) (ev->timer.key - ctx->pending_flush_time) > 0)) {
+            ngx_del_timer(ev);
+        }
+
+        if (!ev->timer_set) {
+            ngx_add_timer(ev, pslcf->output_coalescing_delay);
+        }
+    } else if (ctx->pending == NULL) {
+        ctx->pending = out;
+    } else {
+        ctx->pending_last->next = out;
+    }
+
+    ctx->pending_last = out;
+    ctx->pending_size += ngx_buf_size(out->buf);
+
+    if ((pslcf->output_coalescing_size != NGX_CONF_UNSET_SIZE) && (ctx->pending_size >= pslcf->output_coalescing_size)) {
+        return ngx_http_push_stream_flush_coalesced_output(r);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_push_stream_flush_coalesced_output(ngx_http_request_t *r)
+{
+    ngx_http_push_stream_module_ctx_t     *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+    ngx_chain_t                           *out;
+
+    if ((ctx == NULL) || (ctx->pending == NULL)) {
+        return NGX_OK;
+    }
+
+    out = ctx->pending;
+    ctx->pending_last->buf->flush = 1;
+    ngx_http_push_stream_remove_coalesced_output(ctx);
+
+    if (r->connection->error) {
+        return NGX_ERROR;
+    }
+
+    return ngx_http_push_stream_output_filter(r, out);
+}
+
+
+static size_t
+ngx_http_push_stream_pending_output_size(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx)
+{
+    ngx_chain_t                           *cl;
+    size_t                                 size = ctx->pending_size;
+
+    // data not accepted by the socket yet is kept by the write filter
+    for (cl = r->out; cl != NULL; cl = cl->next) {
+        size += ngx_buf_size(cl->buf);
+    }
+
+    return size;
+}
+
+
+static ngx_int_t
+ngx_http_push_stream_check_pending_output(ngx_http_request_t *r, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *msg)
+{
+    ngx_http_push_stream_main_conf_t      *mcf = ngx_http_get_module_main_conf(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_loc_conf_t       *pslcf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_module_ctx_t     *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+    ngx_slab_pool_t                       *shpool = mcf->shpool;
+    size_t                                 size;
+
+    if ((ctx == NULL) || !ngx_http_push_stream_is_limiting_pending_output(pslcf)) {
+        return NGX_OK;
+    }
+
+    if (!(r->connection->buffered & NGX_HTTP_LOWLEVEL_BUFFERED)) {
+        ctx->pending_messages = 0;
+        if (ngx_http_push_stream_send_deferred_messages(r) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    if (pslcf->pending_output_policy != NGX_HTTP_PUSH_STREAM_PENDING_OUTPUT_DISCONNECT) {
+        // keep the messages out of the connection while the client is not reading
+        if ((r->connection->buffered & NGX_HTTP_LOWLEVEL_BUFFERED) || !ngx_queue_empty(&ctx->deferred_messages)) {
+            return ngx_http_push_stream_defer_message(r, ctx, channel, msg, pslcf);
+        }
+
+        return NGX_OK;
+    }
+
+    size = ngx_http_push_stream_pending_output_size(r, ctx) + ngx_http_push_stream_get_formatted_message(r, channel, msg)->len;
+    if (((pslcf->max_pending_output_size != NGX_CONF_UNSET_SIZE) && (size > pslcf->max_pending_output_size)) ||
+        ((pslcf->max_pending_output_messages != NGX_CONF_UNSET_UINT) && (ctx->pending_messages >= pslcf->max_pending_output_messages))) {
+
+        ngx_log_error(NGX_LOG_INFO, r->connection->log, 0, "push stream module: disconnecting slow subscriber, %uz bytes and %ui messages pending", size, ctx->pending_messages);
+
+        ngx_shmtx_lock(&shpool->mutex);
+        mcf->shm_data->slow_subscribers_disconnected++;
+        ngx_shmtx_unlock(&shpool->mutex);
+
+        r->keepalive = 0;
+        r->connection->error = 1;
+        return NGX_ERROR;
+    }
+
+    ctx->pending_messages++;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_push_stream_defer_message(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *msg, ngx_http_push_stream_loc_conf_t *pslcf)
+{
+    ngx_http_push_stream_main_conf_t      *mcf = ngx_http_get_module_main_conf(r, ngx_http_push_stream_module);
+    ngx_slab_pool_t                       *shpool = mcf->shpool;
+    ngx_http_push_stream_deferred_msg_t   *deferred;
+    ngx_queue_t                           *q;
+    ngx_uint_t                             dropped = 0;
+    size_t                                 pending_size;
+
+    // only the newest message of each channel is kept
+    if (pslcf->pending_output_policy == NGX_HTTP_PUSH_STREAM_PENDING_OUTPUT_CONFLATE) {
+        for (q = ngx_queue_head(&ctx->deferred_messages); q != ngx_queue_sentinel(&ctx->deferred_messages); q = ngx_queue_next(q)) {
+            deferred = ngx_queue_data(q, ngx_http_push_stream_deferred_msg_t, queue);
+            if (deferred->channel == channel) {
+                ngx_http_push_stream_release_deferred_message(r, ctx, deferred);
+                dropped++;
+                break;
+            }
+        }
+    }
+
+    if (ngx_http_push_stream_hold_message(r, ctx, channel, msg) == NULL) {
+        return NGX_ERROR;
+    }
+
+    // drop the oldest messages, but always keep the newest one
+    pending_size = ngx_http_push_stream_pending_output_size(r, ctx);
+    while (ctx->deferred_qtd > 1) {
+        if (((pslcf->max_pending_output_size == NGX_CONF_UNSET_SIZE) || ((pending_size + ctx->deferred_size) <= pslcf->max_pending_output_size)) &&
+            ((pslcf->max_pending_output_messages == NGX_CONF_UNSET_UINT) || (ctx->deferred_qtd <= pslcf->max_pending_output_messages))) {
+            break;
+        }
+
+        deferred = ngx_queue_data(ngx_queue_head(&ctx->deferred_messages), ngx_http_push_stream_deferred_msg_t, queue);
+        ngx_http_push_stream_release_deferred_message(r, ctx, deferred);
+        dropped++;
+    }
+
+    if (dropped > 0) {
+        ngx_shmtx_lock(&shpool->mutex);
+        mcf->shm_data->slow_subscribers_dropped_messages += dropped;
+        ngx_shmtx_unlock(&shpool->mutex);
+    }
+
+    return NGX_DECLINED;
+}
+
+
+static ngx_http_push_stream_deferred_msg_t *
+ngx_http_push_stream_hold_message(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *msg)
+{
+    ngx_http_push_stream_deferred_msg_t   *deferred;
+
+    if ((deferred = ngx_http_push_stream_ref_message(r, ctx, channel, msg)) == NULL) {
+        return NULL;
+    }
+
+    ngx_queue_insert_tail(&ctx->deferred_messages, &deferred->queue);
+    ctx->deferred_qtd++;
+    ctx->deferred_size += deferred->len;
+
+    return deferred;
+}
+
+
+static ngx_http_push_stream_deferred_msg_t *
+ngx_http_push_stream_ref_message(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *msg)
+{
+    ngx_http_push_stream_main_conf_t      *mcf = ngx_http_get_module_main_conf(r, ngx_http_push_stream_module);
+    ngx_slab_pool_t                       *shpool = mcf->shpool;
+    ngx_http_push_stream_deferred_msg_t   *deferred;
+    ngx_str_t                             *formatted;
+    ngx_queue_t                           *q;
+
+    if ((formatted = ngx_http_push_stream_get_formatted_message(r, channel, msg)) == NULL) {
+        return NULL;
+    }
+
+    if (!ngx_queue_empty(&ctx->deferred_free)) {
+        q = ngx_queue_head(&ctx->deferred_free);
+        ngx_queue_remove(q);
+        deferred = ngx_queue_data(q, ngx_http_push_stream_deferred_msg_t, queue);
+    } else if ((deferred = ngx_palloc(r->pool, sizeof(ngx_http_push_stream_deferred_msg_t))) == NULL) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate memory to defer message");
+        return NULL;
+    }
+
+    // the message must stay on shared memory until it is sent or dropped
+    ngx_shmtx_lock(&shpool->mutex);
+    msg->workers_ref_count++;
+    ngx_shmtx_unlock(&shpool->mutex);
+
+    deferred->channel = channel;
+    deferred->msg = msg;
+    deferred->len = formatted->len;
+
+    return deferred;
+}
+
+
+static void
+ngx_http_push_stream_linger_message(ngx_http_request_t *r, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *msg)
+{
+    ngx_http_push_stream_loc_conf_t       *pslcf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_module_ctx_t     *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+
+    if (ngx_http_push_stream_hold_message(r, ctx, channel, msg) == NULL) {
+        ngx_http_push_stream_send_lingering_messages(r);
+        return;
+    }
+
+    if ((pslcf->longpolling_linger_messages != NGX_CONF_UNSET_UINT) && (ctx->deferred_qtd >= pslcf->longpolling_linger_messages)) {
+        ngx_http_push_stream_send_lingering_messages(r);
+        return;
+    }
+
+    if (ctx->deferred_qtd > 1) {
+        return;
+    }
+
+    // the first message starts the window, the connection ttl does not apply anymore
+    ngx_http_push_stream_wheel_timer_del(ctx->disconnect_timer);
+
+    if ((ctx->linger_timer == NULL) && ((ctx->linger_timer = ngx_pcalloc(r->pool, sizeof(ngx_event_t))) == NULL)) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate memory for linger timer");
+        ngx_http_push_stream_send_lingering_messages(r);
+        return;
+    }
+
+    ctx->linger_timer->handler = ngx_http_push_stream_linger_timer_wake_handler;
+    ctx->linger_timer->data = r;
+    ctx->linger_timer->log = r->connection->log;
+    ngx_http_push_stream_timer_reset(pslcf->longpolling_linger_time, ctx->linger_timer);
+}
+
+
+static void
+ngx_http_push_stream_linger_timer_wake_handler(ngx_event_t *ev)
+{
+    ngx_http_push_stream_send_lingering_messages((ngx_http_request_t *) ev->data);
+}
+
+
+static void
+ngx_http_push_stream_send_lingering_messages(ngx_http_request_t *r)
+{
+    ngx_http_push_stream_loc_conf_t       *pslcf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_module_ctx_t     *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_deferred_msg_t   *deferred;
+    ngx_queue_t                           *q;
+    time_t                                 last_message_time = 0;
+    ngx_int_t                              last_message_tag = 0;
+    ngx_int_t                              rc = NGX_OK;
+
+    // the response headers point to the newest message, the next request resumes after it
+    for (q = ngx_queue_head(&ctx->deferred_messages); q != ngx_queue_sentinel(&ctx->deferred_messages); q = ngx_queue_next(q)) {
+        deferred = ngx_queue_data(q, ngx_http_push_stream_deferred_msg_t, queue);
+        if ((deferred->msg->time > last_message_time) || ((deferred->msg->time == last_message_time) && (deferred->msg->tag > last_message_tag))) {
+            last_message_time = deferred->msg->time;
+            last_message_tag = deferred->msg->tag;
+        }
+    }
+
+    ngx_http_push_stream_add_polling_headers(r, last_message_time, last_message_tag, r->pool);
+    ngx_http_send_header(r);
+
+    ngx_http_push_stream_send_response_content_header(r, pslcf);
+
+    if (ctx->callback != NULL) {
+        ngx_http_push_stream_send_response_text(r, ctx->callback->data, ctx->callback->len, 0);
+        ngx_http_push_stream_send_response_text(r, NGX_HTTP_PUSH_STREAM_CALLBACK_INIT_CHUNK.data, NGX_HTTP_PUSH_STREAM_CALLBACK_INIT_CHUNK.len, 0);
+    }
+
+    // messages are released by the request cleanup on finalize
+    for (q = ngx_queue_head(&ctx->deferred_messages); (rc == NGX_OK) && (q != ngx_queue_sentinel(&ctx->deferred_messages)); q = ngx_queue_next(q)) {
+        deferred = ngx_queue_data(q, ngx_http_push_stream_deferred_msg_t, queue);
+        rc = ngx_http_push_stream_send_response_message(r, deferred->channel, deferred->msg, 0, (q != ngx_queue_head(&ctx->deferred_messages)));
+    }
+
+    if (ctx->callback != NULL) {
+        ngx_http_push_stream_send_response_text(r, NGX_HTTP_PUSH_STREAM_CALLBACK_END_CHUNK.data, NGX_HTTP_PUSH_STREAM_CALLBACK_END_CHUNK.len, 0);
+    }
+
+    ngx_http_push_stream_send_response_finalize(r);
+}
+
+
+static ngx_int_t
+ngx_http_push_stream_send_deferred_messages(ngx_http_request_t *r)
+{
+    ngx_http_push_stream_module_ctx_t     *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_deferred_msg_t   *deferred;
+    ngx_int_t                              rc = NGX_OK;
+
+    if (ctx == NULL) {
+        return NGX_OK;
+    }
+
+    ctx->pending_messages = 0;
+
+    while (!ngx_queue_empty(&ctx->deferred_messages) && !(r->connection->buffered & NGX_HTTP_LOWLEVEL_BUFFERED)) {
+        deferred = ngx_queue_data(ngx_queue_head(&ctx->deferred_messages), ngx_http_push_stream_deferred_msg_t, queue);
+        rc = ngx_http_push_stream_send_response_message(r, deferred->channel, deferred->msg, 0, 0);
+        ngx_http_push_stream_release_deferred_message(r, ctx, deferred);
+        if (rc != NGX_OK) {
+            return rc;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_push_stream_release_deferred_message(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx, ngx_http_push_stream_deferred_msg_t *deferred)
+{
+    ctx->deferred_qtd--;
+    ctx->deferred_size -= deferred->len;
+    ngx_http_push_stream_unref_message(r, ctx, deferred);
+}
+
+
+static void
+ngx_http_push_stream_unref_message(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx, ngx_http_push_stream_deferred_msg_t *deferred)
+{
+    ngx_http_push_stream_main_conf_t      *mcf = ngx_http_get_module_main_conf(r, ngx_http_push_stream_module);
+    ngx_slab_pool_t                       *shpool = mcf->shpool;
+
+    ngx_shmtx_lock(&shpool->mutex);
+    deferred->msg->workers_ref_count--;
+    if ((deferred->msg->workers_ref_count <= 0) && deferred->msg->deleted) {
+        deferred->msg->expires = ngx_time() + NGX_HTTP_PUSH_STREAM_DEFAULT_SHM_MEMORY_CLEANUP_OBJECTS_TTL;
+    }
+    ngx_shmtx_unlock(&shpool->mutex);
+
+    ngx_queue_remove(&deferred->queue);
+    ngx_queue_insert_tail(&ctx->deferred_free, &deferred->queue);
+}
+
+
+static ngx_int_t
+ngx_http_push_stream_check_message_rate(ngx_http_request_t *r, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *msg)
+{
+    ngx_http_push_stream_loc_conf_t       *pslcf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_module_ctx_t     *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_deferred_msg_t   *conflated;
+    ngx_queue_t                           *q;
+    ngx_msec_int_t                         delay;
+
+    // control messages, like ping and channel deleted, are never limited
+    if ((ctx == NULL) || (ctx->message_interval == 0) || (msg->id < 0)) {
+        return NGX_OK;
+    }
+
+    delay = (ngx_msec_int_t) (ctx->next_message_slot - ngx_current_msec);
+    if (ngx_queue_empty(&ctx->conflated_messages) && (delay <= 0)) {
+        ctx->next_message_slot = ngx_current_msec + ctx->message_interval;
+        return NGX_OK;
+    }
+
+    // only the newest message of each channel, or of each event id prefix, waits for the next slot
+    for (q = ngx_queue_head(&ctx->conflated_messages); q != ngx_queue_sentinel(&ctx->conflated_messages); q = ngx_queue_next(q)) {
+        conflated = ngx_queue_data(q, ngx_http_push_stream_deferred_msg_t, queue);
+        if ((conflated->channel == channel) && ngx_http_push_stream_same_conflation_key(pslcf, conflated->msg, msg)) {
+            ngx_http_push_stream_unref_message(r, ctx, conflated);
+            break;
+        }
+    }
+
+    if ((conflated = ngx_http_push_stream_ref_message(r, ctx, channel, msg)) == NULL) {
+        return NGX_ERROR;
+    }
+    ngx_queue_insert_tail(&ctx->conflated_messages, &conflated->queue);
+
+    if ((ctx->rate_timer == NULL) && ((ctx->rate_timer = ngx_pcalloc(r->pool, sizeof(ngx_event_t))) == NULL)) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate memory for message rate timer");
+        return NGX_ERROR;
+    }
+
+    if (!ctx->rate_timer->timer_set) {
+        ctx->rate_timer->handler = ngx_http_push_stream_rate_timer_wake_handler;
+        ctx->rate_timer->data = r;
+        ctx->rate_timer->log = r->connection->log;
+        ngx_http_push_stream_timer_reset((delay > 0) ? (ngx_msec_t) delay : 1, ctx->rate_timer);
+    }
+
+    return NGX_DECLINED;
+}
+
+
+static ngx_flag_t
+ngx_http_push_stream_same_conflation_key(ngx_http_push_stream_loc_conf_t *pslcf, ngx_http_push_stream_msg_t *msg, ngx_http_push_stream_msg_t *other)
+{
+    size_t                                 len, other_len;
+
+    if (pslcf->conflation_event_id_separator.len == 0) {
+        return 1;
+    }
+
+    len = ngx_http_push_stream_event_id_prefix_len(msg, &pslcf->conflation_event_id_separator);
+    other_len = ngx_http_push_stream_event_id_prefix_len(other, &pslcf->conflation_event_id_separator);
+
+    return (len == other_len) && ((len == 0) || (ngx_memcmp(msg->event_id->data, other->event_id->data, len) == 0));
+}
+
+
+static size_t
+ngx_http_push_stream_event_id_prefix_len(ngx_http_push_stream_msg_t *msg, ngx_str_t *separator)
+{
+    u_char                                *end;
+
+    if (msg->event_id == NULL) {
+        return 0;
+    }
+
+    // the event id up to the separator, or the whole id when it has none
+    end = (u_char *) ngx_strnstr(msg->event_id->data, (char *) separator->data, msg->event_id->len);
+
+    return (end != NULL) ? (size_t) (end - msg->event_id->data) : msg->event_id->len;
+}
+
+
+static void
+ngx_http_push_stream_rate_timer_wake_handler(ngx_event_t *ev)
+{
+    ngx_http_request_t                    *r = (ngx_http_request_t *) ev->data;
+    ngx_http_push_stream_loc_conf_t       *pslcf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_module_ctx_t     *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_deferred_msg_t   *conflated;
+    ngx_int_t                              rc = NGX_OK;
+
+    ctx->next_message_slot = ngx_current_msec + ctx->message_interval;
+
+    // the slow subscriber protection still applies to the messages sent on the slot
+    while (!ngx_queue_empty(&ctx->conflated_messages)) {
+        conflated = ngx_queue_data(ngx_queue_head(&ctx->conflated_messages), ngx_http_push_stream_deferred_msg_t, queue);
+        if ((rc == NGX_OK) && ((rc = ngx_http_push_stream_check_pending_output(r, conflated->channel, conflated->msg)) == NGX_OK)) {
+            rc = ngx_http_push_stream_send_response_message(r, conflated->channel, conflated->msg, 0, 0);
+        }
+        rc = (rc == NGX_DECLINED) ? NGX_OK : rc;
+        ngx_http_push_stream_unref_message(r, ctx, conflated);
+    }
+
+    if (rc != NGX_OK) {
+        ngx_http_push_stream_send_response_finalize(r);
+        return;
+    }
+
+    ngx_http_push_stream_wheel_timer_reset(pslcf->ping_message_interval, ctx->ping_timer);
+}
+
+
+static ngx_int_t
+ngx_http_push_stream_send_response_padding(ngx_http_request_t *r, size_t len, ngx_flag_t sending_header)
+{
+    ngx_http_push_stream_module_ctx_t *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_loc_conf_t   *pslcf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
+    ngx_flag_t eventsource = (pslcf->location_type == NGX_HTTP_PUSH_STREAM_SUBSCRIBER_MODE_EVENTSOURCE);
+
+    if (ctx->padding != NULL) {
+        ngx_int_t diff = ((sending_header) ? ctx->padding->header_min_len : ctx->padding->message_min_len) - len;
+        if (diff > 0) {
+            ngx_int_t padding_index = diff / 100;
+            ngx_str_t *padding = eventsource ? ngx_http_push_stream_module_paddings_chunks_for_eventsource[padding_index] : ngx_http_push_stream_module_paddings_chunks[padding_index];
+            ngx_http_push_stream_send_response_text(r, padding->data, padding->len, 0);
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+
+static void
+ngx_http_push_stream_run_cleanup_pool_handler(ngx_pool_t *p, ngx_pool_cleanup_pt handler)
+{
+    ngx_pool_cleanup_t       *c;
+
+    if (p == NULL) {
+        return;
+    }
+
+    for (c = p->cleanup; c; c = c->next) {
+        if ((c->handler == handler) && (c->data != NULL)) {
+            c->handler(c->data);
+            return;
+        }
+    }
+}
+
+/**
+ * Should never be called inside a locked block
+ * */
+static void
+ngx_http_push_stream_send_response_finalize(ngx_http_request_t *r)
+{
+    ngx_http_push_stream_loc_conf_t *pslcf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
+    ngx_int_t                        rc = NGX_OK;
 
     ngx_http_push_stream_run_cleanup_pool_handler(r->pool, (ngx_pool_cleanup_pt) ngx_http_push_stream_cleanup_request_context);
 
-    if (pslcf->footer_template.len > 0) {
+    rc = ngx_http_push_stream_flush_coalesced_output(r);
+
+    if ((rc == NGX_OK) && (pslcf->footer_template.len > 0)) {
         rc = ngx_http_push_stream_send_response_text(r, pslcf->footer_template.data, pslcf->footer_template.len, 0);
     }
 
@@ -885,13 +1823,19 @@ ngx_http_push_stream_send_response_finalize_for_longpolling_by_timeout(ngx_http_
 {
     ngx_http_push_stream_main_conf_t   *mcf = ngx_http_get_module_main_conf(r, ngx_http_push_stream_module);
 
+    // messages received on the linger window are not lost when the worker is shutting down
+    if (ngx_http_push_stream_is_lingering((ngx_http_push_stream_module_ctx_t *) ngx_http_get_module_ctx(r, ngx_http_push_stream_module))) {
+        ngx_http_push_stream_send_lingering_messages(r);
+        return;
+    }
+
     ngx_http_push_stream_run_cleanup_pool_handler(r->pool, (ngx_pool_cleanup_pt) ngx_http_push_stream_cleanup_request_context);
 
     ngx_http_push_stream_add_polling_headers(r, ngx_time(), 0, r->pool);
 
     if (mcf->timeout_with_body && (mcf->longpooling_timeout_msg == NULL)) {
         // create longpooling timeout message
-        if ((mcf->longpooling_timeout_msg == NULL) && (mcf->longpooling_timeout_msg = ngx_http_push_stream_convert_char_to_msg_on_shared(mcf, (u_char *) NGX_HTTP_PUSH_STREAM_LONGPOOLING_TIMEOUT_MESSAGE_TEXT, ngx_strlen(NGX_HTTP_PUSH_STREAM_LONGPOOLING_TIMEOUT_MESSAGE_TEXT), NULL, NGX_HTTP_PUSH_STREAM_LONGPOOLING_TIMEOUT_MESSAGE_ID, NULL, NULL, r->pool)) == NULL) {
+        if ((mcf->longpooling_timeout_msg == NULL) && (mcf->longpooling_timeout_msg = ngx_http_push_stream_convert_char_to_msg_on_shared(mcf, (u_char *) NGX_HTTP_PUSH_STREAM_LONGPOOLING_TIMEOUT_MESSAGE_TEXT, ngx_strlen(NGX_HTTP_PUSH_STREAM_LONGPOOLING_TIMEOUT_MESSAGE_TEXT), NULL, NGX_HTTP_PUSH_STREAM_LONGPOOLING_TIMEOUT_MESSAGE_ID, 0, NULL, NULL, NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE, r->pool)) == NULL) {
             ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate long pooling timeout message in shared memory");
         }
     }
@@ -938,7 +1882,9 @@ ngx_http_push_stream_delete_channel(ngx_http_push_stream_main_conf_t *mcf, ngx_h
         (channel->wildcard) ? NGX_HTTP_PUSH_STREAM_DECREMENT_COUNTER(data->wildcard_channels) : NGX_HTTP_PUSH_STREAM_DECREMENT_COUNTER(data->channels);
 
         // remove channel from tree
+        NGX_HTTP_PUSH_STREAM_VERSION_WRITE_BEGIN(data->tree_version);
         ngx_rbtree_delete(&data->tree, &channel->node);
+        NGX_HTTP_PUSH_STREAM_VERSION_WRITE_END(data->tree_version);
         // move the channel to unrecoverable queue
         ngx_queue_remove(&channel->queue);
 
@@ -947,7 +1893,7 @@ ngx_http_push_stream_delete_channel(ngx_http_push_stream_main_conf_t *mcf, ngx_h
         ngx_shmtx_unlock(&data->channels_to_delete_mutex);
 
         // apply channel deleted message text to message template
-        if ((channel->channel_deleted_message = ngx_http_push_stream_convert_char_to_msg_on_shared(mcf, text, len, channel, NGX_HTTP_PUSH_STREAM_CHANNEL_DELETED_MESSAGE_ID, NULL, NULL, temp_pool)) == NULL) {
+        if ((channel->channel_deleted_message = ngx_http_push_stream_convert_char_to_msg_on_shared(mcf, text, len, channel, NGX_HTTP_PUSH_STREAM_CHANNEL_DELETED_MESSAGE_ID, 0, NULL, NULL, NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE, temp_pool)) == NULL) {
             ngx_shmtx_unlock(&data->channels_queue_mutex);
             ngx_log_error(NGX_LOG_ERR, temp_pool->log, 0, "push stream module: unable to allocate memory to channel deleted message");
             return 0;
@@ -1004,13 +1950,15 @@ ngx_http_push_stream_collect_expired_messages_and_empty_channels_data(ngx_http_p
         channel = ngx_queue_data(q, ngx_http_push_stream_channel_t, queue);
         q = ngx_queue_next(q);
 
-        if ((channel->stored_messages == 0) && (channel->subscribers == 0) && (channel->expires < ngx_time()) && !channel->for_events) {
+        if ((channel->stored_messages == 0) && (channel->subscribers == 0) && (channel->expires < ngx_time()) && !channel->for_events && !ngx_http_push_stream_channel_has_snapshot(channel)) {
             channel->deleted = 1;
             channel->expires = ngx_time() + NGX_HTTP_PUSH_STREAM_DEFAULT_SHM_MEMORY_CLEANUP_OBJECTS_TTL;
             (channel->wildcard) ? NGX_HTTP_PUSH_STREAM_DECREMENT_COUNTER(data->wildcard_channels) : NGX_HTTP_PUSH_STREAM_DECREMENT_COUNTER(data->channels);
 
             // move the channel to trash queue
+            NGX_HTTP_PUSH_STREAM_VERSION_WRITE_BEGIN(data->tree_version);
             ngx_rbtree_delete(&data->tree, &channel->node);
+            NGX_HTTP_PUSH_STREAM_VERSION_WRITE_END(data->tree_version);
             ngx_queue_remove(&channel->queue);
             ngx_shmtx_lock(&data->channels_trash_mutex);
             ngx_queue_insert_tail(&data->channels_trash, &channel->queue);
@@ -1032,6 +1980,7 @@ static void
 ngx_http_push_stream_collect_expired_messages_data(ngx_http_push_stream_shm_data_t *data, ngx_flag_t force)
 {
     ngx_http_push_stream_channel_t         *channel;
+    ngx_http_push_stream_msg_t             *snapshot;
     ngx_queue_t                            *q;
     ngx_uint_t                              qtd_removed;
 
@@ -1042,6 +1991,19 @@ ngx_http_push_stream_collect_expired_messages_data(ngx_http_push_stream_shm_data
 
         qtd_removed = ngx_http_push_stream_ensure_qtd_of_messages(data, channel, (force) ? 0 : channel->stored_messages, 1);
         NGX_HTTP_PUSH_STREAM_DECREMENT_COUNTER_BY(data->stored_messages, qtd_removed);
+
+        // an expired snapshot is no longer sent, release its memory with the other expired messages
+        snapshot = NULL;
+        ngx_shmtx_lock(channel->mutex);
+        if ((channel->snapshot_message != NULL) && (force || !ngx_http_push_stream_channel_has_snapshot(channel))) {
+            snapshot = channel->snapshot_message;
+            channel->snapshot_message = NULL;
+        }
+        ngx_shmtx_unlock(channel->mutex);
+
+        if (snapshot != NULL) {
+            ngx_http_push_stream_throw_the_message_away(snapshot, data);
+        }
     }
 
     ngx_shmtx_unlock(&data->channels_queue_mutex);
@@ -1080,6 +2042,7 @@ nxg_http_push_stream_free_channel_memory(ngx_slab_pool_t *shpool, ngx_http_push_
     ngx_shmtx_t                          *mutex = channel->mutex;
 
     if (channel->channel_deleted_message != NULL) ngx_http_push_stream_free_message_memory(shpool, channel->channel_deleted_message);
+    if (channel->snapshot_message != NULL) ngx_http_push_stream_free_message_memory(shpool, channel->snapshot_message);
     ngx_shmtx_lock(mutex);
     while (!ngx_queue_empty(&channel->workers_with_subscribers)) {
         cur = ngx_queue_head(&channel->workers_with_subscribers);
@@ -1183,6 +2146,9 @@ ngx_http_push_stream_free_message_memory(ngx_slab_pool_t *shpool, ngx_http_push_
         return;
     }
 
+    // the delta is a message by itself, released before locking the pool
+    ngx_http_push_stream_free_message_memory(shpool, msg->delta);
+
     ngx_shmtx_lock(&shpool->mutex);
     if (msg->formatted_messages != NULL) {
         for (i = 0; i < msg->qtd_templates; i++) {
@@ -1192,112 +2158,420 @@ ngx_http_push_stream_free_message_memory(ngx_slab_pool_t *shpool, ngx_http_push_
             }
         }
 
-        ngx_slab_free_locked(shpool, msg->formatted_messages);
+        ngx_slab_free_locked(shpool, msg->formatted_messages);
+    }
+
+    if (msg->deflated_messages != NULL) {
+        for (i = 0; i < msg->qtd_templates; i++) {
+            ngx_str_t *deflated = (msg->deflated_messages + i);
+            if (deflated->data != NULL) {
+                ngx_slab_free_locked(shpool, deflated->data);
+            }
+        }
+
+        ngx_slab_free_locked(shpool, msg->deflated_messages);
+    }
+
+    if (msg->raw.data != NULL) ngx_slab_free_locked(shpool, msg->raw.data);
+    if (msg->event_id != NULL) ngx_slab_free_locked(shpool, msg->event_id);
+    if (msg->event_type != NULL) ngx_slab_free_locked(shpool, msg->event_type);
+    if (msg->event_id_message != NULL) ngx_slab_free_locked(shpool, msg->event_id_message);
+    if (msg->event_type_message != NULL) ngx_slab_free_locked(shpool, msg->event_type_message);
+    if (msg->key.data != NULL) ngx_slab_free_locked(shpool, msg->key.data);
+    if (msg->replaced_event_id != NULL) ngx_slab_free_locked(shpool, msg->replaced_event_id);
+    ngx_slab_free_locked(shpool, msg);
+    ngx_shmtx_unlock(&shpool->mutex);
+}
+
+
+static void
+ngx_http_push_stream_free_worker_message_memory(ngx_slab_pool_t *shpool, ngx_http_push_stream_worker_msg_t *worker_msg)
+{
+    ngx_shmtx_lock(&shpool->mutex);
+    worker_msg->msg->workers_ref_count--;
+    if ((worker_msg->msg->workers_ref_count <= 0) && worker_msg->msg->deleted) {
+        worker_msg->msg->expires = ngx_time() + NGX_HTTP_PUSH_STREAM_DEFAULT_SHM_MEMORY_CLEANUP_OBJECTS_TTL;
+    }
+    ngx_queue_remove(&worker_msg->queue);
+    ngx_slab_free_locked(shpool, worker_msg);
+    ngx_shmtx_unlock(&shpool->mutex);
+}
+
+
+static void
+ngx_http_push_stream_throw_the_message_away(ngx_http_push_stream_msg_t *msg, ngx_http_push_stream_shm_data_t *data)
+{
+    ngx_shmtx_lock(&data->channels_trash_mutex);
+    msg->deleted = 1;
+    msg->expires = ngx_time() + NGX_HTTP_PUSH_STREAM_DEFAULT_SHM_MEMORY_CLEANUP_OBJECTS_TTL;
+    ngx_queue_insert_tail(&data->messages_trash, &msg->queue);
+    data->messages_in_trash++;
+    ngx_shmtx_unlock(&data->channels_trash_mutex);
+}
+
+
+static void
+ngx_http_push_stream_timer_set(ngx_msec_t timer_interval, ngx_event_t *event, ngx_event_handler_pt event_handler, ngx_flag_t start_timer)
+{
+    if ((timer_interval != NGX_CONF_UNSET_MSEC) && start_timer) {
+        if (event->handler == NULL) {
+            event->handler = event_handler;
+            event->data = event; //set event as data to avoid error when running on debug mode (on log event)
+            event->log = ngx_cycle->log;
+            ngx_http_push_stream_timer_reset(timer_interval, event);
+        }
+    }
+}
+
+
+static void
+ngx_http_push_stream_timer_reset(ngx_msec_t timer_interval, ngx_event_t *timer_event)
+{
+    if (!ngx_exiting && (timer_interval != NGX_CONF_UNSET_MSEC) && (timer_event != NULL)) {
+        if (timer_event->timedout) {
+            ngx_time_update();
+        }
+        ngx_add_timer(timer_event, timer_interval);
+    }
+}
+
+
+static void
+ngx_http_push_stream_timer_wheel_init(ngx_cycle_t *cycle)
+{
+    ngx_http_push_stream_timer_wheel_t *wheel = &ngx_http_push_stream_timer_wheel;
+    ngx_uint_t                          i;
+
+    for (i = 0; i < NGX_HTTP_PUSH_STREAM_TIMER_WHEEL_SLOTS; i++) {
+        ngx_queue_init(&wheel->slots[i]);
+    }
+
+    wheel->timers = 0;
+    wheel->next_tick = ngx_current_msec / NGX_HTTP_PUSH_STREAM_TIMER_WHEEL_RESOLUTION;
+    wheel->event.handler = ngx_http_push_stream_timer_wheel_wake_handler;
+    wheel->event.data = &wheel->event; //set event as data to avoid error when running on debug mode (on log event)
+    wheel->event.log = cycle->log;
+}
+
+
+static void
+ngx_http_push_stream_wheel_timer_reset(ngx_msec_t timer_interval, ngx_http_push_stream_timer_t *timer)
+{
+    ngx_http_push_stream_timer_wheel_t *wheel = &ngx_http_push_stream_timer_wheel;
+    ngx_msec_t                          tick;
+
+    if (ngx_exiting || (timer_interval == NGX_CONF_UNSET_MSEC) || (timer == NULL)) {
+        return;
+    }
+
+    if (timer->timer_set) {
+        ngx_queue_remove(&timer->queue);
+    } else {
+        timer->timer_set = 1;
+        wheel->timers++;
+    }
+
+    // rounding up the tick the timer never lands on a slot already visited by the current sweep
+    timer->expires = ngx_current_msec + timer_interval;
+    tick = (timer->expires + NGX_HTTP_PUSH_STREAM_TIMER_WHEEL_RESOLUTION - 1) / NGX_HTTP_PUSH_STREAM_TIMER_WHEEL_RESOLUTION;
+    ngx_queue_insert_tail(&wheel->slots[tick & (NGX_HTTP_PUSH_STREAM_TIMER_WHEEL_SLOTS - 1)], &timer->queue);
+
+    if (!wheel->event.timer_set) {
+        wheel->next_tick = ngx_current_msec / NGX_HTTP_PUSH_STREAM_TIMER_WHEEL_RESOLUTION;
+        ngx_add_timer(&wheel->event, NGX_HTTP_PUSH_STREAM_TIMER_WHEEL_RESOLUTION);
+    }
+}
+
+
+static void
+ngx_http_push_stream_wheel_timer_del(ngx_http_push_stream_timer_t *timer)
+{
+    if ((timer != NULL) && timer->timer_set) {
+        ngx_queue_remove(&timer->queue);
+        timer->timer_set = 0;
+        ngx_http_push_stream_timer_wheel.timers--;
+    }
+}
+
+
+static void
+ngx_http_push_stream_timer_wheel_wake_handler(ngx_event_t *ev)
+{
+    ngx_http_push_stream_timer_wheel_t *wheel = &ngx_http_push_stream_timer_wheel;
+    ngx_http_push_stream_timer_t       *timer;
+    ngx_queue_t                         expired, *slot, *q, *next;
+    ngx_msec_t                          now_tick = ngx_current_msec / NGX_HTTP_PUSH_STREAM_TIMER_WHEEL_RESOLUTION;
+    ngx_uint_t                          i;
+
+    ngx_queue_init(&expired);
+
+    // collect every timer due since the last sweep, a full turn visits all of them
+    for (i = 0; (i < NGX_HTTP_PUSH_STREAM_TIMER_WHEEL_SLOTS) && ((ngx_msec_int_t) (now_tick - wheel->next_tick) >= 0); i++, wheel->next_tick++) {
+        slot = &wheel->slots[wheel->next_tick & (NGX_HTTP_PUSH_STREAM_TIMER_WHEEL_SLOTS - 1)];
+        for (q = ngx_queue_head(slot); q != ngx_queue_sentinel(slot); q = next) {
+            next = ngx_queue_next(q);
+            timer = ngx_queue_data(q, ngx_http_push_stream_timer_t, queue);
+            if ((ngx_msec_int_t) (timer->expires - ngx_current_msec) <= 0) {
+                ngx_queue_remove(q);
+                ngx_queue_insert_tail(&expired, q);
+            }
+        }
+    }
+
+    if ((ngx_msec_int_t) (now_tick - wheel->next_tick) >= 0) {
+        wheel->next_tick = now_tick + 1;
+    }
+
+    // handlers may reset their own timers or delete timers still on the expired queue
+    while (!ngx_queue_empty(&expired)) {
+        q = ngx_queue_head(&expired);
+        timer = ngx_queue_data(q, ngx_http_push_stream_timer_t, queue);
+        ngx_http_push_stream_wheel_timer_del(timer);
+        timer->handler(timer);
+    }
+
+    if (!ngx_exiting && (wheel->timers > 0) && !wheel->event.timer_set) {
+        ngx_add_timer(&wheel->event, NGX_HTTP_PUSH_STREAM_TIMER_WHEEL_RESOLUTION);
+    }
+}
+
+
+static void
+ngx_http_push_stream_polling_cache_init(void)
+{
+    ngx_http_push_stream_polling_cache_t   *cache = &ngx_http_push_stream_polling_cache;
+    ngx_uint_t                              i;
+
+    for (i = 0; i < NGX_HTTP_PUSH_STREAM_POLLING_CACHE_BUCKETS; i++) {
+        ngx_queue_init(&cache->buckets[i]);
+    }
+
+    ngx_queue_init(&cache->lru);
+    cache->entries = 0;
+}
+
+
+static void
+ngx_http_push_stream_polling_cache_cleanup(void)
+{
+    ngx_http_push_stream_polling_cache_t   *cache = &ngx_http_push_stream_polling_cache;
+
+    while (!ngx_queue_empty(&cache->lru)) {
+        ngx_http_push_stream_polling_cache_remove(ngx_queue_data(ngx_queue_last(&cache->lru), ngx_http_push_stream_polling_cache_entry_t, lru));
+    }
+}
+
+
+static void
+ngx_http_push_stream_polling_cache_remove(ngx_http_push_stream_polling_cache_entry_t *entry)
+{
+    ngx_queue_remove(&entry->queue);
+    ngx_queue_remove(&entry->lru);
+    ngx_http_push_stream_polling_cache.entries--;
+    ngx_free(entry);
+}
+
+
+static ngx_str_t *
+ngx_http_push_stream_polling_cache_key(ngx_http_request_t *r, ngx_http_push_stream_requested_channel_t *requested_channels, time_t if_modified_since, ngx_int_t tag, ngx_str_t *last_event_id, ngx_pool_t *temp_pool)
+{
+    ngx_http_push_stream_loc_conf_t            *cf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_module_ctx_t          *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_requested_channel_t   *requested_channel;
+    ngx_str_t                                  *callback = (ctx->callback != NULL) ? ctx->callback : &NGX_HTTP_PUSH_STREAM_EMPTY;
+    ngx_str_t                                  *event_id = (last_event_id != NULL) ? last_event_id : &NGX_HTTP_PUSH_STREAM_EMPTY;
+    ngx_str_t                                  *key;
+    ngx_queue_t                                *q;
+    u_char                                     *last;
+    size_t                                      len;
+
+    // the location defines templates and content type, texts are prefixed by their length to keep keys unambiguous
+    len = 2 * NGX_PTR_SIZE + 6 * NGX_INT_T_LEN + 8 + r->exten.len + callback->len + event_id->len;
+    for (q = ngx_queue_head(&requested_channels->queue); q != ngx_queue_sentinel(&requested_channels->queue); q = ngx_queue_next(q)) {
+        requested_channel = ngx_queue_data(q, ngx_http_push_stream_requested_channel_t, queue);
+        len += 2 * NGX_INT_T_LEN + 3 + requested_channel->id->len;
+    }
+
+    if ((key = ngx_http_push_stream_create_str(temp_pool, len)) == NULL) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate memory for polling response cache key");
+        return NULL;
+    }
+
+    last = ngx_sprintf(key->data, "%p %T %i %uz:%V %uz:%V %uz:%V", cf, if_modified_since, tag, r->exten.len, &r->exten, callback->len, callback, event_id->len, event_id);
+    for (q = ngx_queue_head(&requested_channels->queue); q != ngx_queue_sentinel(&requested_channels->queue); q = ngx_queue_next(q)) {
+        requested_channel = ngx_queue_data(q, ngx_http_push_stream_requested_channel_t, queue);
+        last = ngx_sprintf(last, " %uz:%V/%ui", requested_channel->id->len, requested_channel->id, requested_channel->backtrack_messages);
+    }
+    key->len = last - key->data;
+
+    return key;
+}
+
+
+static ngx_http_push_stream_polling_cache_entry_t *
+ngx_http_push_stream_polling_cache_find(ngx_str_t *key, ngx_http_push_stream_requested_channel_t *requested_channels)
+{
+    ngx_http_push_stream_polling_cache_t           *cache = &ngx_http_push_stream_polling_cache;
+    ngx_http_push_stream_polling_cache_entry_t     *entry;
+    ngx_http_push_stream_polling_cache_channel_t   *cached;
+    ngx_http_push_stream_requested_channel_t       *requested_channel;
+    ngx_http_push_stream_channel_t                 *channel;
+    ngx_queue_t                                    *bucket, *q, *cur;
+    uint32_t                                        hash = ngx_crc32_short(key->data, key->len);
+
+    bucket = &cache->buckets[hash & (NGX_HTTP_PUSH_STREAM_POLLING_CACHE_BUCKETS - 1)];
+    for (q = ngx_queue_head(bucket); q != ngx_queue_sentinel(bucket); q = ngx_queue_next(q)) {
+        entry = ngx_queue_data(q, ngx_http_push_stream_polling_cache_entry_t, queue);
+        if ((entry->hash != hash) || (ngx_memn2cmp(entry->key.data, key->data, entry->key.len, key->len) != 0)) {
+            continue;
+        }
+
+        // the key has the channels in the requested order, the response is stale if any of them has changed
+        cached = entry->channels;
+        for (cur = ngx_queue_head(&requested_channels->queue); cur != ngx_queue_sentinel(&requested_channels->queue); cur = ngx_queue_next(cur), cached++) {
+            requested_channel = ngx_queue_data(cur, ngx_http_push_stream_requested_channel_t, queue);
+            channel = requested_channel->channel;
+            if ((channel != cached->channel) || channel->deleted || (channel->last_message_id != cached->last_message_id) ||
+                (channel->last_message_time != cached->last_message_time) || (channel->last_message_tag != cached->last_message_tag) ||
+                (channel->stored_messages != cached->stored_messages) || (ngx_http_push_stream_channel_valid_snapshot(channel) != cached->snapshot_message)) {
+                ngx_http_push_stream_polling_cache_remove(entry);
+                return NULL;
+            }
+        }
+
+        ngx_queue_remove(&entry->lru);
+        ngx_queue_insert_head(&cache->lru, &entry->lru);
+        return entry;
     }
 
-    if (msg->raw.data != NULL) ngx_slab_free_locked(shpool, msg->raw.data);
-    if (msg->event_id != NULL) ngx_slab_free_locked(shpool, msg->event_id);
-    if (msg->event_type != NULL) ngx_slab_free_locked(shpool, msg->event_type);
-    if (msg->event_id_message != NULL) ngx_slab_free_locked(shpool, msg->event_id_message);
-    if (msg->event_type_message != NULL) ngx_slab_free_locked(shpool, msg->event_type_message);
-    ngx_slab_free_locked(shpool, msg);
-    ngx_shmtx_unlock(&shpool->mutex);
+    return NULL;
 }
 
 
-static void
-ngx_http_push_stream_free_worker_message_memory(ngx_slab_pool_t *shpool, ngx_http_push_stream_worker_msg_t *worker_msg)
+static ngx_http_push_stream_polling_cache_channel_t *
+ngx_http_push_stream_polling_cache_snapshot(ngx_http_push_stream_requested_channel_t *requested_channels, ngx_uint_t *qtd_channels, ngx_pool_t *temp_pool)
 {
-    ngx_shmtx_lock(&shpool->mutex);
-    worker_msg->msg->workers_ref_count--;
-    if ((worker_msg->msg->workers_ref_count <= 0) && worker_msg->msg->deleted) {
-        worker_msg->msg->expires = ngx_time() + NGX_HTTP_PUSH_STREAM_DEFAULT_SHM_MEMORY_CLEANUP_OBJECTS_TTL;
+    ngx_http_push_stream_polling_cache_channel_t   *channels, *cached;
+    ngx_http_push_stream_requested_channel_t       *requested_channel;
+    ngx_queue_t                                    *q;
+    ngx_uint_t                                      qtd = 0;
+
+    for (q = ngx_queue_head(&requested_channels->queue); q != ngx_queue_sentinel(&requested_channels->queue); q = ngx_queue_next(q)) {
+        qtd++;
     }
-    ngx_queue_remove(&worker_msg->queue);
-    ngx_slab_free_locked(shpool, worker_msg);
-    ngx_shmtx_unlock(&shpool->mutex);
-}
 
+    if ((channels = ngx_palloc(temp_pool, qtd * sizeof(ngx_http_push_stream_polling_cache_channel_t))) == NULL) {
+        return NULL;
+    }
 
-static void
-ngx_http_push_stream_throw_the_message_away(ngx_http_push_stream_msg_t *msg, ngx_http_push_stream_shm_data_t *data)
-{
-    ngx_shmtx_lock(&data->channels_trash_mutex);
-    msg->deleted = 1;
-    msg->expires = ngx_time() + NGX_HTTP_PUSH_STREAM_DEFAULT_SHM_MEMORY_CLEANUP_OBJECTS_TTL;
-    ngx_queue_insert_tail(&data->messages_trash, &msg->queue);
-    data->messages_in_trash++;
-    ngx_shmtx_unlock(&data->channels_trash_mutex);
+    // taken before rendering, a message published meanwhile only makes the stored response stale
+    cached = channels;
+    for (q = ngx_queue_head(&requested_channels->queue); q != ngx_queue_sentinel(&requested_channels->queue); q = ngx_queue_next(q), cached++) {
+        requested_channel = ngx_queue_data(q, ngx_http_push_stream_requested_channel_t, queue);
+        cached->channel = requested_channel->channel;
+        cached->last_message_id = requested_channel->channel->last_message_id;
+        cached->last_message_time = requested_channel->channel->last_message_time;
+        cached->last_message_tag = requested_channel->channel->last_message_tag;
+        cached->stored_messages = requested_channel->channel->stored_messages;
+        cached->snapshot_message = ngx_http_push_stream_channel_valid_snapshot(requested_channel->channel);
+    }
+
+    *qtd_channels = qtd;
+    return channels;
 }
 
 
 static void
-ngx_http_push_stream_timer_set(ngx_msec_t timer_interval, ngx_event_t *event, ngx_event_handler_pt event_handler, ngx_flag_t start_timer)
+ngx_http_push_stream_polling_cache_store(ngx_http_request_t *r, ngx_str_t *key, ngx_http_push_stream_polling_cache_channel_t *channels, ngx_uint_t qtd_channels, time_t last_modified_time, ngx_int_t tag, ngx_array_t *body)
 {
-    if ((timer_interval != NGX_CONF_UNSET_MSEC) && start_timer) {
-        if (event->handler == NULL) {
-            event->handler = event_handler;
-            event->data = event; //set event as data to avoid error when running on debug mode (on log event)
-            event->log = ngx_cycle->log;
-            ngx_http_push_stream_timer_reset(timer_interval, event);
-        }
-    }
-}
+    ngx_http_push_stream_main_conf_t               *mcf = ngx_http_get_module_main_conf(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_polling_cache_t           *cache = &ngx_http_push_stream_polling_cache;
+    ngx_http_push_stream_polling_cache_entry_t     *entry;
 
+    while ((cache->entries >= mcf->polling_response_cache_entries) && !ngx_queue_empty(&cache->lru)) {
+        ngx_http_push_stream_polling_cache_remove(ngx_queue_data(ngx_queue_last(&cache->lru), ngx_http_push_stream_polling_cache_entry_t, lru));
+    }
 
-static void
-ngx_http_push_stream_timer_reset(ngx_msec_t timer_interval, ngx_event_t *timer_event)
-{
-    if (!ngx_exiting && (timer_interval != NGX_CONF_UNSET_MSEC) && (timer_event != NULL)) {
-        if (timer_event->timedout) {
-            ngx_time_update();
-        }
-        ngx_add_timer(timer_event, timer_interval);
+    // entry, channels, key and body on a single block to be released at once
+    if ((entry = ngx_alloc(sizeof(ngx_http_push_stream_polling_cache_entry_t) + qtd_channels * sizeof(ngx_http_push_stream_polling_cache_channel_t) + key->len + body->nelts, r->connection->log)) == NULL) {
+        return;
     }
+
+    entry->hash = ngx_crc32_short(key->data, key->len);
+    entry->qtd_channels = qtd_channels;
+    entry->channels = (ngx_http_push_stream_polling_cache_channel_t *) (entry + 1);
+    ngx_memcpy(entry->channels, channels, qtd_channels * sizeof(ngx_http_push_stream_polling_cache_channel_t));
+    entry->key.len = key->len;
+    entry->key.data = (u_char *) (entry->channels + qtd_channels);
+    ngx_memcpy(entry->key.data, key->data, key->len);
+    entry->body.len = body->nelts;
+    entry->body.data = entry->key.data + key->len;
+    ngx_memcpy(entry->body.data, body->elts, body->nelts);
+    entry->last_modified_time = last_modified_time;
+    entry->tag = tag;
+
+    ngx_queue_insert_head(&cache->buckets[entry->hash & (NGX_HTTP_PUSH_STREAM_POLLING_CACHE_BUCKETS - 1)], &entry->queue);
+    ngx_queue_insert_head(&cache->lru, &entry->lru);
+    cache->entries++;
 }
 
 
 static void
-ngx_http_push_stream_ping_timer_wake_handler(ngx_event_t *ev)
+ngx_http_push_stream_ping_timer_wake_handler(ngx_http_push_stream_timer_t *timer)
 {
-    ngx_http_request_t                 *r = (ngx_http_request_t *) ev->data;
+    ngx_http_request_t                 *r = (ngx_http_request_t *) timer->data;
     ngx_http_push_stream_main_conf_t   *mcf = ngx_http_get_module_main_conf(r, ngx_http_push_stream_module);
     ngx_http_push_stream_loc_conf_t    *pslcf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
     ngx_http_push_stream_module_ctx_t  *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+    const ngx_str_t                    *ping = NULL;
+    ngx_flag_t                          ping_message = 0;
     ngx_int_t                           rc = NGX_OK;
 
     if ((ctx == NULL) || (ctx->ping_timer == NULL)) {
         return;
     }
 
+    // ping payloads are built before any connection, here it is only a matter of picking the right one
     if (pslcf->location_type == NGX_HTTP_PUSH_STREAM_SUBSCRIBER_MODE_EVENTSOURCE) {
-        rc = ngx_http_push_stream_send_response_text(r, NGX_HTTP_PUSH_STREAM_EVENTSOURCE_PING_MESSAGE_CHUNK.data, NGX_HTTP_PUSH_STREAM_EVENTSOURCE_PING_MESSAGE_CHUNK.len, 0);
+        ping = &NGX_HTTP_PUSH_STREAM_EVENTSOURCE_PING_MESSAGE_CHUNK;
     } else if (pslcf->location_type == NGX_HTTP_PUSH_STREAM_SUBSCRIBER_MODE_WEBSOCKET) {
-        rc = ngx_http_push_stream_send_response_text(r, NGX_HTTP_PUSH_STREAM_WEBSOCKET_PING_LAST_FRAME_BYTE, sizeof(NGX_HTTP_PUSH_STREAM_WEBSOCKET_PING_LAST_FRAME_BYTE), 0);
+        ping = &NGX_HTTP_PUSH_STREAM_WEBSOCKET_PING_FRAME;
     } else {
-        if (mcf->ping_msg == NULL) {
-            // create ping message
-            if ((mcf->ping_msg == NULL) && (mcf->ping_msg = ngx_http_push_stream_convert_char_to_msg_on_shared(mcf, mcf->ping_message_text.data, mcf->ping_message_text.len, NULL, NGX_HTTP_PUSH_STREAM_PING_MESSAGE_ID, NULL, NULL, r->pool)) == NULL) {
-                ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate ping message in shared memory");
-            }
+        // built on the worker start, created here when the shared memory was not available then
+        if ((mcf->ping_msg == NULL) && ((mcf->ping_msg = ngx_http_push_stream_convert_char_to_msg_on_shared(mcf, mcf->ping_message_text.data, mcf->ping_message_text.len, NULL, NGX_HTTP_PUSH_STREAM_PING_MESSAGE_ID, 0, NULL, NULL, NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE, r->pool)) == NULL)) {
+            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate ping message in shared memory");
         }
 
-        if (mcf->ping_msg != NULL) {
+        if ((mcf->ping_msg != NULL) && (ctx->callback == NULL) && (ctx->padding == NULL)) {
+            ping = ngx_http_push_stream_get_formatted_message(r, NULL, mcf->ping_msg);
+            ping_message = 1;
+        } else if (mcf->ping_msg != NULL) {
+            // jsonp callback and padding depend on the request
             rc = ngx_http_push_stream_send_response_message(r, NULL, mcf->ping_msg, 1, 0);
         }
     }
 
+    if (ping != NULL) {
+        rc = ngx_http_push_stream_send_response_text(r, ping->data, ping->len, 0);
+
+        // the formatted ping text counts as a sent message, as on send_response_message
+        if ((rc == NGX_OK) && ping_message) {
+            ctx->message_sent = 1;
+        }
+    }
+
     if (rc != NGX_OK) {
         ngx_http_push_stream_send_response_finalize(r);
     } else {
-        ngx_http_push_stream_timer_reset(pslcf->ping_message_interval, ctx->ping_timer);
+        ngx_http_push_stream_update_subscriber_memory(r);
+        ngx_http_push_stream_wheel_timer_reset(pslcf->ping_message_interval, ctx->ping_timer);
     }
 }
 
 static void
-ngx_http_push_stream_disconnect_timer_wake_handler(ngx_event_t *ev)
+ngx_http_push_stream_disconnect_timer_wake_handler(ngx_http_push_stream_timer_t *timer)
 {
-    ngx_http_request_t                    *r = (ngx_http_request_t *) ev->data;
+    ngx_http_request_t                    *r = (ngx_http_request_t *) timer->data;
     ngx_http_push_stream_module_ctx_t     *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
 
     if (ctx->longpolling) {
@@ -1321,6 +2595,29 @@ ngx_http_push_stream_buffer_timer_wake_handler(ngx_event_t *ev)
     ngx_http_push_stream_timer_reset(NGX_HTTP_PUSH_STREAM_MESSAGE_BUFFER_CLEANUP_INTERVAL, &ngx_http_push_stream_buffer_cleanup_event);
 }
 
+static void
+ngx_http_push_stream_output_coalescing_timer_wake_handler(ngx_event_t *ev)
+{
+    ngx_http_push_stream_module_ctx_t     *ctx;
+    ngx_http_request_t                    *r;
+    ngx_queue_t                           *q;
+
+    while (!ngx_queue_empty(&ngx_http_push_stream_output_coalescing_queue)) {
+        q = ngx_queue_head(&ngx_http_push_stream_output_coalescing_queue);
+        ctx = ngx_queue_data(q, ngx_http_push_stream_module_ctx_t, pending_queue);
+
+        if ((ngx_msec_int_t) (ctx->pending_flush_time - ngx_current_msec) > 0) {
+            ngx_add_timer(ev, ctx->pending_flush_time - ngx_current_msec);
+            break;
+        }
+
+        r = ctx->subscriber->request;
+        if (ngx_http_push_stream_flush_coalesced_output(r) != NGX_OK) {
+            ngx_http_push_stream_send_response_finalize(r);
+        }
+    }
+}
+
 static ngx_str_t *
 ngx_http_push_stream_str_replace(const ngx_str_t *org, const ngx_str_t *find, const ngx_str_t *replace, off_t offset, ngx_pool_t *pool)
 {
@@ -1356,7 +2653,15 @@ static ngx_str_t *
 ngx_http_push_stream_get_formatted_message(ngx_http_request_t *r, ngx_http_push_stream_channel_t *channel, ngx_http_push_stream_msg_t *message)
 {
     ngx_http_push_stream_loc_conf_t        *pslcf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_module_ctx_t      *ctx;
+
     if (pslcf->message_template_index > 0) {
+        if ((message->deflated_messages != NULL) && (message->deflated_messages[pslcf->message_template_index - 1].len > 0)) {
+            ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+            if ((ctx != NULL) && (ctx->frame != NULL) && ctx->frame->deflate) {
+                return message->deflated_messages + pslcf->message_template_index - 1;
+            }
+        }
         return message->formatted_messages + pslcf->message_template_index - 1;
     }
     return &message->raw;
@@ -1373,8 +2678,9 @@ ngx_http_push_stream_format_message(ngx_http_push_stream_channel_t *channel, ngx
     u_char                     id[NGX_INT_T_LEN + 1];
     u_char                     tag[NGX_INT_T_LEN + 1];
     u_char                     size[NGX_INT_T_LEN + 1];
+    u_char                     delta[NGX_INT_T_LEN + 1];
     u_char                     time[NGX_HTTP_PUSH_STREAM_TIME_FMT_LEN + 1];
-    size_t                     id_len, tag_len, time_len, size_len;
+    size_t                     id_len, tag_len, time_len, size_len, delta_len = 0;
 
     ngx_str_t *channel_id = (channel != NULL) ? &channel->id : &NGX_HTTP_PUSH_STREAM_EMPTY;
     ngx_str_t *event_id = (message->event_id != NULL) ? message->event_id : &NGX_HTTP_PUSH_STREAM_EMPTY;
@@ -1392,6 +2698,12 @@ ngx_http_push_stream_format_message(ngx_http_push_stream_channel_t *channel, ngx
     ngx_sprintf(size, "%d%Z", text->len);
     size_len = ngx_strlen(size);
 
+    // full messages have an empty delta base
+    if (message->delta_base > 0) {
+        ngx_sprintf(delta, "%d%Z", message->delta_base);
+        delta_len = ngx_strlen(delta);
+    }
+
     len += template->qtd_channel * channel_id->len;
     len += template->qtd_event_id * event_id->len;
     len += template->qtd_event_type * event_type->len;
@@ -1400,6 +2712,7 @@ ngx_http_push_stream_format_message(ngx_http_push_stream_channel_t *channel, ngx
     len += template->qtd_tag * tag_len;
     len += template->qtd_text * text->len;
     len += template->qtd_size * size_len;
+    len += template->qtd_delta * delta_len;
     len += template->literal_len;
 
     txt = ngx_http_push_stream_create_str(temp_pool, len);
@@ -1436,6 +2749,9 @@ ngx_http_push_stream_format_message(ngx_http_push_stream_channel_t *channel, ngx
             case PUSH_STREAM_TEMPLATE_PART_TYPE_SIZE:
                 last = ngx_cpymem(last, size, size_len);
                 break;
+            case PUSH_STREAM_TEMPLATE_PART_TYPE_DELTA:
+                last = ngx_cpymem(last, delta, delta_len);
+                break;
             case PUSH_STREAM_TEMPLATE_PART_TYPE_TIME:
                 last = ngx_cpymem(last, time, time_len);
                 break;
@@ -1481,6 +2797,26 @@ ngx_http_push_stream_add_request_context(ngx_http_request_t *r)
     ctx->padding = NULL;
     ctx->callback = NULL;
     ctx->requested_channels = NULL;
+    ctx->pending = NULL;
+    ctx->pending_last = NULL;
+    ctx->pending_size = 0;
+    ngx_queue_init(&ctx->pending_queue);
+    ctx->hold_output = 0;
+    ctx->pending_messages = 0;
+    ngx_queue_init(&ctx->deferred_messages);
+    ngx_queue_init(&ctx->deferred_free);
+    ctx->deferred_qtd = 0;
+    ctx->deferred_size = 0;
+    ctx->memory_size = 0;
+    ctx->polling_response = NULL;
+    ctx->linger_timer = NULL;
+    ngx_queue_init(&ctx->free_subscriptions);
+    ctx->event_types = NULL;
+    ctx->accept_delta = 0;
+    ctx->message_interval = 0;
+    ctx->next_message_slot = 0;
+    ngx_queue_init(&ctx->conflated_messages);
+    ctx->rate_timer = NULL;
 
     // set a cleaner to request
     cln->handler = (ngx_pool_cleanup_pt) ngx_http_push_stream_cleanup_request_context;
@@ -1500,16 +2836,33 @@ ngx_http_push_stream_cleanup_request_context(ngx_http_request_t *r)
     r->read_event_handler = ngx_http_request_empty_handler;
 
     if (ctx != NULL) {
-        if ((ctx->disconnect_timer != NULL) && ctx->disconnect_timer->timer_set) {
-            ngx_del_timer(ctx->disconnect_timer);
+        ngx_http_push_stream_wheel_timer_del(ctx->disconnect_timer);
+        ngx_http_push_stream_wheel_timer_del(ctx->ping_timer);
+
+        if (ctx->subscriber != NULL) {
+            ngx_http_push_stream_worker_subscriber_cleanup(ctx->subscriber);
         }
 
-        if ((ctx->ping_timer != NULL) && ctx->ping_timer->timer_set) {
-            ngx_del_timer(ctx->ping_timer);
+        // pending buffers are kept to be sent on finalize, but the connection leaves the flush queue
+        if (ctx->pending != NULL) {
+            ngx_queue_remove(&ctx->pending_queue);
+            ngx_queue_init(&ctx->pending_queue);
         }
 
-        if (ctx->subscriber != NULL) {
-            ngx_http_push_stream_worker_subscriber_cleanup(ctx->subscriber);
+        if ((ctx->linger_timer != NULL) && ctx->linger_timer->timer_set) {
+            ngx_del_timer(ctx->linger_timer);
+        }
+
+        while (!ngx_queue_empty(&ctx->deferred_messages)) {
+            ngx_http_push_stream_release_deferred_message(r, ctx, ngx_queue_data(ngx_queue_head(&ctx->deferred_messages), ngx_http_push_stream_deferred_msg_t, queue));
+        }
+
+        if ((ctx->rate_timer != NULL) && ctx->rate_timer->timer_set) {
+            ngx_del_timer(ctx->rate_timer);
+        }
+
+        while (!ngx_queue_empty(&ctx->conflated_messages)) {
+            ngx_http_push_stream_unref_message(r, ctx, ngx_queue_data(ngx_queue_head(&ctx->conflated_messages), ngx_http_push_stream_deferred_msg_t, queue));
         }
 
         if (ctx->temp_pool != NULL) {
@@ -1528,6 +2881,7 @@ static void
 ngx_http_push_stream_worker_subscriber_cleanup(ngx_http_push_stream_subscriber_t *worker_subscriber)
 {
     ngx_http_push_stream_main_conf_t        *mcf = ngx_http_get_module_main_conf(worker_subscriber->request, ngx_http_push_stream_module);
+    ngx_http_push_stream_module_ctx_t       *ctx = ngx_http_get_module_ctx(worker_subscriber->request, ngx_http_push_stream_module);
     ngx_http_push_stream_shm_data_t         *data = mcf->shm_data;
     ngx_slab_pool_t                         *shpool = mcf->shpool;
     ngx_queue_t                             *cur;
@@ -1535,24 +2889,101 @@ ngx_http_push_stream_worker_subscriber_cleanup(ngx_http_push_stream_subscriber_t
     while (!ngx_queue_empty(&worker_subscriber->subscriptions)) {
         cur = ngx_queue_head(&worker_subscriber->subscriptions);
         ngx_http_push_stream_subscription_t *subscription = ngx_queue_data(cur, ngx_http_push_stream_subscription_t, queue);
-        ngx_shmtx_lock(subscription->channel->mutex);
-        NGX_HTTP_PUSH_STREAM_DECREMENT_COUNTER(subscription->channel->subscribers);
-        NGX_HTTP_PUSH_STREAM_DECREMENT_COUNTER(subscription->channel_worker_sentinel->subscribers);
-        ngx_queue_remove(&subscription->channel_worker_queue);
-        ngx_queue_remove(&subscription->queue);
-        ngx_shmtx_unlock(subscription->channel->mutex);
-
-        ngx_http_push_stream_send_event(mcf, ngx_cycle->log, subscription->channel, &NGX_HTTP_PUSH_STREAM_EVENT_TYPE_CLIENT_UNSUBSCRIBED, worker_subscriber->request->pool);
+        ngx_http_push_stream_remove_subscription(subscription, worker_subscriber->request->pool);
     }
 
     ngx_shmtx_lock(&shpool->mutex);
     ngx_queue_remove(&worker_subscriber->worker_queue);
     NGX_HTTP_PUSH_STREAM_DECREMENT_COUNTER(data->subscribers);
     NGX_HTTP_PUSH_STREAM_DECREMENT_COUNTER(data->ipc[ngx_process_slot].subscribers);
+    if (ctx != NULL) {
+        NGX_HTTP_PUSH_STREAM_DECREMENT_COUNTER_BY(data->ipc[ngx_process_slot].subscribers_memory, ctx->memory_size);
+        ctx->memory_size = 0;
+    }
     ngx_shmtx_unlock(&shpool->mutex);
 }
 
 
+static void
+ngx_http_push_stream_remove_subscription(ngx_http_push_stream_subscription_t *subscription, ngx_pool_t *temp_pool)
+{
+    ngx_http_request_t                      *r = subscription->subscriber->request;
+    ngx_http_push_stream_main_conf_t        *mcf = ngx_http_get_module_main_conf(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_module_ctx_t       *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_deferred_msg_t     *deferred;
+    ngx_queue_t                             *q, *next;
+
+    // messages of the channel waiting to be sent are not delivered anymore
+    if (ctx != NULL) {
+        for (q = ngx_queue_head(&ctx->deferred_messages); q != ngx_queue_sentinel(&ctx->deferred_messages); q = next) {
+            next = ngx_queue_next(q);
+            deferred = ngx_queue_data(q, ngx_http_push_stream_deferred_msg_t, queue);
+            if (deferred->channel == subscription->channel) {
+                ngx_http_push_stream_release_deferred_message(r, ctx, deferred);
+            }
+        }
+
+        for (q = ngx_queue_head(&ctx->conflated_messages); q != ngx_queue_sentinel(&ctx->conflated_messages); q = next) {
+            next = ngx_queue_next(q);
+            deferred = ngx_queue_data(q, ngx_http_push_stream_deferred_msg_t, queue);
+            if (deferred->channel == subscription->channel) {
+                ngx_http_push_stream_unref_message(r, ctx, deferred);
+            }
+        }
+    }
+
+    ngx_shmtx_lock(subscription->channel->mutex);
+    NGX_HTTP_PUSH_STREAM_DECREMENT_COUNTER(subscription->channel->subscribers);
+    NGX_HTTP_PUSH_STREAM_DECREMENT_COUNTER(subscription->channel_worker_sentinel->subscribers);
+    ngx_queue_remove(&subscription->channel_worker_queue);
+    ngx_queue_remove(&subscription->queue);
+    ngx_shmtx_unlock(subscription->channel->mutex);
+
+    ngx_http_push_stream_send_event(mcf, ngx_cycle->log, subscription->channel, &NGX_HTTP_PUSH_STREAM_EVENT_TYPE_CLIENT_UNSUBSCRIBED, temp_pool);
+}
+
+
+static size_t
+ngx_http_push_stream_pool_blocks_size(ngx_pool_t *pool)
+{
+    ngx_pool_t                              *p;
+    size_t                                   size = 0;
+
+    for (p = pool; p != NULL; p = p->d.next) {
+        size += p->d.end - (u_char *) p;
+    }
+
+    return size;
+}
+
+
+static void
+ngx_http_push_stream_update_subscriber_memory(ngx_http_request_t *r)
+{
+    ngx_http_push_stream_main_conf_t        *mcf = ngx_http_get_module_main_conf(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_module_ctx_t       *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_worker_data_t      *thisworker_data = &mcf->shm_data->ipc[ngx_process_slot];
+    ngx_connection_t                        *c = r->connection;
+    size_t                                   size;
+
+    if ((ctx == NULL) || (ctx->subscriber == NULL)) {
+        return;
+    }
+
+    // blocks of the request, connection and temporary pools, and the client header buffer allocated apart
+    // allocations bigger than a pool block are kept on pool->large without their sizes and are not counted
+    size = ngx_http_push_stream_pool_blocks_size(r->pool) + ngx_http_push_stream_pool_blocks_size(c->pool) + ngx_http_push_stream_pool_blocks_size(ctx->temp_pool);
+    if (c->buffer != NULL) {
+        size += c->buffer->end - c->buffer->start;
+    }
+
+    if (size != ctx->memory_size) {
+        thisworker_data->subscribers_memory = thisworker_data->subscribers_memory + size - ctx->memory_size;
+        ctx->memory_size = size;
+    }
+}
+
+
 static ngx_http_push_stream_content_subtype_t *
 ngx_http_push_stream_match_channel_info_format_and_content_type(ngx_http_request_t *r, ngx_uint_t default_subtype)
 {
@@ -1668,6 +3099,104 @@ ngx_http_push_stream_get_formatted_websocket_frame(const u_char *opcode, off_t o
 }
 
 
+#if (NGX_ZLIB)
+
+static ngx_int_t
+ngx_http_push_stream_deflate_message(ngx_http_push_stream_msg_t *msg, ngx_uint_t index, ngx_str_t *text, ngx_slab_pool_t *shpool, ngx_pool_t *temp_pool)
+{
+    z_stream               zstream;
+    ngx_str_t             *frame, *deflated;
+    const u_char          *frame_byte;
+    u_char                *out;
+    size_t                 size;
+    int                    rc, wbits, memlevel;
+
+    // as done by gzip filter, reduce the window and memory used by small messages
+    wbits = NGX_HTTP_PUSH_STREAM_WEBSOCKET_DEFLATE_WINDOW_BITS;
+    memlevel = MAX_MEM_LEVEL - 1;
+    while ((text->len < ((size_t) 1 << (wbits - 1))) && (wbits > 9)) {
+        wbits--;
+        memlevel--;
+    }
+    memlevel = ngx_max(memlevel, 1);
+
+    ngx_memzero(&zstream, sizeof(z_stream));
+    zstream.zalloc = ngx_http_push_stream_zalloc;
+    zstream.zfree = ngx_http_push_stream_zfree;
+    zstream.opaque = temp_pool;
+
+    if (deflateInit2(&zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -wbits, memlevel, Z_DEFAULT_STRATEGY) != Z_OK) {
+        // the message is still delivered without compression
+        return NGX_OK;
+    }
+
+    size = deflateBound(&zstream, text->len) + sizeof(NGX_HTTP_PUSH_STREAM_WEBSOCKET_DEFLATE_TAIL) * 2;
+    if ((out = ngx_palloc(temp_pool, size)) == NULL) {
+        deflateEnd(&zstream);
+        return NGX_OK;
+    }
+
+    zstream.next_in = text->data;
+    zstream.avail_in = text->len;
+    zstream.next_out = out;
+    zstream.avail_out = size;
+
+    rc = deflate(&zstream, Z_SYNC_FLUSH);
+    size = size - zstream.avail_out;
+    deflateEnd(&zstream);
+
+    if ((rc != Z_OK) || (zstream.avail_in > 0) || (size < sizeof(NGX_HTTP_PUSH_STREAM_WEBSOCKET_DEFLATE_TAIL))) {
+        return NGX_OK;
+    }
+
+    // RFC 7692: the empty block produced by the flush is not sent
+    size -= sizeof(NGX_HTTP_PUSH_STREAM_WEBSOCKET_DEFLATE_TAIL);
+
+    // compression does not pay off, subscribers receive the plain frame
+    if (size >= text->len) {
+        return NGX_OK;
+    }
+
+    frame_byte = (msg->opcode == NGX_HTTP_PUSH_STREAM_WEBSOCKET_BINARY_OPCODE) ? &NGX_HTTP_PUSH_STREAM_WEBSOCKET_BINARY_LAST_DEFLATED_FRAME_BYTE : &NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_LAST_DEFLATED_FRAME_BYTE;
+    if ((frame = ngx_http_push_stream_get_formatted_websocket_frame(frame_byte, 1, out, size, temp_pool)) == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (msg->deflated_messages == NULL) {
+        if ((msg->deflated_messages = ngx_slab_alloc(shpool, sizeof(ngx_str_t) * msg->qtd_templates)) == NULL) {
+            return NGX_ERROR;
+        }
+        ngx_memzero(msg->deflated_messages, sizeof(ngx_str_t) * msg->qtd_templates);
+    }
+
+    deflated = (msg->deflated_messages + index);
+    if ((deflated->data = ngx_slab_alloc(shpool, frame->len)) == NULL) {
+        return NGX_ERROR;
+    }
+
+    deflated->len = frame->len;
+    ngx_memcpy(deflated->data, frame->data, deflated->len);
+
+    return NGX_OK;
+}
+
+
+static void *
+ngx_http_push_stream_zalloc(void *opaque, u_int items, u_int size)
+{
+    return ngx_palloc((ngx_pool_t *) opaque, items * size);
+}
+
+
+static void
+ngx_http_push_stream_zfree(void *opaque, void *address)
+{
+    // memory is released with the pool
+}
+
+#endif
+
+
 static ngx_str_t *
 ngx_http_push_stream_create_str(ngx_pool_t *pool, uint len)
 {
@@ -1867,6 +3396,122 @@ ngx_http_push_stream_get_last_received_message_values(ngx_http_request_t *r, tim
 }
 
 
+static ngx_int_t
+ngx_http_push_stream_get_event_types_filter(ngx_http_request_t *r)
+{
+    ngx_http_push_stream_module_ctx_t              *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_loc_conf_t                *cf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
+    ngx_str_t                                      *header, *event_type, vv_event_types = ngx_null_string;
+    u_char                                         *p, *last, *end, *start;
+
+    if (cf->event_types != NULL) {
+        ngx_http_push_stream_complex_value(r, cf->event_types, &vv_event_types);
+    } else if ((header = ngx_http_push_stream_get_header(r, &NGX_HTTP_PUSH_STREAM_HEADER_EVENT_TYPES)) != NULL) {
+        vv_event_types = *header;
+    }
+
+    ctx->event_types = NULL;
+    if (vv_event_types.len == 0) {
+        return NGX_OK;
+    }
+
+    // the values are kept while the subscriber is connected
+    if (((p = ngx_pnalloc(r->pool, vv_event_types.len)) == NULL) || ((ctx->event_types = ngx_array_create(r->pool, 4, sizeof(ngx_str_t))) == NULL)) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate memory for event types filter");
+        return NGX_ERROR;
+    }
+    last = ngx_cpymem(p, vv_event_types.data, vv_event_types.len);
+
+    // a comma separated list of event types
+    while (p < last) {
+        if ((end = ngx_strlchr(p, last, ',')) == NULL) {
+            end = last;
+        }
+
+        for (start = p; (start < end) && (*start == ' '); start++) { /* void */ }
+        for (p = end; (p > start) && (*(p - 1) == ' '); p--) { /* void */ }
+
+        if (p > start) {
+            if ((event_type = ngx_array_push(ctx->event_types)) == NULL) {
+                ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate memory for event types filter");
+                return NGX_ERROR;
+            }
+            event_type->data = start;
+            event_type->len = p - start;
+        }
+
+        p = end + 1;
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_push_stream_get_accept_delta(ngx_http_request_t *r)
+{
+    ngx_http_push_stream_module_ctx_t              *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_loc_conf_t                *cf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
+    ngx_str_t                                      *header, vv_accept_delta = ngx_null_string;
+
+    if (cf->accept_message_delta != NULL) {
+        ngx_http_push_stream_complex_value(r, cf->accept_message_delta, &vv_accept_delta);
+    } else if ((header = ngx_http_push_stream_get_header(r, &NGX_HTTP_PUSH_STREAM_HEADER_ACCEPT_DELTA)) != NULL) {
+        vv_accept_delta = *header;
+    }
+
+    ctx->accept_delta = ((vv_accept_delta.len == 4) && (ngx_strncasecmp(vv_accept_delta.data, (u_char *) "true", 4) == 0));
+}
+
+
+static void
+ngx_http_push_stream_get_max_message_rate(ngx_http_request_t *r)
+{
+    ngx_http_push_stream_module_ctx_t              *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_loc_conf_t                *cf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
+    ngx_str_t                                       vv_max_message_rate = ngx_null_string;
+    ngx_int_t                                       rate;
+
+    ctx->message_interval = 0;
+    if (cf->max_message_rate == NULL) {
+        return;
+    }
+
+    // messages per second, an empty or invalid value disables the limit
+    ngx_http_push_stream_complex_value(r, cf->max_message_rate, &vv_max_message_rate);
+    if ((vv_max_message_rate.len > 0) && ((rate = ngx_atoi(vv_max_message_rate.data, vv_max_message_rate.len)) > 0)) {
+        ctx->message_interval = ngx_max(1000 / rate, 1);
+    }
+}
+
+
+static ngx_flag_t
+ngx_http_push_stream_subscriber_accepts_message(ngx_http_request_t *r, ngx_http_push_stream_msg_t *msg)
+{
+    ngx_http_push_stream_module_ctx_t              *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+    ngx_str_t                                      *event_types;
+    ngx_uint_t                                      i;
+
+    // control messages, like ping and channel deleted, are never filtered
+    if ((ctx == NULL) || (ctx->event_types == NULL) || (msg->id < 0)) {
+        return 1;
+    }
+
+    if (msg->event_type == NULL) {
+        return 0;
+    }
+
+    event_types = ctx->event_types->elts;
+    for (i = 0; i < ctx->event_types->nelts; i++) {
+        if (ngx_memn2cmp(event_types[i].data, msg->event_type->data, event_types[i].len, msg->event_type->len) == 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
 /**
  * Copied from nginx code to only send headers added on this module code
  * */
@@ -2237,19 +3882,27 @@ ngx_http_push_stream_set_expires(ngx_http_request_t *r, ngx_http_push_stream_exp
 
 ngx_http_push_stream_requested_channel_t *
 ngx_http_push_stream_parse_channels_ids_from_path(ngx_http_request_t *r, ngx_pool_t *pool) {
-    ngx_http_push_stream_main_conf_t               *mcf = ngx_http_get_module_main_conf(r, ngx_http_push_stream_module);
     ngx_http_push_stream_loc_conf_t                *cf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
     ngx_str_t                                       vv_channels_path = ngx_null_string;
-    ngx_http_push_stream_requested_channel_t       *requested_channels, *requested_channel;
-    ngx_str_t                                       aux;
-    int                                             captures[15];
-    ngx_int_t                                       n;
 
     ngx_http_push_stream_complex_value(r, cf->channels_path, &vv_channels_path);
     if (vv_channels_path.len == 0) {
         return NULL;
     }
 
+    return ngx_http_push_stream_parse_channels_ids(r, &vv_channels_path, pool);
+}
+
+
+ngx_http_push_stream_requested_channel_t *
+ngx_http_push_stream_parse_channels_ids(ngx_http_request_t *r, ngx_str_t *channels_path, ngx_pool_t *pool) {
+    ngx_http_push_stream_main_conf_t               *mcf = ngx_http_get_module_main_conf(r, ngx_http_push_stream_module);
+    ngx_str_t                                       vv_channels_path = *channels_path;
+    ngx_http_push_stream_requested_channel_t       *requested_channels, *requested_channel;
+    ngx_str_t                                       aux;
+    int                                             captures[15];
+    ngx_int_t                                       n;
+
     if ((requested_channels = ngx_pcalloc(pool, sizeof(ngx_http_push_stream_requested_channel_t))) == NULL) {
         ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate memory for requested_channels queue");
         return NULL;
@@ -2324,21 +3977,37 @@ ngx_http_push_stream_create_shmtx(ngx_shmtx_t *mtx, ngx_shmtx_sh_t *addr, u_char
 ngx_flag_t
 ngx_http_push_stream_is_utf8(u_char *p, size_t n)
 {
-    u_char  c, *last;
-    size_t  len;
+    u_char    *last;
+    uint64_t   word;
+    size_t     ascii = 0;
 
     last = p + n;
 
-    for (len = 0; p < last; len++) {
-
-        c = *p;
+    while (p < last) {
 
-        if (c < 0x80) {
+        if (*p < 0x80) {
             p++;
+
+            // only long ascii runs are skipped a word at a time, short ones would pay the extra load
+            if (++ascii < sizeof(uint64_t)) {
+                continue;
+            }
+
+            while ((size_t) (last - p) >= sizeof(uint64_t)) {
+                ngx_memcpy(&word, p, sizeof(uint64_t));
+                if (word & 0x8080808080808080ULL) {
+                    break;
+                }
+                p += sizeof(uint64_t);
+            }
+
+            ascii = 0;
             continue;
         }
 
-        if (ngx_utf8_decode(&p, n) > 0x10ffff) {
+        ascii = 0;
+
+        if (ngx_utf8_decode(&p, last - p) > 0x10ffff) {
             /* invalid UTF-8 */
             return 0;
         }
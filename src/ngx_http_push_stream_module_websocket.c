@@ -28,6 +28,15 @@
 ngx_str_t *ngx_http_push_stream_generate_websocket_accept_value(ngx_http_request_t *r, ngx_str_t *sec_key, ngx_pool_t *temp_pool);
 ngx_int_t  ngx_http_push_stream_recv(ngx_connection_t *c, ngx_event_t *rev, ngx_buf_t *buf, ssize_t len);
 void       ngx_http_push_stream_set_buffer(ngx_buf_t *buf, u_char *start, u_char *last, ssize_t len);
+ngx_flag_t ngx_http_push_stream_websocket_accept_deflate(ngx_str_t *extensions);
+ngx_int_t  ngx_http_push_stream_websocket_inflate(ngx_http_request_t *r, ngx_http_push_stream_frame_t *frame, ngx_pool_t *temp_pool);
+void       ngx_http_push_stream_websocket_unmask(u_char *payload, uint64_t len, u_char *mask_key);
+ngx_int_t  ngx_http_push_stream_websocket_parse_frame(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx);
+ngx_int_t  ngx_http_push_stream_websocket_process_frame(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx, u_char *payload);
+void       ngx_http_push_stream_websocket_release_read_buffers(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx);
+ngx_int_t  ngx_http_push_stream_websocket_control(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx);
+ngx_int_t  ngx_http_push_stream_websocket_unsubscribe(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx, ngx_http_push_stream_requested_channel_t *requested_channels);
+ngx_int_t  ngx_http_push_stream_websocket_check_publish_rate(ngx_http_push_stream_main_conf_t *mcf, ngx_http_push_stream_subscriber_t *subscriber, size_t len);
 
 static ngx_int_t
 ngx_http_push_stream_websocket_handler(ngx_http_request_t *r)
@@ -91,8 +100,11 @@ ngx_http_push_stream_websocket_handler(ngx_http_request_t *r)
     ctx->frame->payload = NULL;
     ctx->frame->last_fragment = 0;
     ctx->frame->fragmented = 0;
-    ngx_str_set(&ctx->frame->consolidated, "");
-    ngx_http_push_stream_set_buffer(&ctx->frame->buf, ctx->frame->header, NULL, 8);
+    ctx->frame->deflate = 0;
+    ctx->frame->compressed = 0;
+    ctx->frame->fragments = NULL;
+    ctx->frame->fragments_last = &ctx->frame->fragments;
+    ctx->frame->fragments_len = 0;
 
     if ((sec_accept_header = ngx_http_push_stream_generate_websocket_accept_value(r, sec_key_header, ctx->temp_pool)) == NULL) {
         ngx_log_error(NGX_LOG_WARN, r->connection->log, 0, "push stream module: could not generate security accept header value");
@@ -102,10 +114,28 @@ ngx_http_push_stream_websocket_handler(ngx_http_request_t *r)
     ngx_http_push_stream_add_response_header(r, &NGX_HTTP_PUSH_STREAM_HEADER_UPGRADE, &NGX_HTTP_PUSH_STREAM_WEBSOCKET_UPGRADE);
     ngx_http_push_stream_add_response_header(r, &NGX_HTTP_PUSH_STREAM_HEADER_CONNECTION, &NGX_HTTP_PUSH_STREAM_WEBSOCKET_CONNECTION);
     ngx_http_push_stream_add_response_header(r, &NGX_HTTP_PUSH_STREAM_HEADER_SEC_WEBSOCKET_ACCEPT, sec_accept_header);
+
+#if (NGX_ZLIB)
+    if (cf->websocket_deflate) {
+        ngx_str_t *sec_extensions_header = ngx_http_push_stream_get_header(r, &NGX_HTTP_PUSH_STREAM_HEADER_SEC_WEBSOCKET_EXTENSIONS);
+        if ((sec_extensions_header != NULL) && ngx_http_push_stream_websocket_accept_deflate(sec_extensions_header)) {
+            ngx_http_push_stream_add_response_header(r, &NGX_HTTP_PUSH_STREAM_HEADER_SEC_WEBSOCKET_EXTENSIONS, &NGX_HTTP_PUSH_STREAM_WEBSOCKET_PERMESSAGE_DEFLATE_RESPONSE);
+            ctx->frame->deflate = 1;
+        }
+    }
+#endif
     r->headers_out.status_line = NGX_HTTP_PUSH_STREAM_101_STATUS_LINE;
 
     ngx_http_push_stream_send_only_added_headers(r);
 
+    // a batch publisher only reads the records sent on the connection
+    if (cf->location_type == NGX_HTTP_PUSH_STREAM_PUBLISHER_MODE_BATCH) {
+        r->main->count++;
+        r->read_event_handler = ngx_http_push_stream_websocket_reading;
+        r->write_event_handler = ngx_http_request_empty_handler;
+        return NGX_DONE;
+    }
+
     //get channels ids and backtracks from path
     requested_channels = ngx_http_push_stream_parse_channels_ids_from_path(r, ctx->temp_pool);
     if ((requested_channels == NULL) || ngx_queue_empty(&requested_channels->queue)) {
@@ -114,13 +144,20 @@ ngx_http_push_stream_websocket_handler(ngx_http_request_t *r)
     }
 
     //validate channels: name, length and quantity. check if channel exists when authorized_channels_only is on. check if channel is full of subscribers
-    if (ngx_http_push_stream_validate_channels(r, requested_channels, &status_code, &explain_error_message) == NGX_ERROR) {
+    if (ngx_http_push_stream_validate_channels(r, requested_channels, NULL, &status_code, &explain_error_message) == NGX_ERROR) {
         return ngx_http_push_stream_send_websocket_close_frame(r, status_code, explain_error_message);
     }
 
     // get control values
     ngx_http_push_stream_get_last_received_message_values(r, &if_modified_since, &tag, &last_event_id);
 
+    if (ngx_http_push_stream_get_event_types_filter(r) != NGX_OK) {
+        return ngx_http_push_stream_send_websocket_close_frame(r, NGX_HTTP_INTERNAL_SERVER_ERROR, &NGX_HTTP_PUSH_STREAM_EMPTY);
+    }
+
+    ngx_http_push_stream_get_accept_delta(r);
+    ngx_http_push_stream_get_max_message_rate(r);
+
     // stream access
     if ((worker_subscriber = ngx_http_push_stream_subscriber_prepare_request_to_keep_connected(r)) == NULL) {
         return ngx_http_push_stream_send_websocket_close_frame(r, NGX_HTTP_INTERNAL_SERVER_ERROR, &NGX_HTTP_PUSH_STREAM_EMPTY);
@@ -148,6 +185,7 @@ ngx_http_push_stream_websocket_handler(ngx_http_request_t *r)
         ngx_destroy_pool(ctx->temp_pool);
         ctx->temp_pool = NULL;
     }
+    ngx_http_push_stream_update_subscriber_memory(r);
     return NGX_DONE;
 }
 
@@ -180,239 +218,251 @@ ngx_http_push_stream_generate_websocket_accept_value(ngx_http_request_t *r, ngx_
 }
 
 
-void
-ngx_http_push_stream_websocket_reading(ngx_http_request_t *r)
+ngx_flag_t
+ngx_http_push_stream_websocket_accept_deflate(ngx_str_t *extensions)
 {
-    ngx_http_push_stream_main_conf_t  *mcf = ngx_http_get_module_main_conf(r, ngx_http_push_stream_module);
-    ngx_http_push_stream_loc_conf_t   *cf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
-    ngx_http_push_stream_module_ctx_t *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
-    ngx_int_t                          rc = NGX_OK;
-    ngx_event_t                       *rev;
-    ngx_connection_t                  *c;
-    uint64_t                           i;
-    ngx_queue_t                       *q;
-    u_char                            *aux, *last;
-    unsigned char                      opcode;
+    u_char       *pos, *last, *offer_end, *param_end, *name_end, *value;
+    ngx_flag_t    accepted;
+    size_t        len;
 
-    ngx_http_push_stream_set_buffer(&ctx->frame->buf, ctx->frame->buf.start, ctx->frame->buf.last, 0);
+    pos = extensions->data;
+    last = extensions->data + extensions->len;
 
-    c = r->connection;
-    rev = c->read;
-
-    for (;;) {
-        if (c->error || c->timedout || c->close || c->destroyed || rev->closed || rev->eof) {
-            goto finalize;
+    // each offer is separated by a comma and its parameters by a semicolon
+    while (pos < last) {
+        if ((offer_end = ngx_strlchr(pos, last, ',')) == NULL) {
+            offer_end = last;
         }
 
-        switch (ctx->frame->step) {
-            case NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_START_STEP:
-                //reading frame header
-                if ((rc = ngx_http_push_stream_recv(c, rev, &ctx->frame->buf, 2)) != NGX_OK) {
-                    goto exit;
-                }
+        accepted = 0;
+        while (pos < offer_end) {
+            while ((pos < offer_end) && ((*pos == ' ') || (*pos == '\t'))) {
+                pos++;
+            }
 
-                ctx->frame->fin  = (ctx->frame->header[0] >> 7) & 1;
-                ctx->frame->rsv1 = (ctx->frame->header[0] >> 6) & 1;
-                ctx->frame->rsv2 = (ctx->frame->header[0] >> 5) & 1;
-                ctx->frame->rsv3 = (ctx->frame->header[0] >> 4) & 1;
-                opcode           = ctx->frame->header[0] & 0xf;
-
-                ctx->frame->mask = (ctx->frame->header[1] >> 7) & 1;
-                ctx->frame->payload_len = ctx->frame->header[1] & 0x7f;
-
-                if (ctx->frame->fin == 0) {
-                    if (opcode == 0) {
-                        if (!ctx->frame->fragmented) {
-                            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: wrong websocket frames sequence");
-                            goto close;
-                        }
-                    } else {
-                        if (!ctx->frame->fragmented) {
-                            ctx->frame->fragmented = 1;
-                            ctx->frame->opcode = opcode;
-                        }
-                    }
-                } else {
-                    if (opcode == 0) {
-                        if (ctx->frame->fragmented) {
-                            ctx->frame->last_fragment = 1;
-                        } else {
-                            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: wrong websocket frames sequence");
-                            goto close;
-                        }
-                    } else {
-                        if (ctx->frame->fragmented) {
-                            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: wrong websocket frames sequence");
-                            goto close;
-                        } else {
-                            ctx->frame->last_fragment = 1;
-                            ctx->frame->opcode = opcode;
-                        }
-                    }
-                }
+            if ((param_end = ngx_strlchr(pos, offer_end, ';')) == NULL) {
+                param_end = offer_end;
+            }
 
-                if ((ctx->frame->payload_len == 126) || (ctx->frame->payload_len == 127)) {
-                    ctx->frame->step = NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_GET_REAL_SIZE_STEP;
-                    ngx_http_push_stream_set_buffer(&ctx->frame->buf, ctx->frame->header, NULL, 8);
-                } else if (ctx->frame->mask) {
-                    ctx->frame->step = NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_GET_MASK_KEY_STEP;
-                    ngx_http_push_stream_set_buffer(&ctx->frame->buf, ctx->frame->mask_key, NULL, 4);
-                } else {
-                    ctx->frame->step = NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_GET_PAYLOAD_STEP;
-                }
+            if ((name_end = ngx_strlchr(pos, param_end, '=')) == NULL) {
+                name_end = param_end;
+            }
+            value = (name_end < param_end) ? name_end + 1 : NULL;
 
+            len = name_end - pos;
+            while ((len > 0) && ((pos[len - 1] == ' ') || (pos[len - 1] == '\t'))) {
+                len--;
+            }
+
+            if (!accepted) {
+                // the first token is the extension name
+                if ((len != NGX_HTTP_PUSH_STREAM_WEBSOCKET_PERMESSAGE_DEFLATE.len) || (ngx_strncasecmp(pos, NGX_HTTP_PUSH_STREAM_WEBSOCKET_PERMESSAGE_DEFLATE.data, len) != 0)) {
+                    break;
+                }
+                accepted = 1;
+            } else if ((len == sizeof("server_max_window_bits") - 1) && (ngx_strncasecmp(pos, (u_char *) "server_max_window_bits", len) == 0)) {
+                // the compressed messages are shared and may use the whole window
+                while ((value != NULL) && (value < param_end) && ((*value == ' ') || (*value == '"'))) {
+                    value++;
+                }
+                if ((value == NULL) || (value + 2 > param_end) || (ngx_atoi(value, 2) != NGX_HTTP_PUSH_STREAM_WEBSOCKET_DEFLATE_WINDOW_BITS)) {
+                    accepted = 0;
+                    break;
+                }
+            } else if (!(((len == sizeof("server_no_context_takeover") - 1) && (ngx_strncasecmp(pos, (u_char *) "server_no_context_takeover", len) == 0)) ||
+                         ((len == sizeof("client_no_context_takeover") - 1) && (ngx_strncasecmp(pos, (u_char *) "client_no_context_takeover", len) == 0)) ||
+                         ((len == sizeof("client_max_window_bits") - 1) && (ngx_strncasecmp(pos, (u_char *) "client_max_window_bits", len) == 0)))) {
+                accepted = 0;
                 break;
+            }
 
-            case NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_GET_REAL_SIZE_STEP:
+            pos = param_end + 1;
+        }
 
-                if (ctx->frame->payload_len == 126) {
-                    if ((rc = ngx_http_push_stream_recv(c, rev, &ctx->frame->buf, 2)) != NGX_OK) {
-                        goto exit;
-                    }
-                    uint16_t len;
-                    ngx_memcpy(&len, ctx->frame->header, 2);
-                    ctx->frame->payload_len = ntohs(len);
-                } else if (ctx->frame->payload_len == 127) {
-                    if ((rc = ngx_http_push_stream_recv(c, rev, &ctx->frame->buf, 8)) != NGX_OK) {
-                        goto exit;
-                    }
-                    uint64_t len;
-                    ngx_memcpy(&len, ctx->frame->header, 8);
-                    ctx->frame->payload_len = ngx_http_push_stream_ntohll(len);
-                }
+        if (accepted) {
+            return 1;
+        }
 
-                if (ctx->frame->mask) {
-                    ctx->frame->step = NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_GET_MASK_KEY_STEP;
-                    ngx_http_push_stream_set_buffer(&ctx->frame->buf, ctx->frame->mask_key, NULL, 4);
-                } else {
-                    ctx->frame->step = NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_GET_PAYLOAD_STEP;
-                }
+        pos = offer_end + 1;
+    }
 
-                break;
+    return 0;
+}
 
-            case NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_GET_MASK_KEY_STEP:
 
-                if ((rc = ngx_http_push_stream_recv(c, rev, &ctx->frame->buf, 4)) != NGX_OK) {
-                    goto exit;
-                }
+ngx_int_t
+ngx_http_push_stream_websocket_inflate(ngx_http_request_t *r, ngx_http_push_stream_frame_t *frame, ngx_pool_t *temp_pool)
+{
+#if (NGX_ZLIB)
+    ngx_http_core_loc_conf_t    *clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+    z_stream                     zstream;
+    u_char                      *in, *out, *aux;
+    size_t                       size, new_size, max_size;
+    int                          rc;
+
+    // the sender removed the empty block produced by the flush
+    if ((in = ngx_palloc(temp_pool, frame->payload_len + sizeof(NGX_HTTP_PUSH_STREAM_WEBSOCKET_DEFLATE_TAIL))) == NULL) {
+        return NGX_ERROR;
+    }
+    ngx_memcpy(in, frame->payload, frame->payload_len);
+    ngx_memcpy(in + frame->payload_len, NGX_HTTP_PUSH_STREAM_WEBSOCKET_DEFLATE_TAIL, sizeof(NGX_HTTP_PUSH_STREAM_WEBSOCKET_DEFLATE_TAIL));
 
-                ctx->frame->step = NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_GET_PAYLOAD_STEP;
+    // the inflated message is subject to the same limit of a message published by a http request
+    max_size = (clcf->client_max_body_size > 0) ? (size_t) clcf->client_max_body_size : NGX_MAX_SIZE_T_VALUE;
+    size = ngx_min(frame->payload_len * 4 + 128, max_size);
+    if ((out = ngx_palloc(temp_pool, size)) == NULL) {
+        return NGX_ERROR;
+    }
 
-                break;
+    ngx_memzero(&zstream, sizeof(z_stream));
+    zstream.zalloc = ngx_http_push_stream_zalloc;
+    zstream.zfree = ngx_http_push_stream_zfree;
+    zstream.opaque = temp_pool;
 
-            case NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_GET_PAYLOAD_STEP:
-                if (
-                    (ctx->frame->opcode != NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE) &&
-                    (ctx->frame->opcode != NGX_HTTP_PUSH_STREAM_WEBSOCKET_CLOSE_OPCODE) &&
-                    (ctx->frame->opcode != NGX_HTTP_PUSH_STREAM_WEBSOCKET_PING_OPCODE) &&
-                    (ctx->frame->opcode != NGX_HTTP_PUSH_STREAM_WEBSOCKET_PONG_OPCODE)
-                   ) {
-                    goto close;
-                }
+    if (inflateInit2(&zstream, -NGX_HTTP_PUSH_STREAM_WEBSOCKET_DEFLATE_WINDOW_BITS) != Z_OK) {
+        return NGX_ERROR;
+    }
 
-                if (ctx->frame->payload_len > 0) {
-                    //create a temporary pool to allocate temporary elements
-                    if (ctx->temp_pool == NULL) {
-                        if ((ctx->temp_pool = ngx_create_pool(4096, r->connection->log)) == NULL) {
-                            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate memory for temporary pool");
-                            goto finalize;
-                        }
+    zstream.next_in = in;
+    zstream.avail_in = frame->payload_len + sizeof(NGX_HTTP_PUSH_STREAM_WEBSOCKET_DEFLATE_TAIL);
+    zstream.next_out = out;
+    zstream.avail_out = size;
 
-                    }
+    for (;;) {
+        rc = inflate(&zstream, Z_SYNC_FLUSH);
+        if ((rc != Z_OK) && (rc != Z_STREAM_END) && (rc != Z_BUF_ERROR)) {
+            break;
+        }
 
-                    if (ctx->frame->payload == NULL) {
-                        if ((ctx->frame->payload = ngx_pcalloc(ctx->temp_pool, ctx->frame->payload_len)) == NULL) {
-                            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate memory for payload");
-                            goto finalize;
-                        }
+        if ((rc == Z_STREAM_END) || ((zstream.avail_in == 0) && (zstream.avail_out > 0))) {
+            rc = Z_STREAM_END;
+            break;
+        }
 
-                        ngx_http_push_stream_set_buffer(&ctx->frame->buf, ctx->frame->payload, NULL, ctx->frame->payload_len);
-                    }
+        if (zstream.avail_out > 0) {
+            // no progress is possible
+            break;
+        }
 
-                    if ((rc = ngx_http_push_stream_recv(c, rev, &ctx->frame->buf, ctx->frame->payload_len)) != NGX_OK) {
-                        goto exit;
-                    }
+        if (size >= max_size) {
+            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: inflated websocket message is larger than client_max_body_size");
+            break;
+        }
 
-                    if (ctx->frame->mask) {
-                        for (i = 0; i < ctx->frame->payload_len; i++) {
-                            ctx->frame->payload[i] = ctx->frame->payload[i] ^ ctx->frame->mask_key[i % 4];
-                        }
-                    }
+        new_size = ngx_min(size * 2, max_size);
+        if ((aux = ngx_palloc(temp_pool, new_size)) == NULL) {
+            break;
+        }
+        ngx_memcpy(aux, out, size);
+        out = aux;
+        zstream.next_out = out + size;
+        zstream.avail_out = new_size - size;
+        size = new_size;
+    }
 
-                    if (!ngx_http_push_stream_is_utf8(ctx->frame->payload, ctx->frame->payload_len)) {
-                        goto finalize;
-                    }
+    inflateEnd(&zstream);
 
-                    if (ctx->frame->fragmented) {
-                        if (ctx->frame->consolidated.len == 0) {
-                            ctx->frame->consolidated.data = ctx->frame->payload;
-                            ctx->frame->consolidated.len = ctx->frame->payload_len;
-                        } else {
-                            if ((aux = ngx_pcalloc(ctx->temp_pool, ctx->frame->payload_len + ctx->frame->consolidated.len)) == NULL) {
-                                ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate memory for consolidated payload for %ui bytes", ctx->frame->payload_len + ctx->frame->consolidated.len);
-                                goto finalize;
-                            }
-                            last = ngx_cpymem(aux, ctx->frame->consolidated.data, ctx->frame->consolidated.len);
-                            ngx_memcpy(last, ctx->frame->payload, ctx->frame->payload_len);
-                            ctx->frame->consolidated.data = aux;
-                            ctx->frame->consolidated.len = ctx->frame->payload_len + ctx->frame->consolidated.len;
-                        }
-
-                        if (ctx->frame->last_fragment) {
-                            ctx->frame->payload = ctx->frame->consolidated.data;
-                            ctx->frame->payload_len = ctx->frame->consolidated.len;
-                        }
-                    }
+    if (rc != Z_STREAM_END) {
+        return NGX_ERROR;
+    }
 
-                    if (cf->websocket_allow_publish && ctx->frame->last_fragment && (ctx->frame->opcode == NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE)) {
-                        for (q = ngx_queue_head(&ctx->subscriber->subscriptions); q != ngx_queue_sentinel(&ctx->subscriber->subscriptions); q = ngx_queue_next(q)) {
-                            ngx_http_push_stream_subscription_t *subscription = ngx_queue_data(q, ngx_http_push_stream_subscription_t, queue);
-                            if (subscription->channel->for_events) {
-                                // skip events channel on publish by websocket connections
-                                continue;
-                            }
-
-                            if (ngx_http_push_stream_add_msg_to_channel(mcf, r->connection->log, subscription->channel, ctx->frame->payload, ctx->frame->payload_len, NULL, NULL, cf->store_messages, ctx->temp_pool) != NGX_OK) {
-                                goto finalize;
-                            }
-                        }
-                    }
-                }
+    frame->payload = out;
+    frame->payload_len = size - zstream.avail_out;
 
-                if (ctx->frame->last_fragment) {
-                    ctx->frame->last_fragment = 0;
-                    ctx->frame->fragmented = 0;
-                    ngx_str_set(&ctx->frame->consolidated, "");
+    return NGX_OK;
+#else
+    return NGX_ERROR;
+#endif
+}
 
-                    if (ctx->temp_pool != NULL) {
-                        ngx_destroy_pool(ctx->temp_pool);
-                        ctx->temp_pool = NULL;
-                    }
-                }
-                ctx->frame->step = NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_START_STEP;
-                ctx->frame->payload = NULL;
-                ngx_http_push_stream_set_buffer(&ctx->frame->buf, ctx->frame->header, NULL, 8);
 
-                if (ctx->frame->opcode == NGX_HTTP_PUSH_STREAM_WEBSOCKET_PING_OPCODE) {
-                    ngx_http_push_stream_send_response_text(r, NGX_HTTP_PUSH_STREAM_WEBSOCKET_PONG_LAST_FRAME_BYTE, sizeof(NGX_HTTP_PUSH_STREAM_WEBSOCKET_PONG_LAST_FRAME_BYTE), 1);
-                }
+void
+ngx_http_push_stream_websocket_reading(ngx_http_request_t *r)
+{
+    ngx_http_push_stream_module_ctx_t *ctx = ngx_http_get_module_ctx(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_frame_t      *frame = ctx->frame;
+    ngx_int_t                          rc = NGX_OK;
+    ngx_event_t                       *rev;
+    ngx_connection_t                  *c;
+    ngx_buf_t                         *b;
+    ssize_t                            n;
 
-                if (ctx->frame->opcode == NGX_HTTP_PUSH_STREAM_WEBSOCKET_CLOSE_OPCODE) {
-                    goto close;
-                }
-                return;
+    c = r->connection;
+    rev = c->read;
 
-                break;
+    for (;;) {
+        if (c->error || c->timedout || c->close || c->destroyed || rev->closed || rev->eof) {
+            goto finalize;
+        }
 
-            default:
-                ngx_log_debug(NGX_LOG_DEBUG, c->log, 0, "push stream module: unknown websocket step (%d)", ctx->frame->step);
+        if (frame->step == NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_GET_PAYLOAD_STEP) {
+            // a payload which does not fit on the read buffer is received directly on its own memory
+            if ((rc = ngx_http_push_stream_recv(c, rev, &frame->buf, frame->payload_len)) != NGX_OK) {
+                goto exit;
+            }
+
+            frame->step = NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_START_STEP;
+            rc = ngx_http_push_stream_websocket_process_frame(r, ctx, frame->buf.start);
+            if (rc == NGX_DECLINED) {
+                goto close;
+            }
+
+            if (rc == NGX_ERROR) {
                 goto finalize;
-                break;
+            }
+        }
+
+        b = &frame->recv_buf;
+        if (b->start == NULL) {
+            if ((b->start = ngx_palloc(r->pool, NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_BUFFER_SIZE)) == NULL) {
+                ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate memory for websocket read buffer");
+                goto finalize;
+            }
+            b->pos = b->start;
+            b->last = b->start;
+            b->end = b->start + NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_BUFFER_SIZE;
+        }
+
+        // all complete frames received with one recv are handled at once
+        while ((rc = ngx_http_push_stream_websocket_parse_frame(r, ctx)) == NGX_OK) { /* void */ }
+
+        if (rc == NGX_DECLINED) {
+            goto close;
+        }
+
+        if (rc == NGX_ERROR) {
+            goto finalize;
+        }
+
+        if (frame->step == NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_GET_PAYLOAD_STEP) {
+            continue;
+        }
+
+        // keep the incomplete frame at the buffer beginning
+        if (b->pos != b->start) {
+            b->last = ngx_movemem(b->start, b->pos, b->last - b->pos);
+            b->pos = b->start;
+        }
+
+        n = c->recv(c, b->last, b->end - b->last);
+
+        if (n == NGX_AGAIN) {
+            rc = NGX_AGAIN;
+            goto exit;
+        }
+
+        if ((n == NGX_ERROR) || (n == 0)) {
+            rc = NGX_ERROR;
+            goto exit;
         }
+
+        b->last += n;
     }
 
 exit:
     if (rc == NGX_AGAIN) {
+        ngx_http_push_stream_websocket_release_read_buffers(r, ctx);
+
         if (!c->read->ready) {
             if (ngx_handle_read_event(c->read, 0) != NGX_OK) {
                 ngx_log_error(NGX_LOG_INFO, c->log, ngx_socket_errno, "push stream module: failed to restore read events");
@@ -439,6 +489,507 @@ finalize:
 }
 
 
+ngx_int_t
+ngx_http_push_stream_websocket_parse_frame(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx)
+{
+    ngx_http_push_stream_frame_t      *frame = ctx->frame;
+    ngx_buf_t                         *b = &frame->recv_buf;
+    u_char                            *p = b->pos;
+    size_t                             size = b->last - b->pos, header_len = 2, available;
+    uint64_t                           payload_len;
+    unsigned char                      fin, rsv1, mask, opcode;
+    uint16_t                           len16;
+    uint64_t                           len64;
+
+    if (size < header_len) {
+        return NGX_AGAIN;
+    }
+
+    fin    = (p[0] >> 7) & 1;
+    rsv1   = (p[0] >> 6) & 1;
+    opcode = p[0] & 0xf;
+    mask   = (p[1] >> 7) & 1;
+    payload_len = p[1] & 0x7f;
+
+    header_len += (payload_len == 126) ? 2 : ((payload_len == 127) ? 8 : 0);
+    header_len += mask ? 4 : 0;
+
+    if (size < header_len) {
+        return NGX_AGAIN;
+    }
+
+    if (payload_len == 126) {
+        ngx_memcpy(&len16, p + 2, 2);
+        payload_len = ntohs(len16);
+    } else if (payload_len == 127) {
+        ngx_memcpy(&len64, p + 2, 8);
+        payload_len = ngx_http_push_stream_ntohll(len64);
+    }
+
+    // the frame is only consumed when it is complete or does not fit on the buffer
+    available = size - header_len;
+    if ((available < payload_len) && (payload_len <= (uint64_t) (b->end - b->start) - header_len)) {
+        return NGX_AGAIN;
+    }
+
+    if (fin == 0) {
+        if (opcode == 0) {
+            if (!frame->fragmented) {
+                ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: wrong websocket frames sequence");
+                return NGX_DECLINED;
+            }
+        } else {
+            if (!frame->fragmented) {
+                frame->fragmented = 1;
+                frame->opcode = opcode;
+            }
+        }
+    } else {
+        if (opcode == 0) {
+            if (frame->fragmented) {
+                frame->last_fragment = 1;
+            } else {
+                ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: wrong websocket frames sequence");
+                return NGX_DECLINED;
+            }
+        } else {
+            if (frame->fragmented) {
+                ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: wrong websocket frames sequence");
+                return NGX_DECLINED;
+            } else {
+                frame->last_fragment = 1;
+                frame->opcode = opcode;
+            }
+        }
+    }
+
+    // only the first frame of a data message may be compressed
+    if (rsv1 && (!frame->deflate || ((opcode != NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE) && (opcode != NGX_HTTP_PUSH_STREAM_WEBSOCKET_BINARY_OPCODE)))) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unexpected compressed websocket frame");
+        return NGX_DECLINED;
+    }
+
+    if (opcode != 0) {
+        frame->compressed = rsv1;
+    }
+
+    frame->fin = fin;
+    frame->rsv1 = rsv1;
+    frame->mask = mask;
+    frame->payload_len = payload_len;
+    if (mask) {
+        ngx_memcpy(frame->mask_key, p + header_len - 4, 4);
+    }
+
+    b->pos += header_len;
+
+    if (available >= payload_len) {
+        p = b->pos;
+        b->pos += payload_len;
+        return ngx_http_push_stream_websocket_process_frame(r, ctx, p);
+    }
+
+    // the payload is larger than the read buffer
+    if ((ctx->temp_pool == NULL) && ((ctx->temp_pool = ngx_create_pool(4096, r->connection->log)) == NULL)) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate memory for temporary pool");
+        return NGX_ERROR;
+    }
+
+    if ((p = ngx_palloc(ctx->temp_pool, payload_len)) == NULL) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate memory for payload");
+        return NGX_ERROR;
+    }
+
+    ngx_http_push_stream_set_buffer(&frame->buf, p, ngx_cpymem(p, b->pos, available), payload_len);
+    b->pos = b->last;
+    frame->step = NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_GET_PAYLOAD_STEP;
+
+    return NGX_AGAIN;
+}
+
+
+ngx_int_t
+ngx_http_push_stream_websocket_process_frame(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx, u_char *payload)
+{
+    ngx_http_push_stream_main_conf_t  *mcf = ngx_http_get_module_main_conf(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_loc_conf_t   *cf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_frame_t      *frame = ctx->frame;
+    ngx_queue_t                       *q;
+    ngx_chain_t                       *cl;
+    u_char                            *last;
+    ngx_int_t                          rc;
+    const ngx_str_t                   *explain;
+
+    if (
+        (frame->opcode != NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE) &&
+        (frame->opcode != NGX_HTTP_PUSH_STREAM_WEBSOCKET_BINARY_OPCODE) &&
+        (frame->opcode != NGX_HTTP_PUSH_STREAM_WEBSOCKET_CLOSE_OPCODE) &&
+        (frame->opcode != NGX_HTTP_PUSH_STREAM_WEBSOCKET_PING_OPCODE) &&
+        (frame->opcode != NGX_HTTP_PUSH_STREAM_WEBSOCKET_PONG_OPCODE)
+       ) {
+        return NGX_DECLINED;
+    }
+
+    frame->payload = payload;
+
+    if (frame->payload_len > 0) {
+        //create a temporary pool to allocate temporary elements, kept while frames are arriving
+        if (ctx->temp_pool == NULL) {
+            if ((ctx->temp_pool = ngx_create_pool(4096, r->connection->log)) == NULL) {
+                ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate memory for temporary pool");
+                return NGX_ERROR;
+            }
+        }
+
+        if (frame->mask) {
+            ngx_http_push_stream_websocket_unmask(frame->payload, frame->payload_len, frame->mask_key);
+        }
+
+        if (frame->fragmented) {
+            // fragments are kept apart and joined only once, when the message is complete
+            if ((cl = ngx_alloc_chain_link(ctx->temp_pool)) == NULL) {
+                ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate memory for websocket fragment");
+                return NGX_ERROR;
+            }
+
+            if ((cl->buf = ngx_create_temp_buf(ctx->temp_pool, frame->payload_len)) == NULL) {
+                ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate memory for websocket fragment of %uL bytes", frame->payload_len);
+                return NGX_ERROR;
+            }
+
+            cl->buf->last = ngx_cpymem(cl->buf->pos, frame->payload, frame->payload_len);
+            cl->next = NULL;
+            *frame->fragments_last = cl;
+            frame->fragments_last = &cl->next;
+            frame->fragments_len += frame->payload_len;
+        }
+    }
+
+    if (frame->last_fragment && frame->fragmented) {
+        frame->payload = NULL;
+        frame->payload_len = frame->fragments_len;
+
+        if (frame->fragments_len > 0) {
+            if ((frame->payload = ngx_palloc(ctx->temp_pool, frame->fragments_len)) == NULL) {
+                ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate memory for consolidated payload for %uz bytes", frame->fragments_len);
+                return NGX_ERROR;
+            }
+
+            last = frame->payload;
+            for (cl = frame->fragments; cl != NULL; cl = cl->next) {
+                last = ngx_cpymem(last, cl->buf->pos, cl->buf->last - cl->buf->pos);
+            }
+        }
+    }
+
+    if (frame->last_fragment && (frame->payload_len > 0) && ((frame->opcode == NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE) || (frame->opcode == NGX_HTTP_PUSH_STREAM_WEBSOCKET_BINARY_OPCODE))) {
+        if (frame->compressed && (ngx_http_push_stream_websocket_inflate(r, frame, ctx->temp_pool) != NGX_OK)) {
+            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to inflate websocket message");
+            return NGX_ERROR;
+        }
+
+        // the whole text message is validated, a character may be split between fragments
+        if ((frame->opcode == NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE) && !ngx_http_push_stream_is_utf8(frame->payload, frame->payload_len)) {
+            return NGX_ERROR;
+        }
+
+        if (cf->location_type == NGX_HTTP_PUSH_STREAM_PUBLISHER_MODE_BATCH) {
+            // the records of one message are published together, or none of them when one is invalid
+            if ((rc = ngx_http_push_stream_publish_batch(r, frame->payload, frame->payload + frame->payload_len, ctx->temp_pool, ctx->temp_pool, &explain)) != NGX_HTTP_OK) {
+                ngx_http_push_stream_send_websocket_close_frame(r, rc, (explain != NULL) ? explain : &NGX_HTTP_PUSH_STREAM_EMPTY);
+                return NGX_ERROR;
+            }
+        } else if (cf->websocket_allow_subscribe && (frame->opcode == NGX_HTTP_PUSH_STREAM_WEBSOCKET_TEXT_OPCODE) && ((rc = ngx_http_push_stream_websocket_control(r, ctx)) != NGX_DECLINED)) {
+            // subscription commands are not published
+            if (rc != NGX_OK) {
+                return NGX_ERROR;
+            }
+        } else if (cf->websocket_allow_publish) {
+            // a message over the publish rate is dropped, the connection is kept
+            if (ngx_http_push_stream_websocket_check_publish_rate(mcf, ctx->subscriber, frame->payload_len) != NGX_OK) {
+                ngx_log_error(NGX_LOG_INFO, r->connection->log, 0, "push stream module: publish rate limit exceeded, websocket message dropped");
+            } else {
+                for (q = ngx_queue_head(&ctx->subscriber->subscriptions); q != ngx_queue_sentinel(&ctx->subscriber->subscriptions); q = ngx_queue_next(q)) {
+                    ngx_http_push_stream_subscription_t *subscription = ngx_queue_data(q, ngx_http_push_stream_subscription_t, queue);
+                    if (subscription->channel->for_events) {
+                        // skip events channel on publish by websocket connections
+                        continue;
+                    }
+
+                    if (ngx_http_push_stream_add_msg_to_channel(mcf, r->connection->log, subscription->channel, frame->payload, frame->payload_len, NULL, NULL, NULL, frame->opcode, cf->store_messages, 0, ctx->temp_pool) != NGX_OK) {
+                        return NGX_ERROR;
+                    }
+                }
+            }
+        }
+    }
+
+    frame->payload = NULL;
+
+    if (frame->last_fragment) {
+        frame->last_fragment = 0;
+        frame->fragmented = 0;
+        frame->compressed = 0;
+        frame->fragments = NULL;
+        frame->fragments_last = &frame->fragments;
+        frame->fragments_len = 0;
+
+        // memory is reused by the next messages received on the same read event
+        if (ctx->temp_pool != NULL) {
+            ngx_reset_pool(ctx->temp_pool);
+        }
+    }
+
+    if (frame->opcode == NGX_HTTP_PUSH_STREAM_WEBSOCKET_PING_OPCODE) {
+        ngx_http_push_stream_send_response_text(r, NGX_HTTP_PUSH_STREAM_WEBSOCKET_PONG_LAST_FRAME_BYTE, sizeof(NGX_HTTP_PUSH_STREAM_WEBSOCKET_PONG_LAST_FRAME_BYTE), 1);
+    }
+
+    if (frame->opcode == NGX_HTTP_PUSH_STREAM_WEBSOCKET_CLOSE_OPCODE) {
+        return NGX_DECLINED;
+    }
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_http_push_stream_websocket_control(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx)
+{
+    ngx_http_push_stream_main_conf_t               *mcf = ngx_http_get_module_main_conf(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_loc_conf_t                *cf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_frame_t                   *frame = ctx->frame;
+    ngx_http_push_stream_requested_channel_t       *requested_channels, *requested_channel;
+    ngx_http_push_stream_subscription_t            *subscription;
+    ngx_queue_t                                    *q, *next, *q_subscription;
+    ngx_str_t                                       path, name, value, *last_event_id = NULL, *explain_error_message;
+    ngx_int_t                                       status_code, tag = -1;
+    time_t                                          if_modified_since = -1;
+    ngx_flag_t                                      subscribe;
+    u_char                                         *p, *last, *end, *colon;
+
+    p = frame->payload;
+    last = frame->payload + frame->payload_len;
+
+    if ((frame->payload_len > NGX_HTTP_PUSH_STREAM_WEBSOCKET_SUBSCRIBE_COMMAND.len) && (ngx_strncmp(p, NGX_HTTP_PUSH_STREAM_WEBSOCKET_SUBSCRIBE_COMMAND.data, NGX_HTTP_PUSH_STREAM_WEBSOCKET_SUBSCRIBE_COMMAND.len) == 0)) {
+        subscribe = 1;
+        p += NGX_HTTP_PUSH_STREAM_WEBSOCKET_SUBSCRIBE_COMMAND.len;
+    } else if ((frame->payload_len > NGX_HTTP_PUSH_STREAM_WEBSOCKET_UNSUBSCRIBE_COMMAND.len) && (ngx_strncmp(p, NGX_HTTP_PUSH_STREAM_WEBSOCKET_UNSUBSCRIBE_COMMAND.data, NGX_HTTP_PUSH_STREAM_WEBSOCKET_UNSUBSCRIBE_COMMAND.len) == 0)) {
+        subscribe = 0;
+        p += NGX_HTTP_PUSH_STREAM_WEBSOCKET_UNSUBSCRIBE_COMMAND.len;
+    } else {
+        return NGX_DECLINED;
+    }
+
+    // the first line has the channels path, the next ones the values used to resume the new subscriptions
+    if ((end = ngx_strlchr(p, last, '\n')) == NULL) {
+        end = last;
+    }
+    path.data = p;
+    path.len = ((end > p) && (*(end - 1) == '\r')) ? end - p - 1 : end - p;
+
+    while (end < last) {
+        p = end + 1;
+        if ((end = ngx_strlchr(p, last, '\n')) == NULL) {
+            end = last;
+        }
+
+        if ((colon = ngx_strlchr(p, end, ':')) == NULL) {
+            continue;
+        }
+
+        name.data = p;
+        name.len = colon - p;
+        for (value.data = colon + 1; (value.data < end) && (*value.data == ' '); value.data++) { /* void */ }
+        value.len = ((end > value.data) && (*(end - 1) == '\r')) ? end - value.data - 1 : end - value.data;
+
+        if ((name.len == NGX_HTTP_PUSH_STREAM_HEADER_IF_MODIFIED_SINCE.len) && (ngx_strncasecmp(name.data, NGX_HTTP_PUSH_STREAM_HEADER_IF_MODIFIED_SINCE.data, name.len) == 0)) {
+            if_modified_since = value.len ? ngx_http_parse_time(value.data, value.len) : -1;
+        } else if ((name.len == NGX_HTTP_PUSH_STREAM_HEADER_IF_NONE_MATCH.len) && (ngx_strncasecmp(name.data, NGX_HTTP_PUSH_STREAM_HEADER_IF_NONE_MATCH.data, name.len) == 0)) {
+            tag = ((tag = ngx_atoi(value.data, value.len)) != NGX_ERROR) ? ngx_abs(tag) : -1;
+        } else if ((name.len == NGX_HTTP_PUSH_STREAM_HEADER_LAST_EVENT_ID.len) && (ngx_strncasecmp(name.data, NGX_HTTP_PUSH_STREAM_HEADER_LAST_EVENT_ID.data, name.len) == 0) && (value.len > 0)) {
+            if ((last_event_id = ngx_http_push_stream_create_str(ctx->temp_pool, value.len)) == NULL) {
+                ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "push stream module: unable to allocate memory for last event id");
+                return NGX_ERROR;
+            }
+            ngx_memcpy(last_event_id->data, value.data, value.len);
+        }
+    }
+
+    if (((requested_channels = ngx_http_push_stream_parse_channels_ids(r, &path, ctx->temp_pool)) == NULL) || ngx_queue_empty(&requested_channels->queue)) {
+        ngx_log_error(NGX_LOG_WARN, r->connection->log, 0, "push stream module: websocket command without channels");
+        return NGX_OK;
+    }
+
+    if (!subscribe) {
+        return ngx_http_push_stream_websocket_unsubscribe(r, ctx, requested_channels);
+    }
+
+    // remove channels already subscribed from the request
+    for (q = ngx_queue_head(&requested_channels->queue); q != ngx_queue_sentinel(&requested_channels->queue); q = next) {
+        next = ngx_queue_next(q);
+        requested_channel = ngx_queue_data(q, ngx_http_push_stream_requested_channel_t, queue);
+
+        for (q_subscription = ngx_queue_head(&ctx->subscriber->subscriptions); q_subscription != ngx_queue_sentinel(&ctx->subscriber->subscriptions); q_subscription = ngx_queue_next(q_subscription)) {
+            subscription = ngx_queue_data(q_subscription, ngx_http_push_stream_subscription_t, queue);
+            if (ngx_memn2cmp(subscription->channel->id.data, requested_channel->id->data, subscription->channel->id.len, requested_channel->id->len) == 0) {
+                ngx_queue_remove(q);
+                break;
+            }
+        }
+    }
+
+    if (ngx_queue_empty(&requested_channels->queue)) {
+        return NGX_OK;
+    }
+
+    // the same rules applied to the channels used when the connection was opened, counting the ones already subscribed
+    if (ngx_http_push_stream_validate_channels(r, requested_channels, ctx->subscriber, &status_code, &explain_error_message) == NGX_ERROR) {
+        ngx_log_error(NGX_LOG_WARN, r->connection->log, 0, "push stream module: websocket subscription refused: %V", explain_error_message);
+        return NGX_OK;
+    }
+
+    for (q = ngx_queue_head(&requested_channels->queue); q != ngx_queue_sentinel(&requested_channels->queue); q = ngx_queue_next(q)) {
+        requested_channel = ngx_queue_data(q, ngx_http_push_stream_requested_channel_t, queue);
+        if (ngx_http_push_stream_subscriber_assign_channel(mcf, cf, r, requested_channel, if_modified_since, tag, last_event_id, ctx->subscriber, ctx->temp_pool) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    ngx_http_push_stream_update_subscriber_memory(r);
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_http_push_stream_websocket_check_publish_rate(ngx_http_push_stream_main_conf_t *mcf, ngx_http_push_stream_subscriber_t *subscriber, size_t len)
+{
+    ngx_http_push_stream_subscription_t    *subscription;
+    ngx_queue_t                            *q, *q_taken;
+
+    // the message is published on all subscribed channels or on none of them
+    for (q = ngx_queue_head(&subscriber->subscriptions); q != ngx_queue_sentinel(&subscriber->subscriptions); q = ngx_queue_next(q)) {
+        subscription = ngx_queue_data(q, ngx_http_push_stream_subscription_t, queue);
+        if (subscription->channel->for_events || ngx_http_push_stream_take_channel_publish_tokens(mcf, subscription->channel, len)) {
+            continue;
+        }
+
+        for (q_taken = ngx_queue_head(&subscriber->subscriptions); q_taken != q; q_taken = ngx_queue_next(q_taken)) {
+            subscription = ngx_queue_data(q_taken, ngx_http_push_stream_subscription_t, queue);
+            if (!subscription->channel->for_events) {
+                ngx_http_push_stream_give_back_channel_publish_tokens(mcf, subscription->channel, len);
+            }
+        }
+
+        return NGX_DECLINED;
+    }
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_http_push_stream_websocket_unsubscribe(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx, ngx_http_push_stream_requested_channel_t *requested_channels)
+{
+    ngx_http_push_stream_loc_conf_t                *cf = ngx_http_get_module_loc_conf(r, ngx_http_push_stream_module);
+    ngx_http_push_stream_requested_channel_t       *requested_channel;
+    ngx_http_push_stream_subscription_t            *subscription;
+    ngx_queue_t                                    *q, *next, *q_channel;
+    ngx_uint_t                                      remaining_channels_qtd = 0, remaining_wildcard_channels_qtd = 0;
+    ngx_flag_t                                      requested;
+
+    // mark the subscriptions to be removed and count the remaining ones before changing anything
+    for (q = ngx_queue_head(&ctx->subscriber->subscriptions); q != ngx_queue_sentinel(&ctx->subscriber->subscriptions); q = ngx_queue_next(q)) {
+        subscription = ngx_queue_data(q, ngx_http_push_stream_subscription_t, queue);
+
+        requested = 0;
+        for (q_channel = ngx_queue_head(&requested_channels->queue); q_channel != ngx_queue_sentinel(&requested_channels->queue); q_channel = ngx_queue_next(q_channel)) {
+            requested_channel = ngx_queue_data(q_channel, ngx_http_push_stream_requested_channel_t, queue);
+            if (ngx_memn2cmp(subscription->channel->id.data, requested_channel->id->data, subscription->channel->id.len, requested_channel->id->len) == 0) {
+                requested = 1;
+                break;
+            }
+        }
+
+        if (!requested) {
+            remaining_channels_qtd++;
+            if (subscription->channel->wildcard) {
+                remaining_wildcard_channels_qtd++;
+            }
+        }
+    }
+
+    // the connection can not be left subscribed only to wildcard channels
+    if ((cf->wildcard_channel_max_qtd != NGX_CONF_UNSET_UINT) && (remaining_wildcard_channels_qtd > 0) && (remaining_wildcard_channels_qtd == remaining_channels_qtd)) {
+        ngx_log_error(NGX_LOG_WARN, r->connection->log, 0, "push stream module: websocket unsubscription refused: %V", &NGX_HTTP_PUSH_STREAM_TOO_MUCH_WILDCARD_CHANNELS);
+        return NGX_OK;
+    }
+
+    for (q_channel = ngx_queue_head(&requested_channels->queue); q_channel != ngx_queue_sentinel(&requested_channels->queue); q_channel = ngx_queue_next(q_channel)) {
+        requested_channel = ngx_queue_data(q_channel, ngx_http_push_stream_requested_channel_t, queue);
+
+        for (q = ngx_queue_head(&ctx->subscriber->subscriptions); q != ngx_queue_sentinel(&ctx->subscriber->subscriptions); q = next) {
+            next = ngx_queue_next(q);
+            subscription = ngx_queue_data(q, ngx_http_push_stream_subscription_t, queue);
+            if (ngx_memn2cmp(subscription->channel->id.data, requested_channel->id->data, subscription->channel->id.len, requested_channel->id->len) == 0) {
+                ngx_http_push_stream_remove_subscription(subscription, ctx->temp_pool);
+                ngx_queue_insert_tail(&ctx->free_subscriptions, &subscription->queue);
+                break;
+            }
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+void
+ngx_http_push_stream_websocket_release_read_buffers(ngx_http_request_t *r, ngx_http_push_stream_module_ctx_t *ctx)
+{
+    ngx_http_push_stream_frame_t      *frame = ctx->frame;
+    ngx_buf_t                         *b = &frame->recv_buf;
+
+    // idle connections do not hold memory to read frames
+    if ((frame->step != NGX_HTTP_PUSH_STREAM_WEBSOCKET_READ_START_STEP) || frame->fragmented) {
+        return;
+    }
+
+    if (ctx->temp_pool != NULL) {
+        ngx_destroy_pool(ctx->temp_pool);
+        ctx->temp_pool = NULL;
+    }
+
+    if ((b->start != NULL) && (b->pos == b->last) && (ngx_pfree(r->pool, b->start) == NGX_OK)) {
+        b->start = NULL;
+    }
+}
+
+
+void
+ngx_http_push_stream_websocket_unmask(u_char *payload, uint64_t len, u_char *mask_key)
+{
+    u_char      *p = payload, *last = payload + len;
+    uint64_t     mask, word;
+    ngx_uint_t   i;
+
+    // the key starts on the first byte of the payload, a word of 8 bytes always starts at the key beginning
+    for (i = 0; i < sizeof(uint64_t); i++) {
+        ((u_char *) &mask)[i] = mask_key[i % 4];
+    }
+
+    while ((size_t) (last - p) >= sizeof(uint64_t)) {
+        ngx_memcpy(&word, p, sizeof(uint64_t));
+        word ^= mask;
+        ngx_memcpy(p, &word, sizeof(uint64_t));
+        p += sizeof(uint64_t);
+    }
+
+    for (i = 0; p < last; i++, p++) {
+        *p ^= mask_key[i % 4];
+    }
+}
+
+
 ngx_int_t
 ngx_http_push_stream_recv(ngx_connection_t *c, ngx_event_t *rev, ngx_buf_t *buf, ssize_t len)
 {
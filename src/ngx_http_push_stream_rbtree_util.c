@@ -39,6 +39,7 @@ ngx_http_push_stream_find_channel_on_tree(ngx_str_t *id, ngx_log_t *log, ngx_rbt
     uint32_t                            hash;
     ngx_rbtree_node_t                  *node, *sentinel;
     ngx_int_t                           rc;
+    ngx_uint_t                          depth = 0;
     ngx_http_push_stream_channel_t     *channel = NULL;
 
     hash = ngx_crc32_short(id->data, id->len);
@@ -46,7 +47,7 @@ ngx_http_push_stream_find_channel_on_tree(ngx_str_t *id, ngx_log_t *log, ngx_rbt
     node = tree->root;
     sentinel = tree->sentinel;
 
-    while ((node != NULL) && (node != sentinel)) {
+    while ((node != NULL) && (node != sentinel) && (depth++ < NGX_HTTP_PUSH_STREAM_TREE_MAX_DEPTH)) {
         if (hash < node->key) {
             node = node->left;
             continue;
@@ -78,12 +79,24 @@ ngx_http_push_stream_find_channel(ngx_str_t *id, ngx_log_t *log, ngx_http_push_s
 {
     ngx_http_push_stream_shm_data_t    *data = mcf->shm_data;
     ngx_http_push_stream_channel_t     *channel = NULL;
+    ngx_atomic_uint_t                   version;
 
     if (id == NULL) {
         ngx_log_error(NGX_LOG_ERR, log, 0, "push stream module: tried to find a channel with a null id");
         return NULL;
     }
 
+    // look without the lock first, removed channels are only released some seconds after leaving the tree
+    version = data->tree_version;
+    if (!(version & 1)) {
+        ngx_memory_barrier();
+        channel = ngx_http_push_stream_find_channel_on_tree(id, log, &data->tree);
+        ngx_memory_barrier();
+        if (data->tree_version == version) {
+            return channel;
+        }
+    }
+
     ngx_shmtx_lock(&data->channels_queue_mutex);
     channel = ngx_http_push_stream_find_channel_on_tree(id, log, &data->tree);
     ngx_shmtx_unlock(&data->channels_queue_mutex);
@@ -145,12 +158,15 @@ ngx_http_push_stream_get_channel(ngx_str_t *id, ngx_log_t *log, ngx_http_push_st
 
     channel->wildcard = is_wildcard_channel;
     channel->channel_deleted_message = NULL;
+    channel->snapshot_message = NULL;
     channel->last_message_id = 0;
     channel->last_message_time = 0;
     channel->last_message_tag = 0;
+    channel->last_message_version = 0;
     channel->stored_messages = 0;
     channel->subscribers = 0;
     channel->deleted = 0;
+    ngx_memzero(&channel->publish_bucket, sizeof(ngx_http_push_stream_publish_bucket_t));
     channel->for_events = ((mcf->events_channel_id.len > 0) && (channel->id.len == mcf->events_channel_id.len) && (ngx_strncmp(channel->id.data, mcf->events_channel_id.data, mcf->events_channel_id.len) == 0));
     channel->expires = ngx_time() + mcf->channel_inactivity_time;
 
@@ -158,7 +174,9 @@ ngx_http_push_stream_get_channel(ngx_str_t *id, ngx_log_t *log, ngx_http_push_st
     ngx_queue_init(&channel->workers_with_subscribers);
 
     channel->node.key = ngx_crc32_short(channel->id.data, channel->id.len);
+    NGX_HTTP_PUSH_STREAM_VERSION_WRITE_BEGIN(data->tree_version);
     ngx_rbtree_insert(&data->tree, &channel->node);
+    NGX_HTTP_PUSH_STREAM_VERSION_WRITE_END(data->tree_version);
     ngx_queue_insert_tail(&data->channels_queue, &channel->queue);
     (channel->wildcard) ? data->wildcard_channels++ : data->channels++;
 